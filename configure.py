@@ -17,7 +17,7 @@ writer = generator.writer
 toolchain = generator.toolchain
 
 mdns_lib = generator.lib( module = 'mdns', sources = [
-  'discovery.c', 'mdns.c', 'query.c', 'record.c', 'service.c', 'socket.c', 'string.c', 'version.c' ] )
+  'builder.c', 'cache.c', 'discovery.c', 'loop.c', 'mdns.c', 'packet.c', 'querier.c', 'query.c', 'record.c', 'send.c', 'service.c', 'socket.c', 'stats.c', 'store.c', 'string.c', 'template.c', 'txt.c', 'version.c' ] )
 
 extralibs = []
 if target.is_windows():
@@ -27,6 +27,8 @@ if not target.is_ios() and not target.is_android():
   configs = [ config for config in toolchain.configs if config not in [ 'profile', 'deploy' ] ]
   if not configs == []:
     generator.bin( 'mdns', [ 'main.c' ], 'mdns', basepath = 'tools', implicit_deps = [ mdns_lib ], dependlibs = dependlibs, libs = extralibs, configs = configs )
+    generator.bin( 'bench', [ 'main.c' ], 'bench-mdns', basepath = 'tools', implicit_deps = [ mdns_lib ], dependlibs = dependlibs, libs = extralibs, configs = configs )
+    generator.bin( 'replay', [ 'main.c' ], 'replay-mdns', basepath = 'tools', implicit_deps = [ mdns_lib ], dependlibs = dependlibs, libs = extralibs, configs = configs )
 
 if generator.skip_tests():
   sys.exit()
@@ -34,8 +36,16 @@ if generator.skip_tests():
 includepaths = generator.test_includepaths()
 
 test_cases = [
-  'dnssd'
+  'dnssd',
+  'literal',
+  'packet'
 ]
+#Test cases written in C++, linked with the C++ runtime
+test_cxx_cases = [
+  'literal'
+]
+def test_sources(test):
+  return ['main.cpp' if test in test_cxx_cases else 'main.c']
 if toolchain.is_monolithic() or target.is_ios() or target.is_android() or target.is_tizen():
   #Build one fat binary with all test cases
   test_resources = []
@@ -55,13 +65,13 @@ if toolchain.is_monolithic() or target.is_ios() or target.is_android() or target
     ]]
   dependlibs = ['test'] + dependlibs
   if target.is_macos() or target.is_ios() or target.is_android() or target.is_tizen():
-    generator.app(module = '', sources = [os.path.join(module, 'main.c') for module in test_cases] + test_extrasources, binname = 'test-mdns', basepath = 'test', implicit_deps = [mdns_lib], libs = dependlibs, dependlibs = dependlibs, resources = test_resources, includepaths = includepaths)
+    generator.app(module = '', sources = [os.path.join(module, source) for module in test_cases for source in test_sources(module)] + test_extrasources, binname = 'test-mdns', basepath = 'test', implicit_deps = [mdns_lib], libs = dependlibs, dependlibs = dependlibs, resources = test_resources, includepaths = includepaths, variables = {'runtime': 'c++'})
   else:
-    generator.bin(module = '', sources = [os.path.join(module, 'main.c') for module in test_cases] + test_extrasources, binname = 'test-mdns', basepath = 'test', implicit_deps = [mdns_lib], libs = dependlibs, dependlibs = dependlibs, resources = test_resources, includepaths = includepaths)
+    generator.bin(module = '', sources = [os.path.join(module, source) for module in test_cases for source in test_sources(module)] + test_extrasources, binname = 'test-mdns', basepath = 'test', implicit_deps = [mdns_lib], libs = dependlibs, dependlibs = dependlibs, resources = test_resources, includepaths = includepaths, variables = {'runtime': 'c++'})
 else:
   #Build one binary per test case
   if not generator.is_subninja:
     generator.bin(module = 'all', sources = ['main.c'], binname = 'test-all', basepath = 'test', implicit_deps = [mdns_lib], libs = dependlibs + extralibs, dependlibs = dependlibs, includepaths = includepaths)
   dependlibs = ['test'] + dependlibs
   for test in test_cases:
-    generator.bin(module = test, sources = ['main.c'], binname = 'test-' + test, basepath = 'test', implicit_deps = [mdns_lib], libs = dependlibs + extralibs, dependlibs = dependlibs, includepaths = includepaths)
+    generator.bin(module = test, sources = test_sources(test), binname = 'test-' + test, basepath = 'test', implicit_deps = [mdns_lib], libs = dependlibs + extralibs, dependlibs = dependlibs, includepaths = includepaths, variables = {'runtime': 'c++'} if test in test_cxx_cases else None)
@@ -43,3 +43,37 @@
 
 #define MDNS_QUERY_SIZE_DEFAULT 512
 #define MDNS_DISCOVERY_SIZE_DEFAULT 512
+#define MDNS_RECV_BATCH_MAX 64
+#define MDNS_SEND_BATCH_MAX 64
+#define MDNS_LOOP_SOCKETS_MAX 32
+#define MDNS_LOOP_TIMERS_MAX 32
+#define MDNS_LOOP_DATAGRAM_SIZE 9000
+#define MDNS_PACKET_INDEX_MAX 256
+#define MDNS_STRING_TABLE_SIZE 1024
+#define MDNS_STRING_TABLE_BUCKETS 512
+#define MDNS_STRING_CONTEXT_SIZE 64
+#define MDNS_STRING_CONTEXT_BUCKETS 32
+#define MDNS_STRING_CONTEXT_TEXT_SIZE 2048
+#define MDNS_STORE_BUFFER_SIZE 2048
+#define MDNS_STORE_ANSWER_MAX 32
+#define MDNS_STORE_ADDITIONAL_MAX 32
+#define MDNS_STORE_TTL_DEFAULT 120
+#define MDNS_STORE_PENDING_SOCKETS 4
+#define MDNS_STORE_PACKET_SIZE 1440
+#define MDNS_CACHE_WHEEL_BITS 6
+#define MDNS_CACHE_WHEEL_LEVELS 4
+#define MDNS_CACHE_TXT_MAX 32
+#define MDNS_CACHE_REFRESH_MAX 64
+#define MDNS_QUERIER_QUESTIONS_MAX 32
+#define MDNS_QUERIER_INTERVAL_MAX 3600
+#define MDNS_TEMPLATE_SIZE 1440
+#define MDNS_TEMPLATE_RECORDS_MAX 32
+#define MDNS_SPLIT_PACKET_SIZE 1440
+#define MDNS_SPLIT_ADDITIONAL_MAX 64
+#define MDNS_SPLIT_ANSWER_MAX 64
+#define MDNS_TXT_SIZE 1300
+#define MDNS_TXT_ENTRIES_MAX 64
+#define MDNS_RECORD_TXT_INDEX_MAX 64
+#define MDNS_STATS_THREADS_MAX 64
+#define MDNS_STATS_SOCKETS_MAX 32
+#define MDNS_STATS_SOCKET_PROBES 4
@@ -0,0 +1,357 @@
+/* builder.c  -  mDNS library  -  Public Domain  -  2014 Mattias Jansson
+ *
+ * This library provides a cross-platform mDNS and DNS-SD library in C based
+ * on our foundation and network libraries. The implementation is based on RFC 6762
+ * and RFC 6763.
+ *
+ * The latest source code maintained by Mattias Jansson is always available at
+ *
+ * https://github.com/mjansson/mdns_lib
+ *
+ * The foundation and network library source code maintained by Mattias Jansson
+ * is always available at
+ *
+ * https://github.com/mjansson/foundation_lib
+ * https://github.com/mjansson/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify
+ * it without any restrictions.
+ *
+ */
+
+
+#include <mdns/mdns.h>
+#include <mdns/internal.h>
+#include <foundation/foundation.h>
+#include <network/network.h>
+
+// Start a new packet with an empty header in the buffer
+static int
+mdns_builder_restart(mdns_builder_t* builder) {
+	builder->size = 0;
+	builder->section = MDNS_ENTRYTYPE_QUESTION;
+	memset(builder->count, 0, sizeof(builder->count));
+	builder->txt_length_offset = 0;
+	builder->txt_name_offset = 0;
+	mdns_string_table_initialize(&builder->string_table);
+	if (builder->capacity < sizeof(struct mdns_header_t))
+		return -1;
+
+	struct mdns_header_t* header = (struct mdns_header_t*)builder->buffer;
+	header->query_id = htons(builder->query_id);
+	header->flags = htons(builder->flags);
+	header->questions = 0;
+	header->answer_rrs = 0;
+	header->authority_rrs = 0;
+	header->additional_rrs = 0;
+	builder->size = sizeof(struct mdns_header_t);
+	return 0;
+}
+
+int
+mdns_builder_initialize(mdns_builder_t* builder, void* buffer, size_t capacity, uint16_t query_id, uint16_t flags) {
+	builder->buffer = buffer;
+	builder->capacity = capacity;
+	builder->query_id = query_id;
+	builder->flags = flags;
+	builder->flush = 0;
+	builder->flush_data = 0;
+	builder->truncate = false;
+	builder->packets = 0;
+	return mdns_builder_restart(builder);
+}
+
+void
+mdns_builder_set_flush(mdns_builder_t* builder, mdns_builder_flush_fn flush, void* user_data, bool truncate) {
+	builder->flush = flush;
+	builder->flush_data = user_data;
+	builder->truncate = truncate;
+}
+
+static bool
+mdns_builder_is_empty(const mdns_builder_t* builder) {
+	return !builder->count[MDNS_ENTRYTYPE_QUESTION] && !builder->count[MDNS_ENTRYTYPE_ANSWER] &&
+	       !builder->count[MDNS_ENTRYTYPE_AUTHORITY] && !builder->count[MDNS_ENTRYTYPE_ADDITIONAL];
+}
+
+// Pass the current packet to the flush callback and start a new one. If truncated is set the packet
+// is continued in the next one and the TC bit is set if requested (RFC 6762 section 7.2)
+static int
+mdns_builder_emit(mdns_builder_t* builder, bool truncated) {
+	if (!builder->size || mdns_builder_is_empty(builder))
+		return 0;
+	if (truncated && builder->truncate) {
+		struct mdns_header_t* header = (struct mdns_header_t*)builder->buffer;
+		header->flags = htons((uint16_t)(builder->flags | MDNS_FLAG_TRUNCATED));
+	}
+	int result = builder->flush ? builder->flush(builder->buffer, builder->size, builder->flush_data) : 0;
+	++builder->packets;
+	mdns_builder_restart(builder);
+	return result;
+}
+
+int
+mdns_builder_flush(mdns_builder_t* builder) {
+	return mdns_builder_emit(builder, false);
+}
+
+size_t
+mdns_builder_packets(const mdns_builder_t* builder) {
+	return builder->packets;
+}
+
+void
+mdns_builder_mark(const mdns_builder_t* builder, mdns_builder_mark_t* mark) {
+	mark->size = builder->size;
+	mark->string_count = builder->string_table.count;
+	mark->section = builder->section;
+	memcpy(mark->count, builder->count, sizeof(mark->count));
+	mark->txt_length_offset = builder->txt_length_offset;
+	mark->txt_name_offset = builder->txt_name_offset;
+	mark->txt_length = 0;
+	if (builder->txt_length_offset)
+		mark->txt_length = mdns_ntohs(pointer_offset(builder->buffer, builder->txt_length_offset));
+}
+
+// Restore the packet to the given size, dropping dictionary entries for names written past it.
+// Entries are pushed onto the bucket chain heads in order, so they are popped in reverse
+static void
+mdns_builder_truncate(mdns_builder_t* builder, size_t size, size_t string_count) {
+	mdns_string_table_t* string_table = &builder->string_table;
+	while (string_table->count > string_count) {
+		const mdns_string_table_entry_t* entry = string_table->entry + (--string_table->count);
+		string_table->bucket[entry->hash & (MDNS_STRING_TABLE_BUCKETS - 1)] = entry->next;
+	}
+	builder->size = size;
+}
+
+static void
+mdns_builder_set_count(mdns_builder_t* builder, mdns_entry_type_t section) {
+	++builder->count[section];
+	struct mdns_header_t* header = (struct mdns_header_t*)builder->buffer;
+	uint16_t* count = &header->questions + (size_t)section;
+	*count = htons(builder->count[section]);
+}
+
+void
+mdns_builder_rollback(mdns_builder_t* builder, const mdns_builder_mark_t* mark) {
+	mdns_builder_truncate(builder, mark->size, mark->string_count);
+	builder->section = mark->section;
+	struct mdns_header_t* header = (struct mdns_header_t*)builder->buffer;
+	uint16_t* count = &header->questions;
+	for (size_t isection = 0; isection < 4; ++isection) {
+		builder->count[isection] = mark->count[isection];
+		count[isection] = htons(mark->count[isection]);
+	}
+	// A TXT record may have had strings appended after the mark
+	builder->txt_length_offset = mark->txt_length_offset;
+	builder->txt_name_offset = mark->txt_name_offset;
+	if (mark->txt_length_offset)
+		mdns_htons(pointer_offset(builder->buffer, mark->txt_length_offset), mark->txt_length);
+}
+
+int
+mdns_builder_add_question(mdns_builder_t* builder, mdns_record_type_t type, const char* name, size_t length,
+                          uint16_t rclass) {
+	if ((builder->section != MDNS_ENTRYTYPE_QUESTION) || (builder->count[MDNS_ENTRYTYPE_QUESTION] == 0xFFFF))
+		return -1;
+
+	void* buffer = builder->buffer;
+	size_t string_count = builder->string_table.count;
+	void* data = mdns_string_make(buffer, builder->capacity, pointer_offset(buffer, builder->size), name, length,
+	                              &builder->string_table);
+	if (!data || ((builder->capacity - (size_t)pointer_diff(data, buffer)) < 4)) {
+		mdns_builder_truncate(builder, builder->size, string_count);
+		return -1;
+	}
+	data = mdns_htons(data, (uint16_t)type);
+	data = mdns_htons(data, rclass);
+
+	builder->size = (size_t)pointer_diff(data, buffer);
+	mdns_builder_set_count(builder, MDNS_ENTRYTYPE_QUESTION);
+	return 0;
+}
+
+// Append a key=value string to TXT record data, or the pre-encoded strings of a blob record as built by
+// mdns_txt_record. Returns pointer past the string, or null if it does not fit
+static void*
+mdns_builder_add_txt_string(mdns_builder_t* builder, void* data, const mdns_record_t* record) {
+	if (record->data.txt.blob) {
+		size_t size = record->data.txt.value.length;
+		if (builder->capacity - (size_t)pointer_diff(data, builder->buffer) < size)
+			return 0;
+		memcpy(data, record->data.txt.value.str, size);
+		return pointer_offset(data, size);
+	}
+
+	size_t string_length = record->data.txt.key.length + record->data.txt.value.length + 1;
+	size_t remain = builder->capacity - (size_t)pointer_diff(data, builder->buffer);
+	if ((remain <= string_length) || (string_length > 0xFF))
+		return 0;
+
+	unsigned char* strdata = (unsigned char*)data;
+	*strdata++ = (unsigned char)string_length;
+	if (record->data.txt.key.length)
+		memcpy(strdata, record->data.txt.key.str, record->data.txt.key.length);
+	strdata += record->data.txt.key.length;
+	*strdata++ = '=';
+	if (record->data.txt.value.length)
+		memcpy(strdata, record->data.txt.value.str, record->data.txt.value.length);
+	strdata += record->data.txt.value.length;
+	return strdata;
+}
+
+static void*
+mdns_builder_add_record_data(mdns_builder_t* builder, void* data, const mdns_record_t* record) {
+	void* buffer = builder->buffer;
+	size_t capacity = builder->capacity;
+	size_t remain = capacity - (size_t)pointer_diff(data, buffer);
+	switch (record->type) {
+		case MDNS_RECORDTYPE_PTR:
+			return mdns_string_make(buffer, capacity, data, STRING_ARGS(record->data.ptr.name),
+			                        &builder->string_table);
+
+		case MDNS_RECORDTYPE_SRV:
+			if (remain <= 6)
+				return 0;
+			data = mdns_htons(data, record->data.srv.priority);
+			data = mdns_htons(data, record->data.srv.weight);
+			data = mdns_htons(data, record->data.srv.port);
+			return mdns_string_make(buffer, capacity, data, STRING_ARGS(record->data.srv.name),
+			                        &builder->string_table);
+
+		case MDNS_RECORDTYPE_A:
+			if (remain < 4)
+				return 0;
+			memcpy(data, &record->data.a.addr.sin_addr.s_addr, 4);
+			return pointer_offset(data, 4);
+
+		case MDNS_RECORDTYPE_AAAA:
+			if (remain < 16)
+				return 0;
+			memcpy(data, &record->data.aaaa.addr.sin6_addr, 16);  // ipv6 address
+			return pointer_offset(data, 16);
+
+		case MDNS_RECORDTYPE_TXT:
+			return mdns_builder_add_txt_string(builder, data, record);
+
+		case MDNS_RECORDTYPE_ANY:
+		case MDNS_RECORDTYPE_IGNORE:
+		default:
+			break;
+	}
+	return data;
+}
+
+// Check if a TXT record can be appended to the last record written. It must be a TXT record with the
+// same name, and the same class including the cache flush bit and the same TTL
+static bool
+mdns_builder_txt_continues(const mdns_builder_t* builder, const mdns_record_t* record) {
+	if (!builder->txt_length_offset)
+		return false;
+	// Class and TTL fields precede the data length field
+	const void* length_field = pointer_offset_const(builder->buffer, builder->txt_length_offset);
+	uint16_t rclass = record->rclass ? record->rclass : (uint16_t)MDNS_CLASS_IN;
+	if ((mdns_ntohs(pointer_offset_const(length_field, -6)) != rclass) ||
+	    (mdns_ntohl(pointer_offset_const(length_field, -4)) != record->ttl))
+		return false;
+	return mdns_string_equal_name(builder->buffer, builder->size, builder->txt_name_offset,
+	                              STRING_ARGS(record->name)) != 0;
+}
+
+static int
+mdns_builder_add_record_packet(mdns_builder_t* builder, mdns_entry_type_t section, const mdns_record_t* record) {
+	if ((section < MDNS_ENTRYTYPE_ANSWER) || (section > MDNS_ENTRYTYPE_ADDITIONAL) || (section < builder->section) ||
+	    (builder->count[section] == 0xFFFF) || !builder->size)
+		return -1;
+
+	void* buffer = builder->buffer;
+	size_t capacity = builder->capacity;
+	void* data = pointer_offset(buffer, builder->size);
+	if (section != builder->section)
+		builder->txt_length_offset = 0;
+
+	// Consecutive TXT records with the same name, class and TTL are coalesced into one record
+	if ((record->type == MDNS_RECORDTYPE_TXT) && mdns_builder_txt_continues(builder, record)) {
+		data = mdns_builder_add_txt_string(builder, data, record);
+		if (!data)
+			return -1;
+		void* record_length = pointer_offset(buffer, builder->txt_length_offset);
+		size_t length = (size_t)pointer_diff(data, record_length) - 2;
+		if (length > 0xFFFF)
+			return -1;
+		mdns_htons(record_length, (uint16_t)length);
+		builder->size = (size_t)pointer_diff(data, buffer);
+		builder->section = section;
+		return 0;
+	}
+
+	size_t name_offset = builder->size;
+	size_t string_count = builder->string_table.count;
+	data = mdns_string_make(buffer, capacity, data, STRING_ARGS(record->name), &builder->string_table);
+	if (!data || ((capacity - (size_t)pointer_diff(data, buffer)) < 10)) {
+		mdns_builder_truncate(builder, builder->size, string_count);
+		return -1;
+	}
+
+	data = mdns_htons(data, (uint16_t)record->type);
+	data = mdns_htons(data, record->rclass ? record->rclass : (uint16_t)MDNS_CLASS_IN);
+	data = mdns_htonl(data, record->ttl);
+	// Length, filled when record data is written
+	void* record_length = data;
+	data = mdns_htons(data, 0);
+	void* record_data = data;
+
+	data = mdns_builder_add_record_data(builder, data, record);
+	if (!data) {
+		mdns_builder_truncate(builder, builder->size, string_count);
+		return -1;
+	}
+	mdns_htons(record_length, (uint16_t)pointer_diff(data, record_data));
+
+	builder->size = (size_t)pointer_diff(data, buffer);
+	builder->section = section;
+	builder->txt_length_offset =
+	    (record->type == MDNS_RECORDTYPE_TXT) ? (size_t)pointer_diff(record_length, buffer) : 0;
+	builder->txt_name_offset = name_offset;
+	mdns_builder_set_count(builder, section);
+	return 0;
+}
+
+int
+mdns_builder_add_record(mdns_builder_t* builder, mdns_entry_type_t section, const mdns_record_t* record) {
+	if (mdns_builder_add_record_packet(builder, section, record) == 0)
+		return 0;
+	// When splitting, continue in a new packet unless the record did not fit in an empty one
+	if (!builder->flush || mdns_builder_is_empty(builder) || (section < MDNS_ENTRYTYPE_ANSWER) ||
+	    (section > MDNS_ENTRYTYPE_ADDITIONAL) || (section < builder->section))
+		return -1;
+	if (mdns_builder_emit(builder, true) < 0)
+		return -1;
+	return mdns_builder_add_record_packet(builder, section, record);
+}
+
+int
+mdns_builder_add_answer(mdns_builder_t* builder, const mdns_record_t* record) {
+	return mdns_builder_add_record(builder, MDNS_ENTRYTYPE_ANSWER, record);
+}
+
+int
+mdns_builder_add_authority(mdns_builder_t* builder, const mdns_record_t* record) {
+	return mdns_builder_add_record(builder, MDNS_ENTRYTYPE_AUTHORITY, record);
+}
+
+int
+mdns_builder_add_additional(mdns_builder_t* builder, const mdns_record_t* record) {
+	return mdns_builder_add_record(builder, MDNS_ENTRYTYPE_ADDITIONAL, record);
+}
+
+size_t
+mdns_builder_size(const mdns_builder_t* builder) {
+	return builder->size;
+}
+
+size_t
+mdns_builder_remaining(const mdns_builder_t* builder) {
+	return builder->capacity - builder->size;
+}
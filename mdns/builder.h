@@ -0,0 +1,83 @@
+/* builder.h  -  mDNS library  -  Public Domain  -  2014 Mattias Jansson
+ *
+ * This library provides a cross-platform mDNS and DNS-SD library in C based
+ * on our foundation and network libraries. The implementation is based on RFC 6762
+ * and RFC 6763.
+ *
+ * The latest source code maintained by Mattias Jansson is always available at
+ *
+ * https://github.com/mjansson/mdns_lib
+ *
+ * The foundation and network library source code maintained by Mattias Jansson
+ * is always available at
+ *
+ * https://github.com/mjansson/foundation_lib
+ * https://github.com/mjansson/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify
+ * it without any restrictions.
+ *
+ */
+
+
+#pragma once
+
+#include <foundation/platform.h>
+
+#include <mdns/types.h>
+
+//! Initialize a packet builder over the given buffer, which must be 32 bit aligned and remain valid
+//! while building. Writes a header with the given query ID and flags and no entries. All names added
+//! share one compression dictionary. Returns 0 if success, <0 if the buffer cannot hold a header
+MDNS_API int
+mdns_builder_initialize(mdns_builder_t* builder, void* buffer, size_t capacity, uint16_t query_id, uint16_t flags);
+
+//! Split output across several packets of at most the buffer capacity. When a record does not fit, the
+//! current packet is passed to the flush callback and the record is added to a new packet with the
+//! same query ID and flags and no questions. If truncate is set the TC bit is set in each packet
+//! continued in the next one, as for known answer lists in queries (RFC 6762 section 7.2). A flush
+//! callback returning <0 fails the add. Call mdns_builder_flush to pass the last packet
+MDNS_API void
+mdns_builder_set_flush(mdns_builder_t* builder, mdns_builder_flush_fn flush, void* user_data, bool truncate);
+
+//! Pass the current packet to the flush callback, if it has any entries, and start a new packet.
+//! Returns the flush callback result, or 0 if the packet was empty
+MDNS_API int
+mdns_builder_flush(mdns_builder_t* builder);
+
+//! Get the number of packets passed to the flush callback
+MDNS_API size_t
+mdns_builder_packets(const mdns_builder_t* builder);
+
+//! Add a question with the given class, MDNS_CLASS_IN optionally with MDNS_UNICAST_RESPONSE.
+//! Returns 0 if success, <0 if it does not fit or records have already been added
+MDNS_API int
+mdns_builder_add_question(mdns_builder_t* builder, mdns_record_type_t type, const char* name, size_t length,
+                          uint16_t rclass);
+
+//! Add a record to the answer section. The record class and TTL are written as given, a zero class
+//! is written as MDNS_CLASS_IN. A TXT record directly following a TXT record with the same name in
+//! the same section is appended to it as another string. Returns 0 if success, <0 if it does not
+//! fit or authority or additional records have already been added, leaving the packet unchanged
+MDNS_API int
+mdns_builder_add_answer(mdns_builder_t* builder, const mdns_record_t* record);
+
+//! Add a record to the authority section like mdns_builder_add_answer
+MDNS_API int
+mdns_builder_add_authority(mdns_builder_t* builder, const mdns_record_t* record);
+
+//! Add a record to the additional section like mdns_builder_add_answer
+MDNS_API int
+mdns_builder_add_additional(mdns_builder_t* builder, const mdns_record_t* record);
+
+//! Add a record to the given section like mdns_builder_add_answer
+MDNS_API int
+mdns_builder_add_record(mdns_builder_t* builder, mdns_entry_type_t section, const mdns_record_t* record);
+
+//! Get the size of the packet built so far, header counts are always up to date
+MDNS_API size_t
+mdns_builder_size(const mdns_builder_t* builder);
+
+//! Get the number of bytes remaining in the buffer
+MDNS_API size_t
+mdns_builder_remaining(const mdns_builder_t* builder);
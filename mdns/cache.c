@@ -0,0 +1,622 @@
+/* cache.c  -  mDNS library  -  Public Domain  -  2014 Mattias Jansson
+ *
+ * This library provides a cross-platform mDNS and DNS-SD library in C based
+ * on our foundation and network libraries. The implementation is based on RFC 6762
+ * and RFC 6763.
+ *
+ * The latest source code maintained by Mattias Jansson is always available at
+ *
+ * https://github.com/mjansson/mdns_lib
+ *
+ * The foundation and network library source code maintained by Mattias Jansson
+ * is always available at
+ *
+ * https://github.com/mjansson/foundation_lib
+ * https://github.com/mjansson/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify
+ * it without any restrictions.
+ *
+ */
+
+#include <mdns/mdns.h>
+#include <mdns/internal.h>
+#include <foundation/foundation.h>
+#include <network/network.h>
+
+#define MDNS_CACHE_WHEEL_SLOTS (1U << MDNS_CACHE_WHEEL_BITS)
+#define MDNS_CACHE_WHEEL_MASK (MDNS_CACHE_WHEEL_SLOTS - 1)
+#define MDNS_CACHE_WHEEL_SPAN (1ULL << (MDNS_CACHE_WHEEL_LEVELS * MDNS_CACHE_WHEEL_BITS))
+
+mdns_cache_t*
+mdns_cache_allocate(size_t capacity) {
+	mdns_cache_t* cache = memory_allocate(HASH_MDNS, sizeof(mdns_cache_t), 0, MEMORY_PERSISTENT);
+	if (mdns_cache_initialize(cache, capacity) < 0) {
+		memory_deallocate(cache);
+		return 0;
+	}
+	return cache;
+}
+
+void
+mdns_cache_deallocate(mdns_cache_t* cache) {
+	if (!cache)
+		return;
+	mdns_cache_finalize(cache);
+	memory_deallocate(cache);
+}
+
+int
+mdns_cache_initialize(mdns_cache_t* cache, size_t capacity) {
+	memset(cache, 0, sizeof(mdns_cache_t));
+	if (!capacity || (capacity > 0x7FFFFFFF))
+		return -1;
+
+	size_t bucket_count = 16;
+	while (bucket_count < capacity)
+		bucket_count <<= 1;
+
+	cache->entry = memory_allocate(HASH_MDNS, sizeof(mdns_cache_entry_t) * capacity, 0,
+	                               MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED);
+	cache->bucket =
+	    memory_allocate(HASH_MDNS, sizeof(uint32_t) * bucket_count, 0, MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED);
+	cache->capacity = capacity;
+	cache->bucket_mask = bucket_count - 1;
+	cache->base = time_current();
+
+	for (size_t ientry = 0; ientry < capacity; ++ientry)
+		cache->entry[ientry].next = (ientry + 1 < capacity) ? (uint32_t)(ientry + 2) : 0;
+	cache->free = 1;
+	return 0;
+}
+
+void
+mdns_cache_finalize(mdns_cache_t* cache) {
+	for (size_t ientry = 0; ientry < cache->capacity; ++ientry) {
+		if (cache->entry[ientry].used)
+			memory_deallocate(cache->entry[ientry].storage);
+	}
+	memory_deallocate(cache->entry);
+	memory_deallocate(cache->bucket);
+	memset(cache, 0, sizeof(mdns_cache_t));
+}
+
+static size_t
+mdns_cache_bucket(const mdns_cache_t* cache, hash_t name_hash, mdns_record_type_t type) {
+	return (size_t)((name_hash ^ ((hash_t)type * 0x9E3779B97F4A7C15ULL)) >> 7) & cache->bucket_mask;
+}
+
+static hash_t
+mdns_cache_data_hash(const mdns_record_t* record) {
+	uint8_t key[sizeof(hash_t) + 8];
+	switch (record->type) {
+		case MDNS_RECORDTYPE_PTR:
+			return mdns_string_hash(STRING_ARGS(record->data.ptr.name));
+
+		case MDNS_RECORDTYPE_SRV: {
+			hash_t target = mdns_string_hash(STRING_ARGS(record->data.srv.name));
+			memcpy(key, &target, sizeof(hash_t));
+			memcpy(key + sizeof(hash_t), &record->data.srv.priority, 2);
+			memcpy(key + sizeof(hash_t) + 2, &record->data.srv.weight, 2);
+			memcpy(key + sizeof(hash_t) + 4, &record->data.srv.port, 2);
+			return hash(key, sizeof(hash_t) + 6);
+		}
+
+		case MDNS_RECORDTYPE_A:
+			return hash(&record->data.a.addr.sin_addr.s_addr, 4);
+
+		case MDNS_RECORDTYPE_AAAA:
+			return hash(&record->data.aaaa.addr.sin6_addr, 16);
+
+		case MDNS_RECORDTYPE_TXT: {
+			if (record->data.txt.blob)
+				return hash(STRING_ARGS(record->data.txt.value));
+			// Hash the key=value string as it appears on the wire
+			char str[256];
+			size_t key_length = record->data.txt.key.length;
+			size_t value_length = record->data.txt.value.length;
+			if (key_length + value_length + 1 > sizeof(str))
+				value_length = sizeof(str) - key_length - 1;
+			memcpy(str, record->data.txt.key.str, key_length);
+			str[key_length] = '=';
+			if (value_length)
+				memcpy(str + key_length + 1, record->data.txt.value.str, value_length);
+			return hash(str, key_length + 1 + value_length);
+		}
+
+		case MDNS_RECORDTYPE_ANY:
+		case MDNS_RECORDTYPE_IGNORE:
+		default:
+			break;
+	}
+	return 0;
+}
+
+static uint32_t*
+mdns_cache_wheel_head(mdns_cache_t* cache, uint16_t slot) {
+	return cache->wheel + slot;
+}
+
+// Link the entry into the wheel slot of its next event, the earliest of refresh and expiry. Entries
+// due within 2^BITS seconds go in level 0 with one slot per second, entries further out in the level
+// whose slot span covers them. Entries due beyond the wheel span are linked at the end of the span
+// and relinked when reached
+static void
+mdns_cache_wheel_link(mdns_cache_t* cache, uint32_t index) {
+	mdns_cache_entry_t* entry = cache->entry + index;
+	uint32_t wake = entry->expire;
+	if (entry->refresh && (entry->refresh < wake))
+		wake = entry->refresh;
+	// Entries due now while cascading go in the current slot, processed right after the cascade
+	if (wake < cache->time)
+		wake = cache->time;
+	if ((uint64_t)(wake - cache->time) >= MDNS_CACHE_WHEEL_SPAN)
+		wake = cache->time + (uint32_t)(MDNS_CACHE_WHEEL_SPAN - 1);
+
+	uint32_t delta = wake - cache->time;
+	unsigned int level = 0;
+	while ((level + 1 < MDNS_CACHE_WHEEL_LEVELS) && (delta >> ((level + 1) * MDNS_CACHE_WHEEL_BITS)))
+		++level;
+	uint32_t slot = (wake >> (level * MDNS_CACHE_WHEEL_BITS)) & MDNS_CACHE_WHEEL_MASK;
+
+	entry->wheel_slot = (uint16_t)((level << MDNS_CACHE_WHEEL_BITS) | slot);
+	uint32_t* head = mdns_cache_wheel_head(cache, entry->wheel_slot);
+	entry->wheel_prev = 0;
+	entry->wheel_next = *head;
+	if (entry->wheel_next)
+		cache->entry[entry->wheel_next - 1].wheel_prev = index + 1;
+	*head = index + 1;
+}
+
+static void
+mdns_cache_wheel_unlink(mdns_cache_t* cache, uint32_t index) {
+	mdns_cache_entry_t* entry = cache->entry + index;
+	if (entry->wheel_prev)
+		cache->entry[entry->wheel_prev - 1].wheel_next = entry->wheel_next;
+	else
+		*mdns_cache_wheel_head(cache, entry->wheel_slot) = entry->wheel_next;
+	if (entry->wheel_next)
+		cache->entry[entry->wheel_next - 1].wheel_prev = entry->wheel_prev;
+	entry->wheel_next = 0;
+	entry->wheel_prev = 0;
+}
+
+static void
+mdns_cache_link(mdns_cache_t* cache, uint32_t index) {
+	mdns_cache_entry_t* entry = cache->entry + index;
+	size_t ibucket = mdns_cache_bucket(cache, entry->name_hash, entry->record.type);
+	entry->prev = 0;
+	entry->next = cache->bucket[ibucket];
+	if (entry->next)
+		cache->entry[entry->next - 1].prev = index + 1;
+	cache->bucket[ibucket] = index + 1;
+	mdns_cache_wheel_link(cache, index);
+}
+
+static void
+mdns_cache_unlink(mdns_cache_t* cache, uint32_t index) {
+	mdns_cache_entry_t* entry = cache->entry + index;
+	if (entry->prev)
+		cache->entry[entry->prev - 1].next = entry->next;
+	else
+		cache->bucket[mdns_cache_bucket(cache, entry->name_hash, entry->record.type)] = entry->next;
+	if (entry->next)
+		cache->entry[entry->next - 1].prev = entry->prev;
+	mdns_cache_wheel_unlink(cache, index);
+}
+
+static void
+mdns_cache_release(mdns_cache_t* cache, uint32_t index) {
+	mdns_cache_entry_t* entry = cache->entry + index;
+	for (size_t idue = 0; idue < cache->refresh_count; ++idue) {
+		if (cache->refresh_due[idue] == index) {
+			cache->refresh_due[idue] = cache->refresh_due[--cache->refresh_count];
+			break;
+		}
+	}
+	mdns_cache_unlink(cache, index);
+	memory_deallocate(entry->storage);
+	memset(entry, 0, sizeof(mdns_cache_entry_t));
+	entry->next = cache->free;
+	cache->free = index + 1;
+	--cache->count;
+}
+
+// Schedule the next maintenance query at 80%, 85%, 90% or 95% of the TTL with 2% jitter, skipping
+// steps already passed. Must be followed by relinking the entry in the wheel
+static void
+mdns_cache_schedule_refresh(mdns_cache_t* cache, mdns_cache_entry_t* entry) {
+	entry->refresh = 0;
+	if (!cache->refresh)
+		return;
+	uint32_t ttl = entry->record.ttl;
+	while (entry->refresh_step < 4) {
+		uint32_t percent = 80 + 5 * (uint32_t)entry->refresh_step++;
+		uint32_t refresh = entry->received + (uint32_t)(((uint64_t)ttl * percent) / 100) +
+		                   random32_range(0, (ttl / 50) + 1);
+		if (refresh >= entry->expire)
+			break;
+		if (refresh > cache->time) {
+			entry->refresh = refresh;
+			break;
+		}
+	}
+}
+
+static void
+mdns_cache_set_expire(mdns_cache_t* cache, uint32_t index, uint32_t expire) {
+	mdns_cache_wheel_unlink(cache, index);
+	cache->entry[index].expire = expire;
+	mdns_cache_wheel_link(cache, index);
+}
+
+static bool
+mdns_cache_name_equal(const mdns_cache_entry_t* entry, const char* name, size_t length) {
+	size_t entry_length = entry->record.name.length;
+	if (entry_length && (entry->record.name.str[entry_length - 1] == '.'))
+		--entry_length;
+	if (length && (name[length - 1] == '.'))
+		--length;
+	return (entry_length == length) && mdns_string_equal_nocase(entry->record.name.str, name, length);
+}
+
+// Evict the record closest to expiry, found from the first non-empty wheel slot after the current time
+static bool
+mdns_cache_evict(mdns_cache_t* cache) {
+	for (unsigned int level = 0; level < MDNS_CACHE_WHEEL_LEVELS; ++level) {
+		uint32_t first = (cache->time >> (level * MDNS_CACHE_WHEEL_BITS)) + 1;
+		for (uint32_t islot = 0; islot < MDNS_CACHE_WHEEL_SLOTS; ++islot) {
+			uint16_t slot = (uint16_t)((level << MDNS_CACHE_WHEEL_BITS) | ((first + islot) & MDNS_CACHE_WHEEL_MASK));
+			uint32_t head = *mdns_cache_wheel_head(cache, slot);
+			if (head) {
+				mdns_cache_release(cache, head - 1);
+				++cache->evicted;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+static bool
+mdns_cache_target_equal(string_const_t lhs, string_const_t rhs) {
+	if (lhs.length && (lhs.str[lhs.length - 1] == '.'))
+		--lhs.length;
+	if (rhs.length && (rhs.str[rhs.length - 1] == '.'))
+		--rhs.length;
+	return (lhs.length == rhs.length) && mdns_string_equal_nocase(lhs.str, rhs.str, lhs.length);
+}
+
+// Compare the record data of an entry with a record of the same type, after the data hash matched
+static bool
+mdns_cache_data_equal(const mdns_cache_entry_t* entry, const mdns_record_t* record) {
+	const mdns_record_t* cached = &entry->record;
+	switch (record->type) {
+		case MDNS_RECORDTYPE_PTR:
+			return mdns_cache_target_equal(cached->data.ptr.name, record->data.ptr.name);
+
+		case MDNS_RECORDTYPE_SRV:
+			return (cached->data.srv.priority == record->data.srv.priority) &&
+			       (cached->data.srv.weight == record->data.srv.weight) &&
+			       (cached->data.srv.port == record->data.srv.port) &&
+			       mdns_cache_target_equal(cached->data.srv.name, record->data.srv.name);
+
+		case MDNS_RECORDTYPE_A:
+			return !memcmp(&cached->data.a.addr.sin_addr, &record->data.a.addr.sin_addr, 4);
+
+		case MDNS_RECORDTYPE_AAAA:
+			return !memcmp(&cached->data.aaaa.addr.sin6_addr, &record->data.aaaa.addr.sin6_addr, 16);
+
+		case MDNS_RECORDTYPE_TXT:
+			if (cached->data.txt.blob != record->data.txt.blob)
+				return false;
+			if (record->data.txt.blob)
+				return string_equal(STRING_ARGS(cached->data.txt.value), STRING_ARGS(record->data.txt.value));
+			return string_equal(STRING_ARGS(cached->data.txt.key), STRING_ARGS(record->data.txt.key)) &&
+			       string_equal(STRING_ARGS(cached->data.txt.value), STRING_ARGS(record->data.txt.value));
+
+		case MDNS_RECORDTYPE_ANY:
+		case MDNS_RECORDTYPE_IGNORE:
+		default:
+			break;
+	}
+	return false;
+}
+
+int
+mdns_cache_insert(mdns_cache_t* cache, const mdns_record_t* record, bool flush) {
+	if (!record->name.length)
+		return -1;
+
+	hash_t name_hash = mdns_string_hash(STRING_ARGS(record->name));
+	hash_t data_hash = mdns_cache_data_hash(record);
+	int found = -1;
+	uint32_t next = cache->bucket[mdns_cache_bucket(cache, name_hash, record->type)];
+	while (next) {
+		uint32_t index = next - 1;
+		mdns_cache_entry_t* entry = cache->entry + index;
+		next = entry->next;
+		if ((entry->name_hash != name_hash) || (entry->record.type != record->type) ||
+		    !mdns_cache_name_equal(entry, STRING_ARGS(record->name)))
+			continue;
+		if ((entry->data_hash == data_hash) && mdns_cache_data_equal(entry, record)) {
+			found = (int)index;
+		} else if (flush && (entry->received < cache->time) && (entry->expire > cache->time + 1)) {
+			// RFC 6762 section 10.2, records of the same rrset not part of this announcement expire in one second
+			entry->refresh = 0;
+			mdns_cache_set_expire(cache, index, cache->time + 1);
+		}
+	}
+
+	if (found >= 0) {
+		mdns_cache_entry_t* entry = cache->entry + found;
+		// RFC 6762 section 10.1, a goodbye record expires in one second
+		uint32_t ttl = record->ttl ? record->ttl : 1;
+		entry->record.ttl = record->ttl;
+		entry->received = cache->time;
+		entry->expire = cache->time + ttl;
+		entry->refresh_step = 0;
+		mdns_cache_schedule_refresh(cache, entry);
+		mdns_cache_set_expire(cache, (uint32_t)found, entry->expire);
+		++cache->refreshed;
+		return found;
+	}
+
+	if (!record->ttl)
+		return -1;
+	if (!cache->free && !mdns_cache_evict(cache))
+		return -1;
+
+	uint32_t index = cache->free - 1;
+	mdns_cache_entry_t* entry = cache->entry + index;
+	cache->free = entry->next;
+
+	entry->storage = mdns_record_copy(&entry->record, record);
+	entry->name_hash = name_hash;
+	entry->data_hash = data_hash;
+	entry->received = cache->time;
+	entry->expire = cache->time + record->ttl;
+	entry->used = true;
+	mdns_cache_schedule_refresh(cache, entry);
+	mdns_cache_link(cache, index);
+	++cache->count;
+	++cache->inserted;
+	return (int)index;
+}
+
+int
+mdns_cache_remove(mdns_cache_t* cache, int handle) {
+	if (!mdns_cache_record(cache, handle))
+		return -1;
+	mdns_cache_release(cache, (uint32_t)handle);
+	return 0;
+}
+
+int
+mdns_cache_find(const mdns_cache_t* cache, const char* name, size_t length, mdns_record_type_t type, int previous) {
+	uint32_t next;
+	hash_t name_hash = mdns_string_hash(name, length);
+	if (previous < 0)
+		next = cache->bucket[mdns_cache_bucket(cache, name_hash, type)];
+	else if (mdns_cache_record(cache, previous))
+		next = cache->entry[previous].next;
+	else
+		return -1;
+	while (next) {
+		const mdns_cache_entry_t* entry = cache->entry + (next - 1);
+		if ((entry->name_hash == name_hash) && (entry->record.type == type) && (entry->expire > cache->time) &&
+		    mdns_cache_name_equal(entry, name, length))
+			return (int)(next - 1);
+		next = entry->next;
+	}
+	return -1;
+}
+
+const mdns_record_t*
+mdns_cache_record(const mdns_cache_t* cache, int handle) {
+	if ((handle < 0) || ((size_t)handle >= cache->capacity) || !cache->entry[handle].used)
+		return 0;
+	return &cache->entry[handle].record;
+}
+
+uint32_t
+mdns_cache_ttl(const mdns_cache_t* cache, int handle) {
+	if (!mdns_cache_record(cache, handle) || (cache->entry[handle].expire <= cache->time))
+		return 0;
+	return cache->entry[handle].expire - cache->time;
+}
+
+// Move all entries in a higher level slot down to the level matching their remaining time
+static void
+mdns_cache_cascade(mdns_cache_t* cache, unsigned int level, uint32_t slot) {
+	uint32_t* head = mdns_cache_wheel_head(cache, (uint16_t)((level << MDNS_CACHE_WHEEL_BITS) | slot));
+	uint32_t next = *head;
+	*head = 0;
+	while (next) {
+		uint32_t index = next - 1;
+		next = cache->entry[index].wheel_next;
+		mdns_cache_wheel_link(cache, index);
+	}
+}
+
+size_t
+mdns_cache_advance(mdns_cache_t* cache, uint32_t seconds) {
+	size_t expired = 0;
+	for (uint32_t istep = 0; istep < seconds; ++istep) {
+		uint32_t time = ++cache->time;
+		for (unsigned int level = 1; level < MDNS_CACHE_WHEEL_LEVELS; ++level) {
+			uint32_t lower = (time >> ((level - 1) * MDNS_CACHE_WHEEL_BITS)) & MDNS_CACHE_WHEEL_MASK;
+			if (lower)
+				break;
+			mdns_cache_cascade(cache, level, (time >> (level * MDNS_CACHE_WHEEL_BITS)) & MDNS_CACHE_WHEEL_MASK);
+		}
+
+		// Entries in the slot are either expired, due for a maintenance query, or linked early
+		// from beyond the wheel span. Entries not expired are relinked at their next event
+		uint32_t* head = mdns_cache_wheel_head(cache, (uint16_t)(time & MDNS_CACHE_WHEEL_MASK));
+		while (*head) {
+			uint32_t index = *head - 1;
+			mdns_cache_entry_t* entry = cache->entry + index;
+			if (entry->expire <= time) {
+				mdns_cache_release(cache, index);
+				++expired;
+				continue;
+			}
+			if (entry->refresh && (entry->refresh <= time)) {
+				if (cache->refresh_count < MDNS_CACHE_REFRESH_MAX) {
+					cache->refresh_due[cache->refresh_count++] = index;
+					mdns_cache_schedule_refresh(cache, entry);
+				} else {
+					// Due list is full, retry in the next tick instead of dropping the query
+					entry->refresh = time + 1;
+				}
+			}
+			mdns_cache_wheel_unlink(cache, index);
+			mdns_cache_wheel_link(cache, index);
+		}
+	}
+	cache->expired += expired;
+	return expired;
+}
+
+size_t
+mdns_cache_expire(mdns_cache_t* cache) {
+	tick_t elapsed = time_current() - cache->base;
+	uint64_t now = (uint64_t)(elapsed / time_ticks_per_second());
+	if (now <= cache->time)
+		return 0;
+	return mdns_cache_advance(cache, (uint32_t)(now - cache->time));
+}
+
+void
+mdns_cache_set_refresh(mdns_cache_t* cache, bool enable) {
+	cache->refresh = enable;
+}
+
+size_t
+mdns_cache_refresh_queries(mdns_cache_t* cache, mdns_query_t* query, size_t capacity) {
+	size_t count = 0;
+	size_t kept = 0;
+	for (size_t idue = 0; idue < cache->refresh_count; ++idue) {
+		uint32_t index = cache->refresh_due[idue];
+		const mdns_cache_entry_t* entry = cache->entry + index;
+		// Records sharing name and type, like TXT strings and multiple addresses, share the question
+		bool duplicate = false;
+		for (size_t iquery = 0; !duplicate && (iquery < count); ++iquery)
+			duplicate = (query[iquery].type == entry->record.type) &&
+			            mdns_cache_name_equal(entry, query[iquery].name, query[iquery].length);
+		if (duplicate)
+			continue;
+		if (count < capacity) {
+			query[count].type = entry->record.type;
+			query[count].name = entry->record.name.str;
+			query[count].length = entry->record.name.length;
+			++count;
+		} else {
+			// Keep records not fitting due
+			cache->refresh_due[kept++] = index;
+		}
+	}
+	cache->refresh_count = kept;
+	return count;
+}
+
+int
+mdns_cache_refresh_send(mdns_cache_t* cache, socket_t* sock, void* buffer, size_t capacity) {
+	mdns_query_t query[MDNS_CACHE_REFRESH_MAX];
+	size_t count = mdns_cache_refresh_queries(cache, query, MDNS_CACHE_REFRESH_MAX);
+	size_t sent = 0;
+	while (sent < count) {
+		// Put as many questions in each packet as fit in the buffer
+		size_t batch = count - sent;
+		while (batch && !mdns_multiquery_build(buffer, capacity, query + sent, batch, 0, false))
+			batch >>= 1;
+		if (!batch || (mdns_multiquery_send(sock, query + sent, batch, buffer, capacity, 0) < 0))
+			return -1;
+		sent += batch;
+		cache->queried += batch;
+	}
+	return (int)sent;
+}
+
+static void
+mdns_cache_insert_txt(mdns_cache_t* cache, mdns_record_t* record, bool flush, const void* data, size_t size,
+                      size_t record_offset, size_t record_length) {
+	mdns_record_txt_t txt[MDNS_CACHE_TXT_MAX];
+	size_t parsed = mdns_record_parse_txt(data, size, record_offset, record_length, txt, MDNS_CACHE_TXT_MAX);
+	for (size_t itxt = 0; itxt < parsed; ++itxt) {
+		record->data.txt = txt[itxt];
+		mdns_cache_insert(cache, record, flush);
+	}
+}
+
+int
+mdns_cache_callback(socket_t* sock, const network_address_t* from, mdns_entry_type_t entry, uint16_t query_id,
+                    uint16_t rtype, uint16_t rclass, uint32_t ttl, const void* data, size_t size, size_t name_offset,
+                    size_t name_length, size_t record_offset, size_t record_length, void* user_data) {
+	FOUNDATION_UNUSED(sock);
+	FOUNDATION_UNUSED(from);
+	FOUNDATION_UNUSED(query_id);
+	FOUNDATION_UNUSED(name_length);
+	mdns_cache_t* cache = user_data;
+	if (!cache || (entry == MDNS_ENTRYTYPE_QUESTION) || (entry == MDNS_ENTRYTYPE_END))
+		return 0;
+
+	char namebuffer[256];
+	char databuffer[256];
+	mdns_record_t record;
+	memset(&record, 0, sizeof(record));
+	size_t offset = name_offset;
+	record.name = mdns_string_extract(data, size, &offset, namebuffer, sizeof(namebuffer));
+	if (!record.name.length || (record_offset + record_length > size))
+		return 0;
+	record.type = (mdns_record_type_t)rtype;
+	record.rclass = rclass & ~(uint16_t)MDNS_CACHE_FLUSH;
+	record.ttl = ttl;
+	bool flush = (rclass & MDNS_CACHE_FLUSH) != 0;
+
+	switch (rtype) {
+		case MDNS_RECORDTYPE_PTR:
+			record.data.ptr.name =
+			    mdns_record_parse_ptr(data, size, record_offset, record_length, databuffer, sizeof(databuffer));
+			if (!record.data.ptr.name.length)
+				return 0;
+			break;
+
+		case MDNS_RECORDTYPE_SRV:
+			record.data.srv =
+			    mdns_record_parse_srv(data, size, record_offset, record_length, databuffer, sizeof(databuffer));
+			if (!record.data.srv.name.length)
+				return 0;
+			break;
+
+		case MDNS_RECORDTYPE_A: {
+			// A truncated address would otherwise be cached as the unspecified address
+			network_address_ipv4_t addr;
+			if (record_length != 4)
+				return 0;
+			mdns_record_parse_a(data, size, record_offset, record_length, &addr);
+			record.data.a.addr = addr.saddr;
+			break;
+		}
+
+		case MDNS_RECORDTYPE_AAAA: {
+			network_address_ipv6_t addr;
+			if (record_length != 16)
+				return 0;
+			mdns_record_parse_aaaa(data, size, record_offset, record_length, &addr);
+			record.data.aaaa.addr = addr.saddr;
+			break;
+		}
+
+		case MDNS_RECORDTYPE_TXT:
+			mdns_cache_insert_txt(cache, &record, flush, data, size, record_offset, record_length);
+			return 0;
+
+		default:
+			return 0;
+	}
+
+	mdns_cache_insert(cache, &record, flush);
+	return 0;
+}
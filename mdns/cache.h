@@ -0,0 +1,104 @@
+/* cache.h  -  mDNS library  -  Public Domain  -  2014 Mattias Jansson
+ *
+ * This library provides a cross-platform mDNS and DNS-SD library in C based
+ * on our foundation and network libraries. The implementation is based on RFC 6762
+ * and RFC 6763.
+ *
+ * The latest source code maintained by Mattias Jansson is always available at
+ *
+ * https://github.com/mjansson/mdns_lib
+ *
+ * The foundation and network library source code maintained by Mattias Jansson
+ * is always available at
+ *
+ * https://github.com/mjansson/foundation_lib
+ * https://github.com/mjansson/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify
+ * it without any restrictions.
+ *
+ */
+
+#pragma once
+
+#include <foundation/platform.h>
+#include <network/types.h>
+
+#include <mdns/types.h>
+
+//! Allocate a record cache holding up to capacity records
+MDNS_API mdns_cache_t*
+mdns_cache_allocate(size_t capacity);
+
+//! Finalize and deallocate a record cache
+MDNS_API void
+mdns_cache_deallocate(mdns_cache_t* cache);
+
+//! Initialize a record cache holding up to capacity records. Returns 0 if success, <0 if error
+MDNS_API int
+mdns_cache_initialize(mdns_cache_t* cache, size_t capacity);
+
+//! Finalize a record cache, releasing all records
+MDNS_API void
+mdns_cache_finalize(mdns_cache_t* cache);
+
+//! Insert a copy of a received record, keyed by name, type and record data, expiring after the
+//! record TTL. A record already cached is refreshed with the new TTL, a TTL of zero (goodbye)
+//! expires it in one second. If flush is set (MDNS_CACHE_FLUSH bit in the received class) other
+//! records with the same name and type received more than one second ago expire in one second.
+//! Evicts the record closest to expiry if the cache is full. Returns the record handle, or <0 if
+//! the record was not cached
+MDNS_API int
+mdns_cache_insert(mdns_cache_t* cache, const mdns_record_t* record, bool flush);
+
+//! Remove the record with the given handle. Returns 0 if success, <0 if error
+MDNS_API int
+mdns_cache_remove(mdns_cache_t* cache, int handle);
+
+//! Find the next unexpired record with the given name and type after the record with handle
+//! previous, start with previous set to <0. Returns the handle, or <0 if none
+MDNS_API int
+mdns_cache_find(const mdns_cache_t* cache, const char* name, size_t length, mdns_record_type_t type, int previous);
+
+//! Get the record with the given handle, or null if not a valid handle
+MDNS_API const mdns_record_t*
+mdns_cache_record(const mdns_cache_t* cache, int handle);
+
+//! Get the remaining TTL in seconds of the record with the given handle, 0 if not valid
+MDNS_API uint32_t
+mdns_cache_ttl(const mdns_cache_t* cache, int handle);
+
+//! Advance the cache time by the given number of seconds, expiring records and collecting
+//! records due for a maintenance query. Returns the number of records expired
+MDNS_API size_t
+mdns_cache_advance(mdns_cache_t* cache, uint32_t seconds);
+
+//! Advance the cache time to the wall clock, expiring records. Call periodically, expiry
+//! granularity is the call interval. Returns the number of records expired
+MDNS_API size_t
+mdns_cache_expire(mdns_cache_t* cache);
+
+//! Enable or disable maintenance queries. When enabled, records inserted or refreshed are due for
+//! a query at 80%, 85%, 90% and 95% of their TTL plus up to 2% random jitter (RFC 6762 section 5.2),
+//! until refreshed by a response. Due records are collected while advancing the cache time, up to
+//! MDNS_CACHE_REFRESH_MAX records. Records due while the list is full are collected in a later tick
+MDNS_API void
+mdns_cache_set_refresh(mdns_cache_t* cache, bool enable);
+
+//! Take the questions for records due for a maintenance query, one per name and type. Names point
+//! into cached records and are valid until the cache is advanced or modified. Questions not
+//! fitting in the given capacity remain due. Returns the number of questions stored
+MDNS_API size_t
+mdns_cache_refresh_queries(mdns_cache_t* cache, mdns_query_t* query, size_t capacity);
+
+//! Send maintenance queries for all records due, batching the questions into as few multicast
+//! packets as fit in the buffer. Returns the number of questions sent, or <0 if error
+MDNS_API int
+mdns_cache_refresh_send(mdns_cache_t* cache, socket_t* sock, void* buffer, size_t capacity);
+
+//! Record callback to pass to mdns_query_recv, mdns_discovery_recv or mdns_records_parse with the
+//! cache as user data, inserting every answer, authority and additional record
+MDNS_API int
+mdns_cache_callback(socket_t* sock, const network_address_t* from, mdns_entry_type_t entry, uint16_t query_id,
+                    uint16_t rtype, uint16_t rclass, uint32_t ttl, const void* data, size_t size, size_t name_offset,
+                    size_t name_length, size_t record_offset, size_t record_length, void* user_data);
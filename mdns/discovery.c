@@ -23,11 +23,13 @@
 #include <foundation/foundation.h>
 #include <network/network.h>
 
-extern const uint8_t mdns_services_query[46];
+extern const void* const mdns_services_query;
+extern const size_t mdns_services_query_size;
+extern const mdns_name_t mdns_services_name;
 
 int
 mdns_discovery_send(socket_t* sock) {
-	return mdns_multicast_send(sock, mdns_services_query, sizeof(mdns_services_query));
+	return mdns_multicast_send(sock, mdns_services_query, mdns_services_query_size);
 }
 
 size_t
@@ -36,93 +38,79 @@ mdns_discovery_recv(socket_t* sock, void* buffer, size_t capacity, mdns_record_c
 	size_t data_size = udp_socket_recvfrom(sock, buffer, capacity, &address);
 	if (!data_size)
 		return 0;
+	mdns_stats_add(sock, MDNS_STAT_PACKETS_IN, 1);
+	mdns_stats_add(sock, MDNS_STAT_BYTES_IN, data_size);
 
-	size_t records = 0;
-	const uint16_t* data = (uint16_t*)buffer;
+	return mdns_discovery_parse(sock, address, buffer, data_size, callback, user_data);
+}
+
+size_t
+mdns_discovery_recv_batch(socket_t* sock, mdns_datagram_t* datagrams, size_t count, mdns_record_callback_fn callback,
+                          void* user_data, mdns_batch_stats_t* stats) {
+	size_t received = mdns_socket_recv_batch(sock, datagrams, count, stats);
+	size_t total_records = 0;
+	for (size_t idgram = 0; idgram < received; ++idgram)
+		total_records += mdns_discovery_parse(sock, datagrams[idgram].from, datagrams[idgram].buffer,
+		                                      datagrams[idgram].size, callback, user_data);
+	if (stats)
+		stats->records += total_records;
+	return total_records;
+}
 
-	uint16_t query_id = mdns_ntohs(data++);
-	uint16_t flags = mdns_ntohs(data++);
-	uint16_t questions = mdns_ntohs(data++);
-	uint16_t answer_rrs = mdns_ntohs(data++);
-	uint16_t authority_rrs = mdns_ntohs(data++);
-	uint16_t additional_rrs = mdns_ntohs(data++);
+size_t
+mdns_discovery_parse(socket_t* sock, const network_address_t* address, const void* buffer, size_t data_size,
+                     mdns_record_callback_fn callback, void* user_data) {
+	mdns_packet_cursor_t cursor;
+	mdns_packet_entry_t entry;
+	if (mdns_packet_cursor_initialize(&cursor, sock, buffer, data_size) < 0)
+		return 0;
 
 	// According to RFC 6762 the query ID MUST match the sent query ID (which is 0 in our case)
-	if (query_id || (flags != 0x8400))
+	uint16_t query_id = cursor.query_id;
+	if (query_id || (cursor.flags != 0x8400))
 		return 0;  // Not a reply to our question
 
 	// It seems some implementations do not fill the correct questions field,
 	// so ignore this check for now and only validate answer string
 	/*
-	if (questions != 1)
+	if (cursor.remain[MDNS_ENTRYTYPE_QUESTION] != 1)
 	    return 0;
 	*/
 
-	int i;
-	for (i = 0; i < questions; ++i) {
-		size_t offset = (size_t)pointer_diff(data, buffer);
-		size_t verify_offset = 12;
-		// Verify it's our question, _services._dns-sd._udp.local.
-		if (!mdns_string_equal(buffer, data_size, &offset, mdns_services_query, sizeof(mdns_services_query), &verify_offset))
-			return 0;
-		data = pointer_offset_const(buffer, offset);
-
-		uint16_t rtype = mdns_ntohs(data++);
-		uint16_t rclass = mdns_ntohs(data++);
-
-		// Make sure we get a reply based on our PTR question for class IN
-		if ((rtype != MDNS_RECORDTYPE_PTR) || ((rclass & 0x7FFF) != MDNS_CLASS_IN))
-			return 0;
-	}
+	size_t records = 0;
+	while (mdns_packet_cursor_next(&cursor, &entry)) {
+		size_t offset = entry.name_offset;
+		size_t verify_offset = 0;
+		if (entry.section == MDNS_ENTRYTYPE_QUESTION) {
+			// Verify it's our question, _services._dns-sd._udp.local.
+			if (!mdns_string_equal(buffer, data_size, &offset, mdns_services_name.data, mdns_services_name.length,
+			                       &verify_offset))
+				return 0;
+
+			// Make sure we get a reply based on our PTR question for class IN
+			if ((entry.rtype != MDNS_RECORDTYPE_PTR) || ((entry.rclass & 0x7FFF) != MDNS_CLASS_IN))
+				return 0;
+			continue;
+		}
 
-	for (i = 0; i < answer_rrs; ++i) {
-		size_t offset = (size_t)pointer_diff(data, buffer);
-		size_t verify_offset = 12;
 		// Verify it's an answer to our question, _services._dns-sd._udp.local.
-		size_t name_offset = offset;
-		int is_answer =
-		    mdns_string_equal(buffer, data_size, &offset, mdns_services_query, sizeof(mdns_services_query), &verify_offset);
-		if (!is_answer && !mdns_string_skip(buffer, data_size, &offset))
- 			break;		    
-		size_t name_length = offset - name_offset;
-		if ((offset + 10) > data_size)
+		if ((entry.section == MDNS_ENTRYTYPE_ANSWER) &&
+		    !mdns_string_equal(buffer, data_size, &offset, mdns_services_name.data, mdns_services_name.length,
+		                       &verify_offset))
+			continue;
+
+		++records;
+		mdns_stats_record(sock, entry.section, entry.rtype);
+		if (callback && callback(sock, address, entry.section, query_id, entry.rtype, entry.rclass, entry.ttl, buffer,
+		                         data_size, entry.name_offset, entry.name_length, entry.record_offset,
+		                         entry.record_length, user_data))
 			return records;
-		data = pointer_offset_const(buffer, offset);
-
-		uint16_t rtype = mdns_ntohs(data++);
-		uint16_t rclass = mdns_ntohs(data++);
-		uint32_t ttl = mdns_ntohl(data);
-		data += 2;
-		uint16_t length = mdns_ntohs(data++);
-		if (length > (data_size - offset))
-			return 0;
-
-		if (is_answer) {
-			++records;
-			offset = (size_t)pointer_diff(data, buffer);
-			if (callback && callback(sock, address, MDNS_ENTRYTYPE_ANSWER, query_id, rtype, rclass, ttl, buffer,
-			                         data_size, name_offset, name_length, offset, length, user_data))
-				return records;
-		}
-		data = pointer_offset_const(data, length);
 	}
-	size_t total_records = records;
-
-	size_t offset = (size_t)pointer_diff(data, buffer);
-	records = mdns_records_parse(sock, address, buffer, data_size, &offset, MDNS_ENTRYTYPE_AUTHORITY, query_id,
-	                             authority_rrs, callback, user_data);
-	total_records += records;
-	if (records != authority_rrs)
-		return total_records;
-
-	records = mdns_records_parse(sock, address, buffer, data_size, &offset, MDNS_ENTRYTYPE_ADDITIONAL, query_id,
-	                             additional_rrs, callback, user_data);
-	total_records += records;
-	if (records != additional_rrs)
-		return total_records;
+	if (cursor.error)
+		return records;
 
 	if (callback)
-		callback(sock, address, MDNS_ENTRYTYPE_END, query_id, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+		callback(sock, address, MDNS_ENTRYTYPE_END, query_id, 0, 0, 0, 0, 0, 0, 0, 0, 0, user_data);
 
-	return total_records;
+	return records;
 }
@@ -36,3 +36,16 @@ mdns_discovery_send(socket_t* sock);
 //  responses parsed.
 MDNS_API size_t
 mdns_discovery_recv(socket_t* sock, void* buffer, size_t capacity, mdns_record_callback_fn callback, void* user_data);
+
+//! Recieve unicast responses to a DNS-SD like mdns_discovery_recv, but receive up to count datagrams in one batch
+//  with mdns_socket_recv_batch. Returns the total number of responses parsed, and accumulates counts in the
+//  optional stats.
+MDNS_API size_t
+mdns_discovery_recv_batch(socket_t* sock, mdns_datagram_t* datagrams, size_t count, mdns_record_callback_fn callback,
+                          void* user_data, mdns_batch_stats_t* stats);
+
+//! Parse an already received response to a DNS-SD request in the given buffer, as done by mdns_discovery_recv.
+//  Buffer must be 32 bit aligned. Returns the number of responses parsed.
+MDNS_API size_t
+mdns_discovery_parse(socket_t* sock, const network_address_t* from, const void* buffer, size_t size,
+                     mdns_record_callback_fn callback, void* user_data);
@@ -0,0 +1,61 @@
+/* internal.h  -  mDNS library  -  Public Domain  -  2014 Mattias Jansson
+ *
+ * This library provides a cross-platform mDNS and DNS-SD library in C based
+ * on our foundation and network libraries. The implementation is based on RFC 6762
+ * and RFC 6763.
+ *
+ * The latest source code maintained by Mattias Jansson is always available at
+ *
+ * https://github.com/mjansson/mdns_lib
+ *
+ * The foundation and network library source code maintained by Mattias Jansson
+ * is always available at
+ *
+ * https://github.com/mjansson/foundation_lib
+ * https://github.com/mjansson/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify
+ * it without any restrictions.
+ *
+ */
+
+#pragma once
+
+// Functions shared between the library source files, not part of the public API and
+// not included by mdns.h
+
+#include <foundation/platform.h>
+#include <network/types.h>
+
+#include <mdns/types.h>
+
+//! Get the mDNS multicast group address and port for the given address family.
+//! Returns 0 on success, <0 if the family is not supported.
+MDNS_EXTERN int
+mdns_multicast_address(network_address_family_t family, struct sockaddr_storage* addr_storage, socklen_t* saddrlen);
+
+//! Build a response with any number of answer, authority and additional records. If name is set
+//! the question is included. Returns the size of the packet, or 0 if it does not fit in the buffer.
+MDNS_EXTERN size_t
+mdns_answer_build(void* buffer, size_t capacity, uint16_t query_id, mdns_record_type_t record_type, const char* name,
+                  size_t name_length, const mdns_record_t* answer, size_t answer_count,
+                  const mdns_record_t* authority, size_t authority_count, const mdns_record_t* additional,
+                  size_t additional_count, uint16_t rclass, uint32_t ttl, int legacy);
+
+//! Copy the record and all strings it references into one allocated block owned by the caller.
+//! Returns the block, or null if the record references no strings.
+MDNS_EXTERN char*
+mdns_record_copy(mdns_record_t* record, const mdns_record_t* source);
+
+//! Skip a name like mdns_string_skip, counting parse errors for the socket the packet was received on
+MDNS_EXTERN int
+mdns_string_skip_socket(socket_t* sock, const void* buffer, size_t size, size_t* offset);
+
+//! Store the current packet state in the given mark
+MDNS_EXTERN void
+mdns_builder_mark(const mdns_builder_t* builder, mdns_builder_mark_t* mark);
+
+//! Remove all entries added since the given mark was stored. The mark is invalid once the packet has
+//! been flushed
+MDNS_EXTERN void
+mdns_builder_rollback(mdns_builder_t* builder, const mdns_builder_mark_t* mark);
@@ -0,0 +1,298 @@
+/* loop.c  -  mDNS library  -  Public Domain  -  2014 Mattias Jansson
+ *
+ * This library provides a cross-platform mDNS and DNS-SD library in C based
+ * on our foundation and network libraries. The implementation is based on RFC 6762
+ * and RFC 6763.
+ *
+ * The latest source code maintained by Mattias Jansson is always available at
+ *
+ * https://github.com/mjansson/mdns_lib
+ *
+ * The foundation and network library source code maintained by Mattias Jansson
+ * is always available at
+ *
+ * https://github.com/mjansson/foundation_lib
+ * https://github.com/mjansson/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify
+ * it without any restrictions.
+ *
+ */
+
+#include <mdns/mdns.h>
+#include <foundation/foundation.h>
+#include <network/network.h>
+
+#include <limits.h>
+
+#if FOUNDATION_PLATFORM_LINUX || FOUNDATION_PLATFORM_ANDROID
+#include <sys/epoll.h>
+#include <unistd.h>
+#define MDNS_LOOP_EPOLL 1
+#else
+#define MDNS_LOOP_EPOLL 0
+#endif
+
+// Timer identifiers are the slot plus the slot generation times the number of slots
+#define MDNS_LOOP_TIMER_GENERATIONS ((unsigned int)(INT_MAX / MDNS_LOOP_TIMERS_MAX))
+
+mdns_loop_t*
+mdns_loop_allocate(void) {
+	mdns_loop_t* loop = memory_allocate(HASH_MDNS, sizeof(mdns_loop_t), 0, MEMORY_PERSISTENT);
+	if (mdns_loop_initialize(loop) < 0) {
+		memory_deallocate(loop);
+		return 0;
+	}
+	return loop;
+}
+
+void
+mdns_loop_deallocate(mdns_loop_t* loop) {
+	if (!loop)
+		return;
+	mdns_loop_finalize(loop);
+	memory_deallocate(loop);
+}
+
+int
+mdns_loop_initialize(mdns_loop_t* loop) {
+	memset(loop, 0, sizeof(mdns_loop_t));
+	loop->fd = -1;
+#if MDNS_LOOP_EPOLL
+	loop->fd = epoll_create1(EPOLL_CLOEXEC);
+	if (loop->fd < 0) {
+		log_error(HASH_MDNS, ERROR_SYSTEM_CALL_FAIL, STRING_CONST("Failed to create mDNS event loop epoll set"));
+		return -1;
+	}
+#endif
+	return 0;
+}
+
+void
+mdns_loop_finalize(mdns_loop_t* loop) {
+#if MDNS_LOOP_EPOLL
+	if (loop->fd >= 0)
+		close(loop->fd);
+#endif
+	loop->fd = -1;
+}
+
+int
+mdns_loop_add_socket(mdns_loop_t* loop, socket_t* sock, mdns_loop_receive_t receive, void* buffer, size_t capacity,
+                     mdns_record_callback_fn callback, void* user_data) {
+	if (!sock || (sock->fd < 0) || !buffer || (capacity < sizeof(struct mdns_header_t)))
+		return -1;
+
+	size_t islot = 0;
+	while ((islot < MDNS_LOOP_SOCKETS_MAX) && loop->socket[islot].sock)
+		++islot;
+	if (islot >= MDNS_LOOP_SOCKETS_MAX)
+		return -1;
+
+#if MDNS_LOOP_EPOLL
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.u32 = (uint32_t)islot;
+	if (epoll_ctl(loop->fd, EPOLL_CTL_ADD, sock->fd, &event) < 0)
+		return -1;
+#endif
+
+	mdns_loop_socket_t* entry = loop->socket + islot;
+	entry->sock = sock;
+	entry->receive = receive;
+	entry->buffer = buffer;
+	entry->capacity = capacity;
+	entry->slot_count = capacity / MDNS_LOOP_DATAGRAM_SIZE;
+	if (entry->slot_count > MDNS_RECV_BATCH_MAX)
+		entry->slot_count = MDNS_RECV_BATCH_MAX;
+	if (!entry->slot_count)
+		entry->slot_count = 1;
+	// Keep each slot 32 bit aligned
+	entry->slot_size = (capacity / entry->slot_count) & ~(size_t)3;
+	if (entry->slot_count == 1)
+		entry->slot_size = capacity;
+	entry->callback = callback;
+	entry->user_data = user_data;
+	return 0;
+}
+
+void
+mdns_loop_remove_socket(mdns_loop_t* loop, socket_t* sock) {
+	for (size_t islot = 0; islot < MDNS_LOOP_SOCKETS_MAX; ++islot) {
+		if (loop->socket[islot].sock != sock)
+			continue;
+#if MDNS_LOOP_EPOLL
+		if (sock->fd >= 0)
+			epoll_ctl(loop->fd, EPOLL_CTL_DEL, sock->fd, 0);
+#endif
+		memset(loop->socket + islot, 0, sizeof(mdns_loop_socket_t));
+	}
+}
+
+static int
+mdns_loop_timer_id(const mdns_loop_t* loop, int itimer) {
+	return (int)(loop->timer[itimer].generation * MDNS_LOOP_TIMERS_MAX) + itimer;
+}
+
+static void
+mdns_loop_timer_clear(mdns_loop_timer_t* timer) {
+	timer->deadline = 0;
+	timer->callback = 0;
+	timer->user_data = 0;
+}
+
+int
+mdns_loop_add_timer(mdns_loop_t* loop, unsigned int milliseconds, mdns_loop_timer_fn callback, void* user_data) {
+	if (!callback)
+		return -1;
+	for (int itimer = 0; itimer < MDNS_LOOP_TIMERS_MAX; ++itimer) {
+		mdns_loop_timer_t* timer = loop->timer + itimer;
+		if (timer->callback)
+			continue;
+		timer->deadline = time_current() + ((time_ticks_per_second() * (tick_t)milliseconds) / 1000);
+		timer->callback = callback;
+		timer->user_data = user_data;
+		timer->generation = (timer->generation + 1) % MDNS_LOOP_TIMER_GENERATIONS;
+		return mdns_loop_timer_id(loop, itimer);
+	}
+	return -1;
+}
+
+void
+mdns_loop_remove_timer(mdns_loop_t* loop, int timer) {
+	if (timer < 0)
+		return;
+	// A timer that already fired or was removed may have its slot rearmed, leave it be
+	int itimer = timer % MDNS_LOOP_TIMERS_MAX;
+	if (mdns_loop_timer_id(loop, itimer) == timer)
+		mdns_loop_timer_clear(loop->timer + itimer);
+}
+
+void
+mdns_loop_break(mdns_loop_t* loop) {
+	loop->terminate = true;
+}
+
+static size_t
+mdns_loop_receive(mdns_loop_t* loop, mdns_loop_socket_t* entry) {
+	mdns_datagram_t datagram[MDNS_RECV_BATCH_MAX];
+	for (size_t islot = 0; islot < entry->slot_count; ++islot) {
+		datagram[islot].buffer = pointer_offset(entry->buffer, islot * entry->slot_size);
+		datagram[islot].capacity = entry->slot_size;
+	}
+
+	size_t records = 0;
+	// Bound the number of datagrams drained per wakeup so a flood on one socket cannot starve the others,
+	// pending datagrams will trigger another wakeup
+	size_t drained = 0;
+	while ((drained < MDNS_RECV_BATCH_MAX) && entry->sock && !loop->terminate) {
+		size_t count = MDNS_RECV_BATCH_MAX - drained;
+		if (count > entry->slot_count)
+			count = entry->slot_count;
+		size_t received = mdns_socket_recv_batch(entry->sock, datagram, count, 0);
+		// The callback can remove the socket or break the loop, the rest of the batch is then dropped
+		for (size_t idgram = 0; (idgram < received) && entry->sock && !loop->terminate; ++idgram) {
+			const mdns_datagram_t* dgram = datagram + idgram;
+			switch (entry->receive) {
+				case MDNS_LOOP_SERVICE:
+					records += mdns_service_parse(entry->sock, dgram->from, dgram->buffer, dgram->size,
+					                              entry->callback, entry->user_data);
+					break;
+				case MDNS_LOOP_QUERY:
+					records += mdns_query_parse(entry->sock, dgram->from, dgram->buffer, dgram->size,
+					                            entry->callback, entry->user_data, 0);
+					break;
+				case MDNS_LOOP_DISCOVERY:
+					records += mdns_discovery_parse(entry->sock, dgram->from, dgram->buffer, dgram->size,
+					                                entry->callback, entry->user_data);
+					break;
+			}
+		}
+		drained += received;
+		// Socket queue drained
+		if (received < count)
+			break;
+	}
+	return records;
+}
+
+static tick_t
+mdns_loop_fire_timers(mdns_loop_t* loop, tick_t deadline) {
+	tick_t now = time_current();
+	for (int itimer = 0; (itimer < MDNS_LOOP_TIMERS_MAX) && !loop->terminate; ++itimer) {
+		mdns_loop_timer_t* timer = loop->timer + itimer;
+		if (!timer->callback || (timer->deadline > now))
+			continue;
+		mdns_loop_timer_fn callback = timer->callback;
+		void* user_data = timer->user_data;
+		int id = mdns_loop_timer_id(loop, itimer);
+		// Clear before calling so the callback can rearm the same slot
+		mdns_loop_timer_clear(timer);
+		callback(loop, id, user_data);
+	}
+	for (int itimer = 0; itimer < MDNS_LOOP_TIMERS_MAX; ++itimer) {
+		if (loop->timer[itimer].callback && (loop->timer[itimer].deadline < deadline))
+			deadline = loop->timer[itimer].deadline;
+	}
+	return deadline;
+}
+
+size_t
+mdns_loop_run(mdns_loop_t* loop, unsigned int timeout) {
+	size_t records = 0;
+	tick_t ticks_per_second = time_ticks_per_second();
+	tick_t end = time_current() + ((ticks_per_second * (tick_t)timeout) / 1000);
+
+	loop->terminate = false;
+	do {
+		tick_t wake = mdns_loop_fire_timers(loop, end);
+		if (loop->terminate)
+			break;
+
+		// Clamp the wait so the millisecond count fits in an int
+		tick_t now = time_current();
+		tick_t remain = (wake > now) ? wake - now : 0;
+		tick_t max_remain = ((tick_t)INT_MAX / 1000) * ticks_per_second;
+		if (remain > max_remain)
+			remain = max_remain;
+		int wait = (int)((remain * 1000 + (ticks_per_second - 1)) / ticks_per_second);
+
+#if MDNS_LOOP_EPOLL
+		struct epoll_event event[MDNS_LOOP_SOCKETS_MAX];
+		int ready = epoll_wait(loop->fd, event, MDNS_LOOP_SOCKETS_MAX, wait);
+		for (int ievent = 0; (ievent < ready) && !loop->terminate; ++ievent) {
+			uint32_t islot = event[ievent].data.u32;
+			if (islot < MDNS_LOOP_SOCKETS_MAX)
+				records += mdns_loop_receive(loop, loop->socket + islot);
+		}
+#else
+		fd_set readfs;
+		int nfds = 0;
+		FD_ZERO(&readfs);
+		for (size_t islot = 0; islot < MDNS_LOOP_SOCKETS_MAX; ++islot) {
+			socket_t* sock = loop->socket[islot].sock;
+			if (!sock)
+				continue;
+			FD_SET(sock->fd, &readfs);
+			if (sock->fd >= nfds)
+				nfds = sock->fd + 1;
+		}
+		struct timeval tv;
+		tv.tv_sec = wait / 1000;
+		tv.tv_usec = (wait % 1000) * 1000;
+		int ready = select(nfds, &readfs, 0, 0, &tv);
+		for (size_t islot = 0; (ready > 0) && (islot < MDNS_LOOP_SOCKETS_MAX) && !loop->terminate; ++islot) {
+			socket_t* sock = loop->socket[islot].sock;
+			if (sock && FD_ISSET(sock->fd, &readfs))
+				records += mdns_loop_receive(loop, loop->socket + islot);
+		}
+#endif
+	} while (!loop->terminate && (time_current() < end));
+
+	// Fire timers expired during the last wait
+	if (!loop->terminate)
+		mdns_loop_fire_timers(loop, end);
+
+	return records;
+}
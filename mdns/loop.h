@@ -0,0 +1,78 @@
+/* loop.h  -  mDNS library  -  Public Domain  -  2014 Mattias Jansson
+ *
+ * This library provides a cross-platform mDNS and DNS-SD library in C based
+ * on our foundation and network libraries. The implementation is based on RFC 6762
+ * and RFC 6763.
+ *
+ * The latest source code maintained by Mattias Jansson is always available at
+ *
+ * https://github.com/mjansson/mdns_lib
+ *
+ * The foundation and network library source code maintained by Mattias Jansson
+ * is always available at
+ *
+ * https://github.com/mjansson/foundation_lib
+ * https://github.com/mjansson/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify
+ * it without any restrictions.
+ *
+ */
+
+#pragma once
+
+#include <foundation/platform.h>
+#include <network/types.h>
+
+#include <mdns/types.h>
+
+//! Allocate and initialize an event loop. Returns null if error.
+MDNS_API mdns_loop_t*
+mdns_loop_allocate(void);
+
+//! Finalize and deallocate an event loop. Sockets are not deallocated.
+MDNS_API void
+mdns_loop_deallocate(mdns_loop_t* loop);
+
+//! Initialize an event loop, creating the epoll set where available. Returns 0 if success, or <0 if error.
+MDNS_API int
+mdns_loop_initialize(mdns_loop_t* loop);
+
+//! Finalize an event loop. Sockets are not deallocated.
+MDNS_API void
+mdns_loop_finalize(mdns_loop_t* loop);
+
+//! Register a socket bound with mdns_socket_bind in the event loop. When readable, all pending datagrams are
+//! received into the given buffer (must be 32 bit aligned) and parsed with the parse function matching the
+//! receive mode, piping records to the given callback. The buffer is split in slots of at least
+//! MDNS_LOOP_DATAGRAM_SIZE bytes, up to MDNS_RECV_BATCH_MAX, and a batch of datagrams is received into the slots
+//! with as few system calls as the platform allows. A buffer smaller than two slots receives one datagram at a time.
+//! Returns 0 if success, or <0 if error.
+MDNS_API int
+mdns_loop_add_socket(mdns_loop_t* loop, socket_t* sock, mdns_loop_receive_t receive, void* buffer, size_t capacity,
+                     mdns_record_callback_fn callback, void* user_data);
+
+//! Remove a socket from the event loop
+MDNS_API void
+mdns_loop_remove_socket(mdns_loop_t* loop, socket_t* sock);
+
+//! Add a one-shot timer firing the given number of milliseconds from now. Returns the timer identifier, or <0 if
+//! error. The identifier is only valid until the timer fires or is removed, a stale identifier never refers to a
+//! later timer.
+MDNS_API int
+mdns_loop_add_timer(mdns_loop_t* loop, unsigned int milliseconds, mdns_loop_timer_fn callback, void* user_data);
+
+//! Remove a pending timer
+MDNS_API void
+mdns_loop_remove_timer(mdns_loop_t* loop, int timer);
+
+//! Run the event loop until the timeout expires or mdns_loop_break is called, waiting for sockets and timers
+//! without polling. A timeout of 0 processes pending events without waiting. Returns the number of records
+//! parsed.
+MDNS_API size_t
+mdns_loop_run(mdns_loop_t* loop, unsigned int timeout);
+
+//! Stop the currently running mdns_loop_run call, typically called from a record or timer callback once the
+//! expected answer has arrived.
+MDNS_API void
+mdns_loop_break(mdns_loop_t* loop);
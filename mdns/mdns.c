@@ -20,30 +20,34 @@
  */
 
 #include <mdns/mdns.h>
+#include <mdns/internal.h>
 
 #include <foundation/foundation.h>
 #include <network/network.h>
 
 static bool mdns_initialized = false;
 
-extern const uint8_t mdns_services_query[46];
-
-const uint8_t mdns_services_query[46] = {
-    // Query ID
-    0x00, 0x00,
-    // Flags
-    0x00, 0x00,
-    // 1 question
-    0x00, 0x01,
-    // No answer, authority or additional RRs
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+extern const void* const mdns_services_query;
+extern const size_t mdns_services_query_size;
+extern const mdns_name_t mdns_services_name;
+
+static const struct mdns_services_query_t {
+	uint8_t header[12];
+	MDNS_NAME_FIELDS("_services", "_dns-sd", "_udp", "local");
+	uint8_t question[4];
+} mdns_services_packet = {
+    // Query ID, flags, 1 question, no answer, authority or additional RRs
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
     // _services._dns-sd._udp.local.
-    0x09, '_', 's', 'e', 'r', 'v', 'i', 'c', 'e', 's', 0x07, '_', 'd', 'n', 's', '-', 's', 'd', 0x04, '_', 'u', 'd',
-    'p', 0x05, 'l', 'o', 'c', 'a', 'l', 0x00,
-    // PTR record
-    0x00, MDNS_RECORDTYPE_PTR,
-    // QU (unicast response) and class IN
-    0x80, MDNS_CLASS_IN};
+    MDNS_NAME_VALUES("_services", "_dns-sd", "_udp", "local"),
+    // PTR record, QU (unicast response) and class IN
+    {0x00, MDNS_RECORDTYPE_PTR, 0x80, MDNS_CLASS_IN}};
+
+const void* const mdns_services_query = &mdns_services_packet;
+const size_t mdns_services_query_size = sizeof(mdns_services_packet);
+const mdns_name_t mdns_services_name = {
+    (const uint8_t*)&mdns_services_packet + offsetof(struct mdns_services_query_t, length0),
+    offsetof(struct mdns_services_query_t, question) - offsetof(struct mdns_services_query_t, length0), 0};
 
 int
 mdns_module_initialize(const mdns_config_t config) {
@@ -100,45 +104,57 @@ mdns_htonl(void* data, uint32_t val) {
 
 int
 mdns_unicast_send(socket_t* sock, const network_address_t* to, const void* buffer, size_t size) {
-	if (udp_socket_sendto(sock, buffer, size, to) != size)
+	if (udp_socket_sendto(sock, buffer, size, to) != size) {
+		mdns_stats_add(sock, MDNS_STAT_SEND_FAILED, 1);
 		return -1;
+	}
+	mdns_stats_add(sock, MDNS_STAT_PACKETS_OUT, 1);
+	mdns_stats_add(sock, MDNS_STAT_BYTES_OUT, size);
 	return 0;
 }
 
 int
-mdns_multicast_send(socket_t* sock, const void* buffer, size_t size) {
-	struct sockaddr_storage addr_storage;
-	struct sockaddr_in addr;
-	struct sockaddr_in6 addr6;
-	struct sockaddr* saddr = (struct sockaddr*)&addr_storage;
-	socklen_t saddrlen = sizeof(struct sockaddr_storage);
-	if (sock->family == NETWORK_ADDRESSFAMILY_IPV4) {
-		memset(&addr, 0, sizeof(addr));
-		addr.sin_family = AF_INET;
+mdns_multicast_address(network_address_family_t family, struct sockaddr_storage* addr_storage, socklen_t* saddrlen) {
+	if (family == NETWORK_ADDRESSFAMILY_IPV4) {
+		struct sockaddr_in* addr = (struct sockaddr_in*)addr_storage;
+		memset(addr, 0, sizeof(struct sockaddr_in));
+		addr->sin_family = AF_INET;
 #ifdef __APPLE__
-		addr.sin_len = sizeof(addr);
+		addr->sin_len = sizeof(struct sockaddr_in);
 #endif
-		addr.sin_addr.s_addr = htonl((((uint32_t)224U) << 24U) | ((uint32_t)251U));
-		addr.sin_port = htons((unsigned short)MDNS_PORT);
-		saddr = (struct sockaddr*)&addr;
-		saddrlen = sizeof(addr);
-	} else if (sock->family == NETWORK_ADDRESSFAMILY_IPV6) {
-		memset(&addr6, 0, sizeof(addr6));
-		addr6.sin6_family = AF_INET6;
+		addr->sin_addr.s_addr = htonl((((uint32_t)224U) << 24U) | ((uint32_t)251U));
+		addr->sin_port = htons((unsigned short)MDNS_PORT);
+		*saddrlen = sizeof(struct sockaddr_in);
+	} else if (family == NETWORK_ADDRESSFAMILY_IPV6) {
+		struct sockaddr_in6* addr6 = (struct sockaddr_in6*)addr_storage;
+		memset(addr6, 0, sizeof(struct sockaddr_in6));
+		addr6->sin6_family = AF_INET6;
 #ifdef __APPLE__
-		addr6.sin6_len = sizeof(addr6);
+		addr6->sin6_len = sizeof(struct sockaddr_in6);
 #endif
-		addr6.sin6_addr.s6_addr[0] = 0xFF;
-		addr6.sin6_addr.s6_addr[1] = 0x02;
-		addr6.sin6_addr.s6_addr[15] = 0xFB;
-		addr6.sin6_port = htons((unsigned short)MDNS_PORT);
-		saddr = (struct sockaddr*)&addr6;
-		saddrlen = sizeof(addr6);
+		addr6->sin6_addr.s6_addr[0] = 0xFF;
+		addr6->sin6_addr.s6_addr[1] = 0x02;
+		addr6->sin6_addr.s6_addr[15] = 0xFB;
+		addr6->sin6_port = htons((unsigned short)MDNS_PORT);
+		*saddrlen = sizeof(struct sockaddr_in6);
 	} else {
 		return -1;
 	}
+	return 0;
+}
 
-	if (sendto(sock->fd, (const char*)buffer, (mdns_size_t)size, 0, saddr, saddrlen) < 0)
+int
+mdns_multicast_send(socket_t* sock, const void* buffer, size_t size) {
+	struct sockaddr_storage addr_storage;
+	socklen_t saddrlen = sizeof(struct sockaddr_storage);
+	if (mdns_multicast_address(sock->family, &addr_storage, &saddrlen) < 0)
 		return -1;
+
+	if (sendto(sock->fd, (const char*)buffer, (mdns_size_t)size, 0, (struct sockaddr*)&addr_storage, saddrlen) < 0) {
+		mdns_stats_add(sock, MDNS_STAT_SEND_FAILED, 1);
+		return -1;
+	}
+	mdns_stats_add(sock, MDNS_STAT_PACKETS_OUT, 1);
+	mdns_stats_add(sock, MDNS_STAT_BYTES_OUT, size);
 	return 0;
 }
@@ -29,9 +29,19 @@
 #include <mdns/socket.h>
 #include <mdns/query.h>
 #include <mdns/record.h>
+#include <mdns/packet.h>
 #include <mdns/service.h>
 #include <mdns/string.h>
 #include <mdns/discovery.h>
+#include <mdns/send.h>
+#include <mdns/loop.h>
+#include <mdns/store.h>
+#include <mdns/cache.h>
+#include <mdns/querier.h>
+#include <mdns/template.h>
+#include <mdns/builder.h>
+#include <mdns/txt.h>
+#include <mdns/stats.h>
 
 MDNS_API int
 mdns_module_initialize(const mdns_config_t config);
@@ -0,0 +1,347 @@
+/* packet.c  -  mDNS library  -  Public Domain  -  2014 Mattias Jansson
+ *
+ * This library provides a cross-platform mDNS and DNS-SD library in C based
+ * on our foundation and network libraries. The implementation is based on RFC 6762
+ * and RFC 6763.
+ *
+ * The latest source code maintained by Mattias Jansson is always available at
+ *
+ * https://github.com/mjansson/mdns_lib
+ *
+ * The foundation and network library source code maintained by Mattias Jansson
+ * is always available at
+ *
+ * https://github.com/mjansson/foundation_lib
+ * https://github.com/mjansson/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify
+ * it without any restrictions.
+ *
+ */
+
+#include <foundation/foundation.h>
+#include <mdns/mdns.h>
+#include <mdns/internal.h>
+
+int
+mdns_packet_cursor_initialize(mdns_packet_cursor_t* cursor, socket_t* sock, const void* buffer, size_t size) {
+	memset(cursor, 0, sizeof(mdns_packet_cursor_t));
+	cursor->buffer = buffer;
+	cursor->size = size;
+	cursor->sock = sock;
+	if (size < sizeof(struct mdns_header_t)) {
+		mdns_stats_add(sock, MDNS_STAT_ERROR_HEADER, 1);
+		cursor->error = -1;
+		return -1;
+	}
+
+	const uint16_t* data = (const uint16_t*)buffer;
+	cursor->query_id = mdns_ntohs(data++);
+	cursor->flags = mdns_ntohs(data++);
+	cursor->remain[MDNS_ENTRYTYPE_QUESTION] = mdns_ntohs(data++);
+	cursor->remain[MDNS_ENTRYTYPE_ANSWER] = mdns_ntohs(data++);
+	cursor->remain[MDNS_ENTRYTYPE_AUTHORITY] = mdns_ntohs(data++);
+	cursor->remain[MDNS_ENTRYTYPE_ADDITIONAL] = mdns_ntohs(data++);
+	cursor->offset = sizeof(struct mdns_header_t);
+	return 0;
+}
+
+void
+mdns_packet_cursor_initialize_section(mdns_packet_cursor_t* cursor, const void* buffer, size_t size, size_t offset,
+                                      mdns_entry_type_t section, size_t count) {
+	memset(cursor, 0, sizeof(mdns_packet_cursor_t));
+	cursor->buffer = buffer;
+	cursor->size = size;
+	cursor->offset = offset;
+	if (section <= MDNS_ENTRYTYPE_ADDITIONAL)
+		cursor->remain[section] = (uint16_t)((count < 0xFFFF) ? count : 0xFFFF);
+}
+
+mdns_entry_type_t
+mdns_packet_cursor_section(const mdns_packet_cursor_t* cursor) {
+	if (cursor->error)
+		return MDNS_ENTRYTYPE_END;
+	if (cursor->remain[MDNS_ENTRYTYPE_QUESTION])
+		return MDNS_ENTRYTYPE_QUESTION;
+	if (cursor->remain[MDNS_ENTRYTYPE_ANSWER])
+		return MDNS_ENTRYTYPE_ANSWER;
+	if (cursor->remain[MDNS_ENTRYTYPE_AUTHORITY])
+		return MDNS_ENTRYTYPE_AUTHORITY;
+	if (cursor->remain[MDNS_ENTRYTYPE_ADDITIONAL])
+		return MDNS_ENTRYTYPE_ADDITIONAL;
+	return MDNS_ENTRYTYPE_END;
+}
+
+bool
+mdns_packet_cursor_next(mdns_packet_cursor_t* cursor, mdns_packet_entry_t* entry) {
+	mdns_entry_type_t section = mdns_packet_cursor_section(cursor);
+	if (section == MDNS_ENTRYTYPE_END)
+		return false;
+
+	size_t offset = cursor->offset;
+	if (!mdns_string_skip_socket(cursor->sock, cursor->buffer, cursor->size, &offset))
+		goto malformed;
+
+	entry->section = section;
+	entry->name_offset = cursor->offset;
+	entry->name_length = offset - cursor->offset;
+
+	const uint16_t* data = pointer_offset_const(cursor->buffer, offset);
+	if (section == MDNS_ENTRYTYPE_QUESTION) {
+		if ((offset + 4) > cursor->size)
+			goto truncated;
+		entry->rtype = mdns_ntohs(data++);
+		entry->rclass = mdns_ntohs(data++);
+		entry->ttl = 0;
+		entry->record_offset = entry->name_offset;
+		entry->record_length = entry->name_length;
+		offset += 4;
+	} else {
+		if ((offset + 10) > cursor->size)
+			goto truncated;
+		entry->rtype = mdns_ntohs(data++);
+		entry->rclass = mdns_ntohs(data++);
+		entry->ttl = mdns_ntohl(data);
+		data += 2;
+		uint16_t length = mdns_ntohs(data++);
+		offset += 10;
+		if (length > (cursor->size - offset))
+			goto truncated;
+		entry->record_offset = offset;
+		entry->record_length = length;
+		offset += length;
+	}
+
+	cursor->offset = offset;
+	--cursor->remain[section];
+	return true;
+
+truncated:
+	mdns_stats_add(cursor->sock, MDNS_STAT_ERROR_TRUNCATED, 1);
+malformed:
+	// Name errors are counted by mdns_string_skip
+	cursor->error = -1;
+	return false;
+}
+
+size_t
+mdns_packet_cursor_skip_section(mdns_packet_cursor_t* cursor) {
+	mdns_entry_type_t section = mdns_packet_cursor_section(cursor);
+	if (section == MDNS_ENTRYTYPE_END)
+		return 0;
+
+	size_t skipped = 0;
+	size_t offset = cursor->offset;
+	while (cursor->remain[section]) {
+		if (!mdns_string_skip_socket(cursor->sock, cursor->buffer, cursor->size, &offset))
+			goto malformed;
+		if (section == MDNS_ENTRYTYPE_QUESTION) {
+			offset += 4;
+		} else {
+			if ((offset + 10) > cursor->size)
+				goto truncated;
+			offset += 10 + mdns_ntohs(pointer_offset_const(cursor->buffer, offset + 8));
+		}
+		if (offset > cursor->size)
+			goto truncated;
+		--cursor->remain[section];
+		++skipped;
+	}
+
+	cursor->offset = offset;
+	return skipped;
+
+truncated:
+	mdns_stats_add(cursor->sock, MDNS_STAT_ERROR_TRUNCATED, 1);
+malformed:
+	cursor->error = -1;
+	return skipped;
+}
+
+// Validate the name at the given offset, following compression pointers. Each pointer must point before the start
+// of the label sequence containing it, which bounds the walk and rejects loops. Returns the offset following the
+// name in the entry, or 0 if malformed.
+static size_t
+mdns_packet_validate_name(socket_t* sock, const uint8_t* buffer, size_t size, size_t offset) {
+	size_t end = 0;
+	size_t limit = offset;
+	size_t length = 0;
+	while (offset < size) {
+		uint8_t val = buffer[offset];
+		if (!val)
+			return end ? end : offset + 1;
+		if ((val & 0xC0) == 0xC0) {
+			if ((offset + 2) > size)
+				break;
+			size_t target = mdns_ntohs(buffer + offset) & 0x3FFF;
+			if (target >= limit) {
+				mdns_stats_add(sock, MDNS_STAT_ERROR_NAME_LOOP, 1);
+				return 0;
+			}
+			if (!end)
+				end = offset + 2;
+			limit = target;
+			offset = target;
+			continue;
+		}
+		// Reserved label types
+		if (val & 0xC0)
+			return 0;
+		// The name including the root label byte is at most 255 bytes
+		length += (size_t)val + 1;
+		if (length + 1 > 255) {
+			mdns_stats_add(sock, MDNS_STAT_ERROR_NAME_LOOP, 1);
+			return 0;
+		}
+		if ((offset + 1 + val) > size)
+			break;
+		offset += 1 + (size_t)val;
+	}
+	mdns_stats_add(sock, MDNS_STAT_ERROR_NAME_BOUNDS, 1);
+	return 0;
+}
+
+static bool
+mdns_packet_validate_record(socket_t* sock, const uint8_t* buffer, uint16_t rtype, size_t offset, size_t length) {
+	size_t end = offset + length;
+	size_t name_end;
+	switch (rtype) {
+		case MDNS_RECORDTYPE_A:
+			return (length == 4);
+		case MDNS_RECORDTYPE_AAAA:
+			return (length == 16);
+		case MDNS_RECORDTYPE_PTR:
+			name_end = mdns_packet_validate_name(sock, buffer, end, offset);
+			return (name_end == end);
+		case MDNS_RECORDTYPE_SRV:
+			if (length < 8)
+				return false;
+			name_end = mdns_packet_validate_name(sock, buffer, end, offset + 6);
+			return (name_end == end);
+		case MDNS_RECORDTYPE_TXT:
+			while (offset < end)
+				offset += 1 + (size_t)buffer[offset];
+			return (offset == end);
+		default:
+			return true;
+	}
+}
+
+int
+mdns_packet_index(socket_t* sock, const void* buffer, size_t size, mdns_packet_index_t* index) {
+	const uint8_t* data = (const uint8_t*)buffer;
+	index->buffer = buffer;
+	index->size = size;
+	index->sock = sock;
+	index->entry_count = 0;
+	// Offsets are stored in 16 bits, which covers any UDP payload
+	if ((size < sizeof(struct mdns_header_t)) || (size > 0xFFFF)) {
+		mdns_stats_add(sock, MDNS_STAT_ERROR_HEADER, 1);
+		return -1;
+	}
+
+	index->query_id = mdns_ntohs(data);
+	index->flags = mdns_ntohs(data + 2);
+	size_t total = 0;
+	for (int isection = 0; isection < 4; ++isection) {
+		index->count[isection] = mdns_ntohs(data + 4 + (isection * 2));
+		total += index->count[isection];
+	}
+	if (total > MDNS_PACKET_INDEX_MAX)
+		return -1;
+
+	size_t offset = sizeof(struct mdns_header_t);
+	for (int isection = 0; isection < 4; ++isection) {
+		for (uint16_t irec = 0; irec < index->count[isection]; ++irec) {
+			mdns_packet_index_entry_t* entry = index->entry + index->entry_count;
+			size_t name_end = mdns_packet_validate_name(sock, data, size, offset);
+			if (!name_end)
+				return -1;
+
+			entry->section = (uint8_t)isection;
+			entry->name_offset = (uint16_t)offset;
+			entry->name_length = (uint16_t)(name_end - offset);
+			offset = name_end;
+			if (isection == MDNS_ENTRYTYPE_QUESTION) {
+				if ((offset + 4) > size)
+					goto truncated;
+				entry->rtype = mdns_ntohs(data + offset);
+				entry->rclass = mdns_ntohs(data + offset + 2);
+				entry->ttl = 0;
+				entry->record_offset = entry->name_offset;
+				entry->record_length = entry->name_length;
+				offset += 4;
+			} else {
+				if ((offset + 10) > size)
+					goto truncated;
+				entry->rtype = mdns_ntohs(data + offset);
+				entry->rclass = mdns_ntohs(data + offset + 2);
+				entry->ttl = mdns_ntohl(data + offset + 4);
+				uint16_t length = mdns_ntohs(data + offset + 8);
+				offset += 10;
+				if (length > (size - offset))
+					goto truncated;
+				if (!mdns_packet_validate_record(sock, data, entry->rtype, offset, length))
+					return -1;
+				entry->record_offset = (uint16_t)offset;
+				entry->record_length = length;
+				offset += length;
+			}
+			++index->entry_count;
+		}
+	}
+
+	return (int)index->entry_count;
+
+truncated:
+	mdns_stats_add(sock, MDNS_STAT_ERROR_TRUNCATED, 1);
+	return -1;
+}
+
+// Names in an index have been validated, so no bounds checks are needed
+static string_const_t
+mdns_packet_index_extract(const uint8_t* buffer, size_t offset, char* str, size_t capacity) {
+	size_t length = 0;
+	while (buffer[offset]) {
+		if ((buffer[offset] & 0xC0) == 0xC0) {
+			offset = mdns_ntohs(buffer + offset) & 0x3FFF;
+			continue;
+		}
+		size_t sublength = buffer[offset++];
+		size_t to_copy = (sublength < (capacity - length)) ? sublength : (capacity - length);
+		memcpy(str + length, buffer + offset, to_copy);
+		length += to_copy;
+		if (length < capacity)
+			str[length++] = '.';
+		offset += sublength;
+	}
+	return string_const(str, length);
+}
+
+string_const_t
+mdns_packet_index_name(const mdns_packet_index_t* index, size_t ientry, char* str, size_t capacity) {
+	if (ientry >= index->entry_count)
+		return string_const(str, 0);
+	return mdns_packet_index_extract(index->buffer, index->entry[ientry].name_offset, str, capacity);
+}
+
+string_const_t
+mdns_packet_index_target(const mdns_packet_index_t* index, size_t ientry, char* str, size_t capacity) {
+	if (ientry >= index->entry_count)
+		return string_const(str, 0);
+	const mdns_packet_index_entry_t* entry = index->entry + ientry;
+	if (entry->section == MDNS_ENTRYTYPE_QUESTION)
+		return string_const(str, 0);
+	if (entry->rtype == MDNS_RECORDTYPE_PTR)
+		return mdns_packet_index_extract(index->buffer, entry->record_offset, str, capacity);
+	if (entry->rtype == MDNS_RECORDTYPE_SRV)
+		return mdns_packet_index_extract(index->buffer, entry->record_offset + 6U, str, capacity);
+	return string_const(str, 0);
+}
+
+bool
+mdns_packet_index_name_equal(const mdns_packet_index_t* index, size_t ientry, const char* name, size_t length) {
+	if (ientry >= index->entry_count)
+		return false;
+	return mdns_string_equal_name(index->buffer, index->size, index->entry[ientry].name_offset, name, length) != 0;
+}
@@ -0,0 +1,75 @@
+/* packet.h  -  mDNS library  -  Public Domain  -  2014 Mattias Jansson
+ *
+ * This library provides a cross-platform mDNS and DNS-SD library in C based
+ * on our foundation and network libraries. The implementation is based on RFC 6762
+ * and RFC 6763.
+ *
+ * The latest source code maintained by Mattias Jansson is always available at
+ *
+ * https://github.com/mjansson/mdns_lib
+ *
+ * The foundation and network library source code maintained by Mattias Jansson
+ * is always available at
+ *
+ * https://github.com/mjansson/foundation_lib
+ * https://github.com/mjansson/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify
+ * it without any restrictions.
+ *
+ */
+
+#pragma once
+
+#include <foundation/platform.h>
+
+#include <mdns/types.h>
+
+//! Initialize a cursor on a received packet, decoding the header. The cursor references the buffer, which must
+//! remain valid while iterating. Parse errors are counted for the socket the packet was received on, which can be
+//! null if not known. Returns 0 if success, or <0 if the buffer is too small to hold a header.
+MDNS_API int
+mdns_packet_cursor_initialize(mdns_packet_cursor_t* cursor, socket_t* sock, const void* buffer, size_t size);
+
+//! Initialize a cursor on a single section of a packet, starting at the given offset with the given number of
+//! entries. The query ID and flags are not decoded.
+MDNS_API void
+mdns_packet_cursor_initialize_section(mdns_packet_cursor_t* cursor, const void* buffer, size_t size, size_t offset,
+                                      mdns_entry_type_t section, size_t count);
+
+//! Get the section of the next entry, or MDNS_ENTRYTYPE_END if all entries have been read
+MDNS_API mdns_entry_type_t
+mdns_packet_cursor_section(const mdns_packet_cursor_t* cursor);
+
+//! Read the next question or record in the packet. All offsets in the entry point into the packet buffer, no data
+//! is copied. Returns true if an entry was read, false if all entries have been read or the packet is malformed
+//! (cursor error field set).
+MDNS_API bool
+mdns_packet_cursor_next(mdns_packet_cursor_t* cursor, mdns_packet_entry_t* entry);
+
+//! Skip all remaining entries in the current section without decoding them. Returns the number of entries skipped.
+MDNS_API size_t
+mdns_packet_cursor_skip_section(mdns_packet_cursor_t* cursor);
+
+//! Validate a received packet in a single pass and build an index of all questions and records. Every label and
+//! compression pointer in entry names and in PTR and SRV record data is bounds checked, compression pointers must
+//! point strictly backwards, and A, AAAA and TXT record data is checked for correct length. The index references
+//! the buffer, which must remain valid while using the index. Parse errors are counted for the socket the packet
+//! was received on, which can be null if not known. Returns the number of indexed entries, or <0 if the packet is
+//! malformed or has more than MDNS_PACKET_INDEX_MAX entries.
+MDNS_API int
+mdns_packet_index(socket_t* sock, const void* buffer, size_t size, mdns_packet_index_t* index);
+
+//! Extract the name of an indexed entry as a dotted string without revalidating the packet
+MDNS_API string_const_t
+mdns_packet_index_name(const mdns_packet_index_t* index, size_t ientry, char* str, size_t capacity);
+
+//! Extract the target name of an indexed PTR or SRV record as a dotted string without revalidating the packet.
+//! Returns an empty string for other record types.
+MDNS_API string_const_t
+mdns_packet_index_target(const mdns_packet_index_t* index, size_t ientry, char* str, size_t capacity);
+
+//! Compare the name of an indexed entry with a dotted string (with or without trailing dot), ignoring case and
+//! without revalidating the packet
+MDNS_API bool
+mdns_packet_index_name_equal(const mdns_packet_index_t* index, size_t ientry, const char* name, size_t length);
@@ -0,0 +1,283 @@
+/* querier.c  -  mDNS library  -  Public Domain  -  2014 Mattias Jansson
+ *
+ * This library provides a cross-platform mDNS and DNS-SD library in C based
+ * on our foundation and network libraries. The implementation is based on RFC 6762
+ * and RFC 6763.
+ *
+ * The latest source code maintained by Mattias Jansson is always available at
+ *
+ * https://github.com/mjansson/mdns_lib
+ *
+ * The foundation and network library source code maintained by Mattias Jansson
+ * is always available at
+ *
+ * https://github.com/mjansson/foundation_lib
+ * https://github.com/mjansson/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify
+ * it without any restrictions.
+ *
+ */
+
+
+#include <mdns/mdns.h>
+#include <foundation/foundation.h>
+#include <network/network.h>
+
+mdns_querier_t*
+mdns_querier_allocate(void) {
+	mdns_querier_t* querier = memory_allocate(HASH_MDNS, sizeof(mdns_querier_t), 0, MEMORY_PERSISTENT);
+	mdns_querier_initialize(querier);
+	return querier;
+}
+
+void
+mdns_querier_deallocate(mdns_querier_t* querier) {
+	if (!querier)
+		return;
+	mdns_querier_finalize(querier);
+	memory_deallocate(querier);
+}
+
+void
+mdns_querier_initialize(mdns_querier_t* querier) {
+	memset(querier, 0, sizeof(mdns_querier_t));
+	querier->timer = -1;
+}
+
+void
+mdns_querier_finalize(mdns_querier_t* querier) {
+	if (querier->loop && (querier->timer >= 0))
+		mdns_loop_remove_timer(querier->loop, querier->timer);
+	memset(querier, 0, sizeof(mdns_querier_t));
+	querier->timer = -1;
+}
+
+static bool
+mdns_querier_name_equal(const mdns_querier_question_t* question, const char* name, size_t length) {
+	size_t question_length = question->length;
+	if (question_length && (question->name[question_length - 1] == '.'))
+		--question_length;
+	if (length && (name[length - 1] == '.'))
+		--length;
+	return (question_length == length) && mdns_string_equal_nocase(question->name, name, length);
+}
+
+static void
+mdns_querier_timer(mdns_loop_t* loop, int timer, void* user_data);
+
+// Rearm the loop timer for the next due question
+static void
+mdns_querier_arm(mdns_querier_t* querier) {
+	if (!querier->loop)
+		return;
+	if (querier->timer >= 0)
+		mdns_loop_remove_timer(querier->loop, querier->timer);
+	querier->timer = -1;
+	tick_t next = mdns_querier_next(querier);
+	if (!next)
+		return;
+	tick_t now = time_current();
+	unsigned int delay = 0;
+	if (next > now)
+		delay = (unsigned int)(((next - now) * 1000) / time_ticks_per_second()) + 1;
+	querier->timer = mdns_loop_add_timer(querier->loop, delay, mdns_querier_timer, querier);
+}
+
+static void
+mdns_querier_timer(mdns_loop_t* loop, int timer, void* user_data) {
+	FOUNDATION_UNUSED(loop);
+	FOUNDATION_UNUSED(timer);
+	mdns_querier_t* querier = user_data;
+	querier->timer = -1;
+	mdns_querier_send(querier, querier->sock, querier->buffer, querier->capacity);
+}
+
+int
+mdns_querier_add(mdns_querier_t* querier, mdns_record_type_t type, const char* name, size_t length) {
+	if (!length || (length >= sizeof(querier->question[0].name)))
+		return -1;
+
+	hash_t name_hash = mdns_string_hash(name, length);
+	int unused = -1;
+	for (int iquestion = 0; iquestion < MDNS_QUERIER_QUESTIONS_MAX; ++iquestion) {
+		mdns_querier_question_t* question = querier->question + iquestion;
+		if (!question->references) {
+			if (unused < 0)
+				unused = iquestion;
+			continue;
+		}
+		// Identical questions from multiple callers are sent as one
+		if ((question->type == type) && (question->name_hash == name_hash) &&
+		    mdns_querier_name_equal(question, name, length)) {
+			++question->references;
+			return iquestion;
+		}
+	}
+	if (unused < 0)
+		return -1;
+
+	mdns_querier_question_t* question = querier->question + unused;
+	memset(question, 0, sizeof(mdns_querier_question_t));
+	question->type = type;
+	question->name_hash = name_hash;
+	question->references = 1;
+	question->deadline = time_current();
+	question->length = length;
+	memcpy(question->name, name, length);
+	mdns_querier_arm(querier);
+	return unused;
+}
+
+int
+mdns_querier_remove(mdns_querier_t* querier, int handle) {
+	if ((handle < 0) || (handle >= MDNS_QUERIER_QUESTIONS_MAX) || !querier->question[handle].references)
+		return -1;
+	if (!--querier->question[handle].references)
+		mdns_querier_arm(querier);
+	return 0;
+}
+
+static void
+mdns_querier_restart(mdns_querier_t* querier, mdns_querier_question_t* question, tick_t now) {
+	question->interval = 0;
+	question->deadline = now;
+	++querier->resets;
+}
+
+size_t
+mdns_querier_reset(mdns_querier_t* querier, mdns_record_type_t type, const char* name, size_t length) {
+	size_t reset = 0;
+	hash_t name_hash = mdns_string_hash(name, length);
+	tick_t now = time_current();
+	for (int iquestion = 0; iquestion < MDNS_QUERIER_QUESTIONS_MAX; ++iquestion) {
+		mdns_querier_question_t* question = querier->question + iquestion;
+		if (!question->references || (question->name_hash != name_hash) ||
+		    ((type != MDNS_RECORDTYPE_ANY) && (question->type != type)) ||
+		    !mdns_querier_name_equal(question, name, length))
+			continue;
+		mdns_querier_restart(querier, question, now);
+		++reset;
+	}
+	if (reset)
+		mdns_querier_arm(querier);
+	return reset;
+}
+
+size_t
+mdns_querier_send(mdns_querier_t* querier, socket_t* sock, void* buffer, size_t capacity) {
+	mdns_query_t query[MDNS_QUERIER_QUESTIONS_MAX];
+	mdns_querier_question_t* due[MDNS_QUERIER_QUESTIONS_MAX];
+	size_t count = 0;
+	tick_t now = time_current();
+	for (int iquestion = 0; iquestion < MDNS_QUERIER_QUESTIONS_MAX; ++iquestion) {
+		mdns_querier_question_t* question = querier->question + iquestion;
+		if (!question->references || (question->deadline > now))
+			continue;
+		query[count].type = question->type;
+		query[count].name = question->name;
+		query[count].length = question->length;
+		due[count++] = question;
+	}
+
+	size_t handled = 0;
+	size_t sent = 0;
+	while (handled < count) {
+		// Put as many questions in each packet as fit in the buffer
+		size_t batch = count - handled;
+		while (batch && !mdns_multiquery_build(buffer, capacity, query + handled, batch, 0, false))
+			batch >>= 1;
+		if (!batch) {
+			// Question does not fit in the buffer on its own, back it off like the rest instead of
+			// leaving it due and waking up again immediately
+			++handled;
+			continue;
+		}
+		if (mdns_multiquery_send(sock, query + handled, batch, buffer, capacity, 0) >= 0) {
+			++querier->packets;
+			sent += batch;
+		}
+		handled += batch;
+	}
+
+	// Back off exponentially also if the send failed, retrying immediately would flood the link
+	for (size_t ihandled = 0; ihandled < handled; ++ihandled) {
+		mdns_querier_question_t* question = due[ihandled];
+		if (!question->interval)
+			question->interval = 1;
+		else if (question->interval < MDNS_QUERIER_INTERVAL_MAX)
+			question->interval = (question->interval * 2 < MDNS_QUERIER_INTERVAL_MAX) ? question->interval * 2 :
+			                                                                             MDNS_QUERIER_INTERVAL_MAX;
+		question->sent = now;
+		question->deadline = now + (time_ticks_per_second() * (tick_t)question->interval);
+	}
+	querier->queries += sent;
+	mdns_querier_arm(querier);
+	return sent;
+}
+
+tick_t
+mdns_querier_next(const mdns_querier_t* querier) {
+	tick_t next = 0;
+	for (int iquestion = 0; iquestion < MDNS_QUERIER_QUESTIONS_MAX; ++iquestion) {
+		const mdns_querier_question_t* question = querier->question + iquestion;
+		if (question->references && (!next || (question->deadline < next)))
+			next = question->deadline;
+	}
+	return next;
+}
+
+void
+mdns_querier_set_loop(mdns_querier_t* querier, mdns_loop_t* loop, socket_t* sock, void* buffer, size_t capacity) {
+	if (querier->loop && (querier->timer >= 0))
+		mdns_loop_remove_timer(querier->loop, querier->timer);
+	querier->timer = -1;
+	querier->loop = loop;
+	querier->sock = sock;
+	querier->buffer = buffer;
+	querier->capacity = capacity;
+	mdns_querier_arm(querier);
+}
+
+int
+mdns_querier_callback(socket_t* sock, const network_address_t* from, mdns_entry_type_t entry, uint16_t query_id,
+                      uint16_t rtype, uint16_t rclass, uint32_t ttl, const void* data, size_t size,
+                      size_t name_offset, size_t name_length, size_t record_offset, size_t record_length,
+                      void* user_data) {
+	FOUNDATION_UNUSED(sock);
+	FOUNDATION_UNUSED(from);
+	FOUNDATION_UNUSED(query_id);
+	FOUNDATION_UNUSED(name_length);
+	FOUNDATION_UNUSED(record_offset);
+	FOUNDATION_UNUSED(record_length);
+	mdns_querier_t* querier = user_data;
+	if (!querier || (entry == MDNS_ENTRYTYPE_QUESTION) || (entry == MDNS_ENTRYTYPE_END))
+		return 0;
+	bool flush = (rclass & MDNS_CACHE_FLUSH) != 0;
+	if (ttl && !flush)
+		return 0;
+
+	hash_t name_hash = 0;
+	size_t offset = name_offset;
+	if (!mdns_string_skip_hash(data, size, &offset, &name_hash, 0, 0))
+		return 0;
+
+	size_t reset = 0;
+	tick_t now = time_current();
+	for (int iquestion = 0; iquestion < MDNS_QUERIER_QUESTIONS_MAX; ++iquestion) {
+		mdns_querier_question_t* question = querier->question + iquestion;
+		if (!question->references || (question->name_hash != name_hash) ||
+		    ((question->type != MDNS_RECORDTYPE_ANY) && (question->type != rtype)))
+			continue;
+		// Flushed records arriving within a second of the query are the response to it
+		if (ttl && (now - question->sent <= time_ticks_per_second()))
+			continue;
+		if (!mdns_string_equal_name(data, size, name_offset, question->name, question->length))
+			continue;
+		mdns_querier_restart(querier, question, now);
+		++reset;
+	}
+	if (reset)
+		mdns_querier_arm(querier);
+	return 0;
+}
@@ -0,0 +1,84 @@
+/* querier.h  -  mDNS library  -  Public Domain  -  2014 Mattias Jansson
+ *
+ * This library provides a cross-platform mDNS and DNS-SD library in C based
+ * on our foundation and network libraries. The implementation is based on RFC 6762
+ * and RFC 6763.
+ *
+ * The latest source code maintained by Mattias Jansson is always available at
+ *
+ * https://github.com/mjansson/mdns_lib
+ *
+ * The foundation and network library source code maintained by Mattias Jansson
+ * is always available at
+ *
+ * https://github.com/mjansson/foundation_lib
+ * https://github.com/mjansson/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify
+ * it without any restrictions.
+ *
+ */
+
+
+#pragma once
+
+#include <foundation/platform.h>
+#include <network/types.h>
+
+#include <mdns/types.h>
+
+//! Allocate a continuous querier
+MDNS_API mdns_querier_t*
+mdns_querier_allocate(void);
+
+//! Finalize and deallocate a continuous querier
+MDNS_API void
+mdns_querier_deallocate(mdns_querier_t* querier);
+
+//! Initialize a continuous querier with no questions
+MDNS_API void
+mdns_querier_initialize(mdns_querier_t* querier);
+
+//! Finalize a continuous querier, removing the loop timer if any
+MDNS_API void
+mdns_querier_finalize(mdns_querier_t* querier);
+
+//! Add a continuous question, due immediately. An identical question already added by another
+//! caller is shared and keeps its schedule. Returns the question handle, or <0 if full
+MDNS_API int
+mdns_querier_add(mdns_querier_t* querier, mdns_record_type_t type, const char* name, size_t length);
+
+//! Release a question added with mdns_querier_add, the question is removed when the last caller
+//! releases it. Returns 0 if success, <0 if error
+MDNS_API int
+mdns_querier_remove(mdns_querier_t* querier, int handle);
+
+//! Reset the back-off of questions matching the name and type, or all types if type is
+//! MDNS_RECORDTYPE_ANY, making them due immediately. Returns the number of questions reset
+MDNS_API size_t
+mdns_querier_reset(mdns_querier_t* querier, mdns_record_type_t type, const char* name, size_t length);
+
+//! Send all due questions in as few multicast packets as fit in the buffer, built like
+//! mdns_query_send. Each question sent is next due after 1, 2, 4 ... seconds, capped at
+//! MDNS_QUERIER_INTERVAL_MAX seconds (RFC 6762 section 5.2). Returns the number of questions sent
+MDNS_API size_t
+mdns_querier_send(mdns_querier_t* querier, socket_t* sock, void* buffer, size_t capacity);
+
+//! Get the tick when the next question is due, or 0 if no questions
+MDNS_API tick_t
+mdns_querier_next(const mdns_querier_t* querier);
+
+//! Set the event loop sending due questions on the given socket with timers, using the given
+//! buffer to build packets. Set a null loop to stop sending
+MDNS_API void
+mdns_querier_set_loop(mdns_querier_t* querier, mdns_loop_t* loop, socket_t* sock, void* buffer, size_t capacity);
+
+//! Record callback to pass to mdns_query_recv, mdns_discovery_recv or a loop socket with the
+//! querier as user data. A goodbye record resets the back-off of questions matching the record
+//! name and type. So does a record with the cache flush bit set arriving more than a second after
+//! the question was last sent, which is an announcement rather than a response to the question
+MDNS_API int
+mdns_querier_callback(socket_t* sock, const network_address_t* from, mdns_entry_type_t entry, uint16_t query_id,
+                      uint16_t rtype, uint16_t rclass, uint32_t ttl, const void* data, size_t size,
+                      size_t name_offset, size_t name_length, size_t record_offset, size_t record_length,
+                      void* user_data);
@@ -20,17 +20,18 @@
  */
 
 #include <mdns/mdns.h>
+#include <mdns/internal.h>
 #include <foundation/foundation.h>
 #include <network/network.h>
 
 int
 mdns_query_send(socket_t* sock, mdns_record_type_t type, const char* name, size_t length, void* buffer, size_t capacity,
                 uint16_t query_id) {
-	if (capacity < (17 + length))
-		return -1;
-
-	uint16_t rclass = MDNS_CLASS_IN | MDNS_UNICAST_RESPONSE;
+	return mdns_query_send_known(sock, type, name, length, buffer, capacity, query_id, 0, 0);
+}
 
+static bool
+mdns_query_unicast_response(socket_t* sock) {
 	struct sockaddr_storage addr_storage;
 	struct sockaddr* saddr = (struct sockaddr*)&addr_storage;
 	struct sockaddr_in* saddrin = (struct sockaddr_in*)&addr_storage;
@@ -38,34 +39,38 @@ mdns_query_send(socket_t* sock, mdns_record_type_t type, const char* name, size_
 	socklen_t saddrlen = sizeof(addr_storage);
 	if (getsockname(sock->fd, saddr, &saddrlen) == 0) {
 		if ((saddr->sa_family == AF_INET) && (ntohs(saddrin->sin_port) == MDNS_PORT))
-			rclass &= ~MDNS_UNICAST_RESPONSE;
+			return false;
 		else if ((saddr->sa_family == AF_INET6) && (ntohs(saddrin6->sin6_port) == MDNS_PORT))
-			rclass &= ~MDNS_UNICAST_RESPONSE;
+			return false;
 	}
+	return true;
+}
 
-	struct mdns_header_t* header = (struct mdns_header_t*)buffer;
-	// Query ID
-	header->query_id = htons(query_id);
-	// Flags
-	header->flags = 0;
-	// Questions
-	header->questions = htons(1);
-	// No answer, authority or additional RRs
-	header->answer_rrs = 0;
-	header->authority_rrs = 0;
-	header->additional_rrs = 0;
-	// Fill in question
-	// Name string
-	void* data = pointer_offset(buffer, sizeof(struct mdns_header_t));
-	data = mdns_string_make(buffer, capacity, data, name, length, 0);
-	if (!data)
+static int
+mdns_query_flush_multicast(const void* buffer, size_t size, void* user_data) {
+	return mdns_multicast_send((socket_t*)user_data, buffer, size);
+}
+
+int
+mdns_query_send_known(socket_t* sock, mdns_record_type_t type, const char* name, size_t length, void* buffer,
+                      size_t capacity, uint16_t query_id, const mdns_record_t* known, size_t known_count) {
+	if (capacity > MDNS_SPLIT_PACKET_SIZE)
+		capacity = MDNS_SPLIT_PACKET_SIZE;
+	size_t packets =
+	    mdns_query_build_split(buffer, capacity, type, name, length, query_id, mdns_query_unicast_response(sock),
+	                           known, known_count, mdns_query_flush_multicast, sock);
+	if (!packets)
 		return -1;
-	// Record type
-	data = mdns_htons(data, (uint16_t)type);
-	//! Optional unicast response based on local port, class IN
-	data = mdns_htons(data, rclass);
+	return query_id;
+}
 
-	size_t tosend = (size_t)pointer_diff(data, buffer);
+int
+mdns_multiquery_send(socket_t* sock, const mdns_query_t* query, size_t count, void* buffer, size_t capacity,
+                     uint16_t query_id) {
+	size_t tosend =
+	    mdns_multiquery_build(buffer, capacity, query, count, query_id, mdns_query_unicast_response(sock));
+	if (!tosend)
+		return -1;
 	if (mdns_multicast_send(sock, buffer, (size_t)tosend))
 		return -1;
 	return query_id;
@@ -78,55 +83,56 @@ mdns_query_recv(socket_t* sock, void* buffer, size_t capacity, mdns_record_callb
 	size_t data_size = udp_socket_recvfrom(sock, buffer, capacity, &address);
 	if (!data_size)
 		return 0;
+	mdns_stats_add(sock, MDNS_STAT_PACKETS_IN, 1);
+	mdns_stats_add(sock, MDNS_STAT_BYTES_IN, data_size);
 
-	const uint16_t* data = (const uint16_t*)buffer;
+	return mdns_query_parse(sock, address, buffer, data_size, callback, user_data, only_query_id);
+}
 
-	uint16_t query_id = mdns_ntohs(data++);
-	uint16_t flags = mdns_ntohs(data++);
-	uint16_t questions = mdns_ntohs(data++);
-	uint16_t answer_rrs = mdns_ntohs(data++);
-	uint16_t authority_rrs = mdns_ntohs(data++);
-	uint16_t additional_rrs = mdns_ntohs(data++);
-	(void)sizeof(flags);
+size_t
+mdns_query_recv_batch(socket_t* sock, mdns_datagram_t* datagrams, size_t count, mdns_record_callback_fn callback,
+                      void* user_data, int only_query_id, mdns_batch_stats_t* stats) {
+	size_t received = mdns_socket_recv_batch(sock, datagrams, count, stats);
+	size_t total_records = 0;
+	for (size_t idgram = 0; idgram < received; ++idgram)
+		total_records += mdns_query_parse(sock, datagrams[idgram].from, datagrams[idgram].buffer,
+		                                  datagrams[idgram].size, callback, user_data, only_query_id);
+	if (stats)
+		stats->records += total_records;
+	return total_records;
+}
 
+size_t
+mdns_query_parse(socket_t* sock, const network_address_t* address, const void* buffer, size_t data_size,
+                 mdns_record_callback_fn callback, void* user_data, int only_query_id) {
+	mdns_packet_cursor_t cursor;
+	mdns_packet_entry_t entry;
+	if (mdns_packet_cursor_initialize(&cursor, sock, buffer, data_size) < 0)
+		return 0;
+
+	uint16_t query_id = cursor.query_id;
 	if ((only_query_id > 0) && (query_id != only_query_id))
 		return 0;  // Not a reply to the wanted one-shot query
 
-	if (questions > 1)
+	if (cursor.remain[MDNS_ENTRYTYPE_QUESTION] > 1)
 		return 0;
 
-	// Skip questions part
-	int i;
-	for (i = 0; i < questions; ++i) {
-		size_t offset = (size_t)pointer_diff(data, buffer);
-		if (!mdns_string_skip(buffer, data_size, &offset))
-			return 0;
-		data = pointer_offset_const(buffer, offset);
-		/* Record type and class not used, skip
-		uint16_t rtype = mdns_ntohs(data++);
-		uint16_t rclass = mdns_ntohs(data++);*/
-		data += 2;
-	}
+	// Questions part not used, skip
+	if (cursor.remain[MDNS_ENTRYTYPE_QUESTION])
+		mdns_packet_cursor_skip_section(&cursor);
 
 	size_t total_records = 0;
-	size_t records = 0;
-	size_t offset = (size_t)pointer_diff(data, buffer);
-	records = mdns_records_parse(sock, address, buffer, data_size, &offset, MDNS_ENTRYTYPE_ANSWER, query_id, answer_rrs,
-	                             callback, user_data);
-	total_records += records;
-	if (records != answer_rrs)
-		return total_records;
-
-	records = mdns_records_parse(sock, address, buffer, data_size, &offset, MDNS_ENTRYTYPE_AUTHORITY, query_id,
-	                             authority_rrs, callback, user_data);
-	total_records += records;
-	if (records != authority_rrs)
-		return total_records;
-
-	records = mdns_records_parse(sock, address, buffer, data_size, &offset, MDNS_ENTRYTYPE_ADDITIONAL, query_id,
-	                             additional_rrs, callback, user_data);
-	total_records += records;
-	if (records != additional_rrs)
+	while (mdns_packet_cursor_next(&cursor, &entry)) {
+		if (entry.section == MDNS_ENTRYTYPE_QUESTION)
+			continue;
+		++total_records;
+		mdns_stats_record(sock, entry.section, entry.rtype);
+		if (callback && callback(sock, address, entry.section, query_id, entry.rtype, entry.rclass, entry.ttl, buffer,
+		                         data_size, entry.name_offset, entry.name_length, entry.record_offset,
+		                         entry.record_length, user_data))
+			return total_records;
+	}
+	if (cursor.error)
 		return total_records;
 
 	if (callback)
@@ -135,22 +141,6 @@ mdns_query_recv(socket_t* sock, void* buffer, size_t capacity, mdns_record_callb
 	return total_records;
 }
 
-static void*
-mdns_answer_add_question_unicast(void* buffer, size_t capacity, void* data, mdns_record_type_t record_type,
-                                 const char* name, size_t name_length, mdns_string_table_t* string_table) {
-	data = mdns_string_make(buffer, capacity, data, name, name_length, string_table);
-	if (!data)
-		return 0;
-	size_t remain = capacity - (size_t)pointer_diff(data, buffer);
-	if (remain <= 4)
-		return 0;
-
-	data = mdns_htons(data, (uint16_t)record_type);
-	data = mdns_htons(data, MDNS_UNICAST_RESPONSE | MDNS_CLASS_IN);
-
-	return data;
-}
-
 static inline void
 mdns_record_update_rclass_ttl(mdns_record_t* record, uint16_t rclass, uint32_t ttl) {
 	if (!record->rclass)
@@ -163,144 +153,271 @@ mdns_record_update_rclass_ttl(mdns_record_t* record, uint16_t rclass, uint32_t t
 		record->rclass &= ~(uint16_t)MDNS_CACHE_FLUSH;
 }
 
-static void*
-mdns_answer_add_record_header(void* buffer, size_t capacity, void* data, mdns_record_t record,
-                              mdns_string_table_t* string_table) {
-	data = mdns_string_make(buffer, capacity, data, record.name.str, record.name.length, string_table);
-	if (!data)
-		return 0;
-	size_t remain = capacity - (size_t)pointer_diff(data, buffer);
-	if (remain < 10)
-		return 0;
-
-	data = mdns_htons(data, (uint16_t)record.type);
-	data = mdns_htons(data, (uint16_t)record.rclass);
-	data = mdns_htonl(data, record.ttl);
-	data = mdns_htons(data, 0);  // Length, to be filled later
-	return data;
+// Add records to a section, TXT records last so that records with the same name are coalesced into one
+static int
+mdns_answer_add_section(mdns_builder_t* builder, mdns_entry_type_t section, const mdns_record_t* records,
+                        size_t record_count, uint16_t rclass, uint32_t ttl, int legacy, int force_ttl) {
+	size_t txt_count = 0;
+	for (int txt = 0; txt < 2; ++txt) {
+		for (size_t irec = 0; irec < record_count; ++irec) {
+			if ((records[irec].type == MDNS_RECORDTYPE_TXT) != (txt != 0)) {
+				txt_count += (txt == 0);
+				continue;
+			}
+			mdns_record_t record = records[irec];
+			if (legacy) {
+				record.rclass = rclass;
+				if (force_ttl || !record.ttl)
+					record.ttl = ttl;
+			} else {
+				mdns_record_update_rclass_ttl(&record, rclass, ttl);
+			}
+			if (mdns_builder_add_record(builder, section, &record) < 0)
+				return -1;
+		}
+		// Skip the second pass if there are no TXT records
+		if (!txt_count)
+			break;
+	}
+	return 0;
 }
 
-static void*
-mdns_answer_add_record(void* buffer, size_t capacity, void* data, mdns_record_t record,
-                       mdns_string_table_t* string_table) {
-	// TXT records will be coalesced into one record later
-	if (!data || (record.type == MDNS_RECORDTYPE_TXT))
-		return data;
+// Build a response with any number of answer records. If name is set the question is included,
+// and if legacy is set the records are built for a legacy unicast response with the given
+// class and answer TTL. Otherwise class and TTL are defaults for records not setting them.
+size_t
+mdns_answer_build(void* buffer, size_t capacity, uint16_t query_id, mdns_record_type_t record_type, const char* name,
+                  size_t name_length, const mdns_record_t* answer, size_t answer_count,
+                  const mdns_record_t* authority, size_t authority_count, const mdns_record_t* additional,
+                  size_t additional_count, uint16_t rclass, uint32_t ttl, int legacy) {
+	if (capacity < (sizeof(struct mdns_header_t) + 32 + 4))
+		return 0;
+
+	mdns_builder_t builder;
+	mdns_builder_initialize(&builder, buffer, capacity, query_id, 0x8400);
 
-	data = mdns_answer_add_record_header(buffer, capacity, data, record, string_table);
-	if (!data)
+	// Fill in question
+	if (name && (mdns_builder_add_question(&builder, record_type, name, name_length,
+	                                       MDNS_UNICAST_RESPONSE | MDNS_CLASS_IN) < 0))
 		return 0;
 
-	// Pointer to length of record to be filled at end
-	void* record_length = pointer_offset(data, -2);
-	void* record_data = data;
+	// Fill in answer, authority and additional records
+	if ((mdns_answer_add_section(&builder, MDNS_ENTRYTYPE_ANSWER, answer, answer_count, rclass, ttl, legacy, 1) < 0) ||
+	    (mdns_answer_add_section(&builder, MDNS_ENTRYTYPE_AUTHORITY, authority, authority_count, rclass, ttl, legacy,
+	                             0) < 0) ||
+	    (mdns_answer_add_section(&builder, MDNS_ENTRYTYPE_ADDITIONAL, additional, additional_count, rclass, ttl,
+	                             legacy, 0) < 0))
+		return 0;
 
-	size_t remain = capacity - (size_t)pointer_diff(data, buffer);
-	switch (record.type) {
-		case MDNS_RECORDTYPE_PTR:
-			data = mdns_string_make(buffer, capacity, data, record.data.ptr.name.str, record.data.ptr.name.length,
-			                        string_table);
-			break;
+	return mdns_builder_size(&builder);
+}
 
-		case MDNS_RECORDTYPE_SRV:
-			if (remain <= 6)
-				return 0;
-			data = mdns_htons(data, record.data.srv.priority);
-			data = mdns_htons(data, record.data.srv.weight);
-			data = mdns_htons(data, record.data.srv.port);
-			data = mdns_string_make(buffer, capacity, data, record.data.srv.name.str, record.data.srv.name.length,
-			                        string_table);
-			break;
+// Get the hash of the name a PTR or SRV record points to, zero for other records
+static hash_t
+mdns_answer_target_hash(const mdns_record_t* record) {
+	if (record->type == MDNS_RECORDTYPE_PTR)
+		return mdns_string_hash(STRING_ARGS(record->data.ptr.name));
+	if (record->type == MDNS_RECORDTYPE_SRV)
+		return mdns_string_hash(STRING_ARGS(record->data.srv.name));
+	return 0;
+}
 
-		case MDNS_RECORDTYPE_A:
-			if (remain < 4)
-				return 0;
-			memcpy(data, &record.data.a.addr.sin_addr.s_addr, 4);
-			data = pointer_offset(data, 4);
-			break;
+// Assign each additional record to the first answer it is related to, having the name of the answer or
+// a name pointed to by the answer or by a related record. For a PTR answer this is the SRV and TXT
+// records of the instance and the address records of the SRV target. Records not related to any answer
+// are assigned answer_count. The order array receives the records sorted by owning answer
+static void
+mdns_answer_assign_related(const mdns_record_t* answer, size_t answer_count, const hash_t* name_hash,
+                           const hash_t* target_hash, size_t additional_count, size_t* owner, size_t* order) {
+	for (size_t iadd = 0; iadd < additional_count; ++iadd)
+		owner[iadd] = answer_count;
+	for (size_t ianswer = 0; ianswer < answer_count; ++ianswer) {
+		hash_t answer_name = mdns_string_hash(STRING_ARGS(answer[ianswer].name));
+		hash_t answer_target = mdns_answer_target_hash(answer + ianswer);
+		for (size_t iadd = 0; iadd < additional_count; ++iadd) {
+			if ((owner[iadd] == answer_count) &&
+			    ((name_hash[iadd] == answer_name) || (answer_target && (name_hash[iadd] == answer_target))))
+				owner[iadd] = ianswer;
+		}
+	}
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (size_t iadd = 0; iadd < additional_count; ++iadd) {
+			if ((owner[iadd] == answer_count) || !target_hash[iadd])
+				continue;
+			for (size_t itarget = 0; itarget < additional_count; ++itarget) {
+				if ((owner[itarget] > owner[iadd]) && (name_hash[itarget] == target_hash[iadd])) {
+					owner[itarget] = owner[iadd];
+					changed = true;
+				}
+			}
+		}
+	}
+	for (size_t iadd = 0; iadd < additional_count; ++iadd) {
+		size_t ipos = iadd;
+		for (; ipos && (owner[order[ipos - 1]] > owner[iadd]); --ipos)
+			order[ipos] = order[ipos - 1];
+		order[ipos] = iadd;
+	}
+}
 
-		case MDNS_RECORDTYPE_AAAA:
-			if (remain < 16)
-				return 0;
-			memcpy(data, &record.data.aaaa.addr.sin6_addr, 16);  // ipv6 address
-			data = pointer_offset(data, 16);
-			break;
+// Add the related records of the answers from first up to end, taking records from the owner ordered list
+// starting at position begin. If stop is set and the records of an answer after the first do not all fit,
+// none of them are marked as sent and the index of that answer is returned. Otherwise records not fitting
+// are left out. Returns end if no answer was stopped at
+static size_t
+mdns_answer_add_related(mdns_builder_t* builder, const mdns_record_t* additional, const size_t* owner,
+                        const size_t* order, size_t begin, size_t additional_count, size_t first, size_t end,
+                        uint16_t rclass, uint32_t ttl, bool stop, bool* sent) {
+	for (size_t ipos = begin; (ipos < additional_count) && (owner[order[ipos]] < end); ++ipos) {
+		size_t iadd = order[ipos];
+		mdns_record_t record = additional[iadd];
+		mdns_record_update_rclass_ttl(&record, rclass, ttl);
+		sent[iadd] = (mdns_builder_add_additional(builder, &record) == 0);
+		if (!sent[iadd] && stop && (owner[iadd] > first)) {
+			while ((ipos > begin) && (owner[order[ipos - 1]] == owner[iadd]))
+				sent[order[--ipos]] = false;
+			return owner[iadd];
+		}
+	}
+	return end;
+}
 
-		case MDNS_RECORDTYPE_TXT:
-		case MDNS_RECORDTYPE_ANY:
-		case MDNS_RECORDTYPE_IGNORE:
-		default:
-			break;
+size_t
+mdns_answer_build_split(void* buffer, size_t capacity, const mdns_record_t* answer, size_t answer_count,
+                        const mdns_record_t* additional, size_t additional_count, uint16_t rclass, uint32_t ttl,
+                        mdns_builder_flush_fn flush, void* user_data, mdns_split_stats_t* stats) {
+	hash_t name_hash[MDNS_SPLIT_ADDITIONAL_MAX];
+	hash_t target_hash[MDNS_SPLIT_ADDITIONAL_MAX];
+	size_t owner[MDNS_SPLIT_ADDITIONAL_MAX];
+	size_t order[MDNS_SPLIT_ADDITIONAL_MAX];
+	bool sent[MDNS_SPLIT_ADDITIONAL_MAX];
+	mdns_builder_mark_t mark[MDNS_SPLIT_ANSWER_MAX];
+	size_t grouped_count = additional_count;
+	if (grouped_count > MDNS_SPLIT_ADDITIONAL_MAX)
+		grouped_count = MDNS_SPLIT_ADDITIONAL_MAX;
+	for (size_t iadd = 0; iadd < grouped_count; ++iadd) {
+		name_hash[iadd] = mdns_string_hash(STRING_ARGS(additional[iadd].name));
+		target_hash[iadd] = mdns_answer_target_hash(additional + iadd);
+		sent[iadd] = false;
 	}
+	mdns_answer_assign_related(answer, answer_count, name_hash, target_hash, grouped_count, owner, order);
 
-	if (!data)
-		return 0;
+	mdns_split_stats_t split;
+	memset(&split, 0, sizeof(split));
+	size_t packets = 0;
 
-	// Fill record length
-	mdns_htons(record_length, (uint16_t)pointer_diff(data, record_data));
-	return data;
-}
+	mdns_builder_t builder;
+	if (mdns_builder_initialize(&builder, buffer, capacity, 0, 0x8400) < 0) {
+		split.error = -1;
+		goto exit;
+	}
 
-static void*
-mdns_answer_add_txt_record(void* buffer, size_t capacity, void* data, const mdns_record_t* records,
-                           size_t record_count, uint16_t rclass, uint32_t ttl,
-                           mdns_string_table_t* string_table) {
-	// Pointer to length of record to be filled at end
-	void* record_length = 0;
-	void* record_data = 0;
-
-	size_t remain = 0;
-	for (size_t irec = 0; data && (irec < record_count); ++irec) {
-		if (records[irec].type != MDNS_RECORDTYPE_TXT)
+	size_t start = 0;
+	// Position in the owner ordered additional records of the first record of the packet being built
+	size_t next = 0;
+	// Number of answers in the packet being built
+	size_t answer_pending = 0;
+	while (start < answer_count) {
+		mdns_builder_initialize(&builder, buffer, capacity, 0, 0x8400);
+		size_t added = 0;
+		while (((start + added) < answer_count) && (added < MDNS_SPLIT_ANSWER_MAX)) {
+			mdns_record_t record = answer[start + added];
+			mdns_record_update_rclass_ttl(&record, rclass, ttl);
+			mdns_builder_mark(&builder, mark + added);
+			if (mdns_builder_add_answer(&builder, &record) < 0)
+				break;
+			++added;
+		}
+		// Records of dropped answers are sent as not related
+		while ((next < grouped_count) && (owner[order[next]] < start))
+			++next;
+		if (!added) {
+			// Record too large for a packet on its own
+			++split.dropped;
+			++start;
 			continue;
+		}
+		// If the related records of an answer do not all fit, roll back to before that answer so that each
+		// answer is kept in the same packet as its related records where possible. The first answer keeps
+		// the related records that fit
+		size_t end = mdns_answer_add_related(&builder, additional, owner, order, next, grouped_count, start,
+		                                     start + added, rclass, ttl, true, sent);
+		if (end < start + added) {
+			mdns_builder_rollback(&builder, mark + (end - start));
+			added = end - start;
+			mdns_answer_add_related(&builder, additional, owner, order, next, grouped_count, start, end, rclass,
+			                        ttl, false, sent);
+		}
+		while ((next < grouped_count) && (owner[order[next]] < start + added))
+			++next;
+		start += added;
+		answer_pending = added;
+		if (start < answer_count) {
+			int result = flush(buffer, mdns_builder_size(&builder), user_data);
+			if (result < 0) {
+				split.error = result;
+				goto exit;
+			}
+			++packets;
+			split.answers += answer_pending;
+			answer_pending = 0;
+		}
+	}
 
-		mdns_record_t record = records[irec];
+	// Additional records not related to any answer follow in the last packet, or in more packets if needed
+	for (size_t iadd = 0; iadd < additional_count; ++iadd) {
+		if ((iadd < grouped_count) && sent[iadd])
+			continue;
+		mdns_record_t record = additional[iadd];
 		mdns_record_update_rclass_ttl(&record, rclass, ttl);
-		if (!record_data) {
-			data = mdns_answer_add_record_header(buffer, capacity, data, record, string_table);
-			if (!data)
-				return data;
-			record_length = pointer_offset(data, -2);
-			record_data = data;
+		if (mdns_builder_add_additional(&builder, &record) == 0)
+			continue;
+		if (mdns_builder_size(&builder) == sizeof(struct mdns_header_t))
+			continue;
+		int result = flush(buffer, mdns_builder_size(&builder), user_data);
+		if (result < 0) {
+			split.error = result;
+			goto exit;
 		}
-
-		// TXT strings are unlikely to be shared, just make then raw. Also need one byte for
-		// termination, thus the <= check
-		size_t string_length = record.data.txt.key.length + record.data.txt.value.length + 1;
-		remain = capacity - (size_t)pointer_diff(data, buffer);
-		if (!data || (remain <= string_length) || (string_length > 0x3FFF))
-			return 0;
-
-		unsigned char* strdata = (unsigned char*)data;
-		*strdata++ = (unsigned char)string_length;
-		memcpy(strdata, record.data.txt.key.str, record.data.txt.key.length);
-		strdata += record.data.txt.key.length;
-		*strdata++ = '=';
-		memcpy(strdata, record.data.txt.value.str, record.data.txt.value.length);
-		strdata += record.data.txt.value.length;
-
-		data = strdata;
+		++packets;
+		split.answers += answer_pending;
+		answer_pending = 0;
+		mdns_builder_initialize(&builder, buffer, capacity, 0, 0x8400);
+		mdns_builder_add_additional(&builder, &record);
 	}
 
-	// Fill record length
-	if (record_data)
-		mdns_htons(record_length, (uint16_t)pointer_diff(data, record_data));
+	if (mdns_builder_size(&builder) > sizeof(struct mdns_header_t)) {
+		int result = flush(buffer, mdns_builder_size(&builder), user_data);
+		if (result < 0) {
+			split.error = result;
+			goto exit;
+		}
+		++packets;
+		split.answers += answer_pending;
+	}
 
-	return data;
+exit:
+	if (stats)
+		*stats = split;
+	return packets;
 }
 
-static uint16_t
-mdns_answer_get_record_count(const mdns_record_t* records, size_t record_count) {
-	// TXT records will be coalesced into one record
-	uint16_t total_count = 0;
-	uint16_t txt_record = 0;
-	for (size_t irec = 0; irec < record_count; ++irec) {
-		if (records[irec].type == MDNS_RECORDTYPE_TXT)
-			txt_record = 1;
-		else
-			++total_count;
-	}
-	return total_count + txt_record;
+int
+mdns_answer_multicast_split(socket_t* sock, void* buffer, size_t capacity, const mdns_record_t* answer,
+                            size_t answer_count, const mdns_record_t* additional, size_t additional_count,
+                            uint16_t rclass, uint32_t ttl) {
+	if (capacity > MDNS_SPLIT_PACKET_SIZE)
+		capacity = MDNS_SPLIT_PACKET_SIZE;
+	mdns_split_stats_t split;
+	size_t packets = mdns_answer_build_split(buffer, capacity, answer, answer_count, additional, additional_count,
+	                                         rclass, ttl, mdns_query_flush_multicast, sock, &split);
+	if (split.dropped)
+		mdns_stats_add(sock, MDNS_STAT_ANSWERS_DROPPED, split.dropped);
+	if ((split.error < 0) || !packets)
+		return -1;
+	return (int)packets;
 }
 
 int
@@ -308,130 +425,156 @@ mdns_query_answer_unicast(socket_t* sock, const network_address_t* address, void
                           uint16_t query_id, mdns_record_type_t record_type, const char* name, size_t name_length,
                           mdns_record_t answer, const mdns_record_t* authority, size_t authority_count,
                           const mdns_record_t* additional, size_t additional_count) {
-	if (capacity < (sizeof(struct mdns_header_t) + 32 + 4))
+	size_t tosend =
+	    mdns_query_answer_unicast_build(buffer, capacity, query_id, record_type, name, name_length, answer, authority,
+	                                    authority_count, additional, additional_count);
+	if (!tosend)
 		return -1;
+	return mdns_unicast_send(sock, address, buffer, tosend);
+}
 
+size_t
+mdns_query_answer_unicast_build(void* buffer, size_t capacity, uint16_t query_id, mdns_record_type_t record_type,
+                                const char* name, size_t name_length, mdns_record_t answer,
+                                const mdns_record_t* authority, size_t authority_count,
+                                const mdns_record_t* additional, size_t additional_count) {
 	// According to RFC 6762:
 	// The cache-flush bit MUST NOT be set in any resource records in a response message
 	// sent in legacy unicast responses to UDP ports other than 5353.
-	uint16_t rclass = MDNS_CLASS_IN;
-	uint32_t ttl = 10;
-
-	// Basic answer structure
-	struct mdns_header_t* header = (struct mdns_header_t*)buffer;
-	header->query_id = htons(query_id);
-	header->flags = htons(0x8400);
-	header->questions = htons(1);
-	header->answer_rrs = htons(1);
-	header->authority_rrs = htons(mdns_answer_get_record_count(authority, authority_count));
-	header->additional_rrs = htons(mdns_answer_get_record_count(additional, additional_count));
-
-	mdns_string_table_t string_table = {0};
-	void* data = pointer_offset(buffer, sizeof(struct mdns_header_t));
-
-	// Fill in question
-	data = mdns_answer_add_question_unicast(buffer, capacity, data, record_type, name, name_length, &string_table);
-
-	// Fill in answer
-	answer.rclass = rclass;
-	answer.ttl = ttl;
-	data = mdns_answer_add_record(buffer, capacity, data, answer, &string_table);
-
-	// Fill in authority records
-	for (size_t irec = 0; data && (irec < authority_count); ++irec) {
-		mdns_record_t record = authority[irec];
-		record.rclass = rclass;
-		if (!record.ttl)
-			record.ttl = ttl;
-		data = mdns_answer_add_record(buffer, capacity, data, record, &string_table);
-	}
-	data = mdns_answer_add_txt_record(buffer, capacity, data, authority, authority_count, rclass, ttl, &string_table);
-
-	// Fill in additional records
-	for (size_t irec = 0; data && (irec < additional_count); ++irec) {
-		mdns_record_t record = additional[irec];
-		record.rclass = rclass;
-		if (!record.ttl)
-			record.ttl = ttl;
-		data = mdns_answer_add_record(buffer, capacity, data, record, &string_table);
-	}
-	data = mdns_answer_add_txt_record(buffer, capacity, data, additional, additional_count, rclass, ttl, &string_table);
-	if (!data)
-		return -1;
-
-	size_t tosend = (size_t)pointer_diff(data, buffer);
-	return mdns_unicast_send(sock, address, buffer, tosend);
+	return mdns_answer_build(buffer, capacity, query_id, record_type, name, name_length, &answer, 1, authority,
+	                         authority_count, additional, additional_count, MDNS_CLASS_IN, 10, 1);
 }
 
-static int
-mdns_answer_multicast_rclass_ttl(socket_t* sock, void* buffer, size_t capacity, mdns_record_t answer,
-                                 const mdns_record_t* authority, size_t authority_count,
-                                 const mdns_record_t* additional, size_t additional_count,
+static size_t
+mdns_answer_multicast_rclass_ttl(void* buffer, size_t capacity, mdns_record_t answer, const mdns_record_t* authority,
+                                 size_t authority_count, const mdns_record_t* additional, size_t additional_count,
                                  uint16_t rclass, uint32_t ttl) {
-	if (capacity < (sizeof(struct mdns_header_t) + 32 + 4))
-		return -1;
-
-	// Basic answer structure
-	struct mdns_header_t* header = (struct mdns_header_t*)buffer;
-	header->query_id = 0;
-	header->flags = htons(0x8400);
-	header->questions = 0;
-	header->answer_rrs = htons(1);
-	header->authority_rrs = htons(mdns_answer_get_record_count(authority, authority_count));
-	header->additional_rrs = htons(mdns_answer_get_record_count(additional, additional_count));
-
-	mdns_string_table_t string_table = {0};
-	void* data = pointer_offset(buffer, sizeof(struct mdns_header_t));
-
-	// Fill in answer
-	mdns_record_t record = answer;
-	mdns_record_update_rclass_ttl(&record, rclass, ttl);
-	data = mdns_answer_add_record(buffer, capacity, data, record, &string_table);
-
-	// Fill in authority records
-	for (size_t irec = 0; data && (irec < authority_count); ++irec) {
-		record = authority[irec];
-		mdns_record_update_rclass_ttl(&record, rclass, ttl);
-		data = mdns_answer_add_record(buffer, capacity, data, record, &string_table);
-	}
-	data = mdns_answer_add_txt_record(buffer, capacity, data, authority, authority_count, rclass, ttl, &string_table);
+	return mdns_answer_build(buffer, capacity, 0, MDNS_RECORDTYPE_IGNORE, 0, 0, &answer, 1, authority,
+	                         authority_count, additional, additional_count, rclass, ttl, 0);
+}
 
-	// Fill in additional records
-	for (size_t irec = 0; data && (irec < additional_count); ++irec) {
-		record = additional[irec];
-		mdns_record_update_rclass_ttl(&record, rclass, ttl);
-		data = mdns_answer_add_record(buffer, capacity, data, record, &string_table);
-	}
-	data = mdns_answer_add_txt_record(buffer, capacity, data, additional, additional_count, rclass, ttl, &string_table);
-	if (!data)
+static int
+mdns_answer_multicast_send(socket_t* sock, void* buffer, size_t size) {
+	if (!size)
 		return -1;
-
-	size_t tosend = (size_t)pointer_diff(data, buffer);
-	return mdns_multicast_send(sock, buffer, tosend);
+	return mdns_multicast_send(sock, buffer, size);
 }
 
 int
 mdns_query_answer_multicast(socket_t* sock, void* buffer, size_t capacity, mdns_record_t answer,
                             const mdns_record_t* authority, size_t authority_count,
                             const mdns_record_t* additional, size_t additional_count) {
-	return mdns_answer_multicast_rclass_ttl(sock, buffer, capacity, answer, authority, authority_count, additional,
-	                                        additional_count, MDNS_CLASS_IN, 60);
+	return mdns_answer_multicast_send(
+	    sock, buffer,
+	    mdns_query_answer_multicast_build(buffer, capacity, answer, authority, authority_count, additional,
+	                                      additional_count));
 }
 
 int
 mdns_announce_multicast(socket_t* sock, void* buffer, size_t capacity, mdns_record_t answer,
                         const mdns_record_t* authority, size_t authority_count,
                         const mdns_record_t* additional, size_t additional_count) {
-	return mdns_answer_multicast_rclass_ttl(sock, buffer, capacity, answer, authority, authority_count, additional,
-	                                        additional_count, MDNS_CLASS_IN | MDNS_CACHE_FLUSH, 60);
+	return mdns_answer_multicast_send(
+	    sock, buffer,
+	    mdns_announce_multicast_build(buffer, capacity, answer, authority, authority_count, additional,
+	                                  additional_count));
 }
 
 int
 mdns_goodbye_multicast(socket_t* sock, void* buffer, size_t capacity, mdns_record_t answer,
                        const mdns_record_t* authority, size_t authority_count,
                        const mdns_record_t* additional, size_t additional_count) {
+	return mdns_answer_multicast_send(
+	    sock, buffer,
+	    mdns_goodbye_multicast_build(buffer, capacity, answer, authority, authority_count, additional,
+	                                 additional_count));
+}
+
+size_t
+mdns_query_answer_multicast_build(void* buffer, size_t capacity, mdns_record_t answer,
+                                  const mdns_record_t* authority, size_t authority_count,
+                                  const mdns_record_t* additional, size_t additional_count) {
+	return mdns_answer_multicast_rclass_ttl(buffer, capacity, answer, authority, authority_count, additional,
+	                                        additional_count, MDNS_CLASS_IN, 60);
+}
+
+size_t
+mdns_announce_multicast_build(void* buffer, size_t capacity, mdns_record_t answer,
+                              const mdns_record_t* authority, size_t authority_count,
+                              const mdns_record_t* additional, size_t additional_count) {
+	return mdns_answer_multicast_rclass_ttl(buffer, capacity, answer, authority, authority_count, additional,
+	                                        additional_count, MDNS_CLASS_IN | MDNS_CACHE_FLUSH, 60);
+}
+
+size_t
+mdns_goodbye_multicast_build(void* buffer, size_t capacity, mdns_record_t answer,
+                             const mdns_record_t* authority, size_t authority_count,
+                             const mdns_record_t* additional, size_t additional_count) {
 	// Goodbye should have ttl of 0
-	return mdns_answer_multicast_rclass_ttl(sock, buffer, capacity, answer, authority,
-	                                        authority_count, additional, additional_count,
-	                                        MDNS_CLASS_IN | MDNS_CACHE_FLUSH, 0);
+	return mdns_answer_multicast_rclass_ttl(buffer, capacity, answer, authority, authority_count, additional,
+	                                        additional_count, MDNS_CLASS_IN | MDNS_CACHE_FLUSH, 0);
+}
+
+size_t
+mdns_query_build(void* buffer, size_t capacity, mdns_record_type_t type, const char* name, size_t length,
+                 uint16_t query_id, bool unicast_response, const mdns_record_t* known, size_t known_count) {
+	uint16_t rclass = MDNS_CLASS_IN;
+	if (unicast_response)
+		rclass |= MDNS_UNICAST_RESPONSE;
+
+	mdns_builder_t builder;
+	if ((mdns_builder_initialize(&builder, buffer, capacity, query_id, 0) < 0) ||
+	    (mdns_builder_add_question(&builder, type, name, length, rclass) < 0))
+		return 0;
+
+	// Known answers keep their remaining TTL, records without a TTL get the default
+	if (mdns_answer_add_section(&builder, MDNS_ENTRYTYPE_ANSWER, known, known_count, MDNS_CLASS_IN, 120, 1, 0) < 0)
+		return 0;
+
+	return mdns_builder_size(&builder);
+}
+
+size_t
+mdns_query_build_split(void* buffer, size_t capacity, mdns_record_type_t type, const char* name, size_t length,
+                       uint16_t query_id, bool unicast_response, const mdns_record_t* known, size_t known_count,
+                       mdns_builder_flush_fn flush, void* user_data) {
+	uint16_t rclass = MDNS_CLASS_IN;
+	if (unicast_response)
+		rclass |= MDNS_UNICAST_RESPONSE;
+
+	mdns_builder_t builder;
+	if ((mdns_builder_initialize(&builder, buffer, capacity, query_id, 0) < 0) ||
+	    (mdns_builder_add_question(&builder, type, name, length, rclass) < 0))
+		return 0;
+
+	// Known answers not fitting are continued in following packets without the question
+	mdns_builder_set_flush(&builder, flush, user_data, true);
+	if ((mdns_answer_add_section(&builder, MDNS_ENTRYTYPE_ANSWER, known, known_count, MDNS_CLASS_IN, 120, 1, 0) < 0) ||
+	    (mdns_builder_flush(&builder) < 0))
+		return 0;
+
+	return mdns_builder_packets(&builder);
+}
+
+size_t
+mdns_multiquery_build(void* buffer, size_t capacity, const mdns_query_t* query, size_t count, uint16_t query_id,
+                      bool unicast_response) {
+	if (!count)
+		return 0;
+
+	uint16_t rclass = MDNS_CLASS_IN;
+	if (unicast_response)
+		rclass |= MDNS_UNICAST_RESPONSE;
+
+	// Questions commonly share suffixes, the builder compresses them against each other
+	mdns_builder_t builder;
+	if (mdns_builder_initialize(&builder, buffer, capacity, query_id, 0) < 0)
+		return 0;
+	for (size_t iquery = 0; iquery < count; ++iquery) {
+		if (mdns_builder_add_question(&builder, query[iquery].type, query[iquery].name, query[iquery].length,
+		                              rclass) < 0)
+			return 0;
+	}
+
+	return mdns_builder_size(&builder);
 }
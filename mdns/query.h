@@ -36,6 +36,46 @@ MDNS_API int
 mdns_query_send(socket_t* sock, mdns_record_type_t type, const char* name, size_t length, void* buffer, size_t capacity,
                 uint16_t query_id);
 
+//! Send a multicast mDNS query like mdns_query_send, listing the given records in the answer section as
+//  known answers (RFC 6762 section 7.1). Responders will not repeat these records. The TTL of each
+//  known record should be the remaining TTL, and only records with more than half their original TTL
+//  left should be listed. Known answers not fitting in one packet of MDNS_SPLIT_PACKET_SIZE bytes, or the
+//  buffer capacity if smaller, are continued in following packets as by mdns_query_build_split.
+//  Returns the used query ID, or <0 if error.
+MDNS_API int
+mdns_query_send_known(socket_t* sock, mdns_record_type_t type, const char* name, size_t length, void* buffer,
+                      size_t capacity, uint16_t query_id, const mdns_record_t* known, size_t known_count);
+
+//! Build a mDNS query with optional known answers like mdns_query_send_known in the given buffer without
+//  sending it. Set unicast_response to request a unicast response. Returns the size of the packet, or 0
+//  if error.
+MDNS_API size_t
+mdns_query_build(void* buffer, size_t capacity, mdns_record_type_t type, const char* name, size_t length,
+                 uint16_t query_id, bool unicast_response, const mdns_record_t* known, size_t known_count);
+
+//! Build a mDNS query with known answers like mdns_query_build, splitting the known answers across as many
+//  packets of at most the buffer capacity as needed. The first packet holds the question, and each
+//  packet continued in the next one has the TC bit set (RFC 6762 section 7.2). Each packet is passed to
+//  the flush callback, which can fail the build by returning <0. Returns the number of packets, or 0
+//  if error.
+MDNS_API size_t
+mdns_query_build_split(void* buffer, size_t capacity, mdns_record_type_t type, const char* name, size_t length,
+                       uint16_t query_id, bool unicast_response, const mdns_record_t* known, size_t known_count,
+                       mdns_builder_flush_fn flush, void* user_data);
+
+//! Send a multicast mDNS query with multiple questions in one packet, otherwise like mdns_query_send.
+//  Returns the used query ID, or <0 if error.
+MDNS_API int
+mdns_multiquery_send(socket_t* sock, const mdns_query_t* query, size_t count, void* buffer, size_t capacity,
+                     uint16_t query_id);
+
+//! Build a mDNS query with multiple questions like mdns_multiquery_send in the given buffer without
+//  sending it. Set unicast_response to request a unicast response. Returns the size of the packet, or 0
+//  if error.
+MDNS_API size_t
+mdns_multiquery_build(void* buffer, size_t capacity, const mdns_query_t* query, size_t count, uint16_t query_id,
+                      bool unicast_response);
+
 //! Receive unicast responses to a mDNS query sent with mdns_discovery_recv, optionally filtering
 //  out any responses not matching the given query ID. Set the query ID to 0 to parse
 //  all responses, even if it is not matching the query ID set in a specific query. Any data will
@@ -45,6 +85,19 @@ MDNS_API size_t
 mdns_query_recv(socket_t* sock, void* buffer, size_t capacity, mdns_record_callback_fn callback, void* user_data,
                 int query_id);
 
+//! Receive unicast responses to a mDNS query like mdns_query_recv, but receive up to count datagrams in one batch
+//  with mdns_socket_recv_batch. Returns the total number of records parsed, and accumulates counts in the
+//  optional stats.
+MDNS_API size_t
+mdns_query_recv_batch(socket_t* sock, mdns_datagram_t* datagrams, size_t count, mdns_record_callback_fn callback,
+                      void* user_data, int query_id, mdns_batch_stats_t* stats);
+
+//! Parse an already received response to a mDNS query in the given buffer, as done by mdns_query_recv.
+//  Buffer must be 32 bit aligned. Returns the number of records parsed.
+MDNS_API size_t
+mdns_query_parse(socket_t* sock, const network_address_t* from, const void* buffer, size_t size,
+                 mdns_record_callback_fn callback, void* user_data, int query_id);
+
 //! Send a variable unicast mDNS query answer to any question with variable number of records to the
 //! given address. Use the top bit of the query class field (MDNS_UNICAST_RESPONSE) in the query
 //! recieved to determine if the answer should be sent unicast (bit set) or multicast (bit not set).
@@ -73,9 +126,62 @@ mdns_announce_multicast(socket_t* sock, void* buffer, size_t capacity, mdns_reco
                         const mdns_record_t* authority, size_t authority_count,
                         const mdns_record_t* additional, size_t additional_count);
 
+//! Build a multicast mDNS response with any number of answer and additional records, splitting it across
+//! as many packets of at most the buffer capacity as needed. Each packet holds the additional records
+//! related to its answers where they fit, such as the SRV, TXT and address records of a service PTR
+//! answer. Only the first MDNS_SPLIT_ADDITIONAL_MAX additional records are grouped with their answers,
+//! any further additional records are sent as not related. Additional records not related to any answer
+//! follow in the last packets. Class and TTL are defaults for records not setting them. Each packet is
+//! passed to the flush callback, which can fail the build by returning <0. An answer not fitting in a
+//! packet on its own is dropped. If stats is set it receives the number of answers in packets successfully
+//! passed to the flush callback, the number of dropped answers, and the result of a failing flush callback
+//! call. Returns the number of packets successfully passed to the flush callback.
+MDNS_API size_t
+mdns_answer_build_split(void* buffer, size_t capacity, const mdns_record_t* answer, size_t answer_count,
+                        const mdns_record_t* additional, size_t additional_count, uint16_t rclass, uint32_t ttl,
+                        mdns_builder_flush_fn flush, void* user_data, mdns_split_stats_t* stats);
+
+//! Send a multicast mDNS response built like mdns_answer_build_split in packets of MDNS_SPLIT_PACKET_SIZE
+//! bytes, or the buffer capacity if smaller. Use class MDNS_CLASS_IN | MDNS_CACHE_FLUSH and TTL 0 for a
+//! goodbye. Dropped answers are counted in MDNS_STAT_ANSWERS_DROPPED. Returns the number of packets sent,
+//! or <0 if error, in which case the packets before the failing one may have been sent.
+MDNS_API int
+mdns_answer_multicast_split(socket_t* sock, void* buffer, size_t capacity, const mdns_record_t* answer,
+                            size_t answer_count, const mdns_record_t* additional, size_t additional_count,
+                            uint16_t rclass, uint32_t ttl);
+
 //! Send a variable multicast mDNS announcement. Use this on service end for removing the resource
 //! from the local network. The records must be identical to the according announcement.
 MDNS_API int
 mdns_goodbye_multicast(socket_t* sock, void* buffer, size_t capacity, mdns_record_t answer,
                        const mdns_record_t* authority, size_t authority_count,
                        const mdns_record_t* additional, size_t additional_count);
+
+//! Build a unicast mDNS query answer like mdns_query_answer_unicast in the given buffer without sending it, for
+//! example to queue it in a mdns_send_queue_t. Returns the size of the packet, or 0 if error.
+MDNS_API size_t
+mdns_query_answer_unicast_build(void* buffer, size_t capacity, uint16_t query_id, mdns_record_type_t record_type,
+                                const char* name, size_t name_length, mdns_record_t answer,
+                                const mdns_record_t* authority, size_t authority_count,
+                                const mdns_record_t* additional, size_t additional_count);
+
+//! Build a multicast mDNS query answer like mdns_query_answer_multicast in the given buffer without sending it.
+//! Returns the size of the packet, or 0 if error.
+MDNS_API size_t
+mdns_query_answer_multicast_build(void* buffer, size_t capacity, mdns_record_t answer,
+                                  const mdns_record_t* authority, size_t authority_count,
+                                  const mdns_record_t* additional, size_t additional_count);
+
+//! Build a multicast mDNS announcement like mdns_announce_multicast in the given buffer without sending it.
+//! Returns the size of the packet, or 0 if error.
+MDNS_API size_t
+mdns_announce_multicast_build(void* buffer, size_t capacity, mdns_record_t answer,
+                              const mdns_record_t* authority, size_t authority_count,
+                              const mdns_record_t* additional, size_t additional_count);
+
+//! Build a multicast mDNS goodbye like mdns_goodbye_multicast in the given buffer without sending it.
+//! Returns the size of the packet, or 0 if error.
+MDNS_API size_t
+mdns_goodbye_multicast_build(void* buffer, size_t capacity, mdns_record_t answer,
+                             const mdns_record_t* authority, size_t authority_count,
+                             const mdns_record_t* additional, size_t additional_count);
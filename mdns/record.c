@@ -22,6 +22,49 @@
 #include <foundation/foundation.h>
 #include <network/network.h>
 #include <mdns/mdns.h>
+#include <mdns/internal.h>
+
+#if defined(__AVX2__) || FOUNDATION_ARCH_SSE2
+#include <emmintrin.h>
+#elif FOUNDATION_ARCH_NEON
+#include <arm_neon.h>
+#endif
+
+static string_const_t
+mdns_record_copy_string(char** storage, string_const_t str) {
+	string_const_t copy = {*storage, str.length};
+	if (str.length)
+		memcpy(*storage, str.str, str.length);
+	*storage += str.length;
+	return copy;
+}
+
+// Copy the record and all strings it references into one allocated block, which is returned and
+// owned by the caller. Returns null if the record references no strings
+char*
+mdns_record_copy(mdns_record_t* record, const mdns_record_t* source) {
+	size_t total = source->name.length;
+	if (source->type == MDNS_RECORDTYPE_PTR)
+		total += source->data.ptr.name.length;
+	else if (source->type == MDNS_RECORDTYPE_SRV)
+		total += source->data.srv.name.length;
+	else if (source->type == MDNS_RECORDTYPE_TXT)
+		total += source->data.txt.key.length + source->data.txt.value.length;
+
+	char* block = total ? memory_allocate(HASH_MDNS, total, 0, MEMORY_PERSISTENT) : 0;
+	char* storage = block;
+	*record = *source;
+	record->name = mdns_record_copy_string(&storage, source->name);
+	if (source->type == MDNS_RECORDTYPE_PTR) {
+		record->data.ptr.name = mdns_record_copy_string(&storage, source->data.ptr.name);
+	} else if (source->type == MDNS_RECORDTYPE_SRV) {
+		record->data.srv.name = mdns_record_copy_string(&storage, source->data.srv.name);
+	} else if (source->type == MDNS_RECORDTYPE_TXT) {
+		record->data.txt.key = mdns_record_copy_string(&storage, source->data.txt.key);
+		record->data.txt.value = mdns_record_copy_string(&storage, source->data.txt.value);
+	}
+	return block;
+}
 
 string_const_t
 mdns_record_parse_ptr(const void* buffer, size_t size, size_t offset, size_t length, char* strbuffer, size_t capacity) {
@@ -68,6 +111,42 @@ mdns_record_parse_aaaa(const void* buffer, size_t size, size_t offset, size_t le
 	return addr;
 }
 
+// Find the key/value separator in a TXT string, scanning for the first byte which is '=' or outside the
+// printable US-ASCII range DNS-SD TXT record keys MUST be in, [0x20, 0x7E]. Sixteen bytes are tested
+// at a time, with signed compares since bytes above 0x7F are negative. Returns the offset of the found
+// byte, or the length if the whole string is a valid key
+static size_t
+mdns_record_txt_separator(const char* str, size_t length) {
+	size_t ichr = 0;
+#if defined(__AVX2__) || FOUNDATION_ARCH_SSE2
+	const __m128i separator = _mm_set1_epi8('=');
+	const __m128i below = _mm_set1_epi8(0x20 - 1);
+	const __m128i above = _mm_set1_epi8(0x7E + 1);
+	for (; ichr + 16 <= length; ichr += 16) {
+		__m128i val = _mm_loadu_si128((const __m128i*)(const void*)(str + ichr));
+		__m128i valid = _mm_and_si128(_mm_cmpgt_epi8(val, below), _mm_cmplt_epi8(val, above));
+		__m128i stop = _mm_or_si128(_mm_cmpeq_epi8(val, separator), _mm_xor_si128(valid, _mm_set1_epi8(-1)));
+		if (_mm_movemask_epi8(stop))
+			break;
+	}
+#elif FOUNDATION_ARCH_NEON
+	const uint8x16_t separator = vdupq_n_u8('=');
+	for (; ichr + 16 <= length; ichr += 16) {
+		uint8x16_t val = vld1q_u8((const uint8_t*)str + ichr);
+		uint8x16_t invalid = vcgtq_u8(vsubq_u8(val, vdupq_n_u8(0x20)), vdupq_n_u8(0x7E - 0x20));
+		uint64x2_t lanes = vreinterpretq_u64_u8(vorrq_u8(vceqq_u8(val, separator), invalid));
+		if (vgetq_lane_u64(lanes, 0) | vgetq_lane_u64(lanes, 1))
+			break;
+	}
+#endif
+	// The chunk holding the separator, if any, is scanned byte by byte
+	for (; ichr < length; ++ichr) {
+		if ((str[ichr] < 0x20) || (str[ichr] > 0x7E) || (str[ichr] == '='))
+			return ichr;
+	}
+	return length;
+}
+
 size_t
 mdns_record_parse_txt(const void* buffer, size_t size, size_t offset, size_t length, mdns_record_txt_t* records,
                       size_t capacity) {
@@ -85,30 +164,19 @@ mdns_record_parse_txt(const void* buffer, size_t size, size_t offset, size_t len
 
 		++strdata;
 		offset += sublength + 1;
+		if (offset > end)
+			break;
 
-		separator = 0;
-		for (size_t c = 0; c < sublength; ++c) {
-			// DNS-SD TXT record keys MUST be printable US-ASCII, [0x20, 0x7E]
-			if ((strdata[c] < 0x20) || (strdata[c] > 0x7E))
-				break;
-			if (strdata[c] == '=') {
-				separator = c;
-				break;
-			}
-		}
-
-		if (!separator)
+		// Only strings with a non-empty key and a separator are parsed
+		separator = mdns_record_txt_separator(strdata, sublength);
+		if (!separator || (separator == sublength) || (strdata[separator] != '='))
 			continue;
 
-		if (separator < sublength) {
-			records[parsed].key.str = strdata;
-			records[parsed].key.length = separator;
-			records[parsed].value.str = strdata + separator + 1;
-			records[parsed].value.length = sublength - (separator + 1);
-		} else {
-			records[parsed].key.str = strdata;
-			records[parsed].key.length = sublength;
-		}
+		records[parsed].key.str = strdata;
+		records[parsed].key.length = separator;
+		records[parsed].value.str = strdata + separator + 1;
+		records[parsed].value.length = sublength - (separator + 1);
+		records[parsed].blob = false;
 
 		++parsed;
 	}
@@ -116,35 +184,94 @@ mdns_record_parse_txt(const void* buffer, size_t size, size_t offset, size_t len
 	return parsed;
 }
 
+size_t
+mdns_record_txt_index(const void* buffer, size_t size, size_t offset, size_t length, mdns_record_txt_index_t* index) {
+	size_t end = offset + length;
+	if (size < end)
+		end = size;
+
+	index->count = 0;
+	while ((offset < end) && (index->count < MDNS_RECORD_TXT_INDEX_MAX)) {
+		const char* strdata = pointer_offset_const(buffer, offset);
+		size_t sublength = *(const unsigned char*)strdata;
+		++strdata;
+		offset += sublength + 1;
+		if (offset > end)
+			break;
+
+		size_t separator = mdns_record_txt_separator(strdata, sublength);
+		if (!separator || ((separator < sublength) && (strdata[separator] != '=')))
+			continue;
+
+		// A string without a separator is a boolean attribute and has a null value (RFC 6763 section 6.4)
+		mdns_record_txt_t* record = index->entry + index->count++;
+		record->key.str = strdata;
+		record->key.length = separator;
+		record->value.str = (separator < sublength) ? strdata + separator + 1 : 0;
+		record->value.length = (separator < sublength) ? sublength - (separator + 1) : 0;
+		record->blob = false;
+	}
+	return index->count;
+}
+
+const mdns_record_txt_t*
+mdns_record_txt_index_find(const mdns_record_txt_index_t* index, const char* key, size_t key_length) {
+	for (size_t ientry = 0; ientry < index->count; ++ientry) {
+		const mdns_record_txt_t* record = index->entry + ientry;
+		if ((record->key.length == key_length) && mdns_string_equal_nocase(record->key.str, key, key_length))
+			return record;
+	}
+	return 0;
+}
+
+bool
+mdns_record_txt_find(const void* buffer, size_t size, size_t offset, size_t length, const char* key,
+                     size_t key_length, string_const_t* value) {
+	size_t end = offset + length;
+	if (size < end)
+		end = size;
+	if (!key_length)
+		return false;
+
+	// Only the first occurrence of a key counts, so the key compare is all that is needed per string
+	while (offset < end) {
+		const char* strdata = pointer_offset_const(buffer, offset);
+		size_t sublength = *(const unsigned char*)strdata;
+		++strdata;
+		offset += sublength + 1;
+		if (offset > end)
+			break;
+
+		if ((sublength < key_length) || ((sublength > key_length) && (strdata[key_length] != '=')) ||
+		    !mdns_string_equal_nocase(strdata, key, key_length))
+			continue;
+
+		if (value) {
+			value->str = (sublength > key_length) ? strdata + key_length + 1 : 0;
+			value->length = (sublength > key_length) ? sublength - (key_length + 1) : 0;
+		}
+		return true;
+	}
+	return false;
+}
+
 size_t
 mdns_records_parse(socket_t* sock, const network_address_t* from, const void* buffer, size_t size, size_t* offset,
                    mdns_entry_type_t type, uint16_t query_id, size_t records, mdns_record_callback_fn callback,
                    void* user_data) {
-	size_t parsed = 0;
-	for (size_t i = 0; i < records; ++i) {
-		size_t name_offset = *offset;
-		mdns_string_skip(buffer, size, offset);
-		if (((*offset) + 10) > size)
-			return parsed;
-		size_t name_length = (*offset) - name_offset;
-		const uint16_t* data = pointer_offset_const(buffer, *offset);
-
-		uint16_t rtype = mdns_ntohs(data++);
-		uint16_t rclass = mdns_ntohs(data++);
-		uint32_t ttl = mdns_ntohl(data);
-		data += 2;
-		uint16_t length = mdns_ntohs(data++);
-
-		*offset += 10;
-
-		if (length <= (size - (*offset))) {
-			++parsed;
-			if (callback && callback(sock, from, type, query_id, rtype, rclass, ttl, buffer, size, name_offset,
-			                         name_length, *offset, length, user_data))
-				break;
-		}
+	mdns_packet_cursor_t cursor;
+	mdns_packet_entry_t entry;
+	mdns_packet_cursor_initialize_section(&cursor, buffer, size, *offset, type, records);
 
-		*offset += length;
+	size_t parsed = 0;
+	while (mdns_packet_cursor_next(&cursor, &entry)) {
+		++parsed;
+		mdns_stats_record(sock, type, entry.rtype);
+		if (callback && callback(sock, from, type, query_id, entry.rtype, entry.rclass, entry.ttl, buffer, size,
+		                         entry.name_offset, entry.name_length, entry.record_offset, entry.record_length,
+		                         user_data))
+			break;
 	}
+	*offset = cursor.offset;
 	return parsed;
 }
@@ -42,6 +42,25 @@ MDNS_API size_t
 mdns_record_parse_txt(const void* buffer, size_t size, size_t offset, size_t length, mdns_record_txt_t* records,
                       size_t capacity);
 
+//! Index the key/value strings of TXT record data in one pass, for looking up several keys. Strings
+//! without a separator are boolean attributes with a null value, strings with an empty or invalid key
+//! are skipped. The index refers to the buffer. Returns the number of strings indexed, at most
+//! MDNS_RECORD_TXT_INDEX_MAX
+MDNS_API size_t
+mdns_record_txt_index(const void* buffer, size_t size, size_t offset, size_t length, mdns_record_txt_index_t* index);
+
+//! Find a key in a TXT record index, compared case insensitive. Returns the first string with the key,
+//! or null if not found
+MDNS_API const mdns_record_txt_t*
+mdns_record_txt_index_find(const mdns_record_txt_index_t* index, const char* key, size_t key_length);
+
+//! Find a key in TXT record data without indexing it, stopping at the first string with the key as
+//! only the first occurrence counts (RFC 6763 section 6.4). Keys are compared case insensitive. The
+//! value is set to the value in the buffer, null for a boolean attribute. Returns true if found
+MDNS_API bool
+mdns_record_txt_find(const void* buffer, size_t size, size_t offset, size_t length, const char* key,
+                     size_t key_length, string_const_t* value);
+
 MDNS_API size_t
 mdns_records_parse(socket_t* sock, const network_address_t* from, const void* buffer, size_t size, size_t* offset,
                    mdns_entry_type_t type, uint16_t query_id, size_t records, mdns_record_callback_fn callback,
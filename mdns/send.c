@@ -0,0 +1,207 @@
+/* send.c  -  mDNS library  -  Public Domain  -  2014 Mattias Jansson
+ *
+ * This library provides a cross-platform mDNS and DNS-SD library in C based
+ * on our foundation and network libraries. The implementation is based on RFC 6762
+ * and RFC 6763.
+ *
+ * The latest source code maintained by Mattias Jansson is always available at
+ *
+ * https://github.com/mjansson/mdns_lib
+ *
+ * The foundation and network library source code maintained by Mattias Jansson
+ * is always available at
+ *
+ * https://github.com/mjansson/foundation_lib
+ * https://github.com/mjansson/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify
+ * it without any restrictions.
+ *
+ */
+
+#include <mdns/mdns.h>
+#include <mdns/internal.h>
+#include <foundation/foundation.h>
+#include <network/network.h>
+
+mdns_send_queue_t*
+mdns_send_queue_allocate(size_t capacity) {
+	mdns_send_queue_t* queue = memory_allocate(HASH_MDNS, sizeof(mdns_send_queue_t), 0, MEMORY_PERSISTENT);
+	if (mdns_send_queue_initialize(queue, capacity) < 0) {
+		memory_deallocate(queue);
+		return 0;
+	}
+	return queue;
+}
+
+void
+mdns_send_queue_deallocate(mdns_send_queue_t* queue) {
+	if (!queue)
+		return;
+	mdns_send_queue_finalize(queue);
+	memory_deallocate(queue);
+}
+
+int
+mdns_send_queue_initialize(mdns_send_queue_t* queue, size_t capacity) {
+	memset(queue, 0, sizeof(mdns_send_queue_t));
+	if (!capacity)
+		return -1;
+	queue->entry = memory_allocate(HASH_MDNS, sizeof(mdns_send_entry_t) * capacity, 0, MEMORY_PERSISTENT);
+	queue->capacity = capacity;
+	return 0;
+}
+
+void
+mdns_send_queue_finalize(mdns_send_queue_t* queue) {
+	memory_deallocate(queue->entry);
+	queue->entry = 0;
+	queue->capacity = 0;
+	queue->count = 0;
+	queue->pending = 0;
+}
+
+void
+mdns_send_queue_clear(mdns_send_queue_t* queue) {
+	queue->count = 0;
+	queue->pending = 0;
+}
+
+static mdns_send_entry_t*
+mdns_send_queue_push(mdns_send_queue_t* queue, socket_t* sock, const void* buffer, size_t size) {
+	if ((queue->count >= queue->capacity) || !sock || !buffer || !size)
+		return 0;
+	mdns_send_entry_t* entry = queue->entry + queue->count;
+	entry->sock = sock;
+	entry->buffer = buffer;
+	entry->size = size;
+	entry->result = -1;
+	return entry;
+}
+
+int
+mdns_send_queue_unicast(mdns_send_queue_t* queue, socket_t* sock, const network_address_t* to, const void* buffer,
+                        size_t size) {
+	mdns_send_entry_t* entry = mdns_send_queue_push(queue, sock, buffer, size);
+	if (!entry || !to)
+		return -1;
+
+	if (to->family == NETWORK_ADDRESSFAMILY_IPV4) {
+		memcpy(&entry->addr, &((const network_address_ipv4_t*)to)->saddr, sizeof(struct sockaddr_in));
+		entry->addrlen = sizeof(struct sockaddr_in);
+	} else if (to->family == NETWORK_ADDRESSFAMILY_IPV6) {
+		memcpy(&entry->addr, &((const network_address_ipv6_t*)to)->saddr, sizeof(struct sockaddr_in6));
+		entry->addrlen = sizeof(struct sockaddr_in6);
+	} else {
+		return -1;
+	}
+
+	return (int)(queue->count++);
+}
+
+int
+mdns_send_queue_multicast(mdns_send_queue_t* queue, socket_t* sock, const void* buffer, size_t size) {
+	mdns_send_entry_t* entry = mdns_send_queue_push(queue, sock, buffer, size);
+	if (!entry)
+		return -1;
+
+	entry->addrlen = sizeof(struct sockaddr_storage);
+	if (mdns_multicast_address(sock->family, &entry->addr, &entry->addrlen) < 0)
+		return -1;
+
+	return (int)(queue->count++);
+}
+
+#if FOUNDATION_PLATFORM_LINUX || FOUNDATION_PLATFORM_ANDROID
+
+static size_t
+mdns_send_queue_flush_socket(mdns_send_queue_t* queue, size_t first, size_t count) {
+	struct mmsghdr msg[MDNS_SEND_BATCH_MAX];
+	struct iovec iov[MDNS_SEND_BATCH_MAX];
+	mdns_send_entry_t* entry = queue->entry + first;
+	int fd = entry->sock->fd;
+
+	memset(msg, 0, sizeof(struct mmsghdr) * count);
+	for (size_t imsg = 0; imsg < count; ++imsg) {
+		iov[imsg].iov_base = (void*)(uintptr_t)entry[imsg].buffer;
+		iov[imsg].iov_len = entry[imsg].size;
+		msg[imsg].msg_hdr.msg_name = &entry[imsg].addr;
+		msg[imsg].msg_hdr.msg_namelen = entry[imsg].addrlen;
+		msg[imsg].msg_hdr.msg_iov = &iov[imsg];
+		msg[imsg].msg_hdr.msg_iovlen = 1;
+	}
+
+	size_t sent = 0;
+	size_t imsg = 0;
+	while (imsg < count) {
+		int ret = sendmmsg(fd, msg + imsg, (unsigned int)(count - imsg), 0);
+		++queue->calls;
+		if (ret <= 0) {
+			// First remaining packet failed, skip it and try the rest
+			entry[imsg++].result = -1;
+			continue;
+		}
+		for (int isent = 0; isent < ret; ++isent, ++imsg) {
+			entry[imsg].result = (msg[imsg].msg_len == entry[imsg].size) ? 0 : -1;
+			if (!entry[imsg].result)
+				++sent;
+		}
+	}
+	return sent;
+}
+
+#else
+
+static size_t
+mdns_send_queue_flush_socket(mdns_send_queue_t* queue, size_t first, size_t count) {
+	mdns_send_entry_t* entry = queue->entry + first;
+	size_t sent = 0;
+	for (size_t imsg = 0; imsg < count; ++imsg) {
+		mdns_ssize_t ret = sendto(entry[imsg].sock->fd, (const char*)entry[imsg].buffer, (mdns_size_t)entry[imsg].size, 0,
+		                 (const struct sockaddr*)&entry[imsg].addr, entry[imsg].addrlen);
+		++queue->calls;
+		entry[imsg].result = ((ret >= 0) && ((size_t)ret == entry[imsg].size)) ? 0 : -1;
+		if (!entry[imsg].result)
+			++sent;
+	}
+	return sent;
+}
+
+#endif
+
+size_t
+mdns_send_queue_flush(mdns_send_queue_t* queue) {
+	size_t sent = 0;
+	size_t first = queue->pending;
+	while (first < queue->count) {
+		// Batch consecutive packets on the same socket
+		size_t last = first + 1;
+		while ((last < queue->count) && (last - first < MDNS_SEND_BATCH_MAX) &&
+		       (queue->entry[last].sock == queue->entry[first].sock))
+			++last;
+		size_t sock_sent = mdns_send_queue_flush_socket(queue, first, last - first);
+		size_t bytes = 0;
+		for (size_t ientry = first; ientry < last; ++ientry) {
+			if (!queue->entry[ientry].result)
+				bytes += queue->entry[ientry].size;
+		}
+		mdns_stats_add(queue->entry[first].sock, MDNS_STAT_PACKETS_OUT, sock_sent);
+		mdns_stats_add(queue->entry[first].sock, MDNS_STAT_BYTES_OUT, bytes);
+		if (sock_sent < last - first)
+			mdns_stats_add(queue->entry[first].sock, MDNS_STAT_SEND_FAILED, (last - first) - sock_sent);
+		sent += sock_sent;
+		first = last;
+	}
+
+	queue->failed += (queue->count - queue->pending) - sent;
+	queue->sent += sent;
+	queue->pending = queue->count;
+	return sent;
+}
+
+int
+mdns_send_queue_result(const mdns_send_queue_t* queue, size_t index) {
+	if (index >= queue->pending)
+		return -1;
+	return queue->entry[index].result;
+}
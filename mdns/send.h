@@ -0,0 +1,74 @@
+/* send.h  -  mDNS library  -  Public Domain  -  2014 Mattias Jansson
+ *
+ * This library provides a cross-platform mDNS and DNS-SD library in C based
+ * on our foundation and network libraries. The implementation is based on RFC 6762
+ * and RFC 6763.
+ *
+ * The latest source code maintained by Mattias Jansson is always available at
+ *
+ * https://github.com/mjansson/mdns_lib
+ *
+ * The foundation and network library source code maintained by Mattias Jansson
+ * is always available at
+ *
+ * https://github.com/mjansson/foundation_lib
+ * https://github.com/mjansson/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify
+ * it without any restrictions.
+ *
+ */
+
+#pragma once
+
+#include <foundation/platform.h>
+#include <network/types.h>
+
+#include <mdns/types.h>
+
+//! Allocate an empty send queue holding up to capacity packets
+MDNS_API mdns_send_queue_t*
+mdns_send_queue_allocate(size_t capacity);
+
+//! Finalize and deallocate a send queue
+MDNS_API void
+mdns_send_queue_deallocate(mdns_send_queue_t* queue);
+
+//! Initialize an empty send queue holding up to capacity packets. Flushed packets keep their slot so their results
+//! can be queried, the queue only has room for new packets again once cleared. A caller flushing once per batch of
+//! work should size the queue for the largest batch and clear it after each flush. Returns 0 if success, <0 if error
+MDNS_API int
+mdns_send_queue_initialize(mdns_send_queue_t* queue, size_t capacity);
+
+//! Finalize a send queue, dropping all queued packets
+MDNS_API void
+mdns_send_queue_finalize(mdns_send_queue_t* queue);
+
+//! Remove all packets from the send queue, including results of previously flushed packets. Packets queued but not
+//! yet flushed are dropped without being sent
+MDNS_API void
+mdns_send_queue_clear(mdns_send_queue_t* queue);
+
+//! Queue a unicast packet to the given address. The packet buffer must remain valid until the queue is flushed.
+//! Returns the index of the queued packet, or <0 if the queue is full or the address is invalid. A full queue must be
+//! flushed, if needed, and cleared before queueing more packets.
+MDNS_API int
+mdns_send_queue_unicast(mdns_send_queue_t* queue, socket_t* sock, const network_address_t* to, const void* buffer,
+                        size_t size);
+
+//! Queue a multicast packet to the mDNS multicast group matching the socket address family (224.0.0.251 for IPv4,
+//! ff02::fb for IPv6). Queue the same packet on one IPv4 and one IPv6 socket to reach both groups. The packet buffer
+//! must remain valid until the queue is flushed. Returns the index of the queued packet, or <0 if the queue is full
+//! or error.
+MDNS_API int
+mdns_send_queue_multicast(mdns_send_queue_t* queue, socket_t* sock, const void* buffer, size_t size);
+
+//! Send all packets queued since the last flush, batching up to MDNS_SEND_BATCH_MAX consecutive packets on the same
+//! socket into a single sendmmsg call where available. Returns the number of packets sent, the result of each packet
+//! can be queried with mdns_send_queue_result until the queue is cleared.
+MDNS_API size_t
+mdns_send_queue_flush(mdns_send_queue_t* queue);
+
+//! Get the result of the queued packet with the given index, 0 if sent or <0 if failed or not yet flushed
+MDNS_API int
+mdns_send_queue_result(const mdns_send_queue_t* queue, size_t index);
@@ -23,7 +23,9 @@
 
 #include <network/udp.h>
 
-extern const uint8_t mdns_services_query[46];
+extern const void* const mdns_services_query;
+extern const size_t mdns_services_query_size;
+extern const mdns_name_t mdns_services_name;
 
 size_t
 mdns_service_listen(socket_t* sock, void* buffer, size_t capacity, mdns_record_callback_fn callback, void* user_data) {
@@ -31,67 +33,57 @@ mdns_service_listen(socket_t* sock, void* buffer, size_t capacity, mdns_record_c
 	size_t data_size = udp_socket_recvfrom(sock, buffer, capacity, &addr);
 	if (!data_size)
 		return 0;
+	mdns_stats_add(sock, MDNS_STAT_PACKETS_IN, 1);
+	mdns_stats_add(sock, MDNS_STAT_BYTES_IN, data_size);
 
-	const uint16_t* data = (const uint16_t*)buffer;
+	return mdns_service_parse(sock, addr, buffer, data_size, callback, user_data);
+}
 
-	uint16_t query_id = mdns_ntohs(data++);
-	uint16_t flags = mdns_ntohs(data++);
-	uint16_t questions = mdns_ntohs(data++);
-	uint16_t answer_rrs = mdns_ntohs(data++);
-	uint16_t authority_rrs = mdns_ntohs(data++);
-	uint16_t additional_rrs = mdns_ntohs(data++);
+size_t
+mdns_service_listen_batch(socket_t* sock, mdns_datagram_t* datagrams, size_t count, mdns_record_callback_fn callback,
+                          void* user_data, mdns_batch_stats_t* stats) {
+	size_t received = mdns_socket_recv_batch(sock, datagrams, count, stats);
+	size_t total_records = 0;
+	for (size_t idgram = 0; idgram < received; ++idgram)
+		total_records += mdns_service_parse(sock, datagrams[idgram].from, datagrams[idgram].buffer,
+		                                    datagrams[idgram].size, callback, user_data);
+	if (stats)
+		stats->records += total_records;
+	return total_records;
+}
 
-	size_t records;
- 	size_t total_records = 0;
- 	for (int iquestion = 0; iquestion < questions; ++iquestion) {
-		size_t question_offset = (size_t)pointer_diff(data, buffer);
-		size_t offset = question_offset;
-		size_t verify_offset = 12;
-		int dns_sd = 0;
-		if (mdns_string_equal(buffer, data_size, &offset, mdns_services_query, sizeof(mdns_services_query),
-		                      &verify_offset)) {
-			dns_sd = 1;
-		} else {
-			offset = question_offset;
-			if (!mdns_string_skip(buffer, data_size, &offset))
-				break;
-		}
-		size_t length = offset - question_offset;
-		data = pointer_offset_const(buffer, offset);
+size_t
+mdns_service_parse(socket_t* sock, const network_address_t* addr, const void* buffer, size_t data_size,
+                   mdns_record_callback_fn callback, void* user_data) {
+	mdns_packet_cursor_t cursor;
+	mdns_packet_entry_t entry;
+	if (mdns_packet_cursor_initialize(&cursor, sock, buffer, data_size) < 0)
+		return 0;
 
-		uint16_t rtype = mdns_ntohs(data++);
-		uint16_t rclass = mdns_ntohs(data++);
-		uint16_t class_without_flushbit = rclass & ~MDNS_CACHE_FLUSH;
+	uint16_t query_id = cursor.query_id;
+	size_t total_records = 0;
+	while (mdns_packet_cursor_next(&cursor, &entry)) {
+		if (entry.section == MDNS_ENTRYTYPE_QUESTION) {
+			size_t offset = entry.name_offset;
+			size_t verify_offset = 0;
+			int dns_sd = mdns_string_equal(buffer, data_size, &offset, mdns_services_name.data,
+			                               mdns_services_name.length, &verify_offset);
+			uint16_t class_without_flushbit = entry.rclass & ~MDNS_CACHE_FLUSH;
 
-		// Make sure we get a question of class IN
-		if (!((class_without_flushbit == MDNS_CLASS_IN) || (class_without_flushbit == MDNS_CLASS_ANY)))
-			return 0;
-		if (dns_sd && flags)
-			continue;
+			// Make sure we get a question of class IN
+			if (!((class_without_flushbit == MDNS_CLASS_IN) || (class_without_flushbit == MDNS_CLASS_ANY)))
+				return 0;
+			if (dns_sd && cursor.flags)
+				continue;
+		}
 
 		++total_records;
-		if (callback && callback(sock, addr, MDNS_ENTRYTYPE_QUESTION, query_id, rtype, rclass, 0, buffer, data_size,
-		                         question_offset, length, question_offset, length, user_data))
+		mdns_stats_record(sock, entry.section, entry.rtype);
+		if (callback && callback(sock, addr, entry.section, query_id, entry.rtype, entry.rclass, entry.ttl, buffer,
+		                         data_size, entry.name_offset, entry.name_length, entry.record_offset,
+		                         entry.record_length, user_data))
 			return total_records;
 	}
 
-	size_t offset = (size_t)pointer_diff(data, buffer);
-	records = mdns_records_parse(sock, addr, buffer, data_size, &offset,
-	                             MDNS_ENTRYTYPE_ANSWER, query_id, answer_rrs, callback, user_data);
-	total_records += records;
-	if (records != answer_rrs)
-		return total_records;
-
-	records =
-	    mdns_records_parse(sock, addr, buffer, data_size, &offset,
-	                       MDNS_ENTRYTYPE_AUTHORITY, query_id, authority_rrs, callback, user_data);
-	total_records += records;
-	if (records != authority_rrs)
-		return total_records;
-
-	records = mdns_records_parse(sock, addr, buffer, data_size, &offset,
-	                             MDNS_ENTRYTYPE_ADDITIONAL, query_id, additional_rrs, callback,
-	                             user_data);
-
 	return total_records;
 }
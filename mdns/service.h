@@ -30,3 +30,15 @@
 //! mdns_socket_bind. Buffer must be 32 bit aligned. Returns the number of queries parsed.
 MDNS_API size_t
 mdns_service_listen(socket_t* socket, void* buffer, size_t capacity, mdns_record_callback_fn callback, void* user_data);
+
+//! Service incoming multicast DNS-SD and mDNS query requests, receiving up to count datagrams in one batch with
+//! mdns_socket_recv_batch. Returns the total number of queries parsed, and accumulates counts in the optional stats.
+MDNS_API size_t
+mdns_service_listen_batch(socket_t* socket, mdns_datagram_t* datagrams, size_t count, mdns_record_callback_fn callback,
+                          void* user_data, mdns_batch_stats_t* stats);
+
+//! Parse an already received DNS-SD or mDNS query request in the given buffer, as done by mdns_service_listen.
+//! Buffer must be 32 bit aligned. Returns the number of queries parsed.
+MDNS_API size_t
+mdns_service_parse(socket_t* socket, const network_address_t* from, const void* buffer, size_t size,
+                   mdns_record_callback_fn callback, void* user_data);
@@ -80,3 +80,94 @@ mdns_socket_bind(socket_t* sock, const network_address_t* address) {
 
 	return true;
 }
+
+static void
+mdns_datagram_set_address(mdns_datagram_t* datagram, const void* saddr, size_t saddrlen) {
+	const struct sockaddr* addr = (const struct sockaddr*)saddr;
+	if ((addr->sa_family == AF_INET6) && (saddrlen >= sizeof(struct sockaddr_in6))) {
+		network_address_ipv6_initialize(&datagram->address.ipv6);
+		memcpy(&datagram->address.ipv6.saddr, saddr, sizeof(struct sockaddr_in6));
+		datagram->from = (const network_address_t*)&datagram->address.ipv6;
+	} else if ((addr->sa_family == AF_INET) && (saddrlen >= sizeof(struct sockaddr_in))) {
+		network_address_ipv4_initialize(&datagram->address.ipv4);
+		memcpy(&datagram->address.ipv4.saddr, saddr, sizeof(struct sockaddr_in));
+		datagram->from = (const network_address_t*)&datagram->address.ipv4;
+	} else {
+		datagram->from = 0;
+	}
+}
+
+size_t
+mdns_socket_recv_batch(socket_t* sock, mdns_datagram_t* datagrams, size_t count, mdns_batch_stats_t* stats) {
+	size_t received = 0;
+	if (sock->fd < 0)
+		return 0;
+
+#if FOUNDATION_PLATFORM_LINUX || FOUNDATION_PLATFORM_ANDROID
+	struct mmsghdr msg[MDNS_RECV_BATCH_MAX];
+	struct iovec iov[MDNS_RECV_BATCH_MAX];
+	struct sockaddr_storage addr[MDNS_RECV_BATCH_MAX];
+	while (received < count) {
+		size_t batch = count - received;
+		if (batch > MDNS_RECV_BATCH_MAX)
+			batch = MDNS_RECV_BATCH_MAX;
+
+		memset(msg, 0, sizeof(struct mmsghdr) * batch);
+		for (size_t imsg = 0; imsg < batch; ++imsg) {
+			iov[imsg].iov_base = datagrams[received + imsg].buffer;
+			iov[imsg].iov_len = datagrams[received + imsg].capacity;
+			msg[imsg].msg_hdr.msg_name = &addr[imsg];
+			msg[imsg].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+			msg[imsg].msg_hdr.msg_iov = &iov[imsg];
+			msg[imsg].msg_hdr.msg_iovlen = 1;
+		}
+
+		int ret = recvmmsg(sock->fd, msg, (unsigned int)batch, MSG_DONTWAIT, 0);
+		if (stats)
+			++stats->calls;
+		if (ret <= 0)
+			break;
+
+		for (int imsg = 0; imsg < ret; ++imsg) {
+			mdns_datagram_t* datagram = datagrams + received + imsg;
+			datagram->size = msg[imsg].msg_len;
+			mdns_datagram_set_address(datagram, &addr[imsg], msg[imsg].msg_hdr.msg_namelen);
+		}
+		received += (size_t)ret;
+
+		// Socket queue drained
+		if ((size_t)ret < batch)
+			break;
+	}
+#else
+	while (received < count) {
+		mdns_datagram_t* datagram = datagrams + received;
+		const network_address_t* from = 0;
+		datagram->size = udp_socket_recvfrom(sock, datagram->buffer, datagram->capacity, &from);
+		if (stats)
+			++stats->calls;
+		if (!datagram->size)
+			break;
+
+		datagram->from = 0;
+		if (from && (from->family == NETWORK_ADDRESSFAMILY_IPV6))
+			mdns_datagram_set_address(datagram, &((const network_address_ipv6_t*)from)->saddr,
+			                          sizeof(struct sockaddr_in6));
+		else if (from && (from->family == NETWORK_ADDRESSFAMILY_IPV4))
+			mdns_datagram_set_address(datagram, &((const network_address_ipv4_t*)from)->saddr,
+			                          sizeof(struct sockaddr_in));
+		++received;
+	}
+#endif
+
+	if (received) {
+		size_t bytes = 0;
+		for (size_t idgram = 0; idgram < received; ++idgram)
+			bytes += datagrams[idgram].size;
+		mdns_stats_add(sock, MDNS_STAT_PACKETS_IN, received);
+		mdns_stats_add(sock, MDNS_STAT_BYTES_IN, bytes);
+	}
+	if (stats)
+		stats->datagrams += received;
+	return received;
+}
@@ -32,3 +32,9 @@
 //! you must set MDNS_PORT as port.
 MDNS_API bool
 mdns_socket_bind(socket_t* socket, const network_address_t* address);
+
+//! Receive up to count datagrams on the given socket, using as few system calls as the platform allows
+//! (recvmmsg where available). Each datagram must have a 32 bit aligned buffer and capacity set. Does not block.
+//! Returns the number of datagrams received, and accumulates call and datagram counts in the optional stats.
+MDNS_API size_t
+mdns_socket_recv_batch(socket_t* socket, mdns_datagram_t* datagrams, size_t count, mdns_batch_stats_t* stats);
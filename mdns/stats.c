@@ -0,0 +1,233 @@
+/* stats.c  -  mDNS library  -  Public Domain  -  2014 Mattias Jansson
+ *
+ * This library provides a cross-platform mDNS and DNS-SD library in C based
+ * on our foundation and network libraries. The implementation is based on RFC 6762
+ * and RFC 6763.
+ *
+ * The latest source code maintained by Mattias Jansson is always available at
+ *
+ * https://github.com/mjansson/mdns_lib
+ *
+ * The foundation and network library source code maintained by Mattias Jansson
+ * is always available at
+ *
+ * https://github.com/mjansson/foundation_lib
+ * https://github.com/mjansson/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify
+ * it without any restrictions.
+ *
+ */
+
+
+#include <mdns/mdns.h>
+#include <foundation/foundation.h>
+
+// Counters of one thread, padded to keep blocks of different threads off the same cache lines. The
+// owner flag is set while a thread holds the block, the counts stay in the block when released.
+// Each block also has a row of counters per socket slot, so counting for a tracked socket needs no
+// locked instruction either, at the cost of MDNS_STATS_SOCKETS_MAX rows in every block
+typedef struct mdns_stats_block_t {
+	atomic64_t counter[MDNS_STAT_COUNT];
+	atomic64_t socket_counter[MDNS_STATS_SOCKETS_MAX][MDNS_STAT_COUNT];
+	atomic32_t owned;
+	uint8_t padding[64 - ((sizeof(atomic64_t) * MDNS_STAT_COUNT * (MDNS_STATS_SOCKETS_MAX + 1) +
+	                       sizeof(atomic32_t)) %
+	                      64)];
+} mdns_stats_block_t;
+
+// The socket counters are the sums of the slot rows of all blocks, less the sums when tracked
+typedef struct mdns_stats_socket_t {
+	atomicptr_t sock;
+	uint64_t base[MDNS_STAT_COUNT];
+} mdns_stats_socket_t;
+
+// Private blocks of threads counting, followed by the block shared by threads finding no free block
+static FOUNDATION_ALIGN(64) mdns_stats_block_t mdns_stats_thread_block[MDNS_STATS_THREADS_MAX + 1];
+// Tracked sockets, each in one of the MDNS_STATS_SOCKET_PROBES slots from its home slot
+static mdns_stats_socket_t mdns_stats_socket[MDNS_STATS_SOCKETS_MAX];
+static atomic32_t mdns_stats_socket_count;
+
+FOUNDATION_DECLARE_THREAD_LOCAL(mdns_stats_block_t*, mdns_stats_block, 0)
+
+static const string_const_t mdns_stats_names[MDNS_STAT_COUNT] = {
+    {STRING_CONST("packets_in")},
+    {STRING_CONST("bytes_in")},
+    {STRING_CONST("packets_out")},
+    {STRING_CONST("bytes_out")},
+    {STRING_CONST("send_failed")},
+    {STRING_CONST("questions")},
+    {STRING_CONST("records_a")},
+    {STRING_CONST("records_aaaa")},
+    {STRING_CONST("records_ptr")},
+    {STRING_CONST("records_srv")},
+    {STRING_CONST("records_txt")},
+    {STRING_CONST("records_other")},
+    {STRING_CONST("error_header")},
+    {STRING_CONST("error_truncated")},
+    {STRING_CONST("error_name_bounds")},
+    {STRING_CONST("error_name_loop")},
+    {STRING_CONST("answers_suppressed")},
+    {STRING_CONST("answers_dropped")},
+};
+
+static mdns_stats_block_t*
+mdns_stats_thread(void) {
+	mdns_stats_block_t* block = get_thread_mdns_stats_block();
+	if (!block) {
+		// Acquire ordering makes the counts of a previous owner visible before continuing them
+		block = mdns_stats_thread_block + MDNS_STATS_THREADS_MAX;
+		for (size_t iblock = 0; iblock < MDNS_STATS_THREADS_MAX; ++iblock) {
+			mdns_stats_block_t* free_block = mdns_stats_thread_block + iblock;
+			if (!atomic_load32(&free_block->owned, memory_order_relaxed) &&
+			    atomic_cas32(&free_block->owned, 1, 0, memory_order_acquire, memory_order_relaxed)) {
+				block = free_block;
+				break;
+			}
+		}
+		set_thread_mdns_stats_block(block);
+	}
+	return block;
+}
+
+// Sockets are allocated objects, drop the alignment bits of the address and mix the rest
+static size_t
+mdns_stats_socket_home(const socket_t* sock) {
+	uint64_t key = ((uint64_t)(uintptr_t)sock >> 4) * 0x9E3779B97F4A7C15ULL;
+	return (size_t)(key >> 32) & (MDNS_STATS_SOCKETS_MAX - 1);
+}
+
+static mdns_stats_socket_t*
+mdns_stats_socket_find(const socket_t* sock) {
+	size_t home = mdns_stats_socket_home(sock);
+	for (size_t iprobe = 0; iprobe < MDNS_STATS_SOCKET_PROBES; ++iprobe) {
+		mdns_stats_socket_t* slot = mdns_stats_socket + ((home + iprobe) & (MDNS_STATS_SOCKETS_MAX - 1));
+		if (atomic_load_ptr(&slot->sock, memory_order_acquire) == sock)
+			return slot;
+	}
+	return 0;
+}
+
+// Only the owning thread writes a private block, so a relaxed load and store is enough and avoids a
+// locked instruction. The shared block needs a proper atomic add
+static FOUNDATION_FORCEINLINE void
+mdns_stats_count(atomic64_t* counter, uint64_t value, bool shared) {
+	if (!shared)
+		atomic_store64(counter, atomic_load64(counter, memory_order_relaxed) + (int64_t)value, memory_order_relaxed);
+	else
+		atomic_add64(counter, (int64_t)value, memory_order_relaxed);
+}
+
+// Sum the counters of a socket slot over all blocks
+static void
+mdns_stats_socket_sum(size_t islot, uint64_t* counter) {
+	memset(counter, 0, sizeof(uint64_t) * MDNS_STAT_COUNT);
+	for (size_t iblock = 0; iblock < MDNS_STATS_THREADS_MAX + 1; ++iblock) {
+		const atomic64_t* row = mdns_stats_thread_block[iblock].socket_counter[islot];
+		for (size_t istat = 0; istat < MDNS_STAT_COUNT; ++istat)
+			counter[istat] += (uint64_t)atomic_load64(row + istat, memory_order_relaxed);
+	}
+}
+
+void
+mdns_stats_add(socket_t* sock, mdns_stat_t stat, uint64_t value) {
+	mdns_stats_block_t* block = mdns_stats_thread();
+	bool shared = (block == mdns_stats_thread_block + MDNS_STATS_THREADS_MAX);
+	mdns_stats_count(block->counter + stat, value, shared);
+
+	if (!sock || !atomic_load32(&mdns_stats_socket_count, memory_order_relaxed))
+		return;
+	mdns_stats_socket_t* slot = mdns_stats_socket_find(sock);
+	if (slot)
+		mdns_stats_count(block->socket_counter[slot - mdns_stats_socket] + stat, value, shared);
+}
+
+void
+mdns_stats_record(socket_t* sock, mdns_entry_type_t section, uint16_t rtype) {
+	mdns_stat_t stat;
+	if (section == MDNS_ENTRYTYPE_QUESTION)
+		stat = MDNS_STAT_QUESTIONS;
+	else if (rtype == MDNS_RECORDTYPE_A)
+		stat = MDNS_STAT_RECORDS_A;
+	else if (rtype == MDNS_RECORDTYPE_AAAA)
+		stat = MDNS_STAT_RECORDS_AAAA;
+	else if (rtype == MDNS_RECORDTYPE_PTR)
+		stat = MDNS_STAT_RECORDS_PTR;
+	else if (rtype == MDNS_RECORDTYPE_SRV)
+		stat = MDNS_STAT_RECORDS_SRV;
+	else if (rtype == MDNS_RECORDTYPE_TXT)
+		stat = MDNS_STAT_RECORDS_TXT;
+	else
+		stat = MDNS_STAT_RECORDS_OTHER;
+	mdns_stats_add(sock, stat, 1);
+}
+
+int
+mdns_stats_socket_track(socket_t* sock) {
+	if (!sock)
+		return -1;
+	if (mdns_stats_socket_find(sock))
+		return 0;
+	size_t home = mdns_stats_socket_home(sock);
+	for (size_t iprobe = 0; iprobe < MDNS_STATS_SOCKET_PROBES; ++iprobe) {
+		mdns_stats_socket_t* slot = mdns_stats_socket + ((home + iprobe) & (MDNS_STATS_SOCKETS_MAX - 1));
+		if (atomic_load_ptr(&slot->sock, memory_order_relaxed))
+			continue;
+		// Nothing counts into a free slot, so racing trackers store the same base
+		mdns_stats_socket_sum((size_t)(slot - mdns_stats_socket), slot->base);
+		if (!atomic_cas_ptr(&slot->sock, sock, 0, memory_order_release, memory_order_relaxed))
+			continue;
+		atomic_incr32(&mdns_stats_socket_count, memory_order_relaxed);
+		return 0;
+	}
+	return -1;
+}
+
+void
+mdns_stats_socket_untrack(socket_t* sock) {
+	mdns_stats_socket_t* slot = sock ? mdns_stats_socket_find(sock) : 0;
+	if (!slot)
+		return;
+	atomic_store_ptr(&slot->sock, 0, memory_order_release);
+	atomic_add32(&mdns_stats_socket_count, -1, memory_order_relaxed);
+}
+
+void
+mdns_stats_thread_release(void) {
+	mdns_stats_block_t* block = get_thread_mdns_stats_block();
+	if (!block)
+		return;
+	set_thread_mdns_stats_block(0);
+	// Release ordering publishes the counts to the next owner of the block
+	if (block != mdns_stats_thread_block + MDNS_STATS_THREADS_MAX)
+		atomic_store32(&block->owned, 0, memory_order_release);
+}
+
+void
+mdns_stats_snapshot(mdns_stats_t* stats) {
+	memset(stats, 0, sizeof(mdns_stats_t));
+	for (size_t iblock = 0; iblock < MDNS_STATS_THREADS_MAX + 1; ++iblock) {
+		for (size_t istat = 0; istat < MDNS_STAT_COUNT; ++istat)
+			stats->counter[istat] +=
+			    (uint64_t)atomic_load64(mdns_stats_thread_block[iblock].counter + istat, memory_order_relaxed);
+	}
+}
+
+int
+mdns_stats_socket_snapshot(const socket_t* sock, mdns_stats_t* stats) {
+	memset(stats, 0, sizeof(mdns_stats_t));
+	mdns_stats_socket_t* slot = sock ? mdns_stats_socket_find(sock) : 0;
+	if (!slot)
+		return -1;
+	mdns_stats_socket_sum((size_t)(slot - mdns_stats_socket), stats->counter);
+	for (size_t istat = 0; istat < MDNS_STAT_COUNT; ++istat)
+		stats->counter[istat] -= slot->base[istat];
+	return 0;
+}
+
+string_const_t
+mdns_stats_name(mdns_stat_t stat) {
+	if ((unsigned int)stat >= MDNS_STAT_COUNT)
+		return string_const(STRING_CONST(""));
+	return mdns_stats_names[stat];
+}
@@ -0,0 +1,68 @@
+/* stats.h  -  mDNS library  -  Public Domain  -  2014 Mattias Jansson
+ *
+ * This library provides a cross-platform mDNS and DNS-SD library in C based
+ * on our foundation and network libraries. The implementation is based on RFC 6762
+ * and RFC 6763.
+ *
+ * The latest source code maintained by Mattias Jansson is always available at
+ *
+ * https://github.com/mjansson/mdns_lib
+ *
+ * The foundation and network library source code maintained by Mattias Jansson
+ * is always available at
+ *
+ * https://github.com/mjansson/foundation_lib
+ * https://github.com/mjansson/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify
+ * it without any restrictions.
+ *
+ */
+
+
+#pragma once
+
+#include <foundation/platform.h>
+#include <network/types.h>
+
+#include <mdns/types.h>
+
+//! Add to a global counter, and to the counter of the socket if it is tracked with
+//! mdns_stats_socket_track. The socket can be null to only count globally. Each thread counts
+//! into its own block with relaxed atomics, also for tracked sockets, up to MDNS_STATS_THREADS_MAX
+//! threads get a private block and threads finding no free block share one
+MDNS_API void
+mdns_stats_add(socket_t* sock, mdns_stat_t stat, uint64_t value);
+
+//! Count a question or record of the given type parsed from a received packet
+MDNS_API void
+mdns_stats_record(socket_t* sock, mdns_entry_type_t section, uint16_t rtype);
+
+//! Keep separate counters for the given socket, starting from zero, until untracked. Returns 0 if
+//! success, or <0 if no slot is free among the MDNS_STATS_SOCKET_PROBES slots the socket hashes to
+MDNS_API int
+mdns_stats_socket_track(socket_t* sock);
+
+//! Stop keeping separate counters for the given socket
+MDNS_API void
+mdns_stats_socket_untrack(socket_t* sock);
+
+//! Release the private counter block of the calling thread so a later thread can use it, typically
+//! called before the thread exits. The counts stay in the global counters
+MDNS_API void
+mdns_stats_thread_release(void);
+
+//! Sum the global counters of all threads. Counters are never reset, take the difference of two
+//! snapshots to get the counts over an interval. Counters are loaded one by one, so a snapshot
+//! taken while other threads count is not an atomic cut across all counters
+MDNS_API void
+mdns_stats_snapshot(mdns_stats_t* stats);
+
+//! Get the counters of a tracked socket, summed over all threads like mdns_stats_snapshot. Returns 0
+//! if success, or <0 if the socket is not tracked
+MDNS_API int
+mdns_stats_socket_snapshot(const socket_t* sock, mdns_stats_t* stats);
+
+//! Get the name of a counter for export to monitoring systems, such as "packets_in"
+MDNS_API string_const_t
+mdns_stats_name(mdns_stat_t stat);
@@ -0,0 +1,613 @@
+/* store.c  -  mDNS library  -  Public Domain  -  2014 Mattias Jansson
+ *
+ * This library provides a cross-platform mDNS and DNS-SD library in C based
+ * on our foundation and network libraries. The implementation is based on RFC 6762
+ * and RFC 6763.
+ *
+ * The latest source code maintained by Mattias Jansson is always available at
+ *
+ * https://github.com/mjansson/mdns_lib
+ *
+ * The foundation and network library source code maintained by Mattias Jansson
+ * is always available at
+ *
+ * https://github.com/mjansson/foundation_lib
+ * https://github.com/mjansson/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify
+ * it without any restrictions.
+ *
+ */
+
+#include <mdns/mdns.h>
+#include <mdns/internal.h>
+#include <foundation/foundation.h>
+#include <network/network.h>
+
+// Record types expanded for questions of type ANY
+static const mdns_record_type_t mdns_store_any_types[] = {MDNS_RECORDTYPE_PTR, MDNS_RECORDTYPE_SRV,
+                                                          MDNS_RECORDTYPE_TXT, MDNS_RECORDTYPE_A,
+                                                          MDNS_RECORDTYPE_AAAA};
+
+mdns_store_t*
+mdns_store_allocate(size_t capacity) {
+	mdns_store_t* store = memory_allocate(HASH_MDNS, sizeof(mdns_store_t), 0, MEMORY_PERSISTENT);
+	if (mdns_store_initialize(store, capacity) < 0) {
+		memory_deallocate(store);
+		return 0;
+	}
+	return store;
+}
+
+void
+mdns_store_deallocate(mdns_store_t* store) {
+	if (!store)
+		return;
+	mdns_store_finalize(store);
+	memory_deallocate(store);
+}
+
+int
+mdns_store_initialize(mdns_store_t* store, size_t capacity) {
+	memset(store, 0, sizeof(mdns_store_t));
+	if (!capacity || (capacity > 0x7FFFFFFF))
+		return -1;
+
+	size_t bucket_count = 16;
+	while (bucket_count < capacity)
+		bucket_count <<= 1;
+
+	store->entry = memory_allocate(HASH_MDNS, sizeof(mdns_store_entry_t) * capacity, 0,
+	                               MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED);
+	store->bucket =
+	    memory_allocate(HASH_MDNS, sizeof(uint32_t) * bucket_count, 0, MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED);
+	store->capacity = capacity;
+	store->bucket_mask = bucket_count - 1;
+
+	for (size_t ientry = 0; ientry < capacity; ++ientry)
+		store->entry[ientry].next = (ientry + 1 < capacity) ? (uint32_t)(ientry + 2) : 0;
+	store->free = 1;
+	return 0;
+}
+
+void
+mdns_store_finalize(mdns_store_t* store) {
+	for (size_t islot = 0; islot < MDNS_STORE_PENDING_SOCKETS; ++islot) {
+		if (store->loop && store->pending[islot].sock && (store->pending[islot].timer >= 0))
+			mdns_loop_remove_timer(store->loop, store->pending[islot].timer);
+	}
+	memset(store->pending, 0, sizeof(store->pending));
+	for (size_t ientry = 0; ientry < store->capacity; ++ientry) {
+		if (store->entry[ientry].used)
+			memory_deallocate(store->entry[ientry].storage);
+	}
+	memory_deallocate(store->entry);
+	memory_deallocate(store->bucket);
+	store->entry = 0;
+	store->bucket = 0;
+	store->capacity = 0;
+	store->count = 0;
+	store->free = 0;
+}
+
+static size_t
+mdns_store_bucket(const mdns_store_t* store, hash_t name_hash, mdns_record_type_t type) {
+	return (size_t)((name_hash ^ ((hash_t)type * 0x9E3779B97F4A7C15ULL)) >> 7) & store->bucket_mask;
+}
+
+// Copy the record and all strings it references into the entry owned storage
+static void
+mdns_store_entry_set(mdns_store_entry_t* entry, const mdns_record_t* record) {
+	entry->storage = mdns_record_copy(&entry->record, record);
+	entry->name_hash = mdns_string_hash(STRING_ARGS(record->name));
+	entry->target_hash = 0;
+	if (record->type == MDNS_RECORDTYPE_PTR)
+		entry->target_hash = mdns_string_hash(STRING_ARGS(record->data.ptr.name));
+	else if (record->type == MDNS_RECORDTYPE_SRV)
+		entry->target_hash = mdns_string_hash(STRING_ARGS(record->data.srv.name));
+}
+
+static void
+mdns_store_link(mdns_store_t* store, uint32_t index) {
+	mdns_store_entry_t* entry = store->entry + index;
+	size_t ibucket = mdns_store_bucket(store, entry->name_hash, entry->record.type);
+	entry->prev = 0;
+	entry->next = store->bucket[ibucket];
+	if (entry->next)
+		store->entry[entry->next - 1].prev = index + 1;
+	store->bucket[ibucket] = index + 1;
+}
+
+static void
+mdns_store_unlink(mdns_store_t* store, uint32_t index) {
+	mdns_store_entry_t* entry = store->entry + index;
+	if (entry->prev)
+		store->entry[entry->prev - 1].next = entry->next;
+	else
+		store->bucket[mdns_store_bucket(store, entry->name_hash, entry->record.type)] = entry->next;
+	if (entry->next)
+		store->entry[entry->next - 1].prev = entry->prev;
+	entry->next = 0;
+	entry->prev = 0;
+}
+
+int
+mdns_store_insert(mdns_store_t* store, const mdns_record_t* record) {
+	if (!store->free || !record->name.length)
+		return -1;
+
+	uint32_t index = store->free - 1;
+	mdns_store_entry_t* entry = store->entry + index;
+	store->free = entry->next;
+
+	mdns_store_entry_set(entry, record);
+	entry->used = true;
+	mdns_store_link(store, index);
+	++store->count;
+	return (int)index;
+}
+
+int
+mdns_store_update(mdns_store_t* store, int handle, const mdns_record_t* record) {
+	if (!mdns_store_record(store, handle) || !record->name.length)
+		return -1;
+
+	mdns_store_entry_t* entry = store->entry + handle;
+	char* storage = entry->storage;
+	mdns_store_unlink(store, (uint32_t)handle);
+	mdns_store_entry_set(entry, record);
+	mdns_store_link(store, (uint32_t)handle);
+	memory_deallocate(storage);
+	return 0;
+}
+
+int
+mdns_store_remove(mdns_store_t* store, int handle) {
+	if (!mdns_store_record(store, handle))
+		return -1;
+
+	for (size_t islot = 0; islot < MDNS_STORE_PENDING_SOCKETS; ++islot) {
+		mdns_store_pending_t* pending = store->pending + islot;
+		for (size_t ianswer = 0; ianswer < pending->answer_count; ++ianswer) {
+			if (pending->answer[ianswer] == handle) {
+				pending->answer[ianswer] = pending->answer[--pending->answer_count];
+				break;
+			}
+		}
+	}
+
+	mdns_store_entry_t* entry = store->entry + handle;
+	mdns_store_unlink(store, (uint32_t)handle);
+	memory_deallocate(entry->storage);
+	memset(entry, 0, sizeof(mdns_store_entry_t));
+	entry->next = store->free;
+	store->free = (uint32_t)handle + 1;
+	--store->count;
+	return 0;
+}
+
+const mdns_record_t*
+mdns_store_record(const mdns_store_t* store, int handle) {
+	if ((handle < 0) || ((size_t)handle >= store->capacity) || !store->entry[handle].used)
+		return 0;
+	return &store->entry[handle].record;
+}
+
+static int
+mdns_store_lookup(const mdns_store_t* store, hash_t name_hash, const char* name, size_t length,
+                  mdns_record_type_t type, int previous) {
+	uint32_t next;
+	if (previous < 0)
+		next = store->bucket[mdns_store_bucket(store, name_hash, type)];
+	else
+		next = store->entry[previous].next;
+	if (length && (name[length - 1] == '.'))
+		--length;
+	while (next) {
+		const mdns_store_entry_t* entry = store->entry + (next - 1);
+		if ((entry->name_hash == name_hash) && (entry->record.type == type)) {
+			size_t entry_length = entry->record.name.length;
+			if (entry_length && (entry->record.name.str[entry_length - 1] == '.'))
+				--entry_length;
+			if ((entry_length == length) && mdns_string_equal_nocase(entry->record.name.str, name, length))
+				return (int)(next - 1);
+		}
+		next = entry->next;
+	}
+	return -1;
+}
+
+int
+mdns_store_find(const mdns_store_t* store, const char* name, size_t length, mdns_record_type_t type, int previous) {
+	if ((previous >= 0) && !mdns_store_record(store, previous))
+		return -1;
+	return mdns_store_lookup(store, mdns_string_hash(name, length), name, length, type, previous);
+}
+
+static bool
+mdns_store_handle_listed(const int* handle, size_t count, int find) {
+	for (size_t ihandle = 0; ihandle < count; ++ihandle) {
+		if (handle[ihandle] == find)
+			return true;
+	}
+	return false;
+}
+
+// Add all records of the given type and name as additional records, unless already in the response
+static size_t
+mdns_store_add_related(const mdns_store_t* store, hash_t name_hash, string_const_t name, mdns_record_type_t type,
+                       const int* answer, size_t answer_count, int* additional, size_t additional_count) {
+	int handle = mdns_store_lookup(store, name_hash, STRING_ARGS(name), type, -1);
+	while ((handle >= 0) && (additional_count < MDNS_STORE_ADDITIONAL_MAX)) {
+		if (!mdns_store_handle_listed(answer, answer_count, handle) &&
+		    !mdns_store_handle_listed(additional, additional_count, handle))
+			additional[additional_count++] = handle;
+		handle = mdns_store_lookup(store, name_hash, STRING_ARGS(name), type, handle);
+	}
+	return additional_count;
+}
+
+static size_t
+mdns_store_add_address(const mdns_store_t* store, const mdns_store_entry_t* srv, const int* answer,
+                       size_t answer_count, int* additional, size_t additional_count) {
+	additional_count = mdns_store_add_related(store, srv->target_hash, srv->record.data.srv.name, MDNS_RECORDTYPE_A,
+	                                          answer, answer_count, additional, additional_count);
+	return mdns_store_add_related(store, srv->target_hash, srv->record.data.srv.name, MDNS_RECORDTYPE_AAAA, answer,
+	                              answer_count, additional, additional_count);
+}
+
+// Check if a known answer in a received packet holds the same record data as the stored record
+static bool
+mdns_store_known_equal(const mdns_store_entry_t* entry, const void* buffer, size_t size,
+                       const mdns_packet_index_entry_t* known) {
+	const mdns_record_t* record = &entry->record;
+	const uint8_t* rdata = pointer_offset_const(buffer, known->record_offset);
+	switch (record->type) {
+		case MDNS_RECORDTYPE_PTR:
+			return mdns_string_equal_name(buffer, size, known->record_offset, STRING_ARGS(record->data.ptr.name)) != 0;
+
+		case MDNS_RECORDTYPE_SRV:
+			if (known->record_length < 7)
+				return false;
+			return (mdns_ntohs(rdata) == record->data.srv.priority) &&
+			       (mdns_ntohs(rdata + 2) == record->data.srv.weight) &&
+			       (mdns_ntohs(rdata + 4) == record->data.srv.port) &&
+			       mdns_string_equal_name(buffer, size, known->record_offset + 6, STRING_ARGS(record->data.srv.name));
+
+		case MDNS_RECORDTYPE_A:
+			return (known->record_length == 4) && !memcmp(rdata, &record->data.a.addr.sin_addr.s_addr, 4);
+
+		case MDNS_RECORDTYPE_AAAA:
+			return (known->record_length == 16) && !memcmp(rdata, &record->data.aaaa.addr.sin6_addr, 16);
+
+		case MDNS_RECORDTYPE_TXT: {
+			// Stored TXT records are single key=value strings, coalesced on the wire, or pre-encoded blobs
+			size_t key_length = record->data.txt.key.length;
+			size_t value_length = record->data.txt.value.length;
+			if (record->data.txt.blob)
+				return (known->record_length == value_length) &&
+				       !memcmp(rdata, record->data.txt.value.str, value_length);
+			size_t offset = 0;
+			while (offset < known->record_length) {
+				size_t length = rdata[offset++];
+				if (offset + length > known->record_length)
+					return false;
+				if ((length == key_length + 1 + value_length) && (rdata[offset + key_length] == '=') &&
+				    !memcmp(rdata + offset, record->data.txt.key.str, key_length) &&
+				    !memcmp(rdata + offset + key_length + 1, record->data.txt.value.str, value_length))
+					return true;
+				offset += length;
+			}
+			return false;
+		}
+
+		case MDNS_RECORDTYPE_ANY:
+		case MDNS_RECORDTYPE_IGNORE:
+		default:
+			break;
+	}
+	return false;
+}
+
+// Known-answer suppression as per RFC 6762 section 7.1, drop answers the querier already holds
+// with at least half of the TTL we would answer with. The known answers come from an untrusted querier,
+// so the packet is validated and indexed first and nothing is suppressed if it is malformed
+static size_t
+mdns_store_suppress_known(const mdns_store_t* store, socket_t* sock, const void* buffer, size_t size, int* answer,
+                          size_t answer_count) {
+	mdns_packet_index_t index;
+	if ((mdns_packet_index(sock, buffer, size, &index) <= 0) || !index.count[MDNS_ENTRYTYPE_ANSWER])
+		return answer_count;
+
+	size_t first = index.count[MDNS_ENTRYTYPE_QUESTION];
+	size_t last = first + index.count[MDNS_ENTRYTYPE_ANSWER];
+	for (size_t iknown = first; answer_count && (iknown < last); ++iknown) {
+		const mdns_packet_index_entry_t* known = index.entry + iknown;
+		hash_t known_hash = 0;
+		size_t offset = known->name_offset;
+		if (!mdns_string_skip_hash(buffer, size, &offset, &known_hash, 0, 0))
+			continue;
+		for (size_t ianswer = 0; ianswer < answer_count; ++ianswer) {
+			const mdns_store_entry_t* entry = store->entry + answer[ianswer];
+			uint32_t ttl = entry->record.ttl ? entry->record.ttl : MDNS_STORE_TTL_DEFAULT;
+			if ((entry->name_hash != known_hash) || (entry->record.type != known->rtype) || (known->ttl < ttl / 2))
+				continue;
+			// A hash hit is not enough, both the name and the record data must match
+			if (!mdns_packet_index_name_equal(&index, iknown, STRING_ARGS(entry->record.name)) ||
+			    !mdns_store_known_equal(entry, buffer, size, known))
+				continue;
+			answer[ianswer] = answer[--answer_count];
+			mdns_stats_add(0, MDNS_STAT_ANSWERS_SUPPRESSED, 1);
+			break;
+		}
+	}
+	return answer_count;
+}
+
+// Find all records answering the question at the given offset, not already listed as known answers
+static size_t
+mdns_store_match(const mdns_store_t* store, socket_t* sock, const void* buffer, size_t size, size_t name_offset,
+                 uint16_t rtype, int* answer) {
+	hash_t name_hash = 0;
+	size_t offset = name_offset;
+	if (!store->count || !mdns_string_skip_hash(buffer, size, &offset, &name_hash, 0, 0))
+		return 0;
+
+	size_t answer_count = 0;
+	for (size_t itype = 0; itype < sizeof(mdns_store_any_types) / sizeof(mdns_store_any_types[0]); ++itype) {
+		mdns_record_type_t type = mdns_store_any_types[itype];
+		if ((rtype != MDNS_RECORDTYPE_ANY) && (rtype != type))
+			continue;
+		uint32_t next = store->bucket[mdns_store_bucket(store, name_hash, type)];
+		while (next && (answer_count < MDNS_STORE_ANSWER_MAX)) {
+			const mdns_store_entry_t* entry = store->entry + (next - 1);
+			if ((entry->name_hash == name_hash) && (entry->record.type == type) &&
+			    mdns_string_equal_name(buffer, size, name_offset, STRING_ARGS(entry->record.name)))
+				answer[answer_count++] = (int)(next - 1);
+			next = entry->next;
+		}
+	}
+	return mdns_store_suppress_known(store, sock, buffer, size, answer, answer_count);
+}
+
+// Related records as per RFC 6763 section 12, SRV and TXT for a PTR target and
+// address records for a SRV target
+static size_t
+mdns_store_collect_additional(const mdns_store_t* store, const int* answer, size_t answer_count, int* additional) {
+	size_t additional_count = 0;
+	for (size_t ianswer = 0; ianswer < answer_count; ++ianswer) {
+		const mdns_store_entry_t* entry = store->entry + answer[ianswer];
+		if (entry->record.type == MDNS_RECORDTYPE_PTR) {
+			size_t first_srv = additional_count;
+			additional_count =
+			    mdns_store_add_related(store, entry->target_hash, entry->record.data.ptr.name, MDNS_RECORDTYPE_SRV,
+			                           answer, answer_count, additional, additional_count);
+			size_t last_srv = additional_count;
+			additional_count =
+			    mdns_store_add_related(store, entry->target_hash, entry->record.data.ptr.name, MDNS_RECORDTYPE_TXT,
+			                           answer, answer_count, additional, additional_count);
+			for (size_t isrv = first_srv; isrv < last_srv; ++isrv)
+				additional_count = mdns_store_add_address(store, store->entry + additional[isrv], answer,
+				                                          answer_count, additional, additional_count);
+		} else if (entry->record.type == MDNS_RECORDTYPE_SRV) {
+			additional_count =
+			    mdns_store_add_address(store, entry, answer, answer_count, additional, additional_count);
+		}
+	}
+	return additional_count;
+}
+
+// Build a response with the given answer records and their related additional records. Legacy unicast
+// responses echo the question and must not set the cache flush bit. Drops the additional records if the
+// response does not fit
+static size_t
+mdns_store_build(const mdns_store_t* store, const int* answer, size_t answer_count, uint16_t query_id,
+                 uint16_t rtype, const char* name, size_t name_length, bool legacy, void* response, size_t capacity) {
+	int additional[MDNS_STORE_ADDITIONAL_MAX];
+	size_t additional_count = mdns_store_collect_additional(store, answer, answer_count, additional);
+
+	mdns_record_t answer_record[MDNS_STORE_ANSWER_MAX];
+	mdns_record_t additional_record[MDNS_STORE_ADDITIONAL_MAX];
+	for (size_t ianswer = 0; ianswer < answer_count; ++ianswer)
+		answer_record[ianswer] = store->entry[answer[ianswer]].record;
+	for (size_t iadd = 0; iadd < additional_count; ++iadd)
+		additional_record[iadd] = store->entry[additional[iadd]].record;
+
+	uint16_t answer_rclass = legacy ? MDNS_CLASS_IN : (MDNS_CLASS_IN | MDNS_CACHE_FLUSH);
+	uint32_t answer_ttl = legacy ? 10 : MDNS_STORE_TTL_DEFAULT;
+	size_t tosend = 0;
+	while (!tosend) {
+		tosend = mdns_answer_build(response, capacity, legacy ? query_id : 0, (mdns_record_type_t)rtype,
+		                           legacy ? name : 0, name_length, answer_record, answer_count, 0, 0,
+		                           additional_record, additional_count, answer_rclass, answer_ttl, legacy);
+		if (!tosend && !additional_count)
+			return 0;
+		additional_count = 0;
+	}
+	return tosend;
+}
+
+// Build the response to a question received on the given socket
+static size_t
+mdns_store_answer_build_socket(const mdns_store_t* store, socket_t* sock, const void* buffer, size_t size,
+                               size_t name_offset, uint16_t query_id, uint16_t rtype, bool legacy, void* response,
+                               size_t capacity, size_t* answer_records) {
+	int answer[MDNS_STORE_ANSWER_MAX];
+	size_t answer_count = mdns_store_match(store, sock, buffer, size, name_offset, rtype, answer);
+	if (!answer_count)
+		return 0;
+
+	char namebuffer[256];
+	string_const_t name = {0, 0};
+	if (legacy)
+		name = mdns_string_extract(buffer, size, &name_offset, namebuffer, sizeof(namebuffer));
+
+	size_t tosend = mdns_store_build(store, answer, answer_count, query_id, rtype, STRING_ARGS(name), legacy,
+	                                 response, capacity);
+	if (tosend && answer_records)
+		*answer_records = answer_count;
+	return tosend;
+}
+
+size_t
+mdns_store_answer_build(const mdns_store_t* store, const void* buffer, size_t size, size_t name_offset,
+                        uint16_t query_id, uint16_t rtype, bool legacy, void* response, size_t capacity,
+                        size_t* answer_records) {
+	return mdns_store_answer_build_socket(store, 0, buffer, size, name_offset, query_id, rtype, legacy, response,
+	                                      capacity, answer_records);
+}
+
+size_t
+mdns_store_answer(mdns_store_t* store, socket_t* sock, const network_address_t* from, const void* buffer,
+                  size_t size, uint16_t query_id, uint16_t rtype, uint16_t rclass, size_t name_offset) {
+	size_t answer_count = 0;
+	bool legacy = from && (network_address_ip_port(from) != MDNS_PORT);
+	size_t tosend = mdns_store_answer_build_socket(store, sock, buffer, size, name_offset, query_id, rtype, legacy,
+	                                               store->buffer, sizeof(store->buffer), &answer_count);
+	if (!tosend)
+		return 0;
+
+	int result;
+	if (legacy || ((rclass & MDNS_UNICAST_RESPONSE) && from))
+		result = mdns_unicast_send(sock, from, store->buffer, tosend);
+	else
+		result = mdns_multicast_send(sock, store->buffer, tosend);
+	if (result < 0)
+		return 0;
+
+	++store->answered;
+	store->answer_records += answer_count;
+	return answer_count;
+}
+
+// Send a packet of a pending response
+static int
+mdns_store_flush_send(const void* buffer, size_t size, void* user_data) {
+	mdns_store_pending_t* pending = user_data;
+	return mdns_multicast_send(pending->sock, buffer, size);
+}
+
+// Send all records owed on the socket, packing as many answers as fit in each packet together with
+// their related additional records. The response tally is kept until the pending slot is released
+static size_t
+mdns_store_flush_pending(mdns_store_t* store, mdns_store_pending_t* pending) {
+	int additional[MDNS_STORE_ADDITIONAL_MAX];
+	size_t additional_count = mdns_store_collect_additional(store, pending->answer, pending->answer_count, additional);
+
+	mdns_record_t answer_record[MDNS_STORE_ANSWER_MAX];
+	mdns_record_t additional_record[MDNS_STORE_ADDITIONAL_MAX];
+	for (size_t ianswer = 0; ianswer < pending->answer_count; ++ianswer)
+		answer_record[ianswer] = store->entry[pending->answer[ianswer]].record;
+	for (size_t iadd = 0; iadd < additional_count; ++iadd)
+		additional_record[iadd] = store->entry[additional[iadd]].record;
+
+	// Answers too large for a packet are dropped and not counted as answered
+	mdns_split_stats_t split;
+	size_t packets =
+	    mdns_answer_build_split(store->buffer, MDNS_STORE_PACKET_SIZE, answer_record, pending->answer_count,
+	                            additional_record, additional_count, MDNS_CLASS_IN | MDNS_CACHE_FLUSH,
+	                            MDNS_STORE_TTL_DEFAULT, mdns_store_flush_send, pending, &split);
+	store->answer_records += split.answers;
+	if (split.dropped)
+		mdns_stats_add(pending->sock, MDNS_STAT_ANSWERS_DROPPED, split.dropped);
+
+	pending->packets += packets;
+	store->packets += packets;
+	pending->answer_count = 0;
+	return packets;
+}
+
+size_t
+mdns_store_flush(mdns_store_t* store, bool force) {
+	size_t packets = 0;
+	tick_t now = time_current();
+	for (size_t islot = 0; islot < MDNS_STORE_PENDING_SOCKETS; ++islot) {
+		mdns_store_pending_t* pending = store->pending + islot;
+		if (!pending->sock || (!force && (pending->deadline > now)))
+			continue;
+		packets += mdns_store_flush_pending(store, pending);
+		if (pending->responses > pending->packets)
+			store->packets_saved += pending->responses - pending->packets;
+		store->answered += pending->responses;
+		if (store->loop && (pending->timer >= 0))
+			mdns_loop_remove_timer(store->loop, pending->timer);
+		memset(pending, 0, sizeof(mdns_store_pending_t));
+	}
+	return packets;
+}
+
+static void
+mdns_store_flush_timer(mdns_loop_t* loop, int timer, void* user_data) {
+	FOUNDATION_UNUSED(loop);
+	FOUNDATION_UNUSED(timer);
+	mdns_store_flush(user_data, false);
+}
+
+void
+mdns_store_set_loop(mdns_store_t* store, mdns_loop_t* loop) {
+	store->loop = loop;
+}
+
+size_t
+mdns_store_schedule(mdns_store_t* store, socket_t* sock, const network_address_t* from, const void* buffer,
+                    size_t size, uint16_t query_id, uint16_t rtype, uint16_t rclass, size_t name_offset) {
+	// Legacy and unicast responses are never delayed
+	bool legacy = from && (network_address_ip_port(from) != MDNS_PORT);
+	if (legacy || ((rclass & MDNS_UNICAST_RESPONSE) && from))
+		return mdns_store_answer(store, sock, from, buffer, size, query_id, rtype, rclass, name_offset);
+
+	int answer[MDNS_STORE_ANSWER_MAX];
+	size_t answer_count = mdns_store_match(store, sock, buffer, size, name_offset, rtype, answer);
+	if (!answer_count)
+		return 0;
+
+	mdns_store_pending_t* pending = 0;
+	mdns_store_pending_t* unused = 0;
+	for (size_t islot = 0; islot < MDNS_STORE_PENDING_SOCKETS; ++islot) {
+		if (store->pending[islot].sock == sock)
+			pending = store->pending + islot;
+		else if (!store->pending[islot].sock && !unused)
+			unused = store->pending + islot;
+	}
+	if (!pending) {
+		if (!unused)
+			return mdns_store_answer(store, sock, from, buffer, size, query_id, rtype, rclass, name_offset);
+
+		// RFC 6762 section 6, delay multicast responses by a random 20-120 ms
+		unsigned int delay = random32_range(20, 121);
+		pending = unused;
+		pending->sock = sock;
+		pending->deadline = time_current() + ((time_ticks_per_second() * (tick_t)delay) / 1000);
+		pending->timer = store->loop ? mdns_loop_add_timer(store->loop, delay, mdns_store_flush_timer, store) : -1;
+	}
+
+	// Merge into the records owed on this socket, flushing early when the set is full
+	++pending->responses;
+	++store->responses;
+	for (size_t ianswer = 0; ianswer < answer_count; ++ianswer) {
+		if (mdns_store_handle_listed(pending->answer, pending->answer_count, answer[ianswer]))
+			continue;
+		if (pending->answer_count >= MDNS_STORE_ANSWER_MAX)
+			mdns_store_flush_pending(store, pending);
+		pending->answer[pending->answer_count++] = answer[ianswer];
+	}
+	return answer_count;
+}
+
+int
+mdns_store_callback(socket_t* sock, const network_address_t* from, mdns_entry_type_t entry, uint16_t query_id,
+                    uint16_t rtype, uint16_t rclass, uint32_t ttl, const void* data, size_t size, size_t name_offset,
+                    size_t name_length, size_t record_offset, size_t record_length, void* user_data) {
+	FOUNDATION_UNUSED(ttl);
+	FOUNDATION_UNUSED(name_length);
+	FOUNDATION_UNUSED(record_offset);
+	FOUNDATION_UNUSED(record_length);
+	mdns_store_t* store = user_data;
+	if ((entry != MDNS_ENTRYTYPE_QUESTION) || !store)
+		return 0;
+	if (store->loop)
+		mdns_store_schedule(store, sock, from, data, size, query_id, rtype, rclass, name_offset);
+	else
+		mdns_store_answer(store, sock, from, data, size, query_id, rtype, rclass, name_offset);
+	return 0;
+}
@@ -0,0 +1,108 @@
+/* store.h  -  mDNS library  -  Public Domain  -  2014 Mattias Jansson
+ *
+ * This library provides a cross-platform mDNS and DNS-SD library in C based
+ * on our foundation and network libraries. The implementation is based on RFC 6762
+ * and RFC 6763.
+ *
+ * The latest source code maintained by Mattias Jansson is always available at
+ *
+ * https://github.com/mjansson/mdns_lib
+ *
+ * The foundation and network library source code maintained by Mattias Jansson
+ * is always available at
+ *
+ * https://github.com/mjansson/foundation_lib
+ * https://github.com/mjansson/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify
+ * it without any restrictions.
+ *
+ */
+
+#pragma once
+
+#include <foundation/platform.h>
+#include <network/types.h>
+
+#include <mdns/types.h>
+
+//! Allocate a record store holding up to capacity records
+MDNS_API mdns_store_t*
+mdns_store_allocate(size_t capacity);
+
+//! Finalize and deallocate a record store
+MDNS_API void
+mdns_store_deallocate(mdns_store_t* store);
+
+//! Initialize a record store holding up to capacity records. Returns 0 if success, <0 if error
+MDNS_API int
+mdns_store_initialize(mdns_store_t* store, size_t capacity);
+
+//! Finalize a record store, releasing all records
+MDNS_API void
+mdns_store_finalize(mdns_store_t* store);
+
+//! Insert a copy of the record in the store, indexed by name and type. The store owns copies of
+//! all record strings. Returns the record handle, or <0 if the store is full
+MDNS_API int
+mdns_store_insert(mdns_store_t* store, const mdns_record_t* record);
+
+//! Replace the record with the given handle, keeping the handle. Returns 0 if success, <0 if error
+MDNS_API int
+mdns_store_update(mdns_store_t* store, int handle, const mdns_record_t* record);
+
+//! Remove the record with the given handle. Returns 0 if success, <0 if error
+MDNS_API int
+mdns_store_remove(mdns_store_t* store, int handle);
+
+//! Get the record with the given handle, or null if not a valid handle
+MDNS_API const mdns_record_t*
+mdns_store_record(const mdns_store_t* store, int handle);
+
+//! Find the next record with the given name and type after the record with handle previous,
+//! start with previous set to <0. Type ANY is not expanded. Returns the handle, or <0 if none
+MDNS_API int
+mdns_store_find(const mdns_store_t* store, const char* name, size_t length, mdns_record_type_t type, int previous);
+
+//! Build the response to a question in a received packet like mdns_store_answer without sending it,
+//! as a legacy unicast response if legacy is set. Returns the size of the response, or 0 if there
+//! are no matching records or the response could not be built. The number of answer records is
+//! stored in the optional answer_records
+MDNS_API size_t
+mdns_store_answer_build(const mdns_store_t* store, const void* buffer, size_t size, size_t name_offset,
+                        uint16_t query_id, uint16_t rtype, bool legacy, void* response, size_t capacity,
+                        size_t* answer_records);
+
+//! Answer a question in a received packet with all matching records and related SRV, TXT, A and
+//! AAAA additional records. Records listed as known answers in the packet with at least half their
+//! TTL remaining are not repeated. Responds with a legacy unicast response if the question came from a
+//! port other than MDNS_PORT, a unicast response if the unicast response bit is set in the class,
+//! otherwise a multicast response. Returns the number of answer records sent
+MDNS_API size_t
+mdns_store_answer(mdns_store_t* store, socket_t* sock, const network_address_t* from, const void* buffer,
+                  size_t size, uint16_t query_id, uint16_t rtype, uint16_t rclass, size_t name_offset);
+
+//! Schedule the response to a question like mdns_store_answer. Multicast responses are held for a
+//! random 20-120 ms window (RFC 6762 section 6), records owed on the same socket are deduplicated
+//! and sent together in as few packets as possible by mdns_store_flush. Legacy and unicast responses
+//! are sent immediately. Returns the number of answer records scheduled or sent
+MDNS_API size_t
+mdns_store_schedule(mdns_store_t* store, socket_t* sock, const network_address_t* from, const void* buffer,
+                    size_t size, uint16_t query_id, uint16_t rtype, uint16_t rclass, size_t name_offset);
+
+//! Send scheduled multicast responses whose window has passed, or all if force is set. Returns
+//! the number of packets sent
+MDNS_API size_t
+mdns_store_flush(mdns_store_t* store, bool force);
+
+//! Set the event loop used to flush scheduled responses with timers. With a loop set the store
+//! callback schedules multicast responses instead of answering immediately
+MDNS_API void
+mdns_store_set_loop(mdns_store_t* store, mdns_loop_t* loop);
+
+//! Record callback to pass to mdns_service_listen with the store as user data, answering every
+//! question with mdns_store_schedule if a loop is set, otherwise with mdns_store_answer
+MDNS_API int
+mdns_store_callback(socket_t* sock, const network_address_t* from, mdns_entry_type_t entry, uint16_t query_id,
+                    uint16_t rtype, uint16_t rclass, uint32_t ttl, const void* data, size_t size, size_t name_offset,
+                    size_t name_length, size_t record_offset, size_t record_length, void* user_data);
@@ -22,6 +22,15 @@
 #include <foundation/foundation.h>
 
 #include <mdns/mdns.h>
+#include <mdns/internal.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif FOUNDATION_ARCH_SSE2
+#include <emmintrin.h>
+#elif FOUNDATION_ARCH_NEON
+#include <arm_neon.h>
+#endif
 
 static int
 mdns_is_string_ref(uint8_t val) {
@@ -59,14 +68,32 @@ mdns_get_next_substring(const void* rawdata, size_t size, size_t offset) {
 	return pair;
 }
 
+// Count a name walk failing on a label outside the buffer, or on too many labels such as from a
+// compression pointer loop. Returns true if the walk failed
+static bool
+mdns_string_walk_failed(socket_t* sock, mdns_string_pair_t substr, bool overflow) {
+	if (substr.offset == STRING_NPOS)
+		mdns_stats_add(sock, MDNS_STAT_ERROR_NAME_BOUNDS, 1);
+	else if (overflow)
+		mdns_stats_add(sock, MDNS_STAT_ERROR_NAME_LOOP, 1);
+	else
+		return false;
+	return true;
+}
+
 int
 mdns_string_skip(const void* buffer, size_t size, size_t* offset) {
+	return mdns_string_skip_socket(0, buffer, size, offset);
+}
+
+int
+mdns_string_skip_socket(socket_t* sock, const void* buffer, size_t size, size_t* offset) {
 	size_t cur = *offset;
 	mdns_string_pair_t substr;
 	unsigned int counter = 0;
 	do {
 		substr = mdns_get_next_substring(buffer, size, cur);
-		if ((substr.offset == STRING_NPOS) || (counter++ > MDNS_MAX_SUBSTRINGS))
+		if (mdns_string_walk_failed(sock, substr, counter++ > MDNS_MAX_SUBSTRINGS))
 			return 0;
 		if (substr.ref) {
 			*offset = cur + 2;
@@ -79,11 +106,217 @@ mdns_string_skip(const void* buffer, size_t size, size_t* offset) {
 	return 1;
 }
 
+static FOUNDATION_FORCEINLINE uint8_t
+mdns_ascii_lower(uint8_t c) {
+	return ((uint8_t)(c - 'A') < 26) ? (uint8_t)(c | 0x20) : c;
+}
+
+// Fold ASCII upper case to lower case by OR-ing 0x20 into bytes in [A,Z]. The range
+// check biases the bytes so that [A,Z] maps to the lowest signed values, since SSE2
+// and AVX2 only have signed byte compares. Bytes outside ASCII are compared exactly.
+#if defined(__AVX2__)
+static FOUNDATION_FORCEINLINE __m256i
+mdns_ascii_lower_avx2(__m256i val) {
+	__m256i biased = _mm256_add_epi8(val, _mm256_set1_epi8((char)(0x80 - 'A')));
+	__m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(0x80 + 26)), biased);
+	return _mm256_or_si256(val, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+}
+#endif
+
+#if defined(__AVX2__) || FOUNDATION_ARCH_SSE2
+static FOUNDATION_FORCEINLINE __m128i
+mdns_ascii_lower_sse2(__m128i val) {
+	__m128i biased = _mm_add_epi8(val, _mm_set1_epi8((char)(0x80 - 'A')));
+	__m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8((char)(0x80 + 26)), biased);
+	return _mm_or_si128(val, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+#elif FOUNDATION_ARCH_NEON
+static FOUNDATION_FORCEINLINE uint8x16_t
+mdns_ascii_lower_neon(uint8x16_t val) {
+	uint8x16_t upper = vcltq_u8(vsubq_u8(val, vdupq_n_u8('A')), vdupq_n_u8(26));
+	return vorrq_u8(val, vandq_u8(upper, vdupq_n_u8(0x20)));
+}
+#endif
+
+int
+mdns_string_equal_nocase(const void* lhs, const void* rhs, size_t length) {
+	const uint8_t* lhs_byte = (const uint8_t*)lhs;
+	const uint8_t* rhs_byte = (const uint8_t*)rhs;
+	size_t ichr = 0;
+#if defined(__AVX2__)
+	for (; ichr + 32 <= length; ichr += 32) {
+		__m256i lhs_val = mdns_ascii_lower_avx2(_mm256_loadu_si256((const __m256i*)(const void*)(lhs_byte + ichr)));
+		__m256i rhs_val = mdns_ascii_lower_avx2(_mm256_loadu_si256((const __m256i*)(const void*)(rhs_byte + ichr)));
+		if ((unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lhs_val, rhs_val)) != 0xFFFFFFFFU)
+			return 0;
+	}
+#endif
+#if defined(__AVX2__) || FOUNDATION_ARCH_SSE2
+	for (; ichr + 16 <= length; ichr += 16) {
+		__m128i lhs_val = mdns_ascii_lower_sse2(_mm_loadu_si128((const __m128i*)(const void*)(lhs_byte + ichr)));
+		__m128i rhs_val = mdns_ascii_lower_sse2(_mm_loadu_si128((const __m128i*)(const void*)(rhs_byte + ichr)));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(lhs_val, rhs_val)) != 0xFFFF)
+			return 0;
+	}
+#elif FOUNDATION_ARCH_NEON
+	for (; ichr + 16 <= length; ichr += 16) {
+		uint8x16_t lhs_val = mdns_ascii_lower_neon(vld1q_u8(lhs_byte + ichr));
+		uint8x16_t rhs_val = mdns_ascii_lower_neon(vld1q_u8(rhs_byte + ichr));
+		uint8x16_t equal = vceqq_u8(lhs_val, rhs_val);
+		uint64x2_t lanes = vreinterpretq_u64_u8(equal);
+		if ((vgetq_lane_u64(lanes, 0) & vgetq_lane_u64(lanes, 1)) != 0xFFFFFFFFFFFFFFFFULL)
+			return 0;
+	}
+#endif
+	for (; ichr < length; ++ichr) {
+		if (mdns_ascii_lower(lhs_byte[ichr]) != mdns_ascii_lower(rhs_byte[ichr]))
+			return 0;
+	}
+	return 1;
+}
+
+// Get the total wire length of a name with no compression pointers, or zero if the name
+// is compressed or malformed
+static size_t
+mdns_string_contiguous_length(const uint8_t* buffer, size_t size, size_t offset) {
+	size_t cur = offset;
+	unsigned int counter = 0;
+	while (cur < size) {
+		uint8_t length = buffer[cur];
+		if (!length)
+			return cur + 1 - offset;
+		if ((length & 0xC0) || (counter++ > MDNS_MAX_SUBSTRINGS))
+			return 0;
+		cur += 1 + (size_t)length;
+	}
+	return 0;
+}
+
+static hash_t
+mdns_string_hash_label(hash_t suffix, const void* label, size_t length) {
+	uint8_t key[sizeof(hash_t) + 64];
+	const uint8_t* src = (const uint8_t*)label;
+	if (length > 63)
+		length = 63;
+	memcpy(key, &suffix, sizeof(hash_t));
+	for (size_t ichr = 0; ichr < length; ++ichr)
+		key[sizeof(hash_t) + ichr] = mdns_ascii_lower(src[ichr]);
+	return hash(key, sizeof(hash_t) + length);
+}
+
+hash_t
+mdns_string_hash(const char* name, size_t length) {
+	// Hash labels right to left, chaining each label onto the hash of its suffix
+	hash_t result = 0;
+	if (length && (name[length - 1] == '.'))
+		--length;
+	size_t end = length;
+	while (end) {
+		size_t start = end;
+		while (start && (name[start - 1] != '.'))
+			--start;
+		result = mdns_string_hash_label(result, name + start, end - start);
+		end = start ? start - 1 : 0;
+	}
+	return result;
+}
+
+int
+mdns_string_skip_hash(const void* buffer, size_t size, size_t* offset, hash_t* name_hash, hash_t* suffix_hash,
+                      size_t* suffix_count) {
+	mdns_string_pair_t label[MDNS_MAX_SUBSTRINGS + 1];
+	size_t cur = *offset;
+	size_t end = STRING_NPOS;
+	size_t count = 0;
+	mdns_string_pair_t substr;
+	do {
+		substr = mdns_get_next_substring(buffer, size, cur);
+		if (mdns_string_walk_failed(0, substr, count > MDNS_MAX_SUBSTRINGS))
+			return 0;
+		if (substr.ref && (end == STRING_NPOS))
+			end = cur + 2;
+		if (substr.length)
+			label[count++] = substr;
+		cur = substr.offset + substr.length;
+	} while (substr.length);
+
+	if (end == STRING_NPOS)
+		end = cur + 1;
+	*offset = end;
+
+	size_t capacity = suffix_count ? *suffix_count : 0;
+	hash_t result = 0;
+	for (size_t ilabel = count; ilabel; --ilabel) {
+		result = mdns_string_hash_label(result, pointer_offset_const(buffer, label[ilabel - 1].offset),
+		                                label[ilabel - 1].length);
+		if (suffix_hash && (ilabel - 1 < capacity))
+			suffix_hash[ilabel - 1] = result;
+	}
+	if (suffix_count)
+		*suffix_count = (count < capacity) ? count : capacity;
+	if (name_hash)
+		*name_hash = result;
+	return 1;
+}
+
+int
+mdns_string_equal_name(const void* buffer, size_t size, size_t offset, const char* name, size_t length) {
+	const uint8_t* data = (const uint8_t*)buffer;
+	if (length && (name[length - 1] == '.'))
+		--length;
+	size_t pos = 0;
+	unsigned int counter = 0;
+	while (1) {
+		if ((offset >= size) || (counter++ > MDNS_MAX_SUBSTRINGS))
+			return 0;
+		uint8_t sublength = data[offset];
+		if (!sublength)
+			break;
+		if (mdns_is_string_ref(sublength)) {
+			if (size < offset + 2)
+				return 0;
+			offset = mdns_ntohs(data + offset) & 0x3FFF;
+			continue;
+		}
+		++offset;
+		if (size < offset + sublength)
+			return 0;
+		// Compare label by label, a '.' inside a wire label is part of the label and never matches a
+		// separator in the name
+		const char* dot = (pos < length) ? memchr(name + pos, '.', length - pos) : 0;
+		size_t label_end = dot ? (size_t)(dot - name) : length;
+		if ((label_end - pos != sublength) || !mdns_string_equal_nocase(data + offset, name + pos, sublength))
+			return 0;
+		pos = label_end;
+		offset += sublength;
+		if (pos < length)
+			++pos;
+	}
+	return (pos == length);
+}
+
 int
 mdns_string_equal(const void* buffer_lhs, size_t size_lhs, size_t* ofs_lhs, const void* buffer_rhs, size_t size_rhs,
                   size_t* ofs_rhs) {
 	size_t lhs_cur = *ofs_lhs;
 	size_t rhs_cur = *ofs_rhs;
+
+	// Fast path when both names are uncompressed, length bytes are below 64 and never case folded
+	// so the entire wire representation can be compared in one pass
+	size_t lhs_length = mdns_string_contiguous_length((const uint8_t*)buffer_lhs, size_lhs, lhs_cur);
+	if (lhs_length) {
+		size_t rhs_length = mdns_string_contiguous_length((const uint8_t*)buffer_rhs, size_rhs, rhs_cur);
+		if (rhs_length) {
+			if ((lhs_length != rhs_length) ||
+			    !mdns_string_equal_nocase(pointer_offset_const(buffer_lhs, lhs_cur),
+			                              pointer_offset_const(buffer_rhs, rhs_cur), lhs_length))
+				return 0;
+			*ofs_lhs = lhs_cur + lhs_length;
+			*ofs_rhs = rhs_cur + rhs_length;
+			return 1;
+		}
+	}
+
 	size_t lhs_end = STRING_NPOS;
 	size_t rhs_end = STRING_NPOS;
 	mdns_string_pair_t lhs_substr;
@@ -95,8 +328,9 @@ mdns_string_equal(const void* buffer_lhs, size_t size_lhs, size_t* ofs_lhs, cons
 		if ((lhs_substr.offset == STRING_NPOS) || (rhs_substr.offset == STRING_NPOS) ||
 		    (counter++ > MDNS_MAX_SUBSTRINGS))
 			return 0;
-		if (!string_equal_nocase(pointer_offset_const(buffer_lhs, lhs_substr.offset), lhs_substr.length,
-		                         pointer_offset_const(buffer_rhs, rhs_substr.offset), rhs_substr.length))
+		if ((lhs_substr.length != rhs_substr.length) ||
+		    !mdns_string_equal_nocase(pointer_offset_const(buffer_lhs, lhs_substr.offset),
+		                              pointer_offset_const(buffer_rhs, rhs_substr.offset), lhs_substr.length))
 			return 0;
 		if (lhs_substr.ref && (lhs_end == STRING_NPOS))
 			lhs_end = lhs_cur + 2;
@@ -130,7 +364,7 @@ mdns_string_extract(const void* buffer, size_t size, size_t* offset, char* str,
 	size_t remain = capacity;
 	do {
 		substr = mdns_get_next_substring(buffer, size, cur);
-		if ((substr.offset == STRING_NPOS) || (counter++ > MDNS_MAX_SUBSTRINGS))
+		if (mdns_string_walk_failed(0, substr, counter++ > MDNS_MAX_SUBSTRINGS))
 			return result;
 		if (substr.ref && (end == STRING_NPOS))
 			end = cur + 2;
@@ -169,30 +403,59 @@ mdns_string_find(const char* str, size_t length, char c, size_t offset) {
 void*
 mdns_string_make(void* buffer, size_t capacity, void* data, const char* name, size_t length,
                  mdns_string_table_t* string_table) {
-	size_t pos = 0;
-	size_t last_pos = 0;
+	mdns_string_pair_t label[MDNS_MAX_SUBSTRINGS];
+	hash_t suffix_hash[MDNS_MAX_SUBSTRINGS];
+	size_t count = 0;
 	size_t remain = capacity - (size_t)pointer_diff(data, buffer);
-	if (name[length - 1] == '.')
+	if (length && (name[length - 1] == '.'))
 		--length;
+
+	size_t last_pos = 0;
 	while (last_pos < length) {
-		pos = mdns_string_find(name, length, '.', last_pos);
-		size_t sub_length = ((pos != STRING_NPOS) ? pos : length) - last_pos;
-		size_t total_length = length - last_pos;
+		if (count >= MDNS_MAX_SUBSTRINGS)
+			return 0;
+		size_t pos = mdns_string_find(name, length, '.', last_pos);
+		if (pos == STRING_NPOS)
+			pos = length;
+		label[count].offset = last_pos;
+		label[count].length = pos - last_pos;
+		++count;
+		last_pos = pos + 1;
+	}
 
-		size_t ref_offset = mdns_string_table_find(string_table, buffer, capacity, pointer_offset_const(name, last_pos),
-		                                           sub_length, total_length);
-		if (ref_offset != STRING_NPOS)
+	// Look up suffixes longest first, the first match is the longest compressible suffix
+	size_t compress = count;
+	size_t ref_offset = STRING_NPOS;
+	if (string_table) {
+		hash_t suffix = 0;
+		for (size_t ilabel = count; ilabel; --ilabel) {
+			suffix = mdns_string_hash_label(suffix, name + label[ilabel - 1].offset, label[ilabel - 1].length);
+			suffix_hash[ilabel - 1] = suffix;
+		}
+		for (size_t ilabel = 0; ilabel < count; ++ilabel) {
+			ref_offset = mdns_string_table_find(string_table, buffer, capacity, name + label[ilabel].offset,
+			                                    length - label[ilabel].offset, suffix_hash[ilabel]);
+			if (ref_offset != STRING_NPOS) {
+				compress = ilabel;
+				break;
+			}
+		}
+	}
+
+	for (size_t ilabel = 0; ilabel < count; ++ilabel) {
+		if (ilabel == compress)
 			return mdns_string_make_ref(data, remain, ref_offset);
 
+		size_t sub_length = label[ilabel].length;
 		if (remain <= (sub_length + 1))
 			return 0;
 
 		*(unsigned char*)data = (unsigned char)sub_length;
-		memcpy(pointer_offset(data, 1), name + last_pos, sub_length);
-		mdns_string_table_add(string_table, (size_t)pointer_diff(data, buffer));
+		memcpy(pointer_offset(data, 1), name + label[ilabel].offset, sub_length);
+		if (string_table)
+			mdns_string_table_add(string_table, (size_t)pointer_diff(data, buffer), suffix_hash[ilabel]);
 
 		data = pointer_offset(data, sub_length + 1);
-		last_pos = ((pos != STRING_NPOS) ? pos + 1 : length);
 		remain = capacity - (size_t)pointer_diff(data, buffer);
 	}
 
@@ -210,57 +473,236 @@ mdns_string_make_ref(void* data, size_t capacity, size_t ref_offset) {
 	return mdns_htons(data, 0xC000 | (uint16_t)ref_offset);
 }
 
+void
+mdns_string_table_initialize(mdns_string_table_t* string_table) {
+	memset(string_table->bucket, 0, sizeof(string_table->bucket));
+	string_table->count = 0;
+}
+
 size_t
-mdns_string_table_find(mdns_string_table_t* string_table, const void* buffer, size_t capacity, const char* str,
-                       size_t first_length, size_t total_length) {
+mdns_string_table_find(const mdns_string_table_t* string_table, const void* buffer, size_t capacity,
+                       const char* str, size_t length, hash_t suffix_hash) {
 	if (!string_table)
 		return STRING_NPOS;
 
-	for (size_t istr = 0; istr < string_table->count; ++istr) {
-		if (string_table->offset[istr] >= capacity)
+	uint16_t next = string_table->bucket[suffix_hash & (MDNS_STRING_TABLE_BUCKETS - 1)];
+	while (next) {
+		const mdns_string_table_entry_t* entry = string_table->entry + (next - 1);
+		next = entry->next;
+		if ((entry->hash != (uint32_t)suffix_hash) || (entry->offset >= capacity))
 			continue;
-		size_t offset = 0;
-		mdns_string_pair_t sub_string = mdns_get_next_substring(buffer, capacity, string_table->offset[istr]);
-		if (!sub_string.length || (sub_string.length != first_length))
-			continue;
-		if (memcmp(str, pointer_offset_const(buffer, sub_string.offset), sub_string.length))
-			continue;
-
-		// Initial substring matches, now match all remaining substrings
-		offset += first_length + 1;
-		while (offset < total_length) {
-			size_t dot_pos = string_find(str, total_length, '.', offset);
-			if (dot_pos == STRING_NPOS)
-				dot_pos = total_length;
-			size_t current_length = dot_pos - offset;
 
-			sub_string = mdns_get_next_substring(buffer, capacity, sub_string.offset + sub_string.length);
-			if (!sub_string.length || (sub_string.length != current_length))
+		// Verify labels and the terminating root, compression must reproduce the name exactly
+		size_t pos = 0;
+		size_t cur = entry->offset;
+		unsigned int counter = 0;
+		while (1) {
+			mdns_string_pair_t sub_string = mdns_get_next_substring(buffer, capacity, cur);
+			if ((sub_string.offset == STRING_NPOS) || (++counter > MDNS_MAX_SUBSTRINGS))
 				break;
-			if (memcmp(str + offset, pointer_offset_const(buffer, sub_string.offset), sub_string.length))
+			if (!sub_string.length) {
+				if (pos >= length)
+					return entry->offset;
 				break;
-
-			offset = dot_pos + 1;
+			}
+			size_t dot_pos = mdns_string_find(str, length, '.', pos);
+			if (dot_pos == STRING_NPOS)
+				dot_pos = length;
+			if ((pos >= length) || (sub_string.length != dot_pos - pos) ||
+			    memcmp(str + pos, pointer_offset_const(buffer, sub_string.offset), sub_string.length))
+				break;
+			pos = dot_pos + 1;
+			cur = sub_string.offset + sub_string.length;
 		}
-
-		// Return reference offset if entire string matches
-		if (offset >= total_length)
-			return string_table->offset[istr];
 	}
 
 	return STRING_NPOS;
 }
 
 void
-mdns_string_table_add(mdns_string_table_t* string_table, size_t offset) {
-	if (!string_table)
+mdns_string_table_add(mdns_string_table_t* string_table, size_t offset, hash_t suffix_hash) {
+	// Compression pointers hold 14 bit offsets, suffixes past the dictionary size are not compressed
+	if (!string_table || (offset > 0x3FFF) || (string_table->count >= MDNS_STRING_TABLE_SIZE))
 		return;
 
-	string_table->offset[string_table->next] = offset;
+	size_t ibucket = (size_t)(suffix_hash & (MDNS_STRING_TABLE_BUCKETS - 1));
+	mdns_string_table_entry_t* entry = string_table->entry + string_table->count++;
+	entry->hash = (uint32_t)suffix_hash;
+	entry->offset = (uint16_t)offset;
+	entry->next = string_table->bucket[ibucket];
+	string_table->bucket[ibucket] = (uint16_t)string_table->count;
+}
+
+void
+mdns_string_context_initialize(mdns_string_context_t* context, const void* buffer, size_t size) {
+	context->buffer = buffer;
+	context->size = (size > 0xFFFF) ? 0xFFFF : size;
+	context->count = 0;
+	context->text_used = 0;
+	memset(context->bucket, 0, sizeof(context->bucket));
+}
+
+static const mdns_string_context_entry_t*
+mdns_string_context_resolve(mdns_string_context_t* context, size_t offset, unsigned int depth) {
+	size_t ibucket = offset & (MDNS_STRING_CONTEXT_BUCKETS - 1);
+	uint16_t next = context->bucket[ibucket];
+	while (next) {
+		const mdns_string_context_entry_t* entry = context->entry + (next - 1);
+		if (entry->offset == offset)
+			return entry;
+		next = entry->next;
+	}
+
+	if ((depth > MDNS_MAX_SUBSTRINGS) || (context->count >= MDNS_STRING_CONTEXT_SIZE))
+		return 0;
+
+	// Decode the suffix into the text pool, reusing the memoized text of any nested pointer target
+	const uint8_t* buffer = (const uint8_t*)context->buffer;
+	size_t size = context->size;
+	size_t count = context->count;
+	size_t text_offset = context->text_used;
+	size_t text_used = text_offset;
+	size_t cur = offset;
+	unsigned int counter = 0;
+	while (1) {
+		if ((cur >= size) || (counter++ > MDNS_MAX_SUBSTRINGS))
+			goto failed;
+		uint8_t length = buffer[cur];
+		if (!length)
+			break;
+		if (mdns_is_string_ref(length)) {
+			if (size < cur + 2)
+				goto failed;
+			// Claim the labels decoded so far, a newly decoded suffix then lands directly after them
+			// while an already memoized suffix is copied in place
+			size_t target = mdns_ntohs(pointer_offset_const(buffer, cur)) & 0x3fff;
+			context->text_used = text_used;
+			const mdns_string_context_entry_t* suffix = mdns_string_context_resolve(context, target, depth + 1);
+			if (!suffix || (context->count >= MDNS_STRING_CONTEXT_SIZE))
+				goto failed;
+			if (suffix->text_offset != text_used) {
+				if (text_used + suffix->text_length > MDNS_STRING_CONTEXT_TEXT_SIZE)
+					goto failed;
+				memcpy(context->text + text_used, context->text + suffix->text_offset, suffix->text_length);
+			}
+			text_used += suffix->text_length;
+			break;
+		}
+		if ((size < cur + 1 + length) || (text_used + length + 1 > MDNS_STRING_CONTEXT_TEXT_SIZE))
+			goto failed;
+		memcpy(context->text + text_used, buffer + cur + 1, length);
+		text_used += length;
+		context->text[text_used++] = '.';
+		cur += 1 + (size_t)length;
+	}
+
+	if (text_used - text_offset > 255)
+		goto failed;
+
+	mdns_string_context_entry_t* entry = context->entry + context->count++;
+	entry->offset = (uint16_t)offset;
+	entry->text_offset = (uint16_t)text_offset;
+	entry->text_length = (uint16_t)(text_used - text_offset);
+	entry->hash = mdns_string_hash(context->text + text_offset, entry->text_length);
+	entry->next = context->bucket[ibucket];
+	context->bucket[ibucket] = (uint16_t)context->count;
+	context->text_used = text_used;
+	return entry;
+
+failed:
+	// Release the text claimed for this suffix, and any nested suffix decoded into it. Entries are
+	// removed in reverse order so each is the head of its bucket
+	while (context->count > count) {
+		const mdns_string_context_entry_t* entry = context->entry + --context->count;
+		context->bucket[entry->offset & (MDNS_STRING_CONTEXT_BUCKETS - 1)] = entry->next;
+	}
+	context->text_used = text_offset;
+	return 0;
+}
+
+const mdns_string_context_entry_t*
+mdns_string_context_suffix(mdns_string_context_t* context, size_t offset) {
+	return mdns_string_context_resolve(context, offset, 0);
+}
+
+string_const_t
+mdns_string_context_extract(mdns_string_context_t* context, size_t* offset, char* str, size_t capacity) {
+	const uint8_t* buffer = (const uint8_t*)context->buffer;
+	size_t size = context->size;
+	size_t cur = *offset;
+	string_const_t result;
+	result.str = str;
+	result.length = 0;
+	size_t used = 0;
+	unsigned int counter = 0;
+	while (1) {
+		if ((cur >= size) || (counter++ > MDNS_MAX_SUBSTRINGS))
+			return result;
+		uint8_t length = buffer[cur];
+		if (!length) {
+			*offset = cur + 1;
+			break;
+		}
+		if (mdns_is_string_ref(length)) {
+			if (size < cur + 2)
+				return result;
+			size_t target = mdns_ntohs(pointer_offset_const(buffer, cur)) & 0x3fff;
+			const mdns_string_context_entry_t* suffix = mdns_string_context_resolve(context, target, 0);
+			if (!suffix)
+				return mdns_string_extract(context->buffer, size, offset, str, capacity);
+			size_t to_copy = (suffix->text_length < capacity - used) ? suffix->text_length : capacity - used;
+			memcpy(str + used, context->text + suffix->text_offset, to_copy);
+			used += to_copy;
+			*offset = cur + 2;
+			break;
+		}
+		if (size < cur + 1 + length)
+			return result;
+		size_t to_copy = (length < capacity - used) ? length : capacity - used;
+		memcpy(str + used, buffer + cur + 1, to_copy);
+		used += to_copy;
+		if (used < capacity)
+			str[used++] = '.';
+		cur += 1 + (size_t)length;
+	}
 
-	size_t table_capacity = sizeof(string_table->offset) / sizeof(string_table->offset[0]);
-	if (++string_table->count > table_capacity)
-		string_table->count = table_capacity;
-	if (++string_table->next >= table_capacity)
-		string_table->next = 0;
+	result.length = used;
+	return result;
+}
+
+int
+mdns_string_context_equal(mdns_string_context_t* context, size_t* ofs_lhs, size_t* ofs_rhs) {
+	char lhs_buffer[256];
+	char rhs_buffer[256];
+	size_t lhs_end = *ofs_lhs;
+	size_t rhs_end = *ofs_rhs;
+	string_const_t lhs = mdns_string_context_extract(context, &lhs_end, lhs_buffer, sizeof(lhs_buffer));
+	string_const_t rhs = mdns_string_context_extract(context, &rhs_end, rhs_buffer, sizeof(rhs_buffer));
+	if ((lhs_end == *ofs_lhs) || (rhs_end == *ofs_rhs))
+		return 0;
+	if (!string_equal_nocase(STRING_ARGS(lhs), STRING_ARGS(rhs)))
+		return 0;
+	*ofs_lhs = lhs_end;
+	*ofs_rhs = rhs_end;
+	return 1;
+}
+
+hash_t
+mdns_name_hash(mdns_name_t* name) {
+	if (!name->hash) {
+		size_t offset = 0;
+		hash_t name_hash = 0;
+		if (mdns_string_skip_hash(name->data, name->length, &offset, &name_hash, 0, 0))
+			name->hash = name_hash;
+	}
+	return name->hash;
+}
+
+void*
+mdns_string_make_name(void* buffer, size_t capacity, void* data, const mdns_name_t* name) {
+	size_t remain = capacity - (size_t)pointer_diff(data, buffer);
+	if (remain < name->length)
+		return 0;
+	memcpy(data, name->data, name->length);
+	return pointer_offset(data, name->length);
 }
@@ -35,6 +35,25 @@ MDNS_API int
 mdns_string_equal(const void* buffer_lhs, size_t size_lhs, size_t* ofs_lhs, const void* buffer_rhs, size_t size_rhs,
                   size_t* ofs_rhs);
 
+//! Hash a dotted name, case-insensitive and matching the hashes of mdns_string_skip_hash
+MDNS_API hash_t
+mdns_string_hash(const char* name, size_t length);
+
+//! Skip a name like mdns_string_skip while computing the hash of the decompressed name
+//! and, if suffix_hash is set, the hash of each suffix where suffix_hash[0] is the full
+//! name. On input suffix_count holds the capacity of suffix_hash, on output the number
+//! of suffix hashes stored
+MDNS_API int
+mdns_string_skip_hash(const void* buffer, size_t size, size_t* offset, hash_t* name_hash, hash_t* suffix_hash,
+                      size_t* suffix_count);
+
+//! Compare a name in a packet against a dotted name, case-insensitive. Returns 1 if equal
+MDNS_API int
+mdns_string_equal_name(const void* buffer, size_t size, size_t offset, const char* name, size_t length);
+
+MDNS_API int
+mdns_string_equal_nocase(const void* lhs, const void* rhs, size_t length);
+
 MDNS_API void*
 mdns_string_make(void* buffer, size_t capacity, void* data, const char* name, size_t length,
                  mdns_string_table_t* string_table);
@@ -42,9 +61,146 @@ mdns_string_make(void* buffer, size_t capacity, void* data, const char* name, si
 MDNS_API void*
 mdns_string_make_ref(void* data, size_t capacity, size_t ref_offset);
 
+//! Initialize an empty compression dictionary
+MDNS_API void
+mdns_string_table_initialize(mdns_string_table_t* string_table);
+
+//! Add a name suffix written at the given packet offset with the given suffix hash
 MDNS_API void
-mdns_string_table_add(mdns_string_table_t* string_table, size_t offset);
+mdns_string_table_add(mdns_string_table_t* string_table, size_t offset, hash_t suffix_hash);
 
+//! Find the packet offset of a dotted name suffix with the given suffix hash, verifying the
+//! labels in the packet to rule out hash collisions. Returns STRING_NPOS if not found
 MDNS_API size_t
-mdns_string_table_find(mdns_string_table_t* string_table, const void* buffer, size_t capacity, const char* str,
-                       size_t first_length, size_t total_length);
+mdns_string_table_find(const mdns_string_table_t* string_table, const void* buffer, size_t capacity,
+                       const char* str, size_t length, hash_t suffix_hash);
+
+MDNS_API void
+mdns_string_context_initialize(mdns_string_context_t* context, const void* buffer, size_t size);
+
+MDNS_API string_const_t
+mdns_string_context_extract(mdns_string_context_t* context, size_t* offset, char* str, size_t capacity);
+
+MDNS_API int
+mdns_string_context_equal(mdns_string_context_t* context, size_t* ofs_lhs, size_t* ofs_rhs);
+
+MDNS_API const mdns_string_context_entry_t*
+mdns_string_context_suffix(mdns_string_context_t* context, size_t offset);
+
+//! Get the hash of a wire format name, matching mdns_string_hash of the dotted name. The hash is
+//! computed on first call and stored in the name
+MDNS_API hash_t
+mdns_name_hash(mdns_name_t* name);
+
+//! Write a wire format name without encoding or compressing it. Returns pointer past the name,
+//! or null if it does not fit
+MDNS_API void*
+mdns_string_make_name(void* buffer, size_t capacity, void* data, const mdns_name_t* name);
+
+// Compile-time wire format names. In C the labels are given as separate string literals, up to
+// eight labels, each label at most 63 characters:
+//
+//   MDNS_NAME_DECLARE(http_name, "_http", "_tcp", "local");
+//   mdns_string_equal(buffer, size, &offset, http_name.data, http_name.length, &zero);
+//
+// declares a static mdns_name_t http_name with the encoded labels "\5_http\4_tcp\5local\0" and
+// their length computed at compile time. MDNS_NAME_FIELDS and MDNS_NAME_VALUES declare and
+// initialize the encoded labels as members of a struct, for example to embed a name in a
+// constant packet.
+
+#define MDNS_NAME_EXPAND(x) x
+#define MDNS_NAME_CONCAT_(a, b) a##b
+#define MDNS_NAME_CONCAT(a, b) MDNS_NAME_CONCAT_(a, b)
+#define MDNS_NAME_NARG_(_1, _2, _3, _4, _5, _6, _7, _8, count, ...) count
+#define MDNS_NAME_NARG(...) MDNS_NAME_EXPAND(MDNS_NAME_NARG_(__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0))
+
+// Labels longer than 63 characters give a negative array size
+#define MDNS_NAME_FIELD(index, str)                                                                                    \
+	uint8_t length##index;                                                                                             \
+	char label##index[(sizeof(str) - 1) + 0 * sizeof(char[(sizeof(str) <= 64) ? 1 : -1])];
+#define MDNS_NAME_FIELDS_1(a) MDNS_NAME_FIELD(0, a)
+#define MDNS_NAME_FIELDS_2(a, b) MDNS_NAME_FIELDS_1(a) MDNS_NAME_FIELD(1, b)
+#define MDNS_NAME_FIELDS_3(a, b, c) MDNS_NAME_FIELDS_2(a, b) MDNS_NAME_FIELD(2, c)
+#define MDNS_NAME_FIELDS_4(a, b, c, d) MDNS_NAME_FIELDS_3(a, b, c) MDNS_NAME_FIELD(3, d)
+#define MDNS_NAME_FIELDS_5(a, b, c, d, e) MDNS_NAME_FIELDS_4(a, b, c, d) MDNS_NAME_FIELD(4, e)
+#define MDNS_NAME_FIELDS_6(a, b, c, d, e, f) MDNS_NAME_FIELDS_5(a, b, c, d, e) MDNS_NAME_FIELD(5, f)
+#define MDNS_NAME_FIELDS_7(a, b, c, d, e, f, g) MDNS_NAME_FIELDS_6(a, b, c, d, e, f) MDNS_NAME_FIELD(6, g)
+#define MDNS_NAME_FIELDS_8(a, b, c, d, e, f, g, h) MDNS_NAME_FIELDS_7(a, b, c, d, e, f, g) MDNS_NAME_FIELD(7, h)
+#define MDNS_NAME_FIELDS(...)                                                                                          \
+	MDNS_NAME_EXPAND(MDNS_NAME_CONCAT(MDNS_NAME_FIELDS_, MDNS_NAME_NARG(__VA_ARGS__))(__VA_ARGS__)) uint8_t root
+
+#define MDNS_NAME_VALUE(str) (uint8_t)(sizeof(str) - 1), str,
+#define MDNS_NAME_VALUES_1(a) MDNS_NAME_VALUE(a)
+#define MDNS_NAME_VALUES_2(a, b) MDNS_NAME_VALUES_1(a) MDNS_NAME_VALUE(b)
+#define MDNS_NAME_VALUES_3(a, b, c) MDNS_NAME_VALUES_2(a, b) MDNS_NAME_VALUE(c)
+#define MDNS_NAME_VALUES_4(a, b, c, d) MDNS_NAME_VALUES_3(a, b, c) MDNS_NAME_VALUE(d)
+#define MDNS_NAME_VALUES_5(a, b, c, d, e) MDNS_NAME_VALUES_4(a, b, c, d) MDNS_NAME_VALUE(e)
+#define MDNS_NAME_VALUES_6(a, b, c, d, e, f) MDNS_NAME_VALUES_5(a, b, c, d, e) MDNS_NAME_VALUE(f)
+#define MDNS_NAME_VALUES_7(a, b, c, d, e, f, g) MDNS_NAME_VALUES_6(a, b, c, d, e, f) MDNS_NAME_VALUE(g)
+#define MDNS_NAME_VALUES_8(a, b, c, d, e, f, g, h) MDNS_NAME_VALUES_7(a, b, c, d, e, f, g) MDNS_NAME_VALUE(h)
+#define MDNS_NAME_VALUES(...)                                                                                          \
+	MDNS_NAME_EXPAND(MDNS_NAME_CONCAT(MDNS_NAME_VALUES_, MDNS_NAME_NARG(__VA_ARGS__))(__VA_ARGS__)) 0
+
+#define MDNS_NAME_DECLARE(var, ...)                                                                                    \
+	static const struct {                                                                                              \
+		MDNS_NAME_FIELDS(__VA_ARGS__);                                                                                 \
+	} var##_labels = {MDNS_NAME_VALUES(__VA_ARGS__)};                                                                  \
+	static mdns_name_t var = {&var##_labels, sizeof(var##_labels), 0}
+
+#if defined(__cplusplus) && ((__cplusplus >= 201402L) || (defined(_MSVC_LANG) && (_MSVC_LANG >= 201402L)))
+
+// Compile-time wire format names from dotted string literals in C++14 and later, the constructor
+// loops need relaxed constexpr rules:
+//
+//   static constexpr auto http_name = mdns_name_literal("_http._tcp.local.");
+//   mdns_name_t name = http_name.name();
+//
+// Labels must be at most 63 characters and the encoded name at most 255 bytes. A longer label or
+// name calls one of the functions below, which are not constexpr and fail constant evaluation.
+inline void
+mdns_name_literal_label_too_long(void) {
+}
+
+inline void
+mdns_name_literal_name_too_long(void) {
+}
+
+template <size_t N>
+struct mdns_name_literal_t {
+	// Encoded length is at most the dotted length plus the first length byte and the root label
+	uint8_t data[N + 1];
+	size_t length;
+
+	constexpr mdns_name_literal_t(const char (&str)[N]) : data(), length(0) {
+		size_t start = 0;
+		for (size_t ichr = 0; ichr < N; ++ichr) {
+			if ((ichr + 1 < N) && (str[ichr] != '.') && str[ichr])
+				continue;
+			if (ichr > start) {
+				if (ichr - start > 63)
+					mdns_name_literal_label_too_long();
+				data[length++] = (uint8_t)(ichr - start);
+				for (size_t ilabel = start; ilabel < ichr; ++ilabel)
+					data[length++] = (uint8_t)str[ilabel];
+			}
+			start = ichr + 1;
+		}
+		data[length++] = 0;
+		if (length > 255)
+			mdns_name_literal_name_too_long();
+	}
+
+	mdns_name_t
+	name() const {
+		mdns_name_t result = {data, length, 0};
+		return result;
+	}
+};
+
+template <size_t N>
+constexpr mdns_name_literal_t<N>
+mdns_name_literal(const char (&str)[N]) {
+	return mdns_name_literal_t<N>(str);
+}
+
+#endif
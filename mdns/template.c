@@ -0,0 +1,234 @@
+/* template.c  -  mDNS library  -  Public Domain  -  2014 Mattias Jansson
+ *
+ * This library provides a cross-platform mDNS and DNS-SD library in C based
+ * on our foundation and network libraries. The implementation is based on RFC 6762
+ * and RFC 6763.
+ *
+ * The latest source code maintained by Mattias Jansson is always available at
+ *
+ * https://github.com/mjansson/mdns_lib
+ *
+ * The foundation and network library source code maintained by Mattias Jansson
+ * is always available at
+ *
+ * https://github.com/mjansson/foundation_lib
+ * https://github.com/mjansson/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify
+ * it without any restrictions.
+ *
+ */
+
+
+#include <mdns/mdns.h>
+#include <mdns/internal.h>
+#include <foundation/foundation.h>
+#include <network/network.h>
+
+// Class and TTL records without one are compiled with. They are patched when building, but must
+// differ from any explicit value so that TXT records are only coalesced if their class and TTL
+// are the same for every build
+#define MDNS_TEMPLATE_RCLASS_UNSET MDNS_CACHE_FLUSH
+#define MDNS_TEMPLATE_TTL_UNSET 0xFFFFFFFFU
+
+mdns_template_t*
+mdns_template_allocate(void) {
+	mdns_template_t* tpl = memory_allocate(HASH_MDNS, sizeof(mdns_template_t), 0, MEMORY_PERSISTENT);
+	mdns_template_initialize(tpl);
+	return tpl;
+}
+
+void
+mdns_template_deallocate(mdns_template_t* tpl) {
+	if (!tpl)
+		return;
+	mdns_template_finalize(tpl);
+	memory_deallocate(tpl);
+}
+
+void
+mdns_template_initialize(mdns_template_t* tpl) {
+	memset(tpl, 0, sizeof(mdns_template_t));
+}
+
+static void
+mdns_template_clear(mdns_template_t* tpl) {
+	size_t count = tpl->answer_count + tpl->authority_count + tpl->additional_count;
+	for (size_t irec = 0; irec < count; ++irec)
+		memory_deallocate(tpl->storage[irec]);
+	tpl->answer_count = 0;
+	tpl->authority_count = 0;
+	tpl->additional_count = 0;
+}
+
+void
+mdns_template_finalize(mdns_template_t* tpl) {
+	mdns_template_clear(tpl);
+	memset(tpl, 0, sizeof(mdns_template_t));
+}
+
+int
+mdns_template_set(mdns_template_t* tpl, const mdns_record_t* answer, size_t answer_count,
+                  const mdns_record_t* authority, size_t authority_count, const mdns_record_t* additional,
+                  size_t additional_count) {
+	if (answer_count + authority_count + additional_count > MDNS_TEMPLATE_RECORDS_MAX)
+		return -1;
+
+	mdns_template_clear(tpl);
+	size_t irec = 0;
+	for (size_t ians = 0; ians < answer_count; ++ians, ++irec)
+		tpl->storage[irec] = mdns_record_copy(tpl->record + irec, answer + ians);
+	for (size_t iauth = 0; iauth < authority_count; ++iauth, ++irec)
+		tpl->storage[irec] = mdns_record_copy(tpl->record + irec, authority + iauth);
+	for (size_t iadd = 0; iadd < additional_count; ++iadd, ++irec)
+		tpl->storage[irec] = mdns_record_copy(tpl->record + irec, additional + iadd);
+	tpl->answer_count = answer_count;
+	tpl->authority_count = authority_count;
+	tpl->additional_count = additional_count;
+	tpl->dirty = true;
+	return 0;
+}
+
+int
+mdns_template_update(mdns_template_t* tpl, size_t index, const mdns_record_t* record) {
+	if (index >= tpl->answer_count + tpl->authority_count + tpl->additional_count)
+		return -1;
+	char* storage = tpl->storage[index];
+	tpl->storage[index] = mdns_record_copy(tpl->record + index, record);
+	memory_deallocate(storage);
+	tpl->dirty = true;
+	return 0;
+}
+
+static bool
+mdns_template_txt_coalesce(const mdns_record_t* previous, const mdns_record_t* record) {
+	uint16_t mask = (uint16_t)(MDNS_CLASS_IN | MDNS_CACHE_FLUSH);
+	uint16_t previous_rclass = (previous->rclass ? previous->rclass : MDNS_TEMPLATE_RCLASS_UNSET) & mask;
+	uint16_t rclass = (record->rclass ? record->rclass : MDNS_TEMPLATE_RCLASS_UNSET) & mask;
+	uint32_t previous_ttl = previous->ttl ? previous->ttl : MDNS_TEMPLATE_TTL_UNSET;
+	uint32_t ttl = record->ttl ? record->ttl : MDNS_TEMPLATE_TTL_UNSET;
+	if ((previous_rclass != rclass) || (previous_ttl != ttl))
+		return false;
+	string_const_t previous_name = previous->name;
+	string_const_t name = record->name;
+	if (previous_name.length && (previous_name.str[previous_name.length - 1] == '.'))
+		--previous_name.length;
+	if (name.length && (name.str[name.length - 1] == '.'))
+		--name.length;
+	return (previous_name.length == name.length) && mdns_string_equal_nocase(previous_name.str, name.str, name.length);
+}
+
+// List the class and TTL source of each resource record in a section in the order written by
+// mdns_answer_build, where TXT records are written last and consecutive TXT records with the same
+// name, class and TTL are coalesced into one record
+static size_t
+mdns_template_section_patch(mdns_template_t* tpl, const mdns_record_t* records, size_t count, size_t ipatch) {
+	for (int txt = 0; txt < 2; ++txt) {
+		const mdns_record_t* previous = 0;
+		for (size_t irec = 0; irec < count; ++irec) {
+			const mdns_record_t* record = records + irec;
+			if ((record->type == MDNS_RECORDTYPE_TXT) != (txt != 0))
+				continue;
+			if (txt) {
+				if (previous && mdns_template_txt_coalesce(previous, record))
+					continue;
+				previous = record;
+			}
+			tpl->patch[ipatch].rclass = record->rclass;
+			tpl->patch[ipatch].ttl = record->ttl;
+			tpl->patch[ipatch].shared = (record->type == MDNS_RECORDTYPE_PTR);
+			++ipatch;
+		}
+	}
+	return ipatch;
+}
+
+// Encode the records and locate the class and TTL fields of each resource record with a cursor
+static int
+mdns_template_compile(mdns_template_t* tpl) {
+	const mdns_record_t* authority = tpl->record + tpl->answer_count;
+	const mdns_record_t* additional = authority + tpl->authority_count;
+	tpl->size = mdns_answer_build(tpl->data, sizeof(tpl->data), 0, MDNS_RECORDTYPE_IGNORE, 0, 0, tpl->record,
+	                              tpl->answer_count, authority, tpl->authority_count, additional,
+	                              tpl->additional_count, MDNS_TEMPLATE_RCLASS_UNSET, MDNS_TEMPLATE_TTL_UNSET, 0);
+	tpl->patched = false;
+	tpl->patch_count = 0;
+	if (!tpl->size)
+		return -1;
+
+	size_t patch_count = mdns_template_section_patch(tpl, tpl->record, tpl->answer_count, 0);
+	patch_count = mdns_template_section_patch(tpl, authority, tpl->authority_count, patch_count);
+	patch_count = mdns_template_section_patch(tpl, additional, tpl->additional_count, patch_count);
+
+	mdns_packet_cursor_t cursor;
+	mdns_packet_entry_t entry;
+	mdns_packet_cursor_initialize(&cursor, 0, tpl->data, tpl->size);
+	size_t ipatch = 0;
+	while (mdns_packet_cursor_next(&cursor, &entry)) {
+		if (entry.section == MDNS_ENTRYTYPE_QUESTION)
+			continue;
+		if (ipatch >= patch_count)
+			return -1;
+		// Class, TTL and data length fields precede the record data
+		tpl->patch[ipatch++].offset = (uint16_t)(entry.record_offset - 8);
+	}
+	if (cursor.error || (ipatch != patch_count)) {
+		tpl->size = 0;
+		return -1;
+	}
+
+	tpl->patch_count = patch_count;
+	tpl->dirty = false;
+	++tpl->compiled;
+	return 0;
+}
+
+// Compile the template if changed, then patch the query ID, and the class and TTL fields if they
+// differ from the last build
+static size_t
+mdns_template_prepare(mdns_template_t* tpl, uint16_t query_id, uint16_t rclass, uint32_t ttl) {
+	if (tpl->dirty && (mdns_template_compile(tpl) < 0))
+		return 0;
+	if (!tpl->size)
+		return 0;
+
+	struct mdns_header_t* header = (struct mdns_header_t*)tpl->data;
+	header->query_id = htons(query_id);
+	if (tpl->patched && (tpl->patched_rclass == rclass) && (tpl->patched_ttl == ttl))
+		return tpl->size;
+
+	// Same rules as mdns_record_update_rclass_ttl when building answers
+	for (size_t ipatch = 0; ipatch < tpl->patch_count; ++ipatch) {
+		const mdns_template_patch_t* patch = tpl->patch + ipatch;
+		uint16_t record_rclass = patch->rclass ? patch->rclass : rclass;
+		uint32_t record_ttl = (patch->ttl && ttl) ? patch->ttl : ttl;
+		record_rclass &= (uint16_t)(MDNS_CLASS_IN | MDNS_CACHE_FLUSH);
+		if (patch->shared)
+			record_rclass &= ~(uint16_t)MDNS_CACHE_FLUSH;
+		void* field = pointer_offset(tpl->data, patch->offset);
+		field = mdns_htons(field, record_rclass);
+		mdns_htonl(field, record_ttl);
+	}
+	tpl->patched_rclass = rclass;
+	tpl->patched_ttl = ttl;
+	tpl->patched = true;
+	return tpl->size;
+}
+
+size_t
+mdns_template_build(mdns_template_t* tpl, void* buffer, size_t capacity, uint16_t query_id, uint16_t rclass,
+                    uint32_t ttl) {
+	size_t size = mdns_template_prepare(tpl, query_id, rclass, ttl);
+	if (!size || (size > capacity))
+		return 0;
+	memcpy(buffer, tpl->data, size);
+	return size;
+}
+
+int
+mdns_template_send(mdns_template_t* tpl, socket_t* sock, uint16_t query_id, uint16_t rclass, uint32_t ttl) {
+	size_t size = mdns_template_prepare(tpl, query_id, rclass, ttl);
+	if (!size)
+		return -1;
+	return mdns_multicast_send(sock, tpl->data, size);
+}
@@ -0,0 +1,72 @@
+/* template.h  -  mDNS library  -  Public Domain  -  2014 Mattias Jansson
+ *
+ * This library provides a cross-platform mDNS and DNS-SD library in C based
+ * on our foundation and network libraries. The implementation is based on RFC 6762
+ * and RFC 6763.
+ *
+ * The latest source code maintained by Mattias Jansson is always available at
+ *
+ * https://github.com/mjansson/mdns_lib
+ *
+ * The foundation and network library source code maintained by Mattias Jansson
+ * is always available at
+ *
+ * https://github.com/mjansson/foundation_lib
+ * https://github.com/mjansson/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify
+ * it without any restrictions.
+ *
+ */
+
+
+#pragma once
+
+#include <foundation/platform.h>
+#include <network/types.h>
+
+#include <mdns/types.h>
+
+//! Allocate an empty answer template
+MDNS_API mdns_template_t*
+mdns_template_allocate(void);
+
+//! Finalize and deallocate an answer template
+MDNS_API void
+mdns_template_deallocate(mdns_template_t* tpl);
+
+//! Initialize an empty answer template
+MDNS_API void
+mdns_template_initialize(mdns_template_t* tpl);
+
+//! Finalize an answer template, releasing all records
+MDNS_API void
+mdns_template_finalize(mdns_template_t* tpl);
+
+//! Set copies of the answer, authority and additional records of the template, up to
+//! MDNS_TEMPLATE_RECORDS_MAX in total. The template is compiled again on the next build.
+//! Returns 0 if success, <0 if too many records
+MDNS_API int
+mdns_template_set(mdns_template_t* tpl, const mdns_record_t* answer, size_t answer_count,
+                  const mdns_record_t* authority, size_t authority_count, const mdns_record_t* additional,
+                  size_t additional_count);
+
+//! Replace the record with the given index, counting answer, authority and additional records in
+//! order. The template is compiled again on the next build. Returns 0 if success, <0 if error
+MDNS_API int
+mdns_template_update(mdns_template_t* tpl, size_t index, const mdns_record_t* record);
+
+//! Build a multicast answer from the template in the given buffer, identical to the answer built by
+//! mdns_query_answer_multicast_build (class MDNS_CLASS_IN, TTL 60), mdns_announce_multicast_build
+//! (class MDNS_CLASS_IN | MDNS_CACHE_FLUSH, TTL 60) or mdns_goodbye_multicast_build (TTL 0) with the
+//! given class and TTL. The records are only encoded when the template changed, otherwise the
+//! template is copied with the query ID, class and TTL fields patched. Returns the size of the
+//! packet, or 0 if error
+MDNS_API size_t
+mdns_template_build(mdns_template_t* tpl, void* buffer, size_t capacity, uint16_t query_id, uint16_t rclass,
+                    uint32_t ttl);
+
+//! Send a multicast answer from the template like mdns_template_build, directly from the template
+//! data without copying. Returns 0 if success, or <0 if error
+MDNS_API int
+mdns_template_send(mdns_template_t* tpl, socket_t* sock, uint16_t query_id, uint16_t rclass, uint32_t ttl);
@@ -0,0 +1,155 @@
+/* txt.c  -  mDNS library  -  Public Domain  -  2014 Mattias Jansson
+ *
+ * This library provides a cross-platform mDNS and DNS-SD library in C based
+ * on our foundation and network libraries. The implementation is based on RFC 6762
+ * and RFC 6763.
+ *
+ * The latest source code maintained by Mattias Jansson is always available at
+ *
+ * https://github.com/mjansson/mdns_lib
+ *
+ * The foundation and network library source code maintained by Mattias Jansson
+ * is always available at
+ *
+ * https://github.com/mjansson/foundation_lib
+ * https://github.com/mjansson/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify
+ * it without any restrictions.
+ *
+ */
+
+
+#include <mdns/mdns.h>
+#include <foundation/foundation.h>
+
+void
+mdns_txt_initialize(mdns_txt_t* txt) {
+	txt->count = 0;
+	// Empty TXT record data is a single empty string
+	txt->size = 1;
+	txt->data[0] = 0;
+}
+
+int
+mdns_txt_find(const mdns_txt_t* txt, const char* key, size_t key_length) {
+	for (size_t ientry = 0; ientry < txt->count; ++ientry) {
+		const mdns_txt_entry_t* entry = txt->entry + ientry;
+		if ((entry->key_length == key_length) &&
+		    mdns_string_equal_nocase(txt->data + entry->offset + 1, key, key_length))
+			return (int)ientry;
+	}
+	return -1;
+}
+
+// Resize the string of the given entry in place, moving the strings after it and their offsets
+static void
+mdns_txt_resize(mdns_txt_t* txt, size_t index, size_t length) {
+	mdns_txt_entry_t* entry = txt->entry + index;
+	size_t old_end = entry->offset + 1 + txt->data[entry->offset];
+	size_t new_end = entry->offset + 1 + length;
+	if (new_end != old_end) {
+		memmove(txt->data + new_end, txt->data + old_end, txt->size - old_end);
+		txt->size = txt->size + new_end - old_end;
+		for (size_t ientry = index + 1; ientry < txt->count; ++ientry)
+			txt->entry[ientry].offset = (uint16_t)(txt->entry[ientry].offset + new_end - old_end);
+	}
+	txt->data[entry->offset] = (uint8_t)length;
+}
+
+int
+mdns_txt_set(mdns_txt_t* txt, const char* key, size_t key_length, const char* value, size_t value_length) {
+	if (!key_length || memchr(key, '=', key_length))
+		return -1;
+	size_t length = key_length + (value ? value_length + 1 : 0);
+	if (length > 0xFF)
+		return -1;
+
+	int index = mdns_txt_find(txt, key, key_length);
+	bool added = (index < 0);
+	if (added) {
+		if (txt->count >= MDNS_TXT_ENTRIES_MAX)
+			return -1;
+		// The single empty string of an empty blob is replaced by the first string
+		size_t offset = txt->count ? txt->size : 0;
+		if (offset + 1 + length > MDNS_TXT_SIZE)
+			return -1;
+		index = (int)txt->count++;
+		txt->entry[index].offset = (uint16_t)offset;
+		txt->data[offset] = 0;
+		txt->size = offset + 1;
+	} else {
+		const mdns_txt_entry_t* entry = txt->entry + index;
+		if (txt->size - txt->data[entry->offset] + length > MDNS_TXT_SIZE)
+			return -1;
+	}
+
+	mdns_txt_entry_t* entry = txt->entry + index;
+	entry->key_length = (uint8_t)key_length;
+	mdns_txt_resize(txt, (size_t)index, length);
+	// An existing key keeps its spelling, only the value is written
+	uint8_t* str = txt->data + entry->offset + 1;
+	if (added)
+		memcpy(str, key, key_length);
+	if (value) {
+		str[key_length] = '=';
+		if (value_length)
+			memcpy(str + key_length + 1, value, value_length);
+	}
+	return 0;
+}
+
+int
+mdns_txt_remove(mdns_txt_t* txt, const char* key, size_t key_length) {
+	int index = mdns_txt_find(txt, key, key_length);
+	if (index < 0)
+		return -1;
+
+	size_t offset = txt->entry[index].offset;
+	size_t length = 1 + (size_t)txt->data[offset];
+	memmove(txt->data + offset, txt->data + offset + length, txt->size - offset - length);
+	txt->size -= length;
+	--txt->count;
+	for (size_t ientry = (size_t)index; ientry < txt->count; ++ientry) {
+		txt->entry[ientry] = txt->entry[ientry + 1];
+		txt->entry[ientry].offset = (uint16_t)(txt->entry[ientry].offset - length);
+	}
+	if (!txt->count)
+		mdns_txt_initialize(txt);
+	return 0;
+}
+
+string_const_t
+mdns_txt_value(const mdns_txt_t* txt, int index) {
+	string_const_t value = {0, 0};
+	if ((index < 0) || ((size_t)index >= txt->count))
+		return value;
+	const mdns_txt_entry_t* entry = txt->entry + index;
+	size_t length = txt->data[entry->offset];
+	if (length > entry->key_length) {
+		value.str = (const char*)txt->data + entry->offset + 1 + entry->key_length + 1;
+		value.length = length - entry->key_length - 1;
+	}
+	return value;
+}
+
+const void*
+mdns_txt_data(const mdns_txt_t* txt) {
+	return txt->data;
+}
+
+size_t
+mdns_txt_size(const mdns_txt_t* txt) {
+	return txt->size;
+}
+
+mdns_record_t
+mdns_txt_record(const mdns_txt_t* txt, const char* name, size_t length) {
+	mdns_record_t record;
+	memset(&record, 0, sizeof(record));
+	record.name = string_const(name, length);
+	record.type = MDNS_RECORDTYPE_TXT;
+	record.data.txt.value = string_const((const char*)txt->data, txt->size);
+	record.data.txt.blob = true;
+	return record;
+}
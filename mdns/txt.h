@@ -0,0 +1,66 @@
+/* txt.h  -  mDNS library  -  Public Domain  -  2014 Mattias Jansson
+ *
+ * This library provides a cross-platform mDNS and DNS-SD library in C based
+ * on our foundation and network libraries. The implementation is based on RFC 6762
+ * and RFC 6763.
+ *
+ * The latest source code maintained by Mattias Jansson is always available at
+ *
+ * https://github.com/mjansson/mdns_lib
+ *
+ * The foundation and network library source code maintained by Mattias Jansson
+ * is always available at
+ *
+ * https://github.com/mjansson/foundation_lib
+ * https://github.com/mjansson/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify
+ * it without any restrictions.
+ *
+ */
+
+
+#pragma once
+
+#include <foundation/platform.h>
+
+#include <mdns/types.h>
+
+//! Initialize an empty TXT blob. The blob holds key/value pairs encoded once in TXT record wire
+//! format, with an index of the string offsets, so it can be sent without encoding
+MDNS_API void
+mdns_txt_initialize(mdns_txt_t* txt);
+
+//! Set the value of a key, adding the key if not present. Keys are compared case insensitive
+//! (RFC 6763 section 6.4) and an existing key keeps its spelling. A null value sets a boolean
+//! attribute written as the key only, while an empty value is written as "key=". Only the string of
+//! the given key is encoded, following strings are moved if the length changes. Returns 0 if success,
+//! <0 if the key is empty or contains '=', if the string exceeds 255 bytes or if the blob is full
+MDNS_API int
+mdns_txt_set(mdns_txt_t* txt, const char* key, size_t key_length, const char* value, size_t value_length);
+
+//! Remove a key. Returns 0 if success, <0 if the key is not present
+MDNS_API int
+mdns_txt_remove(mdns_txt_t* txt, const char* key, size_t key_length);
+
+//! Find a key. Returns the entry index, or <0 if the key is not present
+MDNS_API int
+mdns_txt_find(const mdns_txt_t* txt, const char* key, size_t key_length);
+
+//! Get the value of the entry with the given index. A boolean attribute has a null value
+MDNS_API string_const_t
+mdns_txt_value(const mdns_txt_t* txt, int index);
+
+//! Get the TXT record data in wire format. An empty blob is a single empty string (RFC 6763 section 6.1)
+MDNS_API const void*
+mdns_txt_data(const mdns_txt_t* txt);
+
+//! Get the size of the TXT record data in wire format
+MDNS_API size_t
+mdns_txt_size(const mdns_txt_t* txt);
+
+//! Get a TXT record with the given name carrying the blob data and the blob flag set, to pass to
+//! answer and builder functions which copy the data as is. The record refers to the blob, which must
+//! not change while the record is in use
+MDNS_API mdns_record_t
+mdns_txt_record(const mdns_txt_t* txt, const char* name, size_t length);
@@ -31,6 +31,7 @@
 #define MDNS_PORT 5353
 #define MDNS_UNICAST_RESPONSE 0x8000U
 #define MDNS_CACHE_FLUSH 0x8000U
+#define MDNS_FLAG_TRUNCATED 0x0200U
 #define MDNS_MAX_SUBSTRINGS 64
 
 enum mdns_record_type {
@@ -59,24 +60,106 @@ enum mdns_entry_type {
 
 enum mdns_class { MDNS_CLASS_IN = 1, MDNS_CLASS_ANY = 255 };
 
+enum mdns_loop_receive {
+	// Incoming queries parsed with mdns_service_parse
+	MDNS_LOOP_SERVICE = 0,
+	// Query responses parsed with mdns_query_parse
+	MDNS_LOOP_QUERY = 1,
+	// DNS-SD responses parsed with mdns_discovery_parse
+	MDNS_LOOP_DISCOVERY = 2
+};
+
+enum mdns_stat {
+	// Datagrams and bytes received
+	MDNS_STAT_PACKETS_IN = 0,
+	MDNS_STAT_BYTES_IN,
+	// Datagrams and bytes sent
+	MDNS_STAT_PACKETS_OUT,
+	MDNS_STAT_BYTES_OUT,
+	// Datagrams that failed to send
+	MDNS_STAT_SEND_FAILED,
+	// Questions parsed from received packets
+	MDNS_STAT_QUESTIONS,
+	// Answer, authority and additional records parsed from received packets by type
+	MDNS_STAT_RECORDS_A,
+	MDNS_STAT_RECORDS_AAAA,
+	MDNS_STAT_RECORDS_PTR,
+	MDNS_STAT_RECORDS_SRV,
+	MDNS_STAT_RECORDS_TXT,
+	MDNS_STAT_RECORDS_OTHER,
+	// Packets shorter than the header
+	MDNS_STAT_ERROR_HEADER,
+	// Records extending past the end of the packet
+	MDNS_STAT_ERROR_TRUNCATED,
+	// Names or compression pointers reaching past the end of the packet
+	MDNS_STAT_ERROR_NAME_BOUNDS,
+	// Names with too many labels, such as compression pointer loops
+	MDNS_STAT_ERROR_NAME_LOOP,
+	// Answers left out of responses since the querier listed them as known answers, counted globally only
+	MDNS_STAT_ANSWERS_SUPPRESSED,
+	// Answers left out of split responses since they do not fit in a packet on their own
+	MDNS_STAT_ANSWERS_DROPPED,
+	MDNS_STAT_COUNT
+};
+
 typedef enum mdns_record_type mdns_record_type_t;
 typedef enum mdns_entry_type mdns_entry_type_t;
 typedef enum mdns_class mdns_class_t;
+typedef enum mdns_loop_receive mdns_loop_receive_t;
+typedef enum mdns_stat mdns_stat_t;
 
 typedef int (*mdns_record_callback_fn)(socket_t* sock, const network_address_t* from, mdns_entry_type_t entry,
                                        uint16_t query_id, uint16_t rtype, uint16_t rclass, uint32_t ttl,
                                        const void* data, size_t size, size_t name_offset, size_t name_length,
                                        size_t record_offset, size_t record_length, void* user_data);
 
+typedef struct mdns_loop_t mdns_loop_t;
+typedef struct mdns_loop_socket_t mdns_loop_socket_t;
+typedef struct mdns_loop_timer_t mdns_loop_timer_t;
+
+typedef void (*mdns_loop_timer_fn)(mdns_loop_t* loop, int timer, void* user_data);
+
+typedef struct mdns_builder_t mdns_builder_t;
+typedef struct mdns_builder_mark_t mdns_builder_mark_t;
+
+typedef int (*mdns_builder_flush_fn)(const void* buffer, size_t size, void* user_data);
+
 typedef struct mdns_config_t mdns_config_t;
 typedef struct mdns_string_pair_t mdns_string_pair_t;
 typedef struct mdns_string_table_t mdns_string_table_t;
+typedef struct mdns_string_table_entry_t mdns_string_table_entry_t;
+typedef struct mdns_name_t mdns_name_t;
+typedef struct mdns_string_context_t mdns_string_context_t;
+typedef struct mdns_string_context_entry_t mdns_string_context_entry_t;
 typedef struct mdns_record_t mdns_record_t;
 typedef struct mdns_record_srv_t mdns_record_srv_t;
 typedef struct mdns_record_ptr_t mdns_record_ptr_t;
 typedef struct mdns_record_a_t mdns_record_a_t;
 typedef struct mdns_record_aaaa_t mdns_record_aaaa_t;
 typedef struct mdns_record_txt_t mdns_record_txt_t;
+typedef struct mdns_record_txt_index_t mdns_record_txt_index_t;
+typedef struct mdns_datagram_t mdns_datagram_t;
+typedef struct mdns_batch_stats_t mdns_batch_stats_t;
+typedef struct mdns_split_stats_t mdns_split_stats_t;
+typedef struct mdns_send_entry_t mdns_send_entry_t;
+typedef struct mdns_packet_cursor_t mdns_packet_cursor_t;
+typedef struct mdns_packet_entry_t mdns_packet_entry_t;
+typedef struct mdns_packet_index_t mdns_packet_index_t;
+typedef struct mdns_packet_index_entry_t mdns_packet_index_entry_t;
+typedef struct mdns_send_queue_t mdns_send_queue_t;
+typedef struct mdns_store_t mdns_store_t;
+typedef struct mdns_store_entry_t mdns_store_entry_t;
+typedef struct mdns_store_pending_t mdns_store_pending_t;
+typedef struct mdns_query_t mdns_query_t;
+typedef struct mdns_cache_t mdns_cache_t;
+typedef struct mdns_querier_t mdns_querier_t;
+typedef struct mdns_querier_question_t mdns_querier_question_t;
+typedef struct mdns_template_t mdns_template_t;
+typedef struct mdns_template_patch_t mdns_template_patch_t;
+typedef struct mdns_cache_entry_t mdns_cache_entry_t;
+typedef struct mdns_txt_t mdns_txt_t;
+typedef struct mdns_txt_entry_t mdns_txt_entry_t;
+typedef struct mdns_stats_t mdns_stats_t;
 
 #ifdef _WIN32
 typedef int mdns_size_t;
@@ -96,10 +179,60 @@ struct mdns_string_pair_t {
 	int ref;
 };
 
+//! Name in wire format, uncompressed length-prefixed labels ending with the root label
+struct mdns_name_t {
+	//! Encoded labels
+	const void* data;
+	//! Encoded length including the root label
+	size_t length;
+	//! Hash as computed by mdns_string_hash, zero until computed by mdns_name_hash
+	hash_t hash;
+};
+
+//! Name suffix written to a packet
+struct mdns_string_table_entry_t {
+	//! Low 32 bits of the case-insensitive hash of the suffix, as computed by mdns_string_hash
+	uint32_t hash;
+	//! Offset of the suffix in the packet
+	uint16_t offset;
+	//! Next entry in the bucket chain as index + 1, zero terminates
+	uint16_t next;
+};
+
+//! Compression dictionary of name suffixes written to a packet, hashed on suffix. Entries are
+//! only valid up to count, initialize with mdns_string_table_initialize. Sized for the suffixes
+//! of a full 9000 byte jumbo packet, suffixes past the size are not compressed. Entries keep the
+//! low 32 bits of the suffix hash to keep the table at about 9 KiB
 struct mdns_string_table_t {
-	size_t offset[16];
+	uint16_t bucket[MDNS_STRING_TABLE_BUCKETS];
+	size_t count;
+	mdns_string_table_entry_t entry[MDNS_STRING_TABLE_SIZE];
+};
+
+//! Decoded name suffix at a compression pointer target
+struct mdns_string_context_entry_t {
+	//! Offset of the suffix in the packet
+	uint16_t offset;
+	//! Offset of the decoded text in the context text pool
+	uint16_t text_offset;
+	//! Length of the decoded text, including trailing dots
+	uint16_t text_length;
+	//! Hash of the decoded name, see mdns_string_hash
+	hash_t hash;
+	//! Next entry in the same offset bucket as index + 1, zero if last
+	uint16_t next;
+};
+
+//! Per-packet name decode context, memoizing every resolved compression pointer target
+struct mdns_string_context_t {
+	const void* buffer;
+	size_t size;
 	size_t count;
-	size_t next;
+	size_t text_used;
+	//! Buckets indexed by suffix offset, holding the last resolved entry as index + 1
+	uint16_t bucket[MDNS_STRING_CONTEXT_BUCKETS];
+	mdns_string_context_entry_t entry[MDNS_STRING_CONTEXT_SIZE];
+	char text[MDNS_STRING_CONTEXT_TEXT_SIZE];
 };
 
 struct mdns_record_srv_t {
@@ -124,6 +257,14 @@ struct mdns_record_aaaa_t {
 struct mdns_record_txt_t {
 	string_const_t key;
 	string_const_t value;
+	// Set if value holds pre-encoded TXT record data as built by mdns_txt_record, key is then ignored
+	bool blob;
+};
+
+struct mdns_record_txt_index_t {
+	// Key and value of each indexed string in record order
+	size_t count;
+	mdns_record_txt_t entry[MDNS_RECORD_TXT_INDEX_MAX];
 };
 
 struct mdns_record_t {
@@ -140,6 +281,365 @@ struct mdns_record_t {
 	uint32_t ttl;
 };
 
+struct mdns_query_t {
+	mdns_record_type_t type;
+	const char* name;
+	size_t length;
+};
+
+struct mdns_datagram_t {
+	// Receive buffer and capacity, buffer must be 32 bit aligned
+	void* buffer;
+	size_t capacity;
+	// Number of bytes received
+	size_t size;
+	// Source address, points into address storage below
+	const network_address_t* from;
+	union mdns_datagram_address {
+		network_address_ipv4_t ipv4;
+		network_address_ipv6_t ipv6;
+	} address;
+};
+
+struct mdns_batch_stats_t {
+	// Number of receive system calls made
+	size_t calls;
+	// Number of datagrams received
+	size_t datagrams;
+	// Number of records parsed
+	size_t records;
+};
+
+struct mdns_split_stats_t {
+	// Number of answers in packets successfully passed to the flush callback
+	size_t answers;
+	// Number of answers dropped since they do not fit in a packet on their own
+	size_t dropped;
+	// Result of the failing flush callback call, zero if all packets were flushed
+	int error;
+};
+
+struct mdns_send_entry_t {
+	socket_t* sock;
+	// Packet data, must remain valid until the queue is flushed
+	const void* buffer;
+	size_t size;
+	struct sockaddr_storage addr;
+	socklen_t addrlen;
+	// Result of send, 0 if success or <0 if error (or not yet flushed)
+	int result;
+};
+
+struct mdns_send_queue_t {
+	mdns_send_entry_t* entry;
+	size_t capacity;
+	size_t count;
+	// Index of first entry not yet flushed
+	size_t pending;
+	// Total number of packets sent and failed
+	size_t sent;
+	size_t failed;
+	// Number of send system calls made
+	size_t calls;
+};
+
+struct mdns_store_entry_t {
+	mdns_record_t record;
+	// Hash of record name and of PTR or SRV target name, see mdns_string_hash
+	hash_t name_hash;
+	hash_t target_hash;
+	// Owned copy of the record strings
+	char* storage;
+	// Bucket chain links as index + 1, zero terminates. Free entries are linked through next
+	uint32_t next;
+	uint32_t prev;
+	bool used;
+};
+
+struct mdns_store_pending_t {
+	// Socket owed the multicast response, null if slot is unused
+	socket_t* sock;
+	tick_t deadline;
+	// Loop timer flushing the response, <0 if none
+	int timer;
+	// Number of questions merged into the response and packets sent for it, kept across early flushes
+	size_t responses;
+	size_t packets;
+	// Answer records owed, as store handles
+	int answer[MDNS_STORE_ANSWER_MAX];
+	size_t answer_count;
+};
+
+struct mdns_store_t {
+	mdns_store_entry_t* entry;
+	size_t capacity;
+	size_t count;
+	// Head of free entry list as index + 1
+	uint32_t free;
+	// Buckets indexed by hash of name and type, holding first chain entry as index + 1
+	uint32_t* bucket;
+	size_t bucket_mask;
+	// Number of questions answered and answer records sent
+	size_t answered;
+	size_t answer_records;
+	// Pending aggregated multicast responses per socket, and the loop used to schedule them
+	mdns_store_pending_t pending[MDNS_STORE_PENDING_SOCKETS];
+	mdns_loop_t* loop;
+	// Number of multicast responses scheduled, aggregated packets sent and packets saved by aggregation
+	size_t responses;
+	size_t packets;
+	size_t packets_saved;
+	// Buffer for building responses
+	uint32_t buffer[MDNS_STORE_BUFFER_SIZE / 4];
+};
+
+struct mdns_cache_entry_t {
+	// Record with owned strings, TTL is the TTL as received
+	mdns_record_t record;
+	char* storage;
+	// Hash of record name and of record data
+	hash_t name_hash;
+	hash_t data_hash;
+	// Cache time in seconds when record was received and when it expires
+	uint32_t received;
+	uint32_t expire;
+	// Cache time in seconds of next maintenance query, zero if none, and number of queries scheduled
+	uint32_t refresh;
+	uint8_t refresh_step;
+	// Bucket chain links as index + 1, zero terminates. Free entries are linked through next
+	uint32_t next;
+	uint32_t prev;
+	// Timer wheel slot list links as index + 1, and slot holding the entry
+	uint32_t wheel_next;
+	uint32_t wheel_prev;
+	uint16_t wheel_slot;
+	bool used;
+};
+
+struct mdns_cache_t {
+	mdns_cache_entry_t* entry;
+	size_t capacity;
+	size_t count;
+	// Head of free entry list as index + 1
+	uint32_t free;
+	// Buckets indexed by hash of name and type, holding first chain entry as index + 1
+	uint32_t* bucket;
+	size_t bucket_mask;
+	// Hierarchical timer wheel of entry expiry and refresh, each level slot holds first entry as
+	// index + 1. Level n slots span 2^(n*MDNS_CACHE_WHEEL_BITS) seconds
+	uint32_t wheel[MDNS_CACHE_WHEEL_LEVELS << MDNS_CACHE_WHEEL_BITS];
+	// Maintenance queries enabled, and handles of records due for a query
+	bool refresh;
+	uint32_t refresh_due[MDNS_CACHE_REFRESH_MAX];
+	size_t refresh_count;
+	// Current cache time in seconds, and the tick it was last advanced to wall clock
+	uint32_t time;
+	tick_t base;
+	// Number of records inserted, refreshed, expired and evicted, and maintenance queries sent
+	size_t inserted;
+	size_t refreshed;
+	size_t expired;
+	size_t evicted;
+	size_t queried;
+};
+
+struct mdns_querier_question_t {
+	mdns_record_type_t type;
+	hash_t name_hash;
+	// Number of callers sharing the question, zero if slot is unused
+	unsigned int references;
+	// Current interval in seconds, zero until first sent
+	unsigned int interval;
+	// Tick when next due and when last sent
+	tick_t deadline;
+	tick_t sent;
+	size_t length;
+	char name[256];
+};
+
+struct mdns_querier_t {
+	mdns_querier_question_t question[MDNS_QUERIER_QUESTIONS_MAX];
+	// Event loop with timer sending due questions on the socket, <0 timer if none
+	mdns_loop_t* loop;
+	int timer;
+	socket_t* sock;
+	void* buffer;
+	size_t capacity;
+	// Number of questions and packets sent, and number of back-off resets
+	size_t queries;
+	size_t packets;
+	size_t resets;
+};
+
+struct mdns_builder_t {
+	// Caller buffer holding the packet, and current packet size
+	void* buffer;
+	size_t capacity;
+	size_t size;
+	// Section currently being added to, entries can not be added to an earlier section
+	mdns_entry_type_t section;
+	// Number of entries in each section, indexed by mdns_entry_type_t
+	uint16_t count[4];
+	// Offset of the data length field of the last record if it is a TXT record, zero otherwise, and
+	// offset of its name. Following TXT records with the same name, class and TTL are appended to it
+	size_t txt_length_offset;
+	size_t txt_name_offset;
+	// Compression dictionary shared by all names in the packet
+	mdns_string_table_t string_table;
+	// Query ID and flags written in the header of each packet
+	uint16_t query_id;
+	uint16_t flags;
+	// Callback receiving each completed packet when splitting, null if not splitting. If truncate is
+	// set the TC bit is set in all packets but the last
+	mdns_builder_flush_fn flush;
+	void* flush_data;
+	bool truncate;
+	// Number of packets passed to the flush callback
+	size_t packets;
+};
+
+struct mdns_builder_mark_t {
+	size_t size;
+	size_t string_count;
+	mdns_entry_type_t section;
+	uint16_t count[4];
+	size_t txt_length_offset;
+	size_t txt_name_offset;
+	uint16_t txt_length;
+};
+
+struct mdns_txt_entry_t {
+	// Offset of the string length byte in the blob data, and length of the key starting the string
+	uint16_t offset;
+	uint8_t key_length;
+};
+
+struct mdns_txt_t {
+	// Number of key/value strings, with the index of each string in data order
+	size_t count;
+	mdns_txt_entry_t entry[MDNS_TXT_ENTRIES_MAX];
+	// TXT record data in wire format, length prefixed key=value strings
+	size_t size;
+	uint8_t data[MDNS_TXT_SIZE];
+};
+
+struct mdns_stats_t {
+	// Counter values indexed by mdns_stat_t
+	uint64_t counter[MDNS_STAT_COUNT];
+};
+
+struct mdns_template_patch_t {
+	// Offset of the class field in the template, followed by the TTL field
+	uint16_t offset;
+	// Class and TTL set in the record, zero if the class and TTL given when building apply
+	uint16_t rclass;
+	uint32_t ttl;
+	// PTR records never have the cache flush bit set
+	bool shared;
+};
+
+struct mdns_template_t {
+	// Owned copies of answer, authority and additional records, in order
+	mdns_record_t record[MDNS_TEMPLATE_RECORDS_MAX];
+	char* storage[MDNS_TEMPLATE_RECORDS_MAX];
+	size_t answer_count;
+	size_t authority_count;
+	size_t additional_count;
+	// Set when a record changed and the template must be compiled again
+	bool dirty;
+	size_t size;
+	// Class and TTL fields of each resource record in the template
+	mdns_template_patch_t patch[MDNS_TEMPLATE_RECORDS_MAX];
+	size_t patch_count;
+	// Class and TTL currently patched into the template
+	uint16_t patched_rclass;
+	uint32_t patched_ttl;
+	bool patched;
+	// Number of times the template was compiled
+	size_t compiled;
+	uint32_t data[MDNS_TEMPLATE_SIZE / 4];
+};
+
+struct mdns_packet_entry_t {
+	mdns_entry_type_t section;
+	uint16_t rtype;
+	uint16_t rclass;
+	uint32_t ttl;
+	// Offset and length of name in packet, name can be compressed
+	size_t name_offset;
+	size_t name_length;
+	// Offset and length of record data in packet. For questions this is the name.
+	size_t record_offset;
+	size_t record_length;
+};
+
+struct mdns_packet_cursor_t {
+	const void* buffer;
+	size_t size;
+	// Socket the packet was received on, parse errors are also counted for it. Null if not known
+	socket_t* sock;
+	size_t offset;
+	uint16_t query_id;
+	uint16_t flags;
+	// Remaining entries in each section, indexed by mdns_entry_type_t
+	uint16_t remain[4];
+	// Set to <0 if a malformed entry was encountered
+	int error;
+};
+
+struct mdns_packet_index_entry_t {
+	uint16_t name_offset;
+	uint16_t name_length;
+	// For questions the record is the name
+	uint16_t record_offset;
+	uint16_t record_length;
+	uint16_t rtype;
+	uint16_t rclass;
+	uint32_t ttl;
+	uint8_t section;
+};
+
+struct mdns_packet_index_t {
+	const void* buffer;
+	size_t size;
+	// Socket the packet was received on, parse errors are also counted for it. Null if not known
+	socket_t* sock;
+	uint16_t query_id;
+	uint16_t flags;
+	// Number of entries in each section, indexed by mdns_entry_type_t
+	uint16_t count[4];
+	size_t entry_count;
+	mdns_packet_index_entry_t entry[MDNS_PACKET_INDEX_MAX];
+};
+
+struct mdns_loop_socket_t {
+	socket_t* sock;
+	mdns_loop_receive_t receive;
+	void* buffer;
+	size_t capacity;
+	// The buffer is split in slots each receiving one datagram of a batch
+	size_t slot_count;
+	size_t slot_size;
+	mdns_record_callback_fn callback;
+	void* user_data;
+};
+
+struct mdns_loop_timer_t {
+	tick_t deadline;
+	mdns_loop_timer_fn callback;
+	void* user_data;
+	// Incremented each time the slot is armed and kept when cleared, so stale identifiers are ignored
+	unsigned int generation;
+};
+
+struct mdns_loop_t {
+	// epoll file descriptor where available, otherwise -1
+	int fd;
+	bool terminate;
+	mdns_loop_socket_t socket[MDNS_LOOP_SOCKETS_MAX];
+	mdns_loop_timer_t timer[MDNS_LOOP_TIMERS_MAX];
+};
+
 struct mdns_header_t {
 	uint16_t query_id;
 	uint16_t flags;
@@ -181,6 +181,10 @@ main_initialize(void) {
 #if BUILD_MONOLITHIC
 extern int
 test_dnssd_run(void);
+extern int
+test_literal_run(void);
+extern int
+test_packet_run(void);
 typedef int (*test_run_fn)(void);
 
 static void*
@@ -257,7 +261,7 @@ main_run(void* main_arg) {
 
 #if BUILD_MONOLITHIC
 
-	test_run_fn tests[] = {test_dnssd_run, 0};
+	test_run_fn tests[] = {test_dnssd_run, test_literal_run, test_packet_run, 0};
 
 #if FOUNDATION_PLATFORM_ANDROID
 
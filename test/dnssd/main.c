@@ -74,11 +74,15 @@ query_callback(socket_t* sock, const network_address_t* from, mdns_entry_type_t
 	char addrbuffer[NETWORK_ADDRESS_NUMERIC_MAX_LENGTH];
 	char FOUNDATION_ALIGN(8) namebuffer[256];
 	FOUNDATION_UNUSED(sock);
-	FOUNDATION_UNUSED(entry);
-	FOUNDATION_UNUSED(user_data);
 	FOUNDATION_UNUSED(name_length);
 	FOUNDATION_UNUSED(name_offset);
 	FOUNDATION_UNUSED(query_id);
+	if (entry == MDNS_ENTRYTYPE_END) {
+		// Complete response received, end the one-shot query
+		if (user_data)
+			mdns_loop_break(user_data);
+		return 0;
+	}
 	string_t fromaddrstr = network_address_to_string(addrbuffer, sizeof(addrbuffer), from, true);
 	const char* entrytype = (entry == MDNS_ENTRYTYPE_ANSWER) ?
 	                            "answer" :
@@ -154,20 +158,21 @@ DECLARE_TEST(dnssd, discover) {
 	}
 	EXPECT_GT(sock_bound_count, 0);
 
+	mdns_loop_t* loop = mdns_loop_allocate();
+	EXPECT_NE(loop, nullptr);
+
 	for (size_t isock = 0; isock < sock_count; ++isock) {
-		if (sock_mdns[isock])
+		if (sock_mdns[isock]) {
+			EXPECT_INTEQ(mdns_loop_add_socket(loop, sock_mdns[isock], MDNS_LOOP_DISCOVERY, databuf, sizeof(databuf),
+			                                  query_callback, nullptr),
+			             0);
 			mdns_discovery_send(sock_mdns[isock]);
-	}
-
-	size_t iloop = 0;
-	while (iloop++ < 50) {
-		for (size_t isock = 0; isock < sock_count; ++isock) {
-			if (sock_mdns[isock])
-				mdns_discovery_recv(sock_mdns[isock], databuf, sizeof(databuf), query_callback, nullptr);
 		}
-		thread_sleep(100);
 	}
 
+	mdns_loop_run(loop, 5000);
+	mdns_loop_deallocate(loop);
+
 	for (size_t isock = 0; isock < sock_count; ++isock)
 		socket_deallocate(sock_mdns[isock]);
 	for (size_t iaddr = 0, acount = array_size(local_address); iaddr < acount; ++iaddr)
@@ -207,61 +212,47 @@ DECLARE_TEST(dnssd, query) {
 	}
 	EXPECT_GT(sock_bound_count, 0);
 
+	mdns_loop_t* loop = mdns_loop_allocate();
+	EXPECT_NE(loop, nullptr);
+
 	for (size_t isock = 0; isock < sock_count; ++isock) {
 		if (!sock_mdns[isock])
 			continue;
 
+		EXPECT_INTEQ(mdns_loop_add_socket(loop, sock_mdns[isock], MDNS_LOOP_QUERY, databuf, sizeof(databuf),
+		                                  query_callback, loop),
+		             0);
+
 		mdns_query_send(sock_mdns[isock], MDNS_RECORDTYPE_PTR, STRING_CONST("_ssh._tcp.local."), databuf, sizeof(databuf), 0);
 
-		size_t iloop = 0;
-		while (iloop++ < 30) {
-			mdns_query_recv(sock_mdns[isock], databuf, sizeof(databuf), query_callback, nullptr, 0);
-			thread_sleep(100);
-		}
+		mdns_loop_run(loop, 3000);
 
 		mdns_query_send(sock_mdns[isock], MDNS_RECORDTYPE_PTR, STRING_CONST("_smb_tcp.local."), databuf,
 		                sizeof(databuf), 0);
 
-		iloop = 0;
-		while (iloop++ < 30) {
-			mdns_query_recv(sock_mdns[isock], databuf, sizeof(databuf), query_callback, nullptr, 0);
-			thread_sleep(100);
-		}
+		mdns_loop_run(loop, 3000);
 
 		mdns_query_send(sock_mdns[isock], MDNS_RECORDTYPE_PTR, STRING_CONST("_googlecast._tcp.local."), databuf, sizeof(databuf),
 		                0);
 
-		iloop = 0;
-		while (iloop++ < 30) {
-			mdns_query_recv(sock_mdns[isock], databuf, sizeof(databuf), query_callback, nullptr, 0);
-			thread_sleep(100);
-		}
+		mdns_loop_run(loop, 3000);
 
 		mdns_query_send(sock_mdns[isock], MDNS_RECORDTYPE_SRV, STRING_CONST("macdev._smb._tcp.local."), databuf, sizeof(databuf),
 		                0);
 
-		iloop = 0;
-		while (iloop++ < 30) {
-			mdns_query_recv(sock_mdns[isock], databuf, sizeof(databuf), query_callback, nullptr, 0);
-			thread_sleep(100);
-		}
+		mdns_loop_run(loop, 3000);
 
 		mdns_query_send(sock_mdns[isock], MDNS_RECORDTYPE_A, STRING_CONST("macdev.local."), databuf, sizeof(databuf), 0);
 
-		iloop = 0;
-		while (iloop++ < 30) {
-			mdns_query_recv(sock_mdns[isock], databuf, sizeof(databuf), query_callback, nullptr, 0);
-			thread_sleep(100);
-		}
+		mdns_loop_run(loop, 3000);
 
 		mdns_query_send(sock_mdns[isock], MDNS_RECORDTYPE_AAAA, STRING_CONST("macdev.local."), databuf, sizeof(databuf), 0);
 
-		iloop = 0;
-		while (iloop++ < 30) {
-			mdns_query_recv(sock_mdns[isock], databuf, sizeof(databuf), query_callback, nullptr, 0);
-			thread_sleep(100);
-		}
+		mdns_loop_run(loop, 3000);
+
+		mdns_loop_remove_socket(loop, sock_mdns[isock]);
 	}
+	mdns_loop_deallocate(loop);
 
 	for (size_t isock = 0; isock < sock_count; ++isock)
 		socket_deallocate(sock_mdns[isock]);
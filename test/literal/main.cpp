@@ -0,0 +1,159 @@
+/* main.cpp  -  mDNS library  -  Public Domain  -  2013 Mattias Jansson
+ *
+ * This library provides a cross-platform mDNS and DNS-SD library in C based
+ * on our foundation and network libraries. The implementation is based on RFC 6762
+ * and RFC 6763.
+ *
+ * The latest source code maintained by Mattias Jansson is always available at
+ *
+ * https://github.com/rampantpixels/mdns_lib
+ *
+ * The foundation and network library source code maintained by Mattias Jansson
+ * is always available at
+ *
+ * https://github.com/rampantpixels/foundation_lib
+ * https://github.com/rampantpixels/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify it without any restrictions.
+ *
+ */
+
+#include <mdns/mdns.h>
+
+#include <network/network.h>
+#include <foundation/foundation.h>
+#include <test/test.h>
+
+// Compile-time names are only available with C++14 relaxed constexpr
+#if (__cplusplus >= 201402L) || (defined(_MSVC_LANG) && (_MSVC_LANG >= 201402L))
+#define TEST_LITERAL_CONSTEXPR 1
+#else
+#define TEST_LITERAL_CONSTEXPR 0
+#endif
+
+static application_t
+test_literal_application(void) {
+	application_t app;
+	memset(&app, 0, sizeof(app));
+	app.name = string_const(STRING_CONST("Literal tests"));
+	app.short_name = string_const(STRING_CONST("test_literal"));
+	app.company = string_const(STRING_CONST(""));
+	app.flags = APPLICATION_UTILITY;
+	app.exception_handler = test_exception_handler;
+	return app;
+}
+
+static memory_system_t
+test_literal_memory_system(void) {
+	return memory_system_malloc();
+}
+
+static foundation_config_t
+test_literal_foundation_config(void) {
+	foundation_config_t config;
+	memset(&config, 0, sizeof(config));
+	return config;
+}
+
+static int
+test_literal_initialize(void) {
+	network_config_t network_config;
+	memset(&network_config, 0, sizeof(network_config));
+	if (network_module_initialize(network_config) < 0)
+		return -1;
+
+	mdns_config_t mdns_config;
+	memset(&mdns_config, 0, sizeof(mdns_config));
+	if (mdns_module_initialize(mdns_config) < 0)
+		return -1;
+
+	return 0;
+}
+
+static void
+test_literal_finalize(void) {
+	mdns_module_finalize();
+	network_module_finalize();
+}
+
+#if TEST_LITERAL_CONSTEXPR
+
+static constexpr auto test_literal_http = mdns_name_literal("_http._tcp.local.");
+static constexpr auto test_literal_undotted = mdns_name_literal("_http._tcp.local");
+static constexpr auto test_literal_longest =
+    mdns_name_literal("abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijk.local.");
+
+// Encoding happens at compile time
+static_assert(test_literal_http.length == 18, "literal length");
+static_assert((test_literal_http.data[0] == 5) && (test_literal_http.data[6] == 4) &&
+                  (test_literal_http.data[11] == 5) && (test_literal_http.data[17] == 0),
+              "literal label lengths");
+static_assert(test_literal_undotted.length == test_literal_http.length, "literal root label");
+static_assert((test_literal_longest.data[0] == 63) && (test_literal_longest.length == 71), "literal longest label");
+
+#endif
+
+DECLARE_TEST(literal, encode) {
+#if TEST_LITERAL_CONSTEXPR
+	uint32_t buffer[64];
+
+	// Labels are encoded at compile time exactly as at runtime
+	mdns_name_t name = test_literal_http.name();
+	void* end = mdns_string_make(buffer, sizeof(buffer), buffer, STRING_CONST("_http._tcp.local."), 0);
+	EXPECT_SIZEEQ((size_t)pointer_diff(end, buffer), name.length);
+	EXPECT_INTEQ(memcmp(buffer, name.data, name.length), 0);
+	EXPECT_EQ(mdns_name_hash(&name), mdns_string_hash(STRING_CONST("_HTTP._tcp.local")));
+
+	mdns_name_t undotted = test_literal_undotted.name();
+	EXPECT_SIZEEQ(undotted.length, name.length);
+	EXPECT_INTEQ(memcmp(undotted.data, name.data, name.length), 0);
+
+	end = mdns_string_make(buffer, sizeof(buffer), buffer,
+	                       STRING_CONST("abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijk.local."), 0);
+	EXPECT_SIZEEQ((size_t)pointer_diff(end, buffer), test_literal_longest.length);
+	EXPECT_INTEQ(memcmp(buffer, test_literal_longest.data, test_literal_longest.length), 0);
+
+	// The literal is written to packets and matches the dotted name
+	end = mdns_string_make_name(buffer, sizeof(buffer), buffer, &name);
+	EXPECT_SIZEEQ((size_t)pointer_diff(end, buffer), name.length);
+	EXPECT_TRUE(mdns_string_equal_name(buffer, sizeof(buffer), 0, STRING_CONST("_HTTP._tcp.local.")));
+#endif
+
+	return 0;
+}
+
+static void
+test_literal_declare(void) {
+	ADD_TEST(literal, encode);
+}
+
+static test_suite_t test_literal_suite = {test_literal_application,
+                                          test_literal_memory_system,
+                                          test_literal_foundation_config,
+                                          test_literal_declare,
+                                          test_literal_initialize,
+                                          test_literal_finalize,
+                                          0};
+
+#if BUILD_MONOLITHIC
+
+extern "C" int
+test_literal_run(void);
+
+extern "C" int
+test_literal_run(void) {
+	test_suite = test_literal_suite;
+	return test_run_all();
+}
+
+#else
+
+extern "C" test_suite_t
+test_suite_define(void);
+
+extern "C" test_suite_t
+test_suite_define(void) {
+	return test_literal_suite;
+}
+
+#endif
@@ -0,0 +1,1621 @@
+/* main.c  -  mDNS library  -  Public Domain  -  2013 Mattias Jansson
+ *
+ * This library provides a cross-platform mDNS and DNS-SD library in C based
+ * on our foundation and network libraries. The implementation is based on RFC 6762
+ * and RFC 6763.
+ *
+ * The latest source code maintained by Mattias Jansson is always available at
+ *
+ * https://github.com/rampantpixels/mdns_lib
+ *
+ * The foundation and network library source code maintained by Mattias Jansson
+ * is always available at
+ *
+ * https://github.com/rampantpixels/foundation_lib
+ * https://github.com/rampantpixels/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify it without any restrictions.
+ *
+ */
+
+#include <mdns/mdns.h>
+#include <mdns/internal.h>
+
+#include <network/network.h>
+#include <foundation/foundation.h>
+#include <test/test.h>
+
+static application_t
+test_packet_application(void) {
+	application_t app;
+	memset(&app, 0, sizeof(app));
+	app.name = string_const(STRING_CONST("Packet tests"));
+	app.short_name = string_const(STRING_CONST("test_packet"));
+	app.company = string_const(STRING_CONST(""));
+	app.flags = APPLICATION_UTILITY;
+	app.exception_handler = test_exception_handler;
+	return app;
+}
+
+static memory_system_t
+test_packet_memory_system(void) {
+	return memory_system_malloc();
+}
+
+static foundation_config_t
+test_packet_foundation_config(void) {
+	foundation_config_t config;
+	memset(&config, 0, sizeof(config));
+	return config;
+}
+
+static int
+test_packet_initialize(void) {
+	network_config_t network_config = {0};
+	if (network_module_initialize(network_config) < 0)
+		return -1;
+
+	mdns_config_t mdns_config = {0};
+	if (mdns_module_initialize(mdns_config) < 0)
+		return -1;
+
+	return 0;
+}
+
+static void
+test_packet_finalize(void) {
+	mdns_module_finalize();
+	network_module_finalize();
+}
+
+static mdns_record_t
+test_packet_record(mdns_record_type_t type, const char* name, size_t length) {
+	mdns_record_t record;
+	memset(&record, 0, sizeof(record));
+	record.name = string_const(name, length);
+	record.type = type;
+	return record;
+}
+
+// Fill a PTR record for _http._tcp.local. and SRV, A and two TXT additional records
+static void
+test_packet_service_records(mdns_record_t* answer, mdns_record_t* additional) {
+	*answer = test_packet_record(MDNS_RECORDTYPE_PTR, STRING_CONST("_http._tcp.local."));
+	answer->data.ptr.name = string_const(STRING_CONST("web._http._tcp.local."));
+
+	additional[0] = test_packet_record(MDNS_RECORDTYPE_SRV, STRING_CONST("web._http._tcp.local."));
+	additional[0].data.srv.priority = 1;
+	additional[0].data.srv.weight = 2;
+	additional[0].data.srv.port = 8080;
+	additional[0].data.srv.name = string_const(STRING_CONST("host.local."));
+	additional[1] = test_packet_record(MDNS_RECORDTYPE_A, STRING_CONST("host.local."));
+	additional[1].data.a.addr.sin_family = AF_INET;
+	additional[1].data.a.addr.sin_addr.s_addr = htonl(0xC0A80001U);
+	additional[2] = test_packet_record(MDNS_RECORDTYPE_TXT, STRING_CONST("web._http._tcp.local."));
+	additional[2].data.txt.key = string_const(STRING_CONST("path"));
+	additional[2].data.txt.value = string_const(STRING_CONST("/index.html"));
+	additional[3] = test_packet_record(MDNS_RECORDTYPE_TXT, STRING_CONST("web._http._tcp.local."));
+	additional[3].data.txt.key = string_const(STRING_CONST("version"));
+	additional[3].data.txt.value = string_const(STRING_CONST("1.2"));
+}
+
+// Build a unicast answer to a PTR question for _http._tcp.local. with SRV, A and TXT additional records
+static size_t
+test_packet_build_answer(void* buffer, size_t capacity) {
+	mdns_record_t answer;
+	mdns_record_t additional[4];
+	test_packet_service_records(&answer, additional);
+	return mdns_query_answer_unicast_build(buffer, capacity, 0x1234, MDNS_RECORDTYPE_PTR,
+	                                       STRING_CONST("_http._tcp.local."), answer, 0, 0, additional, 4);
+}
+
+DECLARE_TEST(packet, cursor) {
+	uint32_t buffer[256];
+	char namebuffer[256];
+	size_t size = test_packet_build_answer(buffer, sizeof(buffer));
+	EXPECT_GT(size, sizeof(struct mdns_header_t));
+
+	mdns_packet_cursor_t cursor;
+	mdns_packet_entry_t entry;
+	EXPECT_INTEQ(mdns_packet_cursor_initialize(&cursor, 0, buffer, size), 0);
+	EXPECT_UINTEQ(cursor.query_id, 0x1234);
+	EXPECT_UINTEQ(cursor.flags, 0x8400);
+	EXPECT_EQ(mdns_packet_cursor_section(&cursor), MDNS_ENTRYTYPE_QUESTION);
+
+	EXPECT_TRUE(mdns_packet_cursor_next(&cursor, &entry));
+	EXPECT_EQ(entry.section, MDNS_ENTRYTYPE_QUESTION);
+	EXPECT_UINTEQ(entry.rtype, MDNS_RECORDTYPE_PTR);
+	size_t offset = entry.name_offset;
+	string_const_t name = mdns_string_extract(buffer, size, &offset, namebuffer, sizeof(namebuffer));
+	EXPECT_CONSTSTRINGEQ(name, string_const(STRING_CONST("_http._tcp.local.")));
+
+	EXPECT_TRUE(mdns_packet_cursor_next(&cursor, &entry));
+	EXPECT_EQ(entry.section, MDNS_ENTRYTYPE_ANSWER);
+	EXPECT_UINTEQ(entry.rtype, MDNS_RECORDTYPE_PTR);
+	name = mdns_record_parse_ptr(buffer, size, entry.record_offset, entry.record_length, namebuffer,
+	                             sizeof(namebuffer));
+	EXPECT_CONSTSTRINGEQ(name, string_const(STRING_CONST("web._http._tcp.local.")));
+
+	EXPECT_TRUE(mdns_packet_cursor_next(&cursor, &entry));
+	EXPECT_EQ(entry.section, MDNS_ENTRYTYPE_ADDITIONAL);
+	EXPECT_UINTEQ(entry.rtype, MDNS_RECORDTYPE_SRV);
+	mdns_record_srv_t srv = mdns_record_parse_srv(buffer, size, entry.record_offset, entry.record_length,
+	                                              namebuffer, sizeof(namebuffer));
+	EXPECT_UINTEQ(srv.port, 8080);
+	EXPECT_CONSTSTRINGEQ(srv.name, string_const(STRING_CONST("host.local.")));
+
+	EXPECT_TRUE(mdns_packet_cursor_next(&cursor, &entry));
+	EXPECT_UINTEQ(entry.rtype, MDNS_RECORDTYPE_A);
+	EXPECT_SIZEEQ(entry.record_length, 4);
+
+	// Both TXT strings are coalesced into one record
+	EXPECT_TRUE(mdns_packet_cursor_next(&cursor, &entry));
+	EXPECT_UINTEQ(entry.rtype, MDNS_RECORDTYPE_TXT);
+	EXPECT_SIZEEQ(entry.record_offset + entry.record_length, size);
+
+	EXPECT_FALSE(mdns_packet_cursor_next(&cursor, &entry));
+	EXPECT_INTEQ(cursor.error, 0);
+	EXPECT_EQ(mdns_packet_cursor_section(&cursor), MDNS_ENTRYTYPE_END);
+
+	return 0;
+}
+
+DECLARE_TEST(packet, skip) {
+	uint32_t buffer[256];
+	size_t size = test_packet_build_answer(buffer, sizeof(buffer));
+
+	mdns_packet_cursor_t cursor;
+	mdns_packet_entry_t entry;
+	EXPECT_INTEQ(mdns_packet_cursor_initialize(&cursor, 0, buffer, size), 0);
+	EXPECT_SIZEEQ(mdns_packet_cursor_skip_section(&cursor), 1);
+	EXPECT_SIZEEQ(mdns_packet_cursor_skip_section(&cursor), 1);
+	EXPECT_EQ(mdns_packet_cursor_section(&cursor), MDNS_ENTRYTYPE_ADDITIONAL);
+	EXPECT_SIZEEQ(mdns_packet_cursor_skip_section(&cursor), 3);
+	EXPECT_SIZEEQ(cursor.offset, size);
+	EXPECT_FALSE(mdns_packet_cursor_next(&cursor, &entry));
+	EXPECT_INTEQ(cursor.error, 0);
+
+	// Truncated packet must stop the cursor with an error
+	EXPECT_INTEQ(mdns_packet_cursor_initialize(&cursor, 0, buffer, size - 3), 0);
+	while (mdns_packet_cursor_next(&cursor, &entry)) {
+	}
+	EXPECT_INTEQ(cursor.error, -1);
+
+	EXPECT_INTEQ(mdns_packet_cursor_initialize(&cursor, 0, buffer, 4), -1);
+	EXPECT_FALSE(mdns_packet_cursor_next(&cursor, &entry));
+
+	return 0;
+}
+
+static int
+test_packet_count_callback(socket_t* sock, const network_address_t* from, mdns_entry_type_t entry,
+                           uint16_t query_id, uint16_t rtype, uint16_t rclass, uint32_t ttl, const void* data,
+                           size_t size, size_t name_offset, size_t name_length, size_t record_offset,
+                           size_t record_length, void* user_data) {
+	FOUNDATION_UNUSED(sock);
+	FOUNDATION_UNUSED(from);
+	FOUNDATION_UNUSED(query_id);
+	FOUNDATION_UNUSED(rtype);
+	FOUNDATION_UNUSED(rclass);
+	FOUNDATION_UNUSED(ttl);
+	FOUNDATION_UNUSED(data);
+	FOUNDATION_UNUSED(size);
+	FOUNDATION_UNUSED(name_offset);
+	FOUNDATION_UNUSED(name_length);
+	FOUNDATION_UNUSED(record_offset);
+	FOUNDATION_UNUSED(record_length);
+	size_t* count = user_data;
+	++count[entry];
+	return 0;
+}
+
+DECLARE_TEST(packet, parse) {
+	uint32_t buffer[256];
+	size_t size = test_packet_build_answer(buffer, sizeof(buffer));
+
+	size_t count[MDNS_ENTRYTYPE_END + 1];
+	memset(count, 0, sizeof(count));
+	EXPECT_SIZEEQ(mdns_query_parse(0, 0, buffer, size, test_packet_count_callback, count, 0), 4);
+	EXPECT_SIZEEQ(count[MDNS_ENTRYTYPE_QUESTION], 0);
+	EXPECT_SIZEEQ(count[MDNS_ENTRYTYPE_ANSWER], 1);
+	EXPECT_SIZEEQ(count[MDNS_ENTRYTYPE_ADDITIONAL], 3);
+	EXPECT_SIZEEQ(count[MDNS_ENTRYTYPE_END], 1);
+
+	memset(count, 0, sizeof(count));
+	EXPECT_SIZEEQ(mdns_query_parse(0, 0, buffer, size, test_packet_count_callback, count, 0x4321), 0);
+
+	memset(count, 0, sizeof(count));
+	EXPECT_SIZEEQ(mdns_service_parse(0, 0, buffer, size, test_packet_count_callback, count), 5);
+	EXPECT_SIZEEQ(count[MDNS_ENTRYTYPE_QUESTION], 1);
+
+	// Multicast answers carry no question section
+	mdns_record_t answer;
+	mdns_record_t additional[4];
+	test_packet_service_records(&answer, additional);
+	size = mdns_query_answer_multicast_build(buffer, sizeof(buffer), answer, 0, 0, additional, 4);
+	memset(count, 0, sizeof(count));
+	EXPECT_SIZEEQ(mdns_query_parse(0, 0, buffer, size, test_packet_count_callback, count, 0), 4);
+	EXPECT_SIZEEQ(count[MDNS_ENTRYTYPE_ANSWER], 1);
+	EXPECT_SIZEEQ(count[MDNS_ENTRYTYPE_ADDITIONAL], 3);
+
+	return 0;
+}
+
+DECLARE_TEST(packet, index) {
+	uint32_t buffer[256];
+	char namebuffer[256];
+	size_t size = test_packet_build_answer(buffer, sizeof(buffer));
+
+	mdns_packet_index_t index;
+	EXPECT_INTEQ(mdns_packet_index(0, buffer, size, &index), 5);
+	EXPECT_UINTEQ(index.query_id, 0x1234);
+	EXPECT_UINTEQ(index.count[MDNS_ENTRYTYPE_QUESTION], 1);
+	EXPECT_UINTEQ(index.count[MDNS_ENTRYTYPE_ANSWER], 1);
+	EXPECT_UINTEQ(index.count[MDNS_ENTRYTYPE_ADDITIONAL], 3);
+
+	EXPECT_UINTEQ(index.entry[0].section, MDNS_ENTRYTYPE_QUESTION);
+	EXPECT_TRUE(mdns_packet_index_name_equal(&index, 0, STRING_CONST("_HTTP._tcp.local.")));
+	EXPECT_TRUE(mdns_packet_index_name_equal(&index, 0, STRING_CONST("_http._tcp.local")));
+	EXPECT_FALSE(mdns_packet_index_name_equal(&index, 0, STRING_CONST("_http._tcp")));
+	EXPECT_FALSE(mdns_packet_index_name_equal(&index, 0, STRING_CONST("_http._tcp.local.org")));
+
+	EXPECT_UINTEQ(index.entry[1].rtype, MDNS_RECORDTYPE_PTR);
+	string_const_t name = mdns_packet_index_target(&index, 1, namebuffer, sizeof(namebuffer));
+	EXPECT_CONSTSTRINGEQ(name, string_const(STRING_CONST("web._http._tcp.local.")));
+
+	EXPECT_UINTEQ(index.entry[2].rtype, MDNS_RECORDTYPE_SRV);
+	name = mdns_packet_index_name(&index, 2, namebuffer, sizeof(namebuffer));
+	EXPECT_CONSTSTRINGEQ(name, string_const(STRING_CONST("web._http._tcp.local.")));
+	name = mdns_packet_index_target(&index, 2, namebuffer, sizeof(namebuffer));
+	EXPECT_CONSTSTRINGEQ(name, string_const(STRING_CONST("host.local.")));
+
+	// Truncated packet
+	EXPECT_INTEQ(mdns_packet_index(0, buffer, size - 1, &index), -1);
+
+	// Compression pointer loop and forward pointer
+	uint8_t loop[] = {0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 'a', 0xC0, 12, 0, 1, 0, 1};
+	EXPECT_INTEQ(mdns_packet_index(0, loop, sizeof(loop), &index), -1);
+	uint8_t forward[] = {0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0xC0, 14, 1, 'a', 0, 0, 1, 0, 1};
+	EXPECT_INTEQ(mdns_packet_index(0, forward, sizeof(forward), &index), -1);
+	uint8_t valid[] = {0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 1, 'a', 0, 0, 1, 0, 1, 1, 'b', 0xC0, 12, 0, 1, 0, 1};
+	EXPECT_INTEQ(mdns_packet_index(0, valid, sizeof(valid), &index), 2);
+	EXPECT_TRUE(mdns_packet_index_name_equal(&index, 1, STRING_CONST("b.a.")));
+
+	// Names are at most 255 bytes including the root label byte
+	uint8_t longname[12 + 256 + 4] = {0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0};
+	for (size_t ilabel = 0; ilabel < 4; ++ilabel)
+		longname[12 + (ilabel * 64)] = (ilabel < 3) ? 63 : 61;
+	longname[12 + 255 + 1] = 1;
+	longname[12 + 255 + 3] = 1;
+	EXPECT_INTEQ(mdns_packet_index(0, longname, 12 + 255 + 4, &index), 1);
+	longname[12 + (3 * 64)] = 62;
+	longname[12 + 256 + 1] = 1;
+	longname[12 + 256 + 3] = 1;
+	EXPECT_INTEQ(mdns_packet_index(0, longname, sizeof(longname), &index), -1);
+
+	return 0;
+}
+
+DECLARE_TEST(packet, context) {
+	uint32_t buffer[256];
+	char namebuffer[256];
+	char contextbuffer[256];
+	size_t size = test_packet_build_answer(buffer, sizeof(buffer));
+
+	mdns_string_context_t* context = memory_allocate(HASH_MDNS, sizeof(mdns_string_context_t), 0, MEMORY_PERSISTENT);
+	mdns_string_context_initialize(context, buffer, size);
+
+	mdns_packet_cursor_t cursor;
+	mdns_packet_entry_t entry;
+	size_t records = 0;
+	EXPECT_INTEQ(mdns_packet_cursor_initialize(&cursor, 0, buffer, size), 0);
+	while (mdns_packet_cursor_next(&cursor, &entry)) {
+		size_t offset = entry.name_offset;
+		size_t context_offset = entry.name_offset;
+		string_const_t name = mdns_string_extract(buffer, size, &offset, namebuffer, sizeof(namebuffer));
+		string_const_t context_name =
+		    mdns_string_context_extract(context, &context_offset, contextbuffer, sizeof(contextbuffer));
+		EXPECT_CONSTSTRINGEQ(context_name, name);
+		EXPECT_SIZEEQ(context_offset, offset);
+		++records;
+	}
+	EXPECT_SIZEEQ(records, 5);
+
+	// Every record name is a back reference, the SRV target shares the "local." suffix
+	EXPECT_GT(context->count, 0);
+	const mdns_string_context_entry_t* suffix = mdns_string_context_suffix(context, sizeof(struct mdns_header_t));
+	EXPECT_NE(suffix, 0);
+	EXPECT_SIZEEQ(suffix->text_length, 17);
+	EXPECT_EQ(suffix->hash, mdns_string_hash(STRING_CONST("_http._tcp.local.")));
+	size_t count = context->count;
+	EXPECT_EQ(mdns_string_context_suffix(context, sizeof(struct mdns_header_t)), suffix);
+	EXPECT_SIZEEQ(context->count, count);
+
+	// Question name and answer name are equal, answer name and PTR target are not
+	EXPECT_INTEQ(mdns_packet_cursor_initialize(&cursor, 0, buffer, size), 0);
+	mdns_packet_entry_t question;
+	EXPECT_TRUE(mdns_packet_cursor_next(&cursor, &question));
+	EXPECT_TRUE(mdns_packet_cursor_next(&cursor, &entry));
+	size_t lhs = question.name_offset;
+	size_t rhs = entry.name_offset;
+	EXPECT_TRUE(mdns_string_context_equal(context, &lhs, &rhs));
+	lhs = entry.name_offset;
+	rhs = entry.record_offset;
+	EXPECT_FALSE(mdns_string_context_equal(context, &lhs, &rhs));
+	EXPECT_SIZEEQ(lhs, entry.name_offset);
+
+	// Pointer loop must fail without recursing forever
+	uint8_t loop[] = {0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 'a', 0xC0, 12, 0, 1, 0, 1};
+	mdns_string_context_initialize(context, loop, sizeof(loop));
+	size_t offset = 12;
+	EXPECT_SIZEEQ(mdns_string_context_extract(context, &offset, contextbuffer, sizeof(contextbuffer)).length, 0);
+	EXPECT_EQ(mdns_string_context_suffix(context, 12), 0);
+	// A failed decode releases the text it claimed
+	EXPECT_SIZEEQ(context->text_used, 0);
+	EXPECT_SIZEEQ(context->count, 0);
+
+	memory_deallocate(context);
+
+	return 0;
+}
+
+DECLARE_TEST(packet, equal) {
+	char lhs[128];
+	char rhs[128];
+	for (size_t length = 0; length <= sizeof(lhs); ++length) {
+		for (size_t ichr = 0; ichr < length; ++ichr) {
+			lhs[ichr] = (char)('a' + (ichr % 26));
+			rhs[ichr] = (ichr & 1) ? (char)('A' + (ichr % 26)) : lhs[ichr];
+		}
+		EXPECT_TRUE(mdns_string_equal_nocase(lhs, rhs, length));
+		if (length) {
+			// Only ASCII letters fold, so '@' (0x40) and '`' (0x60) must stay distinct
+			lhs[length - 1] = '@';
+			rhs[length - 1] = '`';
+			EXPECT_FALSE(mdns_string_equal_nocase(lhs, rhs, length));
+			rhs[length - 1] = (char)0xE0;
+			lhs[length - 1] = (char)0xC0;
+			EXPECT_FALSE(mdns_string_equal_nocase(lhs, rhs, length));
+		}
+	}
+
+	uint8_t plain[] = {5, '_', 'h', 't', 't', 'p', 4, '_', 't', 'c', 'p', 5, 'l', 'o', 'c', 'a', 'l', 0};
+	uint8_t upper[] = {5, '_', 'H', 'T', 'T', 'P', 4, '_', 'T', 'C', 'P', 5, 'L', 'o', 'C', 'a', 'L', 0};
+	uint8_t compressed[] = {5, 'l', 'o', 'c', 'a', 'l', 0, 5, '_', 'h', 't', 't', 'p', 4, '_', 't', 'c', 'p', 0xC0, 0};
+	size_t lhs_offset = 0;
+	size_t rhs_offset = 0;
+	EXPECT_TRUE(mdns_string_equal(plain, sizeof(plain), &lhs_offset, upper, sizeof(upper), &rhs_offset));
+	EXPECT_SIZEEQ(lhs_offset, sizeof(plain));
+	EXPECT_SIZEEQ(rhs_offset, sizeof(upper));
+	lhs_offset = 0;
+	rhs_offset = 7;
+	EXPECT_TRUE(mdns_string_equal(upper, sizeof(upper), &lhs_offset, compressed, sizeof(compressed), &rhs_offset));
+	EXPECT_SIZEEQ(lhs_offset, sizeof(upper));
+	EXPECT_SIZEEQ(rhs_offset, sizeof(compressed));
+	lhs_offset = 0;
+	rhs_offset = 0;
+	EXPECT_FALSE(mdns_string_equal(plain, sizeof(plain), &lhs_offset, compressed, sizeof(compressed), &rhs_offset));
+
+	return 0;
+}
+
+DECLARE_TEST(packet, hash) {
+	uint32_t buffer[256];
+	size_t size = test_packet_build_answer(buffer, sizeof(buffer));
+
+	hash_t service_hash = mdns_string_hash(STRING_CONST("_http._tcp.local."));
+	EXPECT_EQ(service_hash, mdns_string_hash(STRING_CONST("_HTTP._Tcp.local")));
+	EXPECT_NE(service_hash, mdns_string_hash(STRING_CONST("_http._udp.local.")));
+	EXPECT_NE(service_hash, mdns_string_hash(STRING_CONST("_http.tcp.local.")));
+
+	mdns_packet_cursor_t cursor;
+	mdns_packet_entry_t entry;
+	EXPECT_INTEQ(mdns_packet_cursor_initialize(&cursor, 0, buffer, size), 0);
+	EXPECT_TRUE(mdns_packet_cursor_next(&cursor, &entry));
+
+	hash_t name_hash = 0;
+	hash_t suffix_hash[8];
+	size_t suffix_count = sizeof(suffix_hash) / sizeof(suffix_hash[0]);
+	size_t offset = entry.name_offset;
+	size_t skip_offset = entry.name_offset;
+	EXPECT_TRUE(mdns_string_skip_hash(buffer, size, &offset, &name_hash, suffix_hash, &suffix_count));
+	EXPECT_TRUE(mdns_string_skip(buffer, size, &skip_offset));
+	EXPECT_SIZEEQ(offset, skip_offset);
+	EXPECT_EQ(name_hash, service_hash);
+	EXPECT_SIZEEQ(suffix_count, 3);
+	EXPECT_EQ(suffix_hash[0], service_hash);
+	EXPECT_EQ(suffix_hash[1], mdns_string_hash(STRING_CONST("_tcp.local.")));
+	EXPECT_EQ(suffix_hash[2], mdns_string_hash(STRING_CONST("local.")));
+
+	// Compressed PTR target hashes as the fully decompressed name, suffix array may be short
+	EXPECT_TRUE(mdns_packet_cursor_next(&cursor, &entry));
+	offset = entry.record_offset;
+	suffix_count = 2;
+	EXPECT_TRUE(mdns_string_skip_hash(buffer, size, &offset, &name_hash, suffix_hash, &suffix_count));
+	EXPECT_SIZEEQ(offset, entry.record_offset + entry.record_length);
+	EXPECT_EQ(name_hash, mdns_string_hash(STRING_CONST("web._http._tcp.local.")));
+	EXPECT_SIZEEQ(suffix_count, 2);
+	EXPECT_EQ(suffix_hash[1], service_hash);
+
+	return 0;
+}
+
+static size_t
+test_packet_build_question(void* buffer, size_t capacity, const char* name, size_t length, mdns_record_type_t type) {
+	struct mdns_header_t* header = (struct mdns_header_t*)buffer;
+	memset(header, 0, sizeof(struct mdns_header_t));
+	header->query_id = htons(0x4321);
+	header->questions = htons(1);
+	void* data = mdns_string_make(buffer, capacity, pointer_offset(buffer, sizeof(struct mdns_header_t)), name, length,
+	                              0);
+	data = mdns_htons(data, (uint16_t)type);
+	data = mdns_htons(data, MDNS_CLASS_IN);
+	return (size_t)pointer_diff(data, buffer);
+}
+
+DECLARE_TEST(packet, store) {
+	uint32_t question[128];
+	uint32_t response[512];
+	size_t answer_records = 0;
+
+	mdns_store_t* store = mdns_store_allocate(8);
+	EXPECT_NE(store, 0);
+
+	mdns_record_t record = test_packet_record(MDNS_RECORDTYPE_PTR, STRING_CONST("_http._tcp.local."));
+	record.data.ptr.name = string_const(STRING_CONST("web._http._tcp.local."));
+	int ptr = mdns_store_insert(store, &record);
+	record = test_packet_record(MDNS_RECORDTYPE_SRV, STRING_CONST("web._http._tcp.local."));
+	record.data.srv.port = 8080;
+	record.data.srv.name = string_const(STRING_CONST("host.local."));
+	int srv = mdns_store_insert(store, &record);
+	record = test_packet_record(MDNS_RECORDTYPE_TXT, STRING_CONST("web._http._tcp.local."));
+	record.data.txt.key = string_const(STRING_CONST("path"));
+	record.data.txt.value = string_const(STRING_CONST("/"));
+	int txt = mdns_store_insert(store, &record);
+	record = test_packet_record(MDNS_RECORDTYPE_A, STRING_CONST("host.local."));
+	record.data.a.addr.sin_family = AF_INET;
+	record.data.a.addr.sin_addr.s_addr = htonl(0xC0A80001U);
+	int a = mdns_store_insert(store, &record);
+	record = test_packet_record(MDNS_RECORDTYPE_AAAA, STRING_CONST("host.local."));
+	record.data.aaaa.addr.sin6_family = AF_INET6;
+	int aaaa = mdns_store_insert(store, &record);
+	record = test_packet_record(MDNS_RECORDTYPE_A, STRING_CONST("other.local."));
+	int other = mdns_store_insert(store, &record);
+	EXPECT_GE(ptr, 0);
+	EXPECT_GE(srv, 0);
+	EXPECT_GE(txt, 0);
+	EXPECT_GE(a, 0);
+	EXPECT_GE(aaaa, 0);
+	EXPECT_GE(other, 0);
+	EXPECT_SIZEEQ(store->count, 6);
+
+	// Store owns copies of all strings
+	char name[] = "HOST.local";
+	EXPECT_INTEQ(mdns_store_find(store, name, sizeof(name) - 1, MDNS_RECORDTYPE_A, -1), a);
+	name[0] = 'X';
+	EXPECT_INTEQ(mdns_store_find(store, STRING_CONST("host.local."), MDNS_RECORDTYPE_A, a), -1);
+	EXPECT_INTEQ(mdns_store_find(store, STRING_CONST("host.local."), MDNS_RECORDTYPE_SRV, -1), -1);
+	EXPECT_CONSTSTRINGEQ(mdns_store_record(store, srv)->data.srv.name, string_const(STRING_CONST("host.local.")));
+
+	// PTR question gets SRV, TXT, A and AAAA as additional records
+	size_t size = test_packet_build_question(question, sizeof(question), STRING_CONST("_http._tcp.local."),
+	                                         MDNS_RECORDTYPE_PTR);
+	size_t response_size = mdns_store_answer_build(store, question, size, sizeof(struct mdns_header_t), 0x4321,
+	                                               MDNS_RECORDTYPE_PTR, false, response, sizeof(response),
+	                                               &answer_records);
+	EXPECT_GT(response_size, 0);
+	EXPECT_SIZEEQ(answer_records, 1);
+
+	mdns_packet_index_t index;
+	EXPECT_INTEQ(mdns_packet_index(0, response, response_size, &index), 5);
+	EXPECT_UINTEQ(index.query_id, 0);
+	EXPECT_UINTEQ(index.count[MDNS_ENTRYTYPE_QUESTION], 0);
+	EXPECT_UINTEQ(index.count[MDNS_ENTRYTYPE_ANSWER], 1);
+	EXPECT_UINTEQ(index.count[MDNS_ENTRYTYPE_ADDITIONAL], 4);
+	EXPECT_UINTEQ(index.entry[1].rtype, MDNS_RECORDTYPE_SRV);
+	EXPECT_UINTEQ(index.entry[1].rclass, MDNS_CLASS_IN | MDNS_CACHE_FLUSH);
+
+	// Legacy unicast response echoes the question without cache flush
+	response_size = mdns_store_answer_build(store, question, size, sizeof(struct mdns_header_t), 0x4321,
+	                                        MDNS_RECORDTYPE_PTR, true, response, sizeof(response), 0);
+	EXPECT_INTEQ(mdns_packet_index(0, response, response_size, &index), 6);
+	EXPECT_UINTEQ(index.query_id, 0x4321);
+	EXPECT_UINTEQ(index.count[MDNS_ENTRYTYPE_QUESTION], 1);
+	EXPECT_UINTEQ(index.entry[2].rclass, MDNS_CLASS_IN);
+
+	// ANY question expands to both address records, case-insensitive
+	size = test_packet_build_question(question, sizeof(question), STRING_CONST("Host.Local."), MDNS_RECORDTYPE_ANY);
+	response_size = mdns_store_answer_build(store, question, size, sizeof(struct mdns_header_t), 0,
+	                                        MDNS_RECORDTYPE_ANY, false, response, sizeof(response), &answer_records);
+	EXPECT_SIZEEQ(answer_records, 2);
+
+	// Remove and update keep the index consistent
+	EXPECT_INTEQ(mdns_store_remove(store, a), 0);
+	EXPECT_INTEQ(mdns_store_remove(store, a), -1);
+	EXPECT_INTEQ(mdns_store_find(store, STRING_CONST("host.local."), MDNS_RECORDTYPE_A, -1), -1);
+	record = test_packet_record(MDNS_RECORDTYPE_AAAA, STRING_CONST("renamed.local."));
+	EXPECT_INTEQ(mdns_store_update(store, aaaa, &record), 0);
+	EXPECT_INTEQ(mdns_store_find(store, STRING_CONST("renamed.local."), MDNS_RECORDTYPE_AAAA, -1), aaaa);
+	response_size = mdns_store_answer_build(store, question, size, sizeof(struct mdns_header_t), 0,
+	                                        MDNS_RECORDTYPE_ANY, false, response, sizeof(response), &answer_records);
+	EXPECT_SIZEEQ(response_size, 0);
+	EXPECT_SIZEEQ(store->count, 5);
+
+	// Freed slot is reused
+	record = test_packet_record(MDNS_RECORDTYPE_A, STRING_CONST("host.local."));
+	EXPECT_INTEQ(mdns_store_insert(store, &record), a);
+
+	mdns_store_deallocate(store);
+
+	return 0;
+}
+
+DECLARE_TEST(packet, known) {
+	uint32_t question[128];
+	uint32_t response[512];
+	size_t answer_records = 0;
+
+	mdns_store_t* store = mdns_store_allocate(8);
+	mdns_record_t record[3];
+	record[0] = test_packet_record(MDNS_RECORDTYPE_PTR, STRING_CONST("_http._tcp.local."));
+	record[0].data.ptr.name = string_const(STRING_CONST("web._http._tcp.local."));
+	record[1] = test_packet_record(MDNS_RECORDTYPE_PTR, STRING_CONST("_http._tcp.local."));
+	record[1].data.ptr.name = string_const(STRING_CONST("printer._http._tcp.local."));
+	record[2] = test_packet_record(MDNS_RECORDTYPE_TXT, STRING_CONST("web._http._tcp.local."));
+	record[2].data.txt.key = string_const(STRING_CONST("path"));
+	record[2].data.txt.value = string_const(STRING_CONST("/"));
+	for (size_t irec = 0; irec < 3; ++irec)
+		EXPECT_GE(mdns_store_insert(store, record + irec), 0);
+
+	// Querier lists one of the two instances with more than half the TTL left
+	mdns_record_t known = record[0];
+	known.ttl = MDNS_STORE_TTL_DEFAULT - 10;
+	size_t size = mdns_query_build(question, sizeof(question), MDNS_RECORDTYPE_PTR, STRING_CONST("_http._tcp.local."),
+	                               0, false, &known, 1);
+	EXPECT_GT(size, 0);
+
+	mdns_packet_index_t index;
+	EXPECT_INTEQ(mdns_packet_index(0, question, size, &index), 2);
+	EXPECT_UINTEQ(index.count[MDNS_ENTRYTYPE_ANSWER], 1);
+	EXPECT_UINTEQ(index.entry[1].ttl, MDNS_STORE_TTL_DEFAULT - 10);
+	EXPECT_UINTEQ(index.entry[1].rclass, MDNS_CLASS_IN);
+
+	size_t response_size =
+	    mdns_store_answer_build(store, question, size, sizeof(struct mdns_header_t), 0, MDNS_RECORDTYPE_PTR, false,
+	                            response, sizeof(response), &answer_records);
+	EXPECT_GT(response_size, 0);
+	EXPECT_SIZEEQ(answer_records, 1);
+	EXPECT_INTEQ(mdns_packet_index(0, response, response_size, &index), 1);
+	string_const_t target = mdns_packet_index_target(&index, 0, (char*)question, sizeof(question));
+	EXPECT_CONSTSTRINGEQ(target, string_const(STRING_CONST("printer._http._tcp.local.")));
+
+	// Known answer with less than half the TTL left is answered again
+	known.ttl = MDNS_STORE_TTL_DEFAULT / 2 - 1;
+	size = mdns_query_build(question, sizeof(question), MDNS_RECORDTYPE_PTR, STRING_CONST("_http._tcp.local."), 0,
+	                        false, &known, 1);
+	mdns_store_answer_build(store, question, size, sizeof(struct mdns_header_t), 0, MDNS_RECORDTYPE_PTR, false,
+	                        response, sizeof(response), &answer_records);
+	EXPECT_SIZEEQ(answer_records, 2);
+
+	// All answers known gives no response, TXT strings are matched inside the coalesced record
+	known = record[2];
+	known.ttl = MDNS_STORE_TTL_DEFAULT;
+	size = mdns_query_build(question, sizeof(question), MDNS_RECORDTYPE_TXT, STRING_CONST("web._http._tcp.local."),
+	                        0, false, &known, 1);
+	EXPECT_SIZEEQ(mdns_store_answer_build(store, question, size, sizeof(struct mdns_header_t), 0,
+	                                      MDNS_RECORDTYPE_TXT, false, response, sizeof(response), 0),
+	              0);
+	known.data.txt.value = string_const(STRING_CONST("/index.html"));
+	size = mdns_query_build(question, sizeof(question), MDNS_RECORDTYPE_TXT, STRING_CONST("web._http._tcp.local."),
+	                        0, false, &known, 1);
+	EXPECT_GT(mdns_store_answer_build(store, question, size, sizeof(struct mdns_header_t), 0, MDNS_RECORDTYPE_TXT,
+	                                  false, response, sizeof(response), 0),
+	          0);
+
+	mdns_store_deallocate(store);
+
+	return 0;
+}
+
+DECLARE_TEST(packet, aggregate) {
+	uint32_t question[128];
+
+	mdns_store_t* store = mdns_store_allocate(64);
+	mdns_record_t record = test_packet_record(MDNS_RECORDTYPE_PTR, STRING_CONST("_http._tcp.local."));
+	record.data.ptr.name = string_const(STRING_CONST("web._http._tcp.local."));
+	mdns_store_insert(store, &record);
+	record = test_packet_record(MDNS_RECORDTYPE_A, STRING_CONST("host.local."));
+	record.data.a.addr.sin_family = AF_INET;
+	mdns_store_insert(store, &record);
+
+	socket_t* sock = udp_socket_allocate();
+
+	// Same question from many hosts plus one other question owe two records in total
+	size_t size = test_packet_build_question(question, sizeof(question), STRING_CONST("_http._tcp.local."),
+	                                         MDNS_RECORDTYPE_PTR);
+	for (int iquery = 0; iquery < 10; ++iquery)
+		EXPECT_SIZEEQ(mdns_store_schedule(store, sock, 0, question, size, 0, MDNS_RECORDTYPE_PTR, MDNS_CLASS_IN,
+		                                  sizeof(struct mdns_header_t)),
+		              1);
+	size = test_packet_build_question(question, sizeof(question), STRING_CONST("host.local."), MDNS_RECORDTYPE_A);
+	EXPECT_SIZEEQ(mdns_store_schedule(store, sock, 0, question, size, 0, MDNS_RECORDTYPE_A, MDNS_CLASS_IN,
+	                                  sizeof(struct mdns_header_t)),
+	              1);
+
+	EXPECT_EQ(store->pending[0].sock, sock);
+	EXPECT_SIZEEQ(store->pending[0].answer_count, 2);
+	EXPECT_SIZEEQ(store->responses, 11);
+
+	// Nothing is sent before the window has passed
+	EXPECT_SIZEEQ(mdns_store_flush(store, false), 0);
+	EXPECT_SIZEEQ(mdns_store_flush(store, true), 1);
+	EXPECT_SIZEEQ(store->packets, 1);
+	EXPECT_SIZEEQ(store->packets_saved, 10);
+	EXPECT_EQ(store->pending[0].sock, 0);
+	EXPECT_SIZEEQ(mdns_store_flush(store, true), 0);
+
+	// Flushing early when the owed set is full keeps the tally for the whole response
+	char namebuffer[MDNS_STORE_ANSWER_MAX + 1][32];
+	string_t name[MDNS_STORE_ANSWER_MAX + 1];
+	for (int ihost = 0; ihost <= MDNS_STORE_ANSWER_MAX; ++ihost) {
+		name[ihost] = string_format(namebuffer[ihost], sizeof(namebuffer[ihost]), STRING_CONST("host%d.local."),
+		                            ihost);
+		record = test_packet_record(MDNS_RECORDTYPE_A, STRING_ARGS(name[ihost]));
+		record.data.a.addr.sin_family = AF_INET;
+		mdns_store_insert(store, &record);
+	}
+	size_t answered = store->answered;
+	size_t packets = store->packets;
+	size_t packets_saved = store->packets_saved;
+	for (int ihost = 0; ihost <= MDNS_STORE_ANSWER_MAX; ++ihost) {
+		size = test_packet_build_question(question, sizeof(question), STRING_ARGS(name[ihost]), MDNS_RECORDTYPE_A);
+		EXPECT_SIZEEQ(mdns_store_schedule(store, sock, 0, question, size, 0, MDNS_RECORDTYPE_A, MDNS_CLASS_IN,
+		                                  sizeof(struct mdns_header_t)),
+		              1);
+	}
+	EXPECT_SIZEEQ(store->pending[0].answer_count, 1);
+	EXPECT_GE(mdns_store_flush(store, true), 1);
+	packets = store->packets - packets;
+	EXPECT_GE(packets, 2);
+	EXPECT_SIZEEQ(store->answered - answered, MDNS_STORE_ANSWER_MAX + 1);
+	EXPECT_SIZEEQ(store->packets_saved - packets_saved, MDNS_STORE_ANSWER_MAX + 1 - packets);
+
+	socket_deallocate(sock);
+	mdns_store_deallocate(store);
+
+	return 0;
+}
+
+DECLARE_TEST(packet, cache) {
+	uint32_t buffer[256];
+	size_t size = test_packet_build_answer(buffer, sizeof(buffer));
+
+	mdns_cache_t* cache = mdns_cache_allocate(5);
+
+	// Records parsed from a response, both TXT strings are cached separately
+	size_t offset = sizeof(struct mdns_header_t);
+	EXPECT_TRUE(mdns_string_skip(buffer, size, &offset));
+	offset += 4;
+	EXPECT_SIZEEQ(mdns_records_parse(0, 0, buffer, size, &offset, MDNS_ENTRYTYPE_ANSWER, 0, 1, mdns_cache_callback,
+	                                 cache),
+	              1);
+	EXPECT_SIZEEQ(mdns_records_parse(0, 0, buffer, size, &offset, MDNS_ENTRYTYPE_ADDITIONAL, 0, 3,
+	                                 mdns_cache_callback, cache),
+	              3);
+	EXPECT_SIZEEQ(cache->count, 5);
+	EXPECT_SIZEEQ(cache->inserted, 5);
+
+	int ptr = mdns_cache_find(cache, STRING_CONST("_HTTP._tcp.local"), MDNS_RECORDTYPE_PTR, -1);
+	EXPECT_GE(ptr, 0);
+	EXPECT_CONSTSTRINGEQ(mdns_cache_record(cache, ptr)->data.ptr.name,
+	                     string_const(STRING_CONST("web._http._tcp.local.")));
+	EXPECT_UINTEQ(mdns_cache_ttl(cache, ptr), 10);
+	int srv = mdns_cache_find(cache, STRING_CONST("web._http._tcp.local."), MDNS_RECORDTYPE_SRV, -1);
+	EXPECT_UINTEQ(mdns_cache_record(cache, srv)->data.srv.port, 8080);
+	int txt = mdns_cache_find(cache, STRING_CONST("web._http._tcp.local."), MDNS_RECORDTYPE_TXT, -1);
+	EXPECT_GE(mdns_cache_find(cache, STRING_CONST("web._http._tcp.local."), MDNS_RECORDTYPE_TXT, txt), 0);
+
+	// Cache is full, a new record evicts the one closest to expiry
+	mdns_record_t record = test_packet_record(MDNS_RECORDTYPE_A, STRING_CONST("other.local."));
+	record.data.a.addr.sin_addr.s_addr = htonl(0x0A000001U);
+	record.ttl = 4500;
+	int other = mdns_cache_insert(cache, &record, true);
+	EXPECT_GE(other, 0);
+	EXPECT_SIZEEQ(cache->count, 5);
+	EXPECT_SIZEEQ(cache->evicted, 1);
+
+	// Receiving the same record again refreshes it
+	record.ttl = 5000;
+	EXPECT_INTEQ(mdns_cache_insert(cache, &record, true), other);
+	EXPECT_SIZEEQ(cache->refreshed, 1);
+
+	// Level 0 expiry is exact to the second
+	EXPECT_SIZEEQ(mdns_cache_advance(cache, 9), 0);
+	EXPECT_UINTEQ(mdns_cache_ttl(cache, srv), 1);
+	EXPECT_SIZEEQ(mdns_cache_advance(cache, 1), 4);
+	EXPECT_INTEQ(mdns_cache_find(cache, STRING_CONST("_http._tcp.local."), MDNS_RECORDTYPE_PTR, -1), -1);
+
+	// Records further out cascade down through the wheel levels and still expire exactly
+	record = test_packet_record(MDNS_RECORDTYPE_A, STRING_CONST("other.local."));
+	record.data.a.addr.sin_addr.s_addr = htonl(0x0A000002U);
+	record.ttl = 100;
+	int second = mdns_cache_insert(cache, &record, false);
+	EXPECT_SIZEEQ(mdns_cache_advance(cache, 99), 0);
+	EXPECT_UINTEQ(mdns_cache_ttl(cache, second), 1);
+	EXPECT_SIZEEQ(mdns_cache_advance(cache, 1), 1);
+	EXPECT_UINTEQ(mdns_cache_ttl(cache, other), 5000 - 110);
+	EXPECT_SIZEEQ(mdns_cache_advance(cache, 5000 - 111), 0);
+	EXPECT_GE(mdns_cache_find(cache, STRING_CONST("other.local."), MDNS_RECORDTYPE_A, -1), 0);
+	EXPECT_SIZEEQ(mdns_cache_advance(cache, 1), 1);
+	EXPECT_SIZEEQ(cache->count, 0);
+
+	// Cache flush bit expires older records of the same name and type in one second
+	record.ttl = 120;
+	int first = mdns_cache_insert(cache, &record, false);
+	mdns_cache_advance(cache, 2);
+	record.data.a.addr.sin_addr.s_addr = htonl(0x0A000003U);
+	second = mdns_cache_insert(cache, &record, true);
+	EXPECT_UINTEQ(mdns_cache_ttl(cache, first), 1);
+	EXPECT_UINTEQ(mdns_cache_ttl(cache, second), 120);
+
+	// Goodbye expires the record in one second
+	record.ttl = 0;
+	EXPECT_INTEQ(mdns_cache_insert(cache, &record, false), second);
+	EXPECT_UINTEQ(mdns_cache_ttl(cache, second), 1);
+	EXPECT_SIZEEQ(mdns_cache_advance(cache, 1), 2);
+	EXPECT_SIZEEQ(cache->count, 0);
+
+	// Truncated record data is not cached
+	static const uint8_t truncated[] = {4, 'h', 'o', 's', 't', 5, 'l', 'o', 'c', 'a', 'l', 0, 10, 0};
+	mdns_cache_callback(0, 0, MDNS_ENTRYTYPE_ANSWER, 0, MDNS_RECORDTYPE_A, MDNS_CLASS_IN, 120, truncated,
+	                    sizeof(truncated), 0, 12, 12, 2, cache);
+	mdns_cache_callback(0, 0, MDNS_ENTRYTYPE_ANSWER, 0, MDNS_RECORDTYPE_PTR, MDNS_CLASS_IN, 120, truncated,
+	                    sizeof(truncated), 0, 12, 12, 2, cache);
+	EXPECT_SIZEEQ(cache->count, 0);
+
+	mdns_cache_deallocate(cache);
+
+	return 0;
+}
+
+DECLARE_TEST(packet, refresh) {
+	uint32_t buffer[256];
+	mdns_query_t query[8];
+
+	mdns_cache_t* cache = mdns_cache_allocate(8);
+	mdns_cache_set_refresh(cache, true);
+
+	mdns_record_t record = test_packet_record(MDNS_RECORDTYPE_A, STRING_CONST("host.local."));
+	record.data.a.addr.sin_addr.s_addr = htonl(0x0A000001U);
+	record.ttl = 100;
+	int addr = mdns_cache_insert(cache, &record, true);
+	record = test_packet_record(MDNS_RECORDTYPE_TXT, STRING_CONST("host.local."));
+	record.data.txt.key = string_const(STRING_CONST("key"));
+	record.ttl = 100;
+	mdns_cache_insert(cache, &record, true);
+	record.data.txt.key = string_const(STRING_CONST("other"));
+	mdns_cache_insert(cache, &record, true);
+	record = test_packet_record(MDNS_RECORDTYPE_PTR, STRING_CONST("_http._tcp.local."));
+	record.data.ptr.name = string_const(STRING_CONST("web._http._tcp.local."));
+	record.ttl = 4500;
+	mdns_cache_insert(cache, &record, true);
+
+	// First query is due at 80% of TTL plus up to 2% jitter, records sharing name and type
+	// are collected in one question
+	EXPECT_SIZEEQ(mdns_cache_advance(cache, 79), 0);
+	EXPECT_SIZEEQ(mdns_cache_refresh_queries(cache, query, 8), 0);
+	EXPECT_SIZEEQ(mdns_cache_advance(cache, 3), 0);
+	EXPECT_SIZEEQ(cache->refresh_count, 3);
+	EXPECT_SIZEEQ(mdns_cache_refresh_queries(cache, query, 1), 1);
+	EXPECT_NE(cache->refresh_count, 0);
+	EXPECT_SIZEEQ(mdns_cache_refresh_queries(cache, query + 1, 7), 1);
+	EXPECT_SIZEEQ(cache->refresh_count, 0);
+	EXPECT_NE(query[0].type, query[1].type);
+
+	// Questions due in the same tick are batched in one packet
+	size_t size = mdns_multiquery_build(buffer, sizeof(buffer), query, 2, 0, false);
+	EXPECT_NE(size, 0);
+	EXPECT_UINTEQ(ntohs(((struct mdns_header_t*)buffer)->questions), 2);
+	size_t offset = sizeof(struct mdns_header_t);
+	for (int iquery = 0; iquery < 2; ++iquery) {
+		EXPECT_TRUE(mdns_string_equal_name(buffer, size, offset, STRING_CONST("host.local.")));
+		EXPECT_TRUE(mdns_string_skip(buffer, size, &offset));
+		EXPECT_UINTEQ(ntohs(*(uint16_t*)pointer_offset(buffer, offset)), query[iquery].type);
+		offset += 4;
+	}
+	EXPECT_SIZEEQ(offset, size);
+	EXPECT_SIZEEQ(mdns_multiquery_build(buffer, 32, query, 2, 0, false), 0);
+
+	// A response refreshing the address stops its queries, the TXT records are queried again at
+	// 85%, 90% and 95% of TTL, then expire
+	record = test_packet_record(MDNS_RECORDTYPE_A, STRING_CONST("host.local."));
+	record.data.a.addr.sin_addr.s_addr = htonl(0x0A000001U);
+	record.ttl = 100;
+	EXPECT_INTEQ(mdns_cache_insert(cache, &record, true), addr);
+	size_t queries = 0;
+	for (int istep = 0; istep < 18; ++istep) {
+		EXPECT_SIZEEQ(mdns_cache_advance(cache, 1), (istep == 17) ? 2 : 0);
+		size_t count = mdns_cache_refresh_queries(cache, query, 8);
+		for (size_t iquery = 0; iquery < count; ++iquery)
+			EXPECT_UINTEQ(query[iquery].type, MDNS_RECORDTYPE_TXT);
+		queries += count;
+	}
+	// Each TXT record has its own jitter, a question per step unless due in the same tick
+	EXPECT_GE(queries, 3);
+	EXPECT_LE(queries, 6);
+	EXPECT_SIZEEQ(cache->count, 2);
+	EXPECT_SIZEEQ(cache->refresh_count, 0);
+
+	mdns_cache_deallocate(cache);
+
+	// Records due while the due list is full are carried over to the next tick
+	mdns_query_t overflow[MDNS_CACHE_REFRESH_MAX + 8];
+	cache = mdns_cache_allocate(MDNS_CACHE_REFRESH_MAX + 8);
+	mdns_cache_set_refresh(cache, true);
+	for (unsigned int irecord = 0; irecord < MDNS_CACHE_REFRESH_MAX + 8; ++irecord) {
+		char namebuffer[32];
+		string_t name = string_format(namebuffer, sizeof(namebuffer), STRING_CONST("host%u.local."), irecord);
+		record = test_packet_record(MDNS_RECORDTYPE_A, STRING_ARGS(name));
+		record.ttl = 100;
+		EXPECT_GE(mdns_cache_insert(cache, &record, true), 0);
+	}
+	mdns_cache_advance(cache, 83);
+	EXPECT_SIZEEQ(cache->refresh_count, MDNS_CACHE_REFRESH_MAX);
+	EXPECT_SIZEEQ(mdns_cache_refresh_queries(cache, overflow, MDNS_CACHE_REFRESH_MAX + 8), MDNS_CACHE_REFRESH_MAX);
+	mdns_cache_advance(cache, 1);
+	EXPECT_SIZEEQ(mdns_cache_refresh_queries(cache, overflow, MDNS_CACHE_REFRESH_MAX + 8), 8);
+
+	mdns_cache_deallocate(cache);
+
+	return 0;
+}
+
+DECLARE_TEST(packet, querier) {
+	uint32_t buffer[256];
+	size_t size = test_packet_build_answer(buffer, sizeof(buffer));
+
+	mdns_querier_t* querier = mdns_querier_allocate();
+	socket_t* sock = udp_socket_allocate();
+
+	// Identical questions from multiple callers are merged
+	int browse = mdns_querier_add(querier, MDNS_RECORDTYPE_PTR, STRING_CONST("_http._tcp.local."));
+	EXPECT_GE(browse, 0);
+	EXPECT_INTEQ(mdns_querier_add(querier, MDNS_RECORDTYPE_PTR, STRING_CONST("_HTTP._tcp.local")), browse);
+	int host = mdns_querier_add(querier, MDNS_RECORDTYPE_A, STRING_CONST("host.local."));
+	EXPECT_NE(host, browse);
+
+	// First query is sent immediately in one packet, then backs off 1, 2, 4 ... seconds up to the cap
+	uint32_t packet[128];
+	EXPECT_SIZEEQ(mdns_querier_send(querier, sock, packet, sizeof(packet)), 2);
+	EXPECT_SIZEEQ(querier->packets, 1);
+	EXPECT_UINTEQ(querier->question[browse].interval, 1);
+	EXPECT_SIZEEQ(mdns_querier_send(querier, sock, packet, sizeof(packet)), 0);
+	EXPECT_EQ(mdns_querier_next(querier), querier->question[browse].deadline);
+	unsigned int interval = 1;
+	for (int istep = 0; istep < 16; ++istep) {
+		querier->question[browse].deadline = 0;
+		EXPECT_SIZEEQ(mdns_querier_send(querier, sock, packet, sizeof(packet)), 1);
+		interval = (interval * 2 < MDNS_QUERIER_INTERVAL_MAX) ? interval * 2 : MDNS_QUERIER_INTERVAL_MAX;
+		EXPECT_UINTEQ(querier->question[browse].interval, interval);
+	}
+	EXPECT_UINTEQ(querier->question[browse].interval, MDNS_QUERIER_INTERVAL_MAX);
+	EXPECT_UINTEQ(querier->question[host].interval, 1);
+
+	// A flushed record right after the query is the response and keeps the back-off
+	mdns_querier_callback(0, 0, MDNS_ENTRYTYPE_ANSWER, 0, MDNS_RECORDTYPE_PTR, MDNS_CLASS_IN | MDNS_CACHE_FLUSH, 10,
+	                      buffer, size, sizeof(struct mdns_header_t), 0, 0, 0, querier);
+	EXPECT_SIZEEQ(querier->resets, 0);
+
+	// A goodbye resets it
+	mdns_querier_callback(0, 0, MDNS_ENTRYTYPE_ANSWER, 0, MDNS_RECORDTYPE_PTR, MDNS_CLASS_IN, 0, buffer, size,
+	                      sizeof(struct mdns_header_t), 0, 0, 0, querier);
+	EXPECT_SIZEEQ(querier->resets, 1);
+	EXPECT_UINTEQ(querier->question[browse].interval, 0);
+	EXPECT_SIZEEQ(mdns_querier_send(querier, sock, packet, sizeof(packet)), 1);
+	EXPECT_UINTEQ(querier->question[browse].interval, 1);
+
+	// A question not fitting in the buffer is backed off without counting a packet
+	size_t packets = querier->packets;
+	querier->question[browse].deadline = 0;
+	EXPECT_SIZEEQ(mdns_querier_send(querier, sock, packet, 24), 0);
+	EXPECT_SIZEEQ(querier->packets, packets);
+	EXPECT_UINTEQ(querier->question[browse].interval, 2);
+	EXPECT_GT(querier->question[browse].deadline, 0);
+
+	// Question is removed when the last caller releases it, the other question is still sent
+	EXPECT_SIZEEQ(mdns_querier_reset(querier, MDNS_RECORDTYPE_ANY, STRING_CONST("host.local")), 1);
+	EXPECT_INTEQ(mdns_querier_remove(querier, browse), 0);
+	EXPECT_INTEQ(mdns_querier_remove(querier, browse), 0);
+	EXPECT_INTEQ(mdns_querier_remove(querier, browse), -1);
+	EXPECT_SIZEEQ(mdns_querier_send(querier, sock, packet, sizeof(packet)), 1);
+
+	socket_deallocate(sock);
+	mdns_querier_deallocate(querier);
+
+	return 0;
+}
+
+DECLARE_TEST(packet, compress) {
+	uint32_t buffer[512];
+	mdns_string_table_t string_table;
+	mdns_string_table_initialize(&string_table);
+
+	// Longest suffix is compressed, case must match exactly
+	void* data = mdns_string_make(buffer, sizeof(buffer), buffer, STRING_CONST("web._http._tcp.local."), &string_table);
+	EXPECT_SIZEEQ(pointer_diff(data, buffer), 22);
+	void* next =
+	    mdns_string_make(buffer, sizeof(buffer), data, STRING_CONST("printer._http._tcp.local"), &string_table);
+	EXPECT_SIZEEQ(pointer_diff(next, data), 10);
+	EXPECT_UINTEQ(mdns_ntohs(pointer_offset(data, 8)), 0xC000 | 4);
+	data = next;
+	next = mdns_string_make(buffer, sizeof(buffer), data, STRING_CONST("_HTTP._tcp.local."), &string_table);
+	EXPECT_SIZEEQ(pointer_diff(next, data), 8);
+	EXPECT_UINTEQ(mdns_ntohs(pointer_offset(data, 6)), 0xC000 | 10);
+	data = next;
+
+	// Suffixes written long ago are still found, a suffix of a longer name in the packet is not
+	// mistaken for a name ending at the same label
+	char name[32];
+	for (int iname = 0; iname < 40; ++iname) {
+		string_t host = string_format(name, sizeof(name), STRING_CONST("host%d.local."), iname);
+		data = mdns_string_make(buffer, sizeof(buffer), data, STRING_ARGS(host), &string_table);
+		EXPECT_NE(data, 0);
+	}
+	next = mdns_string_make(buffer, sizeof(buffer), data, STRING_CONST("_tcp.local"), &string_table);
+	EXPECT_SIZEEQ(pointer_diff(next, data), 2);
+	EXPECT_UINTEQ(mdns_ntohs(data), 0xC000 | 10);
+	data = next;
+	next = mdns_string_make(buffer, sizeof(buffer), data, STRING_CONST("_http._tcp"), &string_table);
+	EXPECT_SIZEEQ(pointer_diff(next, data), 12);
+
+	size_t offset = (size_t)pointer_diff(data, buffer);
+	EXPECT_TRUE(mdns_string_equal_name(buffer, sizeof(buffer), offset, STRING_CONST("_http._tcp.")));
+
+	// A dot inside a label is not a separator
+	static const uint8_t dotted[] = {3, 'a', '.', 'b', 0, 1, 'a', 1, 'b', 0};
+	EXPECT_FALSE(mdns_string_equal_name(dotted, sizeof(dotted), 0, STRING_CONST("a.b.")));
+	EXPECT_TRUE(mdns_string_equal_name(dotted, sizeof(dotted), 5, STRING_CONST("a.b.")));
+	EXPECT_FALSE(mdns_string_equal_name(dotted, sizeof(dotted), 5, STRING_CONST("a.")));
+
+	return 0;
+}
+
+DECLARE_TEST(packet, template) {
+	uint32_t expect[256];
+	uint32_t buffer[256];
+	mdns_record_t answer;
+	mdns_record_t additional[4];
+	test_packet_service_records(&answer, additional);
+	additional[1].ttl = 4500;
+
+	mdns_template_t* tpl = mdns_template_allocate();
+	EXPECT_INTEQ(mdns_template_set(tpl, &answer, 1, 0, 0, additional, 4), 0);
+	EXPECT_SIZEEQ(tpl->compiled, 0);
+
+	// Answer, announcement and goodbye from the template are identical to the ones built from records
+	size_t size = mdns_query_answer_multicast_build(expect, sizeof(expect), answer, 0, 0, additional, 4);
+	EXPECT_SIZEEQ(mdns_template_build(tpl, buffer, sizeof(buffer), 0, MDNS_CLASS_IN, 60), size);
+	EXPECT_INTEQ(memcmp(buffer, expect, size), 0);
+	size = mdns_announce_multicast_build(expect, sizeof(expect), answer, 0, 0, additional, 4);
+	EXPECT_SIZEEQ(mdns_template_build(tpl, buffer, sizeof(buffer), 0, MDNS_CLASS_IN | MDNS_CACHE_FLUSH, 60), size);
+	EXPECT_INTEQ(memcmp(buffer, expect, size), 0);
+	size = mdns_goodbye_multicast_build(expect, sizeof(expect), answer, 0, 0, additional, 4);
+	EXPECT_SIZEEQ(mdns_template_build(tpl, buffer, sizeof(buffer), 0, MDNS_CLASS_IN | MDNS_CACHE_FLUSH, 0), size);
+	EXPECT_INTEQ(memcmp(buffer, expect, size), 0);
+	EXPECT_SIZEEQ(mdns_template_build(tpl, buffer, sizeof(buffer), 0x55AA, MDNS_CLASS_IN | MDNS_CACHE_FLUSH, 0),
+	              size);
+	EXPECT_UINTEQ(ntohs(((struct mdns_header_t*)buffer)->query_id), 0x55AA);
+	EXPECT_SIZEEQ(mdns_template_build(tpl, buffer, size - 1, 0, MDNS_CLASS_IN, 60), 0);
+	EXPECT_SIZEEQ(tpl->compiled, 1);
+
+	// Changing a record compiles the template again on the next build
+	additional[0].data.srv.port = 8081;
+	EXPECT_INTEQ(mdns_template_update(tpl, 1, additional), 0);
+	EXPECT_INTEQ(mdns_template_update(tpl, 5, additional), -1);
+	size = mdns_announce_multicast_build(expect, sizeof(expect), answer, 0, 0, additional, 4);
+	EXPECT_SIZEEQ(mdns_template_build(tpl, buffer, sizeof(buffer), 0, MDNS_CLASS_IN | MDNS_CACHE_FLUSH, 60), size);
+	EXPECT_INTEQ(memcmp(buffer, expect, size), 0);
+	EXPECT_SIZEEQ(tpl->compiled, 2);
+
+	mdns_template_deallocate(tpl);
+
+	return 0;
+}
+
+MDNS_NAME_DECLARE(test_packet_http_name, "_http", "_tcp", "local");
+
+DECLARE_TEST(packet, literal) {
+	uint32_t buffer[64];
+
+	// Labels are encoded at compile time exactly as at runtime
+	void* end = mdns_string_make(buffer, sizeof(buffer), buffer, STRING_CONST("_http._tcp.local."), 0);
+	EXPECT_SIZEEQ(test_packet_http_name.length, 18);
+	EXPECT_SIZEEQ((size_t)pointer_diff(end, buffer), test_packet_http_name.length);
+	EXPECT_INTEQ(memcmp(buffer, test_packet_http_name.data, test_packet_http_name.length), 0);
+	EXPECT_EQ(mdns_name_hash(&test_packet_http_name), mdns_string_hash(STRING_CONST("_HTTP._tcp.local")));
+	EXPECT_EQ(test_packet_http_name.hash, mdns_string_hash(STRING_CONST("_http._tcp.local.")));
+
+	// The constant is usable as comparand for names in packets, also compressed ones
+	size_t size = test_packet_build_question(buffer, sizeof(buffer), STRING_CONST("_http._tcp.local."),
+	                                         MDNS_RECORDTYPE_PTR);
+	size_t offset = sizeof(struct mdns_header_t);
+	size_t name_offset = 0;
+	EXPECT_TRUE(mdns_string_equal(buffer, size, &offset, test_packet_http_name.data, test_packet_http_name.length,
+	                              &name_offset));
+	EXPECT_SIZEEQ(name_offset, test_packet_http_name.length);
+
+	end = mdns_string_make_name(buffer, sizeof(buffer), buffer, &test_packet_http_name);
+	EXPECT_SIZEEQ((size_t)pointer_diff(end, buffer), 18);
+	EXPECT_EQ(mdns_string_make_name(buffer, 17, buffer, &test_packet_http_name), 0);
+
+	return 0;
+}
+
+DECLARE_TEST(packet, builder) {
+	uint32_t buffer[256];
+	mdns_record_t answer;
+	mdns_record_t additional[4];
+	test_packet_service_records(&answer, additional);
+
+	mdns_builder_t builder;
+	EXPECT_INTEQ(mdns_builder_initialize(&builder, buffer, 8, 0, 0x8400), -1);
+	EXPECT_INTEQ(mdns_builder_initialize(&builder, buffer, sizeof(buffer), 0x1234, 0x8400), 0);
+	EXPECT_SIZEEQ(mdns_builder_remaining(&builder), sizeof(buffer) - sizeof(struct mdns_header_t));
+
+	// Multiple questions and answers in one packet, sharing one compression dictionary
+	EXPECT_INTEQ(mdns_builder_add_question(&builder, MDNS_RECORDTYPE_PTR, STRING_CONST("_http._tcp.local."),
+	                                       MDNS_CLASS_IN),
+	             0);
+	EXPECT_INTEQ(mdns_builder_add_question(&builder, MDNS_RECORDTYPE_A, STRING_CONST("host.local."), MDNS_CLASS_IN),
+	             0);
+	EXPECT_INTEQ(mdns_builder_add_answer(&builder, &answer), 0);
+	mdns_record_t printer = answer;
+	printer.data.ptr.name = string_const(STRING_CONST("printer._http._tcp.local."));
+	EXPECT_INTEQ(mdns_builder_add_answer(&builder, &printer), 0);
+	for (int irec = 0; irec < 4; ++irec)
+		EXPECT_INTEQ(mdns_builder_add_additional(&builder, additional + irec), 0);
+
+	// Sections must be added in order
+	EXPECT_INTEQ(mdns_builder_add_question(&builder, MDNS_RECORDTYPE_A, STRING_CONST("host.local."), MDNS_CLASS_IN),
+	             -1);
+	EXPECT_INTEQ(mdns_builder_add_answer(&builder, &answer), -1);
+
+	// A record not fitting leaves the packet unchanged
+	size_t size = mdns_builder_size(&builder);
+	builder.capacity = size + 12;
+	mdns_record_t other = test_packet_record(MDNS_RECORDTYPE_A, STRING_CONST("other.local."));
+	EXPECT_INTEQ(mdns_builder_add_additional(&builder, &other), -1);
+	EXPECT_SIZEEQ(mdns_builder_size(&builder), size);
+	EXPECT_SIZEEQ(mdns_builder_remaining(&builder), 12);
+	builder.capacity = sizeof(buffer);
+
+	// Both TXT strings are in one record
+	mdns_packet_cursor_t cursor;
+	mdns_packet_entry_t entry;
+	mdns_packet_cursor_initialize(&cursor, 0, buffer, size);
+	EXPECT_UINTEQ(cursor.query_id, 0x1234);
+	EXPECT_UINTEQ(cursor.remain[MDNS_ENTRYTYPE_QUESTION], 2);
+	EXPECT_UINTEQ(cursor.remain[MDNS_ENTRYTYPE_ANSWER], 2);
+	EXPECT_UINTEQ(cursor.remain[MDNS_ENTRYTYPE_AUTHORITY], 0);
+	EXPECT_UINTEQ(cursor.remain[MDNS_ENTRYTYPE_ADDITIONAL], 3);
+	mdns_record_txt_t txt[4];
+	size_t txt_count = 0;
+	while (mdns_packet_cursor_next(&cursor, &entry)) {
+		if (entry.rtype == MDNS_RECORDTYPE_TXT)
+			txt_count = mdns_record_parse_txt(buffer, size, entry.record_offset, entry.record_length, txt, 4);
+	}
+	EXPECT_INTEQ(cursor.error, 0);
+	EXPECT_SIZEEQ(txt_count, 2);
+	EXPECT_CONSTSTRINGEQ(txt[1].value, string_const(STRING_CONST("1.2")));
+
+	// Names in later records are still compressed against names written before the failed record
+	EXPECT_INTEQ(mdns_builder_add_additional(&builder, &other), 0);
+	EXPECT_SIZEEQ(mdns_builder_size(&builder), size + 6 + 2 + 10 + 4);
+
+	// TXT records are only coalesced if name, class including the cache flush bit, and TTL match
+	mdns_builder_initialize(&builder, buffer, sizeof(buffer), 0, 0x8400);
+	mdns_record_t record = test_packet_record(MDNS_RECORDTYPE_TXT, STRING_CONST("web._http._tcp.local."));
+	record.rclass = MDNS_CLASS_IN;
+	record.ttl = 120;
+	record.data.txt.key = string_const(STRING_CONST("a"));
+	EXPECT_INTEQ(mdns_builder_add_answer(&builder, &record), 0);
+	record.name = string_const(STRING_CONST("WEB._http._tcp.local"));
+	record.data.txt.key = string_const(STRING_CONST("b"));
+	EXPECT_INTEQ(mdns_builder_add_answer(&builder, &record), 0);
+	EXPECT_UINTEQ(builder.count[MDNS_ENTRYTYPE_ANSWER], 1);
+	record.ttl = 60;
+	record.data.txt.key = string_const(STRING_CONST("c"));
+	EXPECT_INTEQ(mdns_builder_add_answer(&builder, &record), 0);
+	EXPECT_UINTEQ(builder.count[MDNS_ENTRYTYPE_ANSWER], 2);
+	record.rclass = MDNS_CLASS_IN | MDNS_CACHE_FLUSH;
+	record.data.txt.key = string_const(STRING_CONST("d"));
+	EXPECT_INTEQ(mdns_builder_add_answer(&builder, &record), 0);
+	EXPECT_UINTEQ(builder.count[MDNS_ENTRYTYPE_ANSWER], 3);
+	record.name = string_const(STRING_CONST("printer._http._tcp.local."));
+	record.data.txt.key = string_const(STRING_CONST("e"));
+	EXPECT_INTEQ(mdns_builder_add_answer(&builder, &record), 0);
+	EXPECT_UINTEQ(builder.count[MDNS_ENTRYTYPE_ANSWER], 4);
+
+	// Names of every service in a full 9000 byte packet are compressed
+	uint32_t jumbo[9000 / 4];
+	char namebuffer[2][32];
+	mdns_builder_initialize(&builder, jumbo, sizeof(jumbo), 0, 0x8400);
+	size_t services = 0;
+	while (true) {
+		string_t instance = string_format(namebuffer[0], sizeof(namebuffer[0]),
+		                                  STRING_CONST("svc%u._http._tcp.local."), (unsigned int)services);
+		string_t host =
+		    string_format(namebuffer[1], sizeof(namebuffer[1]), STRING_CONST("host%u.local."), (unsigned int)services);
+		size = mdns_builder_size(&builder);
+		record = test_packet_record(MDNS_RECORDTYPE_PTR, STRING_CONST("_http._tcp.local."));
+		record.data.ptr.name = string_const(STRING_ARGS(instance));
+		if (mdns_builder_add_answer(&builder, &record) < 0)
+			break;
+		record = test_packet_record(MDNS_RECORDTYPE_SRV, STRING_ARGS(instance));
+		record.data.srv.name = string_const(STRING_ARGS(host));
+		if (mdns_builder_add_answer(&builder, &record) < 0)
+			break;
+		record = test_packet_record(MDNS_RECORDTYPE_A, STRING_ARGS(host));
+		record.data.a.addr.sin_family = AF_INET;
+		if (mdns_builder_add_answer(&builder, &record) < 0)
+			break;
+		// PTR with new instance label, SRV with new host label and A, all other names as pointers
+		if (services)
+			EXPECT_SIZEEQ(mdns_builder_size(&builder) - size, (2 + 10 + 1 + (instance.length - 18) + 2) +
+			                                                      (2 + 10 + 6 + 1 + (host.length - 7) + 2) +
+			                                                      (2 + 10 + 4));
+		++services;
+	}
+	EXPECT_SIZEEQ(services, 141);
+
+	return 0;
+}
+
+static uint32_t test_packet_split_buffer[16][128];
+static size_t test_packet_split_size[16];
+static size_t test_packet_split_count;
+
+static int
+test_packet_split_flush(const void* buffer, size_t size, void* user_data) {
+	FOUNDATION_UNUSED(user_data);
+	if ((test_packet_split_count >= 16) || (size > sizeof(test_packet_split_buffer[0])))
+		return -1;
+	memcpy(test_packet_split_buffer[test_packet_split_count], buffer, size);
+	test_packet_split_size[test_packet_split_count++] = size;
+	return 0;
+}
+
+DECLARE_TEST(packet, split) {
+	uint32_t buffer[128];
+	char namebuffer[16][64];
+	mdns_packet_cursor_t cursor;
+	mdns_packet_entry_t entry;
+
+	// Rolling back to a mark restores a TXT record strings were appended to
+	mdns_record_t answer;
+	mdns_record_t additional[4];
+	test_packet_service_records(&answer, additional);
+	mdns_builder_t builder;
+	mdns_builder_mark_t mark;
+	mdns_builder_initialize(&builder, buffer, sizeof(buffer), 0, 0x8400);
+	EXPECT_INTEQ(mdns_builder_add_additional(&builder, additional + 2), 0);
+	size_t size = mdns_builder_size(&builder);
+	mdns_builder_mark(&builder, &mark);
+	EXPECT_INTEQ(mdns_builder_add_additional(&builder, additional + 3), 0);
+	EXPECT_INTEQ(mdns_builder_add_additional(&builder, additional + 1), 0);
+	mdns_builder_rollback(&builder, &mark);
+	EXPECT_SIZEEQ(mdns_builder_size(&builder), size);
+	mdns_packet_cursor_initialize(&cursor, 0, buffer, size);
+	EXPECT_UINTEQ(cursor.remain[MDNS_ENTRYTYPE_ADDITIONAL], 1);
+	EXPECT_TRUE(mdns_packet_cursor_next(&cursor, &entry));
+	EXPECT_SIZEEQ(entry.record_offset + entry.record_length, size);
+
+	// Known answers not fitting continue in following packets, with the TC bit set in all but the last
+	mdns_record_t known[16];
+	for (int irec = 0; irec < 16; ++irec) {
+		string_t name = string_format(namebuffer[irec], sizeof(namebuffer[irec]),
+		                              STRING_CONST("instance-%d._http._tcp.local."), irec);
+		known[irec] = test_packet_record(MDNS_RECORDTYPE_PTR, STRING_CONST("_http._tcp.local."));
+		known[irec].data.ptr.name = string_const(STRING_ARGS(name));
+		known[irec].ttl = 100;
+	}
+	EXPECT_SIZEEQ(mdns_query_build(buffer, 128, MDNS_RECORDTYPE_PTR, STRING_CONST("_http._tcp.local."), 0, false,
+	                               known, 16),
+	              0);
+	test_packet_split_count = 0;
+	size_t packets = mdns_query_build_split(buffer, 128, MDNS_RECORDTYPE_PTR, STRING_CONST("_http._tcp.local."), 0,
+	                                        false, known, 16, test_packet_split_flush, 0);
+	EXPECT_GE(packets, 3);
+	EXPECT_SIZEEQ(packets, test_packet_split_count);
+	size_t known_count = 0;
+	for (size_t ipacket = 0; ipacket < packets; ++ipacket) {
+		EXPECT_LE(test_packet_split_size[ipacket], 128);
+		mdns_packet_cursor_initialize(&cursor, 0, test_packet_split_buffer[ipacket], test_packet_split_size[ipacket]);
+		EXPECT_UINTEQ(cursor.remain[MDNS_ENTRYTYPE_QUESTION], ipacket ? 0 : 1);
+		EXPECT_UINTEQ(cursor.flags & MDNS_FLAG_TRUNCATED, (ipacket + 1 < packets) ? MDNS_FLAG_TRUNCATED : 0);
+		known_count += cursor.remain[MDNS_ENTRYTYPE_ANSWER];
+		while (mdns_packet_cursor_next(&cursor, &entry)) {
+		}
+		EXPECT_INTEQ(cursor.error, 0);
+	}
+	EXPECT_SIZEEQ(known_count, 16);
+
+	// A response split across packets keeps the SRV, TXT and address records of each service with its
+	// PTR answer, even when listed apart. Records not related to any answer follow last
+	mdns_record_t service[4];
+	mdns_record_t related[13];
+	for (int isvc = 0; isvc < 4; ++isvc) {
+		string_t instance = string_format(namebuffer[isvc], sizeof(namebuffer[isvc]),
+		                                  STRING_CONST("svc%d._http._tcp.local."), isvc);
+		string_t host = string_format(namebuffer[isvc + 4], sizeof(namebuffer[isvc + 4]),
+		                              STRING_CONST("host%d.local."), isvc);
+		test_packet_service_records(service + isvc, additional);
+		service[isvc].data.ptr.name = string_const(STRING_ARGS(instance));
+		related[isvc] = additional[0];
+		related[isvc].name = string_const(STRING_ARGS(instance));
+		related[isvc].data.srv.name = string_const(STRING_ARGS(host));
+		related[isvc + 4] = additional[2];
+		related[isvc + 4].name = string_const(STRING_ARGS(instance));
+		related[isvc + 8] = additional[1];
+		related[isvc + 8].name = string_const(STRING_ARGS(host));
+	}
+	related[12] = test_packet_record(MDNS_RECORDTYPE_A, STRING_CONST("other.local."));
+	test_packet_split_count = 0;
+	mdns_split_stats_t split;
+	packets = mdns_answer_build_split(buffer, 256, service, 4, related, 13, MDNS_CLASS_IN | MDNS_CACHE_FLUSH, 60,
+	                                  test_packet_split_flush, 0, &split);
+	EXPECT_GE(packets, 2);
+	EXPECT_SIZEEQ(split.answers, 4);
+	EXPECT_SIZEEQ(split.dropped, 0);
+	EXPECT_INTEQ(split.error, 0);
+	EXPECT_SIZEEQ(packets, test_packet_split_count);
+	size_t answer_count = 0;
+	size_t additional_count = 0;
+	for (size_t ipacket = 0; ipacket < packets; ++ipacket) {
+		EXPECT_LE(test_packet_split_size[ipacket], 256);
+		mdns_packet_cursor_initialize(&cursor, 0, test_packet_split_buffer[ipacket], test_packet_split_size[ipacket]);
+		EXPECT_UINTEQ(cursor.flags, 0x8400);
+		size_t packet_answers = cursor.remain[MDNS_ENTRYTYPE_ANSWER];
+		size_t packet_additional = cursor.remain[MDNS_ENTRYTYPE_ADDITIONAL];
+		EXPECT_SIZEEQ(packet_additional - ((ipacket + 1 < packets) ? 0 : 1), 3 * packet_answers);
+		answer_count += packet_answers;
+		additional_count += packet_additional;
+		while (mdns_packet_cursor_next(&cursor, &entry)) {
+		}
+		EXPECT_INTEQ(cursor.error, 0);
+	}
+	EXPECT_SIZEEQ(answer_count, 4);
+	EXPECT_SIZEEQ(additional_count, 13);
+
+	// A failing flush ends the build, only packets and answers successfully flushed are counted
+	test_packet_split_count = 15;
+	packets = mdns_answer_build_split(buffer, 256, service, 4, related, 13, MDNS_CLASS_IN | MDNS_CACHE_FLUSH, 60,
+	                                  test_packet_split_flush, 0, &split);
+	EXPECT_SIZEEQ(packets, 1);
+	EXPECT_LT(split.error, 0);
+	mdns_packet_cursor_initialize(&cursor, 0, test_packet_split_buffer[15], test_packet_split_size[15]);
+	EXPECT_SIZEEQ(split.answers, cursor.remain[MDNS_ENTRYTYPE_ANSWER]);
+	EXPECT_LT(split.answers, 4);
+
+	// An answer not fitting in a packet on its own is dropped and counted, the others are still sent
+	char longname[256];
+	memset(longname, 'x', sizeof(longname));
+	for (size_t ilabel = 1; ilabel <= 4; ++ilabel)
+		longname[ilabel * 61 - 1] = '.';
+	memcpy(longname + 244, "local.", 6);
+	service[2].data.ptr.name = string_const(longname, 250);
+	test_packet_split_count = 0;
+	packets = mdns_answer_build_split(buffer, 256, service, 4, related, 13, MDNS_CLASS_IN | MDNS_CACHE_FLUSH, 60,
+	                                  test_packet_split_flush, 0, &split);
+	EXPECT_SIZEEQ(packets, test_packet_split_count);
+	EXPECT_SIZEEQ(split.answers, 3);
+	EXPECT_SIZEEQ(split.dropped, 1);
+	EXPECT_INTEQ(split.error, 0);
+	additional_count = 0;
+	for (size_t ipacket = 0; ipacket < packets; ++ipacket) {
+		mdns_packet_cursor_initialize(&cursor, 0, test_packet_split_buffer[ipacket], test_packet_split_size[ipacket]);
+		additional_count += cursor.remain[MDNS_ENTRYTYPE_ADDITIONAL];
+	}
+	EXPECT_SIZEEQ(additional_count, 13);
+
+	return 0;
+}
+
+DECLARE_TEST(packet, txt) {
+	uint32_t buffer[128];
+	uint32_t reference[128];
+	mdns_txt_t txt;
+	mdns_txt_initialize(&txt);
+	EXPECT_SIZEEQ(mdns_txt_size(&txt), 1);
+
+	EXPECT_INTEQ(mdns_txt_set(&txt, STRING_CONST("path"), STRING_CONST("/index.html")), 0);
+	EXPECT_INTEQ(mdns_txt_set(&txt, STRING_CONST("version"), STRING_CONST("1.0")), 0);
+	EXPECT_INTEQ(mdns_txt_set(&txt, STRING_CONST("secure"), 0, 0), 0);
+	EXPECT_INTEQ(mdns_txt_set(&txt, STRING_CONST("a=b"), STRING_CONST("c")), -1);
+	EXPECT_INTEQ(mdns_txt_set(&txt, 0, 0, STRING_CONST("c")), -1);
+	EXPECT_SIZEEQ(mdns_txt_size(&txt), 17 + 12 + 7);
+
+	// Updates only re-encode the affected string, moving the following strings if the length changes
+	EXPECT_INTEQ(mdns_txt_set(&txt, STRING_CONST("Version"), STRING_CONST("1.2")), 0);
+	EXPECT_INTEQ(mdns_txt_set(&txt, STRING_CONST("path"), STRING_CONST("/")), 0);
+	EXPECT_SIZEEQ(mdns_txt_size(&txt), 7 + 12 + 7);
+	EXPECT_INTEQ(mdns_txt_find(&txt, STRING_CONST("VERSION")), 1);
+	EXPECT_CONSTSTRINGEQ(mdns_txt_value(&txt, 1), string_const(STRING_CONST("1.2")));
+	EXPECT_EQ(mdns_txt_value(&txt, 2).str, 0);
+	EXPECT_INTEQ(mdns_txt_remove(&txt, STRING_CONST("secure")), 0);
+	EXPECT_INTEQ(mdns_txt_remove(&txt, STRING_CONST("secure")), -1);
+	EXPECT_INTEQ(mdns_txt_set(&txt, STRING_CONST("path"), STRING_CONST("/index.html")), 0);
+	EXPECT_INTEQ(mdns_txt_find(&txt, STRING_CONST("secure")), -1);
+
+	// The blob is written as is, matching the strings encoded from key/value records
+	mdns_record_t answer;
+	mdns_record_t additional[4];
+	test_packet_service_records(&answer, additional);
+	mdns_builder_t builder;
+	mdns_builder_initialize(&builder, reference, sizeof(reference), 0, 0x8400);
+	EXPECT_INTEQ(mdns_builder_add_answer(&builder, additional + 2), 0);
+	EXPECT_INTEQ(mdns_builder_add_answer(&builder, additional + 3), 0);
+	size_t reference_size = mdns_builder_size(&builder);
+	mdns_record_t record = mdns_txt_record(&txt, STRING_CONST("web._http._tcp.local."));
+	mdns_builder_initialize(&builder, buffer, sizeof(buffer), 0, 0x8400);
+	EXPECT_INTEQ(mdns_builder_add_answer(&builder, &record), 0);
+	size_t size = mdns_builder_size(&builder);
+	EXPECT_NE(size, 0);
+	EXPECT_SIZEEQ(size, reference_size);
+	EXPECT_INTEQ(memcmp(buffer, reference, size), 0);
+
+	// A record with an empty key that is not a blob is encoded as a "=value" string
+	record.data.txt.blob = false;
+	record.data.txt.value = string_const(STRING_CONST("value"));
+	mdns_builder_initialize(&builder, buffer, sizeof(buffer), 0, 0x8400);
+	EXPECT_INTEQ(mdns_builder_add_answer(&builder, &record), 0);
+	size = mdns_builder_size(&builder);
+	EXPECT_INTEQ(memcmp(pointer_offset(buffer, size - 7), "\x06=value", 7), 0);
+	EXPECT_UINTEQ(mdns_ntohs(pointer_offset(buffer, size - 9)), 7);
+
+	// Removing all keys leaves the single empty string
+	EXPECT_INTEQ(mdns_txt_remove(&txt, STRING_CONST("path")), 0);
+	EXPECT_INTEQ(mdns_txt_remove(&txt, STRING_CONST("version")), 0);
+	EXPECT_SIZEEQ(mdns_txt_size(&txt), 1);
+	EXPECT_UINTEQ(*(const uint8_t*)mdns_txt_data(&txt), 0);
+
+	return 0;
+}
+
+DECLARE_TEST(packet, txtfind) {
+	// Keys longer than a vector, a key with a control character, a boolean attribute and a repeated key
+	static const char data[] = "\x29"
+	                           "description_of_device=living room speaker"
+	                           "\x0b"
+	                           "version=1.2"
+	                           "\x16"
+	                           "bad\x01key_longer_than=16"
+	                           "\x06"
+	                           "secure"
+	                           "\x01"
+	                           "="
+	                           "\x0b"
+	                           "VERSION=9.9";
+	size_t size = sizeof(data) - 1;
+
+	mdns_record_txt_t records[8];
+	EXPECT_SIZEEQ(mdns_record_parse_txt(data, size, 0, size, records, 8), 3);
+	EXPECT_CONSTSTRINGEQ(records[0].key, string_const(STRING_CONST("description_of_device")));
+	EXPECT_CONSTSTRINGEQ(records[0].value, string_const(STRING_CONST("living room speaker")));
+
+	mdns_record_txt_index_t index;
+	EXPECT_SIZEEQ(mdns_record_txt_index(data, size, 0, size, &index), 4);
+	const mdns_record_txt_t* record = mdns_record_txt_index_find(&index, STRING_CONST("Version"));
+	EXPECT_NE(record, 0);
+	EXPECT_CONSTSTRINGEQ(record->value, string_const(STRING_CONST("1.2")));
+	record = mdns_record_txt_index_find(&index, STRING_CONST("secure"));
+	EXPECT_NE(record, 0);
+	EXPECT_EQ(record->value.str, 0);
+	EXPECT_EQ(mdns_record_txt_index_find(&index, STRING_CONST("missing")), 0);
+
+	// Only the first occurrence of a key counts
+	string_const_t value;
+	EXPECT_TRUE(mdns_record_txt_find(data, size, 0, size, STRING_CONST("version"), &value));
+	EXPECT_CONSTSTRINGEQ(value, string_const(STRING_CONST("1.2")));
+	EXPECT_TRUE(mdns_record_txt_find(data, size, 0, size, STRING_CONST("SECURE"), &value));
+	EXPECT_EQ(value.str, 0);
+	EXPECT_TRUE(!mdns_record_txt_find(data, size, 0, size, STRING_CONST("descr"), &value));
+
+	// Strings running past the record are ignored
+	EXPECT_TRUE(!mdns_record_txt_find(data, size, 0, 40, STRING_CONST("description_of_device"), &value));
+	EXPECT_SIZEEQ(mdns_record_txt_index(data, size, 0, 50, &index), 1);
+
+	return 0;
+}
+
+DECLARE_TEST(packet, stats) {
+	uint32_t buffer[256];
+	size_t size = test_packet_build_answer(buffer, sizeof(buffer));
+	mdns_stats_t before;
+	mdns_stats_t after;
+	mdns_stats_t sock_stats;
+
+	socket_t* sock = udp_socket_allocate();
+	EXPECT_INTEQ(mdns_stats_socket_track(sock), 0);
+	mdns_stats_snapshot(&before);
+
+	EXPECT_SIZEEQ(mdns_query_parse(sock, 0, buffer, size, 0, 0, 0), 4);
+	// Truncated TXT record, and a packet shorter than the header
+	EXPECT_SIZEEQ(mdns_query_parse(sock, 0, buffer, size - 3, 0, 0, 0), 3);
+	EXPECT_SIZEEQ(mdns_query_parse(sock, 0, buffer, 4, 0, 0, 0), 0);
+
+	// A label followed by a compression pointer back to the label loops
+	static const uint8_t loop[] = {0x01, 'a', 0xC0, 0x00};
+	size_t offset = 0;
+	hash_t name_hash = 0;
+	EXPECT_INTEQ(mdns_string_skip_hash(loop, sizeof(loop), &offset, &name_hash, 0, 0), 0);
+	offset = 0;
+	EXPECT_INTEQ(mdns_string_skip(loop, 3, &offset), 0);
+
+	mdns_stats_snapshot(&after);
+	EXPECT_UINTEQ(after.counter[MDNS_STAT_RECORDS_PTR] - before.counter[MDNS_STAT_RECORDS_PTR], 2);
+	EXPECT_UINTEQ(after.counter[MDNS_STAT_RECORDS_SRV] - before.counter[MDNS_STAT_RECORDS_SRV], 2);
+	EXPECT_UINTEQ(after.counter[MDNS_STAT_RECORDS_TXT] - before.counter[MDNS_STAT_RECORDS_TXT], 1);
+	EXPECT_UINTEQ(after.counter[MDNS_STAT_ERROR_TRUNCATED] - before.counter[MDNS_STAT_ERROR_TRUNCATED], 1);
+	EXPECT_UINTEQ(after.counter[MDNS_STAT_ERROR_HEADER] - before.counter[MDNS_STAT_ERROR_HEADER], 1);
+	EXPECT_UINTEQ(after.counter[MDNS_STAT_ERROR_NAME_LOOP] - before.counter[MDNS_STAT_ERROR_NAME_LOOP], 1);
+
+	// Counts of a released thread block are kept, and the block is taken again on the next count
+	mdns_stats_t released;
+	mdns_stats_thread_release();
+	mdns_stats_snapshot(&released);
+	EXPECT_UINTEQ(released.counter[MDNS_STAT_RECORDS_PTR], after.counter[MDNS_STAT_RECORDS_PTR]);
+	mdns_stats_add(0, MDNS_STAT_ANSWERS_SUPPRESSED, 1);
+	mdns_stats_snapshot(&released);
+	EXPECT_UINTEQ(released.counter[MDNS_STAT_ANSWERS_SUPPRESSED], after.counter[MDNS_STAT_ANSWERS_SUPPRESSED] + 1);
+	EXPECT_UINTEQ(after.counter[MDNS_STAT_ERROR_NAME_BOUNDS] - before.counter[MDNS_STAT_ERROR_NAME_BOUNDS], 1);
+
+	// Socket counters start at zero when tracked and only count packets parsed for the socket, including
+	// parse errors
+	EXPECT_INTEQ(mdns_stats_socket_snapshot(sock, &sock_stats), 0);
+	EXPECT_UINTEQ(sock_stats.counter[MDNS_STAT_RECORDS_PTR], 2);
+	EXPECT_UINTEQ(sock_stats.counter[MDNS_STAT_RECORDS_A], 2);
+	EXPECT_UINTEQ(sock_stats.counter[MDNS_STAT_QUESTIONS], 0);
+	EXPECT_UINTEQ(sock_stats.counter[MDNS_STAT_ERROR_TRUNCATED], 1);
+	EXPECT_UINTEQ(sock_stats.counter[MDNS_STAT_ERROR_HEADER], 1);
+	EXPECT_UINTEQ(sock_stats.counter[MDNS_STAT_ERROR_NAME_LOOP], 0);
+	mdns_stats_socket_untrack(sock);
+	EXPECT_INTEQ(mdns_stats_socket_snapshot(sock, &sock_stats), -1);
+	// Counts of the socket kept by the thread blocks are left out when tracked again
+	EXPECT_INTEQ(mdns_stats_socket_track(sock), 0);
+	EXPECT_INTEQ(mdns_stats_socket_snapshot(sock, &sock_stats), 0);
+	EXPECT_UINTEQ(sock_stats.counter[MDNS_STAT_RECORDS_PTR], 0);
+	EXPECT_SIZEEQ(mdns_query_parse(sock, 0, buffer, size, 0, 0, 0), 4);
+	EXPECT_INTEQ(mdns_stats_socket_snapshot(sock, &sock_stats), 0);
+	EXPECT_UINTEQ(sock_stats.counter[MDNS_STAT_RECORDS_PTR], 1);
+	mdns_stats_socket_untrack(sock);
+	socket_deallocate(sock);
+
+	EXPECT_CONSTSTRINGEQ(mdns_stats_name(MDNS_STAT_PACKETS_IN), string_const(STRING_CONST("packets_in")));
+	EXPECT_CONSTSTRINGEQ(mdns_stats_name(MDNS_STAT_ANSWERS_SUPPRESSED),
+	                     string_const(STRING_CONST("answers_suppressed")));
+
+	return 0;
+}
+
+DECLARE_TEST(packet, sendqueue) {
+	uint32_t buffer[64];
+	size_t size = test_packet_build_answer(buffer, sizeof(buffer));
+	socket_t* sock = udp_socket_allocate();
+	network_address_ipv4_t address;
+	network_address_ipv4_initialize(&address);
+	network_address_ipv4_set_ip((network_address_t*)&address, INADDR_LOOPBACK);
+	network_address_ip_set_port((network_address_t*)&address, MDNS_PORT);
+	const network_address_t* to = (const network_address_t*)&address;
+
+	// The queue holds the capacity given by the caller, a full queue takes packets again once cleared
+	mdns_send_queue_t* queue = mdns_send_queue_allocate(2);
+	EXPECT_NE(queue, 0);
+	EXPECT_INTEQ(mdns_send_queue_unicast(queue, sock, to, buffer, size), 0);
+	EXPECT_INTEQ(mdns_send_queue_unicast(queue, sock, to, buffer, size), 1);
+	EXPECT_INTEQ(mdns_send_queue_unicast(queue, sock, to, buffer, size), -1);
+	EXPECT_INTEQ(mdns_send_queue_result(queue, 0), -1);
+	mdns_send_queue_clear(queue);
+	EXPECT_INTEQ(mdns_send_queue_unicast(queue, sock, to, buffer, size), 0);
+	mdns_send_queue_deallocate(queue);
+
+	mdns_send_queue_t local;
+	EXPECT_INTEQ(mdns_send_queue_initialize(&local, 0), -1);
+	mdns_send_queue_finalize(&local);
+
+	socket_deallocate(sock);
+	return 0;
+}
+
+static void
+test_packet_timer_fired(mdns_loop_t* loop, int timer, void* user_data) {
+	FOUNDATION_UNUSED(loop);
+	*(int*)user_data = timer;
+}
+
+DECLARE_TEST(packet, timer) {
+	mdns_loop_t* loop = mdns_loop_allocate();
+	EXPECT_NE(loop, 0);
+
+	// A removed timer slot is armed again with a new identifier, the stale identifier leaves it be
+	int fired = -1;
+	int stale = mdns_loop_add_timer(loop, 0, test_packet_timer_fired, &fired);
+	EXPECT_GE(stale, 0);
+	mdns_loop_remove_timer(loop, stale);
+	int timer = mdns_loop_add_timer(loop, 0, test_packet_timer_fired, &fired);
+	EXPECT_GE(timer, 0);
+	EXPECT_NE(timer, stale);
+	mdns_loop_remove_timer(loop, stale);
+	mdns_loop_run(loop, 0);
+	EXPECT_INTEQ(fired, timer);
+
+	// Same for the identifier of a timer that has fired
+	int next = mdns_loop_add_timer(loop, 0, test_packet_timer_fired, &fired);
+	EXPECT_NE(next, timer);
+	mdns_loop_remove_timer(loop, timer);
+	fired = -1;
+	mdns_loop_run(loop, 0);
+	EXPECT_INTEQ(fired, next);
+
+	mdns_loop_deallocate(loop);
+
+	return 0;
+}
+
+static void
+test_packet_declare(void) {
+	ADD_TEST(packet, cursor);
+	ADD_TEST(packet, skip);
+	ADD_TEST(packet, parse);
+	ADD_TEST(packet, index);
+	ADD_TEST(packet, context);
+	ADD_TEST(packet, equal);
+	ADD_TEST(packet, hash);
+	ADD_TEST(packet, store);
+	ADD_TEST(packet, known);
+	ADD_TEST(packet, aggregate);
+	ADD_TEST(packet, cache);
+	ADD_TEST(packet, refresh);
+	ADD_TEST(packet, querier);
+	ADD_TEST(packet, compress);
+	ADD_TEST(packet, template);
+	ADD_TEST(packet, literal);
+	ADD_TEST(packet, builder);
+	ADD_TEST(packet, split);
+	ADD_TEST(packet, txt);
+	ADD_TEST(packet, txtfind);
+	ADD_TEST(packet, stats);
+	ADD_TEST(packet, sendqueue);
+	ADD_TEST(packet, timer);
+}
+
+static test_suite_t test_packet_suite = {test_packet_application,
+                                         test_packet_memory_system,
+                                         test_packet_foundation_config,
+                                         test_packet_declare,
+                                         test_packet_initialize,
+                                         test_packet_finalize,
+                                         0};
+
+#if BUILD_MONOLITHIC
+
+int
+test_packet_run(void);
+
+int
+test_packet_run(void) {
+	test_suite = test_packet_suite;
+	return test_run_all();
+}
+
+#else
+
+test_suite_t
+test_suite_define(void);
+
+test_suite_t
+test_suite_define(void) {
+	return test_packet_suite;
+}
+
+#endif
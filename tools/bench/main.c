@@ -0,0 +1,532 @@
+/* main.c  -  mDNS library benchmark  -  Public Domain  -  2014 Mattias Jansson
+ *
+ * This library provides a cross-platform mDNS and DNS-SD library in C based
+ * on our foundation and network libraries. The implementation is based on RFC 6762
+ * and RFC 6763.
+ *
+ * The latest source code maintained by Mattias Jansson is always available at
+ *
+ * https://github.com/mjansson/mdns_lib
+ *
+ * The foundation and network library source code maintained by Mattias Jansson
+ * is always available at
+ *
+ * https://github.com/mjansson/foundation_lib
+ * https://github.com/mjansson/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify
+ * it without any restrictions.
+ *
+ */
+
+#include <foundation/foundation.h>
+#include <network/network.h>
+#include <mdns/mdns.h>
+
+// Each benchmark runs over the whole packet corpus in batches until the minimum time has passed
+#define BENCH_TIME_MIN 0.5
+#define BENCH_BATCH 64
+#define BENCH_PACKETS_MAX 8
+#define BENCH_ENTRIES_MAX 64
+#define BENCH_NAMES_MAX (BENCH_PACKETS_MAX * BENCH_ENTRIES_MAX)
+#define BENCH_SERVICES 4
+
+typedef struct bench_packet_t bench_packet_t;
+typedef struct bench_count_t bench_count_t;
+typedef void (*bench_fn)(bench_count_t* count);
+
+struct bench_packet_t {
+	uint32_t data[MDNS_SPLIT_PACKET_SIZE / 4];
+	size_t size;
+	// Offset of the answer section, and the entries of all sections
+	size_t answer_offset;
+	size_t entry_count;
+	mdns_packet_entry_t entry[BENCH_ENTRIES_MAX];
+};
+
+struct bench_count_t {
+	// Number of operations, and number of packets and bytes they processed
+	size_t ops;
+	size_t packets;
+	size_t bytes;
+};
+
+// IPP printer announcement laid out as printers send it, with names compressed across records and a
+// large TXT record: PTR answer for _ipp._tcp.local. and SRV, TXT, A and AAAA additional records
+static const uint8_t bench_printer_packet[] = {
+	0x00, 0x00, 0x84, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x04, 0x04, 0x5f, 0x69, 0x70,
+	0x70, 0x04, 0x5f, 0x74, 0x63, 0x70, 0x05, 0x6c, 0x6f, 0x63, 0x61, 0x6c, 0x00, 0x00, 0x0c, 0x00,
+	0x01, 0x00, 0x00, 0x11, 0x94, 0x00, 0x11, 0x0e, 0x4f, 0x66, 0x66, 0x69, 0x63, 0x65, 0x20, 0x50,
+	0x72, 0x69, 0x6e, 0x74, 0x65, 0x72, 0xc0, 0x0c, 0xc0, 0x27, 0x00, 0x21, 0x80, 0x01, 0x00, 0x00,
+	0x00, 0x78, 0x00, 0x15, 0x00, 0x00, 0x00, 0x00, 0x02, 0x77, 0x0c, 0x70, 0x72, 0x69, 0x6e, 0x74,
+	0x65, 0x72, 0x2d, 0x33, 0x66, 0x32, 0x61, 0xc0, 0x16, 0xc0, 0x27, 0x00, 0x10, 0x80, 0x01, 0x00,
+	0x00, 0x11, 0x94, 0x01, 0x78, 0x09, 0x74, 0x78, 0x74, 0x76, 0x65, 0x72, 0x73, 0x3d, 0x31, 0x08,
+	0x71, 0x74, 0x6f, 0x74, 0x61, 0x6c, 0x3d, 0x31, 0x0c, 0x72, 0x70, 0x3d, 0x69, 0x70, 0x70, 0x2f,
+	0x70, 0x72, 0x69, 0x6e, 0x74, 0x19, 0x74, 0x79, 0x3d, 0x4f, 0x66, 0x66, 0x69, 0x63, 0x65, 0x20,
+	0x50, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x20, 0x4d, 0x58, 0x2d, 0x34, 0x31, 0x30, 0x30, 0x11,
+	0x70, 0x72, 0x6f, 0x64, 0x75, 0x63, 0x74, 0x3d, 0x28, 0x4d, 0x58, 0x2d, 0x34, 0x31, 0x30, 0x30,
+	0x29, 0x11, 0x6e, 0x6f, 0x74, 0x65, 0x3d, 0x53, 0x65, 0x63, 0x6f, 0x6e, 0x64, 0x20, 0x66, 0x6c,
+	0x6f, 0x6f, 0x72, 0x2e, 0x70, 0x64, 0x6c, 0x3d, 0x61, 0x70, 0x70, 0x6c, 0x69, 0x63, 0x61, 0x74,
+	0x69, 0x6f, 0x6e, 0x2f, 0x70, 0x64, 0x66, 0x2c, 0x69, 0x6d, 0x61, 0x67, 0x65, 0x2f, 0x75, 0x72,
+	0x66, 0x2c, 0x69, 0x6d, 0x61, 0x67, 0x65, 0x2f, 0x70, 0x77, 0x67, 0x2d, 0x72, 0x61, 0x73, 0x74,
+	0x65, 0x72, 0x3c, 0x55, 0x52, 0x46, 0x3d, 0x57, 0x38, 0x2c, 0x53, 0x52, 0x47, 0x42, 0x32, 0x34,
+	0x2c, 0x43, 0x50, 0x31, 0x2c, 0x49, 0x53, 0x31, 0x2d, 0x34, 0x2c, 0x4d, 0x54, 0x31, 0x2d, 0x33,
+	0x2d, 0x34, 0x2d, 0x35, 0x2d, 0x38, 0x2c, 0x4f, 0x42, 0x31, 0x30, 0x2c, 0x50, 0x51, 0x34, 0x2d,
+	0x35, 0x2c, 0x52, 0x53, 0x33, 0x30, 0x30, 0x2d, 0x36, 0x30, 0x30, 0x2c, 0x44, 0x4d, 0x31, 0x29,
+	0x55, 0x55, 0x49, 0x44, 0x3d, 0x35, 0x64, 0x34, 0x61, 0x32, 0x63, 0x37, 0x65, 0x2d, 0x38, 0x66,
+	0x31, 0x62, 0x2d, 0x34, 0x63, 0x33, 0x64, 0x2d, 0x39, 0x65, 0x32, 0x61, 0x2d, 0x30, 0x62, 0x37,
+	0x63, 0x36, 0x64, 0x35, 0x65, 0x34, 0x66, 0x33, 0x61, 0x07, 0x43, 0x6f, 0x6c, 0x6f, 0x72, 0x3d,
+	0x54, 0x08, 0x44, 0x75, 0x70, 0x6c, 0x65, 0x78, 0x3d, 0x54, 0x07, 0x54, 0x4c, 0x53, 0x3d, 0x31,
+	0x2e, 0x32, 0x14, 0x6d, 0x6f, 0x70, 0x72, 0x69, 0x61, 0x2d, 0x63, 0x65, 0x72, 0x74, 0x69, 0x66,
+	0x69, 0x65, 0x64, 0x3d, 0x32, 0x2e, 0x30, 0x1c, 0x6b, 0x69, 0x6e, 0x64, 0x3d, 0x64, 0x6f, 0x63,
+	0x75, 0x6d, 0x65, 0x6e, 0x74, 0x2c, 0x65, 0x6e, 0x76, 0x65, 0x6c, 0x6f, 0x70, 0x65, 0x2c, 0x70,
+	0x68, 0x6f, 0x74, 0x6f, 0x11, 0x50, 0x61, 0x70, 0x65, 0x72, 0x4d, 0x61, 0x78, 0x3d, 0x6c, 0x65,
+	0x67, 0x61, 0x6c, 0x2d, 0x41, 0x34, 0x0f, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x2d, 0x73,
+	0x74, 0x61, 0x74, 0x65, 0x3d, 0x33, 0x16, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x2d, 0x74,
+	0x79, 0x70, 0x65, 0x3d, 0x30, 0x78, 0x34, 0x38, 0x30, 0x39, 0x30, 0x30, 0x45, 0xc0, 0x44, 0x00,
+	0x01, 0x80, 0x01, 0x00, 0x00, 0x00, 0x78, 0x00, 0x04, 0xc0, 0xa8, 0x01, 0x2a, 0xc0, 0x44, 0x00,
+	0x1c, 0x80, 0x01, 0x00, 0x00, 0x00, 0x78, 0x00, 0x10, 0xfe, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x02, 0x11, 0x22, 0xff, 0xfe, 0x33, 0x44, 0x55,
+};
+
+static bench_packet_t bench_corpus[BENCH_PACKETS_MAX];
+static size_t bench_corpus_count;
+static size_t bench_corpus_bytes;
+
+// Decoded record names, and the same names in upper case, for the label compare benchmarks
+static char bench_name[BENCH_NAMES_MAX][256];
+static char bench_name_upper[BENCH_NAMES_MAX][256];
+static size_t bench_name_length[BENCH_NAMES_MAX];
+static size_t bench_name_count;
+
+static char bench_service_name[BENCH_SERVICES * 2][64];
+static mdns_record_t bench_answer[BENCH_SERVICES];
+static mdns_record_t bench_additional[BENCH_SERVICES * 4];
+static mdns_template_t* bench_template;
+
+static uint32_t bench_buffer[MDNS_SPLIT_PACKET_SIZE / 4];
+static char bench_strbuffer[256];
+static volatile size_t bench_sink;
+
+static void
+bench_corpus_add(const void* data, size_t size) {
+	if ((bench_corpus_count >= BENCH_PACKETS_MAX) || !size || (size > sizeof(bench_corpus[0].data)))
+		return;
+	bench_packet_t* packet = bench_corpus + bench_corpus_count++;
+	memcpy(packet->data, data, size);
+	packet->size = size;
+	bench_corpus_bytes += size;
+
+	mdns_packet_cursor_t cursor;
+	mdns_packet_entry_t entry;
+	mdns_packet_cursor_initialize(&cursor, 0, packet->data, size);
+	packet->answer_offset = 0;
+	packet->entry_count = 0;
+	while ((packet->entry_count < BENCH_ENTRIES_MAX) && mdns_packet_cursor_next(&cursor, &entry)) {
+		if ((entry.section != MDNS_ENTRYTYPE_QUESTION) && !packet->answer_offset)
+			packet->answer_offset = entry.name_offset;
+		packet->entry[packet->entry_count++] = entry;
+
+		size_t offset = entry.name_offset;
+		string_const_t name = mdns_string_extract(packet->data, size, &offset, bench_name[bench_name_count],
+		                                          sizeof(bench_name[0]));
+		for (size_t ichr = 0; ichr < name.length; ++ichr) {
+			char c = name.str[ichr];
+			bench_name_upper[bench_name_count][ichr] = ((c >= 'a') && (c <= 'z')) ? (char)(c - 0x20) : c;
+		}
+		bench_name_length[bench_name_count++] = name.length;
+	}
+	if (!packet->answer_offset)
+		packet->answer_offset = size;
+}
+
+static void
+bench_records_initialize(void) {
+	for (int isvc = 0; isvc < BENCH_SERVICES; ++isvc) {
+		string_t instance = string_format(bench_service_name[isvc], sizeof(bench_service_name[isvc]),
+		                                  STRING_CONST("Living Room Speaker %d._http._tcp.local."), isvc);
+		string_t host = string_format(bench_service_name[BENCH_SERVICES + isvc],
+		                              sizeof(bench_service_name[BENCH_SERVICES + isvc]),
+		                              STRING_CONST("speaker-%d.local."), isvc);
+
+		mdns_record_t* answer = bench_answer + isvc;
+		memset(answer, 0, sizeof(mdns_record_t));
+		answer->name = string_const(STRING_CONST("_http._tcp.local."));
+		answer->type = MDNS_RECORDTYPE_PTR;
+		answer->data.ptr.name = string_const(STRING_ARGS(instance));
+
+		mdns_record_t* additional = bench_additional + (isvc * 4);
+		memset(additional, 0, sizeof(mdns_record_t) * 4);
+		additional[0].name = string_const(STRING_ARGS(instance));
+		additional[0].type = MDNS_RECORDTYPE_SRV;
+		additional[0].data.srv.port = 8080;
+		additional[0].data.srv.name = string_const(STRING_ARGS(host));
+		additional[1].name = string_const(STRING_ARGS(instance));
+		additional[1].type = MDNS_RECORDTYPE_TXT;
+		additional[1].data.txt.key = string_const(STRING_CONST("path"));
+		additional[1].data.txt.value = string_const(STRING_CONST("/index.html"));
+		additional[2].name = string_const(STRING_ARGS(host));
+		additional[2].type = MDNS_RECORDTYPE_A;
+		additional[2].data.a.addr.sin_family = AF_INET;
+		additional[2].data.a.addr.sin_addr.s_addr = htonl(0xC0A80010U + (uint32_t)isvc);
+		additional[3].name = string_const(STRING_ARGS(host));
+		additional[3].type = MDNS_RECORDTYPE_AAAA;
+		additional[3].data.aaaa.addr.sin6_family = AF_INET6;
+		additional[3].data.aaaa.addr.sin6_addr.s6_addr[0] = 0xFE;
+		additional[3].data.aaaa.addr.sin6_addr.s6_addr[1] = 0x80;
+		additional[3].data.aaaa.addr.sin6_addr.s6_addr[15] = (uint8_t)isvc;
+	}
+}
+
+static void
+bench_corpus_initialize(void) {
+	bench_records_initialize();
+
+	// Response with all records of a few services, as sent by a responder answering a browse
+	mdns_builder_t builder;
+	mdns_builder_initialize(&builder, bench_buffer, sizeof(bench_buffer), 0, 0x8400);
+	for (int isvc = 0; isvc < BENCH_SERVICES; ++isvc)
+		mdns_builder_add_answer(&builder, bench_answer + isvc);
+	for (int iadd = 0; iadd < BENCH_SERVICES * 4; ++iadd)
+		mdns_builder_add_additional(&builder, bench_additional + iadd);
+	bench_corpus_add(bench_buffer, mdns_builder_size(&builder));
+
+	// Browse query listing the services as known answers
+	bench_corpus_add(bench_buffer,
+	                 mdns_query_build(bench_buffer, sizeof(bench_buffer), MDNS_RECORDTYPE_PTR,
+	                                  STRING_CONST("_http._tcp.local."), 0, false, bench_answer, BENCH_SERVICES));
+
+	// Response to a DNS-SD service type enumeration
+	static const string_const_t service_type[] = {
+	    {STRING_CONST("_http._tcp.local.")},       {STRING_CONST("_ipp._tcp.local.")},
+	    {STRING_CONST("_airplay._tcp.local.")},    {STRING_CONST("_raop._tcp.local.")},
+	    {STRING_CONST("_googlecast._tcp.local.")}, {STRING_CONST("_spotify-connect._tcp.local.")},
+	    {STRING_CONST("_smb._tcp.local.")},        {STRING_CONST("_ssh._tcp.local.")}};
+	mdns_builder_initialize(&builder, bench_buffer, sizeof(bench_buffer), 0, 0x8400);
+	for (size_t itype = 0; itype < sizeof(service_type) / sizeof(service_type[0]); ++itype) {
+		mdns_record_t record;
+		memset(&record, 0, sizeof(record));
+		record.name = string_const(STRING_CONST("_services._dns-sd._udp.local."));
+		record.type = MDNS_RECORDTYPE_PTR;
+		record.data.ptr.name = service_type[itype];
+		mdns_builder_add_answer(&builder, &record);
+	}
+	bench_corpus_add(bench_buffer, mdns_builder_size(&builder));
+
+	bench_corpus_add(bench_printer_packet, sizeof(bench_printer_packet));
+
+	bench_template = mdns_template_allocate();
+	mdns_template_set(bench_template, bench_answer, BENCH_SERVICES, 0, 0, bench_additional, BENCH_SERVICES * 4);
+}
+
+static void
+bench_corpus_pass(bench_count_t* count) {
+	count->packets += bench_corpus_count;
+	count->bytes += bench_corpus_bytes;
+}
+
+static void
+bench_packet_cursor(bench_count_t* count) {
+	mdns_packet_cursor_t cursor;
+	mdns_packet_entry_t entry;
+	for (size_t ipacket = 0; ipacket < bench_corpus_count; ++ipacket) {
+		const bench_packet_t* packet = bench_corpus + ipacket;
+		mdns_packet_cursor_initialize(&cursor, 0, packet->data, packet->size);
+		while (mdns_packet_cursor_next(&cursor, &entry))
+			bench_sink += entry.record_length;
+		++count->ops;
+	}
+	bench_corpus_pass(count);
+}
+
+static void
+bench_string_extract(bench_count_t* count) {
+	for (size_t ipacket = 0; ipacket < bench_corpus_count; ++ipacket) {
+		const bench_packet_t* packet = bench_corpus + ipacket;
+		for (size_t ientry = 0; ientry < packet->entry_count; ++ientry) {
+			size_t offset = packet->entry[ientry].name_offset;
+			string_const_t name =
+			    mdns_string_extract(packet->data, packet->size, &offset, bench_strbuffer, sizeof(bench_strbuffer));
+			bench_sink += name.length;
+			++count->ops;
+		}
+	}
+	bench_corpus_pass(count);
+}
+
+static void
+bench_string_equal(bench_count_t* count) {
+	// Compare each name with the next, mixing equal names and names sharing a compressed suffix
+	for (size_t ipacket = 0; ipacket < bench_corpus_count; ++ipacket) {
+		const bench_packet_t* packet = bench_corpus + ipacket;
+		for (size_t ientry = 0; ientry + 1 < packet->entry_count; ++ientry) {
+			size_t lhs = packet->entry[ientry].name_offset;
+			size_t rhs = packet->entry[ientry + 1].name_offset;
+			bench_sink += (size_t)mdns_string_equal(packet->data, packet->size, &lhs, packet->data, packet->size, &rhs);
+			++count->ops;
+		}
+	}
+	bench_corpus_pass(count);
+}
+
+static void
+bench_string_make(bench_count_t* count) {
+	// Encode the names of each packet into a new packet sharing one compression dictionary
+	static mdns_string_table_t string_table;
+	for (size_t ipacket = 0; ipacket < bench_corpus_count; ++ipacket) {
+		const bench_packet_t* packet = bench_corpus + ipacket;
+		mdns_string_table_initialize(&string_table);
+		void* data = pointer_offset(bench_buffer, sizeof(struct mdns_header_t));
+		for (size_t iname = 0; iname < packet->entry_count; ++iname) {
+			size_t offset = packet->entry[iname].name_offset;
+			string_const_t name =
+			    mdns_string_extract(packet->data, packet->size, &offset, bench_strbuffer, sizeof(bench_strbuffer));
+			void* next = mdns_string_make(bench_buffer, sizeof(bench_buffer), data, STRING_ARGS(name), &string_table);
+			if (next)
+				data = next;
+			++count->ops;
+		}
+		bench_sink += (size_t)pointer_diff(data, bench_buffer);
+	}
+	bench_corpus_pass(count);
+}
+
+static int
+bench_record_callback(socket_t* sock, const network_address_t* from, mdns_entry_type_t entry, uint16_t query_id,
+                      uint16_t rtype, uint16_t rclass, uint32_t ttl, const void* data, size_t size, size_t name_offset,
+                      size_t name_length, size_t record_offset, size_t record_length, void* user_data) {
+	(void)sizeof(sock);
+	(void)sizeof(from);
+	(void)sizeof(entry);
+	(void)sizeof(query_id);
+	(void)sizeof(rclass);
+	(void)sizeof(ttl);
+	(void)sizeof(data);
+	(void)sizeof(size);
+	(void)sizeof(name_offset);
+	(void)sizeof(name_length);
+	(void)sizeof(record_offset);
+	*(size_t*)user_data += rtype + record_length;
+	return 0;
+}
+
+static void
+bench_records_parse(bench_count_t* count) {
+	size_t total = 0;
+	for (size_t ipacket = 0; ipacket < bench_corpus_count; ++ipacket) {
+		const bench_packet_t* packet = bench_corpus + ipacket;
+		const struct mdns_header_t* header = (const struct mdns_header_t*)(const void*)packet->data;
+		size_t offset = packet->answer_offset;
+		count->ops += mdns_records_parse(0, 0, packet->data, packet->size, &offset, MDNS_ENTRYTYPE_ANSWER, 0,
+		                                 ntohs(header->answer_rrs), bench_record_callback, &total);
+		count->ops += mdns_records_parse(0, 0, packet->data, packet->size, &offset, MDNS_ENTRYTYPE_AUTHORITY, 0,
+		                                 ntohs(header->authority_rrs), bench_record_callback, &total);
+		count->ops += mdns_records_parse(0, 0, packet->data, packet->size, &offset, MDNS_ENTRYTYPE_ADDITIONAL, 0,
+		                                 ntohs(header->additional_rrs), bench_record_callback, &total);
+	}
+	bench_sink += total;
+	bench_corpus_pass(count);
+}
+
+static void
+bench_record_parse_txt(bench_count_t* count) {
+	mdns_record_txt_t records[32];
+	for (size_t ipacket = 0; ipacket < bench_corpus_count; ++ipacket) {
+		const bench_packet_t* packet = bench_corpus + ipacket;
+		for (size_t ientry = 0; ientry < packet->entry_count; ++ientry) {
+			const mdns_packet_entry_t* entry = packet->entry + ientry;
+			if ((entry->section == MDNS_ENTRYTYPE_QUESTION) || (entry->rtype != MDNS_RECORDTYPE_TXT))
+				continue;
+			bench_sink += mdns_record_parse_txt(packet->data, packet->size, entry->record_offset,
+			                                    entry->record_length, records, sizeof(records) / sizeof(records[0]));
+			++count->ops;
+		}
+	}
+	bench_corpus_pass(count);
+}
+
+static void
+bench_record_txt_find(bench_count_t* count) {
+	string_const_t value;
+	for (size_t ipacket = 0; ipacket < bench_corpus_count; ++ipacket) {
+		const bench_packet_t* packet = bench_corpus + ipacket;
+		for (size_t ientry = 0; ientry < packet->entry_count; ++ientry) {
+			const mdns_packet_entry_t* entry = packet->entry + ientry;
+			if ((entry->section == MDNS_ENTRYTYPE_QUESTION) || (entry->rtype != MDNS_RECORDTYPE_TXT))
+				continue;
+			if (mdns_record_txt_find(packet->data, packet->size, entry->record_offset, entry->record_length,
+			                         STRING_CONST("UUID"), &value))
+				bench_sink += value.length;
+			++count->ops;
+		}
+	}
+	bench_corpus_pass(count);
+}
+
+static void
+bench_record_parse_srv(bench_count_t* count) {
+	for (size_t ipacket = 0; ipacket < bench_corpus_count; ++ipacket) {
+		const bench_packet_t* packet = bench_corpus + ipacket;
+		for (size_t ientry = 0; ientry < packet->entry_count; ++ientry) {
+			const mdns_packet_entry_t* entry = packet->entry + ientry;
+			if ((entry->section == MDNS_ENTRYTYPE_QUESTION) || (entry->rtype != MDNS_RECORDTYPE_SRV))
+				continue;
+			mdns_record_srv_t srv = mdns_record_parse_srv(packet->data, packet->size, entry->record_offset,
+			                                              entry->record_length, bench_strbuffer,
+			                                              sizeof(bench_strbuffer));
+			bench_sink += srv.port + srv.name.length;
+			++count->ops;
+		}
+	}
+	bench_corpus_pass(count);
+}
+
+// Byte by byte case-insensitive compare, the reference for the vectorized mdns_string_equal_nocase
+static int
+bench_equal_nocase_bytewise(const char* lhs, const char* rhs, size_t length) {
+	for (size_t ichr = 0; ichr < length; ++ichr) {
+		char lhs_chr = ((lhs[ichr] >= 'A') && (lhs[ichr] <= 'Z')) ? (char)(lhs[ichr] | 0x20) : lhs[ichr];
+		char rhs_chr = ((rhs[ichr] >= 'A') && (rhs[ichr] <= 'Z')) ? (char)(rhs[ichr] | 0x20) : rhs[ichr];
+		if (lhs_chr != rhs_chr)
+			return 0;
+	}
+	return 1;
+}
+
+static void
+bench_label_compare(bench_count_t* count) {
+	for (size_t iname = 0; iname < bench_name_count; ++iname) {
+		bench_sink +=
+		    (size_t)mdns_string_equal_nocase(bench_name[iname], bench_name_upper[iname], bench_name_length[iname]);
+		count->bytes += bench_name_length[iname];
+		++count->ops;
+	}
+}
+
+static void
+bench_label_compare_bytewise(bench_count_t* count) {
+	for (size_t iname = 0; iname < bench_name_count; ++iname) {
+		bench_sink +=
+		    (size_t)bench_equal_nocase_bytewise(bench_name[iname], bench_name_upper[iname], bench_name_length[iname]);
+		count->bytes += bench_name_length[iname];
+		++count->ops;
+	}
+}
+
+static void
+bench_answer_build(bench_count_t* count) {
+	for (int isvc = 0; isvc < BENCH_SERVICES; ++isvc) {
+		count->bytes += mdns_query_answer_multicast_build(bench_buffer, sizeof(bench_buffer), bench_answer[isvc], 0,
+		                                                  0, bench_additional + (isvc * 4), 4);
+		++count->packets;
+		++count->ops;
+	}
+}
+
+static void
+bench_builder(bench_count_t* count) {
+	mdns_builder_t builder;
+	mdns_builder_initialize(&builder, bench_buffer, sizeof(bench_buffer), 0, 0x8400);
+	for (int isvc = 0; isvc < BENCH_SERVICES; ++isvc)
+		mdns_builder_add_answer(&builder, bench_answer + isvc);
+	for (int iadd = 0; iadd < BENCH_SERVICES * 4; ++iadd)
+		mdns_builder_add_additional(&builder, bench_additional + iadd);
+	count->bytes += mdns_builder_size(&builder);
+	++count->packets;
+	++count->ops;
+}
+
+static void
+bench_template_build(bench_count_t* count) {
+	count->bytes += mdns_template_build(bench_template, bench_buffer, sizeof(bench_buffer), 0, MDNS_CLASS_IN, 120);
+	++count->packets;
+	++count->ops;
+}
+
+static void
+bench_query_build(bench_count_t* count) {
+	count->bytes += mdns_query_build(bench_buffer, sizeof(bench_buffer), MDNS_RECORDTYPE_PTR,
+	                                 STRING_CONST("_http._tcp.local."), 0, false, bench_answer, BENCH_SERVICES);
+	++count->packets;
+	++count->ops;
+}
+
+static void
+bench_run(const char* name, bench_fn fn) {
+	bench_count_t count = {0, 0, 0};
+	tick_t start = time_current();
+	deltatime_t elapsed = 0;
+	do {
+		for (int ibatch = 0; ibatch < BENCH_BATCH; ++ibatch)
+			fn(&count);
+		elapsed = time_elapsed(start);
+	} while (elapsed < BENCH_TIME_MIN);
+
+	double ns_per_op = count.ops ? ((double)elapsed * 1000000000.0) / (double)count.ops : 0;
+	double packets_per_second = (double)count.packets / (double)elapsed;
+	double bytes_per_second = (double)count.bytes / (double)elapsed;
+	log_infof(HASH_MDNS, STRING_CONST("%-24s %10.1f ns/op %12.0f packets/s %10.1f MiB/s"), name, ns_per_op,
+	          packets_per_second, bytes_per_second / (1024.0 * 1024.0));
+}
+
+int
+main_initialize(void) {
+	int ret = 0;
+	application_t application = {0};
+	foundation_config_t config = {0};
+
+	application.name = string_const(STRING_CONST("bench-mdns"));
+	application.short_name = string_const(STRING_CONST("bench-mdns"));
+	application.flags = APPLICATION_UTILITY;
+
+	log_enable_prefix(false);
+	log_set_suppress(0, ERRORLEVEL_WARNING);
+
+	if ((ret = foundation_initialize(memory_system_malloc(), application, config)) < 0)
+		return ret;
+
+	network_config_t network_config = {0};
+	if ((ret = network_module_initialize(network_config)) < 0)
+		return ret;
+
+	mdns_config_t mdns_config = {0};
+	if ((ret = mdns_module_initialize(mdns_config)) < 0)
+		return ret;
+
+	return 0;
+}
+
+int
+main_run(void* main_arg) {
+	FOUNDATION_UNUSED(main_arg);
+
+	bench_corpus_initialize();
+	log_infof(HASH_MDNS, STRING_CONST("Corpus of %u packets, %u bytes, %u names\n"), (unsigned int)bench_corpus_count,
+	          (unsigned int)bench_corpus_bytes, (unsigned int)bench_name_count);
+
+	bench_run("packet_cursor", bench_packet_cursor);
+	bench_run("string_extract", bench_string_extract);
+	bench_run("string_equal", bench_string_equal);
+	bench_run("string_make", bench_string_make);
+	bench_run("records_parse", bench_records_parse);
+	bench_run("record_parse_txt", bench_record_parse_txt);
+	bench_run("record_txt_find", bench_record_txt_find);
+	bench_run("record_parse_srv", bench_record_parse_srv);
+	bench_run("label_compare", bench_label_compare);
+	bench_run("label_compare_bytewise", bench_label_compare_bytewise);
+	bench_run("answer_multicast_build", bench_answer_build);
+	bench_run("builder", bench_builder);
+	bench_run("template_build", bench_template_build);
+	bench_run("query_build_known", bench_query_build);
+
+	mdns_template_deallocate(bench_template);
+	bench_template = 0;
+	return 0;
+}
+
+void
+main_finalize(void) {
+	mdns_module_finalize();
+	network_module_finalize();
+	foundation_finalize();
+}
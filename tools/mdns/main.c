@@ -3,6 +3,8 @@
 #include <network/network.h>
 #include <mdns/mdns.h>
 
+#include <stdlib.h>
+
 static char recvbuffer[1024];
 static char addrbuffer[256];
 static char entrybuffer[256];
@@ -67,6 +69,509 @@ query_callback(socket_t* sock, const network_address_t* from, mdns_entry_type_t
 	return 0;
 }
 
+#define STRESS_THREADS_MAX 64
+#define STRESS_SERVICES_MAX 1024
+#define STRESS_SOURCES_MAX 256
+#define STRESS_NAME_MAX 64
+// Query IDs hold the querier number above a wrapping per querier sequence number
+#define STRESS_SEQUENCE_BITS 9
+#define STRESS_SEQUENCE_MASK ((1U << STRESS_SEQUENCE_BITS) - 1)
+
+typedef struct stress_name_t stress_name_t;
+typedef struct stress_flood_t stress_flood_t;
+typedef struct stress_source_t stress_source_t;
+typedef struct stress_publish_t stress_publish_t;
+
+struct stress_name_t {
+	char str[STRESS_NAME_MAX];
+	size_t length;
+};
+
+// Query sender thread, one socket on the mDNS port sending multicast queries on loopback. Answers are
+// multicast responses seen by all queriers, so an answer covers all outstanding queries for its service
+struct stress_flood_t {
+	thread_t thread;
+	socket_t* sock;
+	// Querier number sent in the query IDs, starting at 1
+	unsigned int querier;
+	// Send tick of the oldest unanswered query and number of unanswered queries, by service
+	tick_t* pending_tick;
+	size_t* pending_count;
+	// Answer latency in ticks, from the oldest query covered by the answer
+	tick_t* latency;
+	size_t latency_capacity;
+	size_t latency_count;
+	size_t sent;
+	size_t answered;
+	size_t failed;
+	uint32_t buffer[512];
+};
+
+// Last sequence number seen from a querier, to count questions lost on the way to the responder
+struct stress_source_t {
+	uint16_t port;
+	uint16_t querier;
+	uint16_t sequence;
+};
+
+// Responder thread publishing the synthetic services from a record store
+struct stress_publish_t {
+	thread_t thread;
+	socket_t* sock;
+	mdns_store_t* store;
+	mdns_loop_t* loop;
+	stress_source_t source[STRESS_SOURCES_MAX];
+	size_t source_count;
+	// Time to answer or schedule the answer to each question in ticks
+	tick_t* latency;
+	size_t latency_capacity;
+	size_t questions;
+	size_t answered;
+	size_t missed;
+	// Receive buffer for the event loop, split in slots to receive batches of questions
+	uint32_t buffer[(MDNS_LOOP_DATAGRAM_SIZE * 16) / sizeof(uint32_t)];
+};
+
+static unsigned int stress_qps = 1000;
+static unsigned int stress_threads = 4;
+static unsigned int stress_services = 16;
+static unsigned int stress_duration = 10;
+static atomic32_t stress_stop;
+static stress_name_t stress_service[STRESS_SERVICES_MAX];
+
+static int
+stress_tick_compare(const void* lhs, const void* rhs) {
+	tick_t lhs_tick = *(const tick_t*)lhs;
+	tick_t rhs_tick = *(const tick_t*)rhs;
+	return (lhs_tick < rhs_tick) ? -1 : ((lhs_tick > rhs_tick) ? 1 : 0);
+}
+
+static double
+stress_percentile(const tick_t* latency, size_t count, double percentile) {
+	if (!count)
+		return 0;
+	size_t index = (size_t)(percentile * (double)(count - 1) + 0.5);
+	return ((double)latency[index] * 1000.0) / (double)time_ticks_per_second();
+}
+
+static void
+stress_report_latency(const char* what, size_t length, tick_t* latency, size_t count) {
+	qsort(latency, count, sizeof(tick_t), stress_tick_compare);
+	log_infof(HASH_MDNS,
+	          STRING_CONST("%.*s latency p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, p99.9 %.3f ms, max %.3f ms"),
+	          (int)length, what, stress_percentile(latency, count, 0.5), stress_percentile(latency, count, 0.9),
+	          stress_percentile(latency, count, 0.99), stress_percentile(latency, count, 0.999),
+	          stress_percentile(latency, count, 1.0));
+}
+
+// Stress traffic publishes made up records and must never reach the network. Bind to the mDNS port on
+// any address, since group traffic is only delivered to sockets bound to the wildcard or group address,
+// but join the mDNS group on the loopback interface only and send multicast on the loopback interface
+// only. Fails if any of it cannot be set up
+static bool
+stress_socket_bind(socket_t* sock) {
+	socket_set_reuse_address(sock, true);
+	socket_set_reuse_port(sock, true);
+	socket_set_blocking(sock, false);
+	if (sock->fd < 0)
+		sock->family = NETWORK_ADDRESSFAMILY_IPV4;
+	if (!socket_create(sock))
+		return false;
+
+	struct ip_mreq membership;
+	membership.imr_multiaddr.s_addr = htonl((((uint32_t)224U) << 24U) | (uint32_t)251U);
+	membership.imr_interface.s_addr = htonl(INADDR_LOOPBACK);
+#if FOUNDATION_PLATFORM_WINDOWS
+	DWORD multicast_loop = 1;
+#else
+	unsigned char multicast_loop = 1;
+#endif
+	if (setsockopt(sock->fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, (const char*)&membership, sizeof(membership)) < 0)
+		return false;
+	if (setsockopt(sock->fd, IPPROTO_IP, IP_MULTICAST_IF, (const char*)&membership.imr_interface,
+	               sizeof(membership.imr_interface)) < 0)
+		return false;
+	if (setsockopt(sock->fd, IPPROTO_IP, IP_MULTICAST_LOOP, (const char*)&multicast_loop, sizeof(multicast_loop)) < 0)
+		return false;
+
+	network_address_ipv4_t address;
+	network_address_ipv4_initialize(&address);
+	network_address_ipv4_set_ip((network_address_t*)&address, INADDR_ANY);
+	network_address_ip_set_port((network_address_t*)&address, MDNS_PORT);
+	return socket_bind(sock, (const network_address_t*)&address);
+}
+
+// Get the index of the synthetic service with the name at the given offset, or -1 if not a stress service
+static int
+stress_service_index(const void* data, size_t size, size_t name_offset) {
+	char namebuffer[STRESS_NAME_MAX];
+	size_t offset = name_offset;
+	string_const_t name = mdns_string_extract(data, size, &offset, namebuffer, sizeof(namebuffer));
+	if ((name.length < 7) || !string_equal(name.str, 7, STRING_CONST("_stress")))
+		return -1;
+	unsigned int index = 0;
+	size_t ichr = 7;
+	for (; (ichr < name.length) && (name.str[ichr] >= '0') && (name.str[ichr] <= '9'); ++ichr)
+		index = (index * 10) + (unsigned int)(name.str[ichr] - '0');
+	if ((ichr == 7) || (index >= stress_services) ||
+	    !string_equal(STRING_ARGS(name), stress_service[index].str, stress_service[index].length))
+		return -1;
+	return (int)index;
+}
+
+static int
+stress_flood_callback(socket_t* sock, const network_address_t* from, mdns_entry_type_t entry, uint16_t query_id,
+                      uint16_t rtype, uint16_t rclass, uint32_t ttl, const void* data, size_t size,
+                      size_t name_offset, size_t name_length, size_t record_offset, size_t record_length,
+                      void* user_data) {
+	(void)sizeof(sock);
+	(void)sizeof(from);
+	(void)sizeof(query_id);
+	(void)sizeof(rclass);
+	(void)sizeof(ttl);
+	(void)sizeof(name_length);
+	(void)sizeof(record_offset);
+	(void)sizeof(record_length);
+	if ((entry != MDNS_ENTRYTYPE_ANSWER) || (rtype != MDNS_RECORDTYPE_PTR))
+		return 0;
+
+	// Multicast responses do not echo the query ID, match the answer to the queries by service name.
+	// Answers with no queries outstanding, such as for the queries of other threads, are ignored
+	stress_flood_t* flood = user_data;
+	int iservice = stress_service_index(data, size, name_offset);
+	if ((iservice < 0) || !flood->pending_count[iservice])
+		return 0;
+	if (flood->latency_count < flood->latency_capacity)
+		flood->latency[flood->latency_count++] = time_current() - flood->pending_tick[iservice];
+	flood->answered += flood->pending_count[iservice];
+	flood->pending_count[iservice] = 0;
+	return 0;
+}
+
+static void*
+stress_flood_thread(void* arg) {
+	stress_flood_t* flood = arg;
+	tick_t ticks_per_second = time_ticks_per_second();
+	tick_t interval = (ticks_per_second * (tick_t)stress_threads) / (tick_t)stress_qps;
+	if (interval < 1)
+		interval = 1;
+
+	tick_t now = time_current();
+	tick_t end = now + ticks_per_second * (tick_t)stress_duration;
+	tick_t next = now;
+	unsigned int sequence = 0;
+	// Keep receiving for half a second after the last query to collect late answers
+	while (now < end + (ticks_per_second / 2)) {
+		bool idle = true;
+		// Do not burst to catch up after a stall longer than 100 ms
+		if (next < now - (ticks_per_second / 10))
+			next = now;
+		while ((now < end) && (now >= next)) {
+			uint16_t query_id =
+			    (uint16_t)((flood->querier << STRESS_SEQUENCE_BITS) | (sequence++ & STRESS_SEQUENCE_MASK));
+			size_t iservice = (flood->sent + flood->failed) % stress_services;
+			const stress_name_t* name = stress_service + iservice;
+			size_t size = mdns_query_build(flood->buffer, sizeof(flood->buffer), MDNS_RECORDTYPE_PTR, name->str,
+			                               name->length, query_id, false, 0, 0);
+			if (!size || (mdns_multicast_send(flood->sock, flood->buffer, size) < 0)) {
+				++flood->failed;
+			} else {
+				if (!flood->pending_count[iservice])
+					flood->pending_tick[iservice] = now;
+				++flood->pending_count[iservice];
+				++flood->sent;
+			}
+			next += interval;
+			idle = false;
+		}
+		while (mdns_query_recv(flood->sock, flood->buffer, sizeof(flood->buffer), stress_flood_callback, flood, 0))
+			idle = false;
+		if (idle) {
+			if ((now < end) && (next - now < ticks_per_second / 1000))
+				thread_yield();
+			else
+				thread_sleep(1);
+		}
+		now = time_current();
+	}
+	return 0;
+}
+
+// Count gaps in the sequence numbers of each querier as questions lost before reaching the responder.
+// All queriers send from the mDNS port, so queriers are told apart by the number in the query ID
+static void
+stress_publish_track(stress_publish_t* publish, const network_address_t* from, uint16_t query_id) {
+	uint16_t querier = (uint16_t)(query_id >> STRESS_SEQUENCE_BITS);
+	uint16_t sequence = (uint16_t)(query_id & STRESS_SEQUENCE_MASK);
+	if (!from || !querier)
+		return;
+	uint16_t port = network_address_ip_port(from);
+	for (size_t isource = 0; isource < publish->source_count; ++isource) {
+		stress_source_t* source = publish->source + isource;
+		if ((source->port != port) || (source->querier != querier))
+			continue;
+		uint16_t gap = (uint16_t)((sequence - source->sequence - 1) & STRESS_SEQUENCE_MASK);
+		// Reordered or repeated questions do not move the sequence back
+		if (gap <= (STRESS_SEQUENCE_MASK / 2)) {
+			publish->missed += gap;
+			source->sequence = sequence;
+		}
+		return;
+	}
+	if (publish->source_count < STRESS_SOURCES_MAX) {
+		publish->source[publish->source_count].port = port;
+		publish->source[publish->source_count].querier = querier;
+		publish->source[publish->source_count].sequence = sequence;
+		++publish->source_count;
+	}
+}
+
+static int
+stress_publish_callback(socket_t* sock, const network_address_t* from, mdns_entry_type_t entry, uint16_t query_id,
+                        uint16_t rtype, uint16_t rclass, uint32_t ttl, const void* data, size_t size,
+                        size_t name_offset, size_t name_length, size_t record_offset, size_t record_length,
+                        void* user_data) {
+	(void)sizeof(ttl);
+	(void)sizeof(name_length);
+	(void)sizeof(record_offset);
+	(void)sizeof(record_length);
+	if (entry != MDNS_ENTRYTYPE_QUESTION)
+		return 0;
+
+	stress_publish_t* publish = user_data;
+	stress_publish_track(publish, from, query_id);
+	tick_t start = time_current();
+	size_t answers = mdns_store_schedule(publish->store, sock, from, data, size, query_id, rtype, rclass, name_offset);
+	if (publish->questions < publish->latency_capacity)
+		publish->latency[publish->questions] = time_current() - start;
+	++publish->questions;
+	if (answers)
+		++publish->answered;
+	return 0;
+}
+
+static void*
+stress_publish_thread(void* arg) {
+	stress_publish_t* publish = arg;
+	while (!atomic_load32(&stress_stop, memory_order_acquire))
+		mdns_loop_run(publish->loop, 100);
+	mdns_store_flush(publish->store, true);
+	return 0;
+}
+
+// Publish a PTR, SRV and TXT record for each synthetic service, all on one host with a loopback address
+static int
+stress_publish_initialize(stress_publish_t* publish) {
+	char namebuffer[STRESS_NAME_MAX];
+	char valuebuffer[16];
+	mdns_record_t record;
+
+	publish->sock = udp_socket_allocate();
+	if (!publish->sock || !stress_socket_bind(publish->sock)) {
+		log_error(HASH_MDNS, ERROR_SYSTEM_CALL_FAIL, STRING_CONST("Failed to bind mDNS responder socket"));
+		return -1;
+	}
+
+	publish->store = mdns_store_allocate(stress_services * 3 + 1);
+	memset(&record, 0, sizeof(record));
+	record.name = string_const(STRING_CONST("stress.local."));
+	record.type = MDNS_RECORDTYPE_A;
+	record.data.a.addr.sin_family = AF_INET;
+	record.data.a.addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	mdns_store_insert(publish->store, &record);
+
+	for (unsigned int iservice = 0; iservice < stress_services; ++iservice) {
+		string_t instance = string_format(namebuffer, sizeof(namebuffer), STRING_CONST("stress%u.%.*s"), iservice,
+		                                  (int)stress_service[iservice].length, stress_service[iservice].str);
+
+		memset(&record, 0, sizeof(record));
+		record.name = string_const(stress_service[iservice].str, stress_service[iservice].length);
+		record.type = MDNS_RECORDTYPE_PTR;
+		record.data.ptr.name = string_const(STRING_ARGS(instance));
+		mdns_store_insert(publish->store, &record);
+
+		memset(&record, 0, sizeof(record));
+		record.name = string_const(STRING_ARGS(instance));
+		record.type = MDNS_RECORDTYPE_SRV;
+		record.data.srv.port = (uint16_t)(10000 + iservice);
+		record.data.srv.name = string_const(STRING_CONST("stress.local."));
+		mdns_store_insert(publish->store, &record);
+
+		memset(&record, 0, sizeof(record));
+		record.name = string_const(STRING_ARGS(instance));
+		record.type = MDNS_RECORDTYPE_TXT;
+		record.data.txt.key = string_const(STRING_CONST("index"));
+		string_t value = string_format(valuebuffer, sizeof(valuebuffer), STRING_CONST("%u"), iservice);
+		record.data.txt.value = string_const(STRING_ARGS(value));
+		mdns_store_insert(publish->store, &record);
+	}
+
+	publish->loop = mdns_loop_allocate();
+	if (!publish->loop || (mdns_loop_add_socket(publish->loop, publish->sock, MDNS_LOOP_SERVICE, publish->buffer,
+	                                            sizeof(publish->buffer), stress_publish_callback, publish) < 0)) {
+		log_error(HASH_MDNS, ERROR_SYSTEM_CALL_FAIL, STRING_CONST("Failed to create mDNS event loop"));
+		return -1;
+	}
+	mdns_store_set_loop(publish->store, publish->loop);
+	return 0;
+}
+
+static void
+stress_publish_finalize(stress_publish_t* publish) {
+	mdns_loop_deallocate(publish->loop);
+	mdns_store_deallocate(publish->store);
+	if (publish->sock)
+		socket_deallocate(publish->sock);
+}
+
+static void
+stress_flood_report(stress_flood_t** flood, size_t count) {
+	size_t sent = 0;
+	size_t answered = 0;
+	size_t failed = 0;
+	size_t latency_count = 0;
+	for (size_t iflood = 0; iflood < count; ++iflood) {
+		sent += flood[iflood]->sent;
+		answered += flood[iflood]->answered;
+		failed += flood[iflood]->failed;
+		latency_count += flood[iflood]->latency_count;
+	}
+
+	log_infof(HASH_MDNS,
+	          STRING_CONST("Flood sent %u queries (%.0f/s) from %u threads, %u answered, %u send failures, "
+	                       "drop rate %.2f%%"),
+	          (unsigned int)sent, (double)sent / (double)stress_duration, (unsigned int)count,
+	          (unsigned int)answered, (unsigned int)failed,
+	          sent ? (100.0 * (double)(sent - answered)) / (double)sent : 0.0);
+	if (!latency_count)
+		return;
+
+	tick_t* latency = memory_allocate(HASH_MDNS, sizeof(tick_t) * latency_count, 0, MEMORY_PERSISTENT);
+	size_t offset = 0;
+	for (size_t iflood = 0; iflood < count; ++iflood) {
+		memcpy(latency + offset, flood[iflood]->latency, sizeof(tick_t) * flood[iflood]->latency_count);
+		offset += flood[iflood]->latency_count;
+	}
+	stress_report_latency(STRING_CONST("Answer"), latency, latency_count);
+	memory_deallocate(latency);
+}
+
+static void
+stress_publish_report(stress_publish_t* publish, deltatime_t elapsed) {
+	size_t total = publish->questions + publish->missed;
+	log_infof(HASH_MDNS,
+	          STRING_CONST("Responder served %u services, received %u questions (%.0f/s), answered %u, "
+	                       "missed %u, drop rate %.2f%%"),
+	          stress_services, (unsigned int)publish->questions,
+	          (elapsed > 0) ? (double)publish->questions / (double)elapsed : 0.0, (unsigned int)publish->answered,
+	          (unsigned int)publish->missed, total ? (100.0 * (double)publish->missed) / (double)total : 0.0);
+	size_t count = (publish->questions < publish->latency_capacity) ? publish->questions : publish->latency_capacity;
+	if (count)
+		stress_report_latency(STRING_CONST("Responder"), publish->latency, count);
+}
+
+// Run a local capacity test, publishing synthetic services and/or flooding questions for them over
+// loopback multicast. Run both in one process, or each in its own process to separate the load
+static int
+stress_run(bool flood_mode, bool publish_mode) {
+	int result = 0;
+	stress_publish_t* publish = 0;
+	stress_flood_t* flood[STRESS_THREADS_MAX];
+	size_t flood_count = 0;
+	tick_t ticks_per_second = time_ticks_per_second();
+
+	for (unsigned int iservice = 0; iservice < stress_services; ++iservice) {
+		string_t name = string_format(stress_service[iservice].str, sizeof(stress_service[iservice].str),
+		                              STRING_CONST("_stress%u._tcp.local."), iservice);
+		stress_service[iservice].length = name.length;
+	}
+	atomic_store32(&stress_stop, 0, memory_order_release);
+
+	tick_t start = time_current();
+	bool publish_started = false;
+	if (publish_mode) {
+		publish = memory_allocate(HASH_MDNS, sizeof(stress_publish_t), 0,
+		                          MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED);
+		publish->latency_capacity = (size_t)stress_qps * (stress_duration + 1);
+		publish->latency = memory_allocate(HASH_MDNS, sizeof(tick_t) * publish->latency_capacity, 0,
+		                                   MEMORY_PERSISTENT);
+		if (stress_publish_initialize(publish) < 0) {
+			result = -1;
+			goto finalize;
+		}
+		thread_initialize(&publish->thread, stress_publish_thread, publish, STRING_CONST("publish"),
+		                  THREAD_PRIORITY_NORMAL, 0);
+		thread_start(&publish->thread);
+		publish_started = true;
+		log_infof(HASH_MDNS, STRING_CONST("Publishing %u services for %u seconds"), stress_services,
+		          stress_duration);
+	}
+
+	if (flood_mode) {
+		// Give the responder a moment to start listening
+		if (publish_mode)
+			thread_sleep(100);
+		log_infof(HASH_MDNS, STRING_CONST("Sending %u queries/s from %u threads for %u seconds"), stress_qps,
+		          stress_threads, stress_duration);
+		for (unsigned int ithread = 0; ithread < stress_threads; ++ithread) {
+			stress_flood_t* thread_flood = memory_allocate(HASH_MDNS, sizeof(stress_flood_t), 0,
+			                                               MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED);
+			flood[flood_count++] = thread_flood;
+			thread_flood->querier = ithread + 1;
+			thread_flood->pending_tick = memory_allocate(HASH_MDNS, sizeof(tick_t) * stress_services, 0,
+			                                             MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED);
+			thread_flood->pending_count = memory_allocate(HASH_MDNS, sizeof(size_t) * stress_services, 0,
+			                                              MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED);
+			thread_flood->latency_capacity = ((size_t)stress_qps * stress_duration) / stress_threads + 1;
+			thread_flood->latency = memory_allocate(HASH_MDNS, sizeof(tick_t) * thread_flood->latency_capacity, 0,
+			                                        MEMORY_PERSISTENT);
+			thread_flood->sock = udp_socket_allocate();
+			if (!thread_flood->sock || !stress_socket_bind(thread_flood->sock)) {
+				log_error(HASH_MDNS, ERROR_SYSTEM_CALL_FAIL, STRING_CONST("Failed to bind mDNS query socket"));
+				result = -1;
+				goto finalize;
+			}
+		}
+		for (size_t iflood = 0; iflood < flood_count; ++iflood) {
+			thread_initialize(&flood[iflood]->thread, stress_flood_thread, flood[iflood], STRING_CONST("flood"),
+			                  THREAD_PRIORITY_NORMAL, 0);
+			thread_start(&flood[iflood]->thread);
+		}
+		for (size_t iflood = 0; iflood < flood_count; ++iflood) {
+			thread_join(&flood[iflood]->thread);
+			thread_finalize(&flood[iflood]->thread);
+		}
+		stress_flood_report(flood, flood_count);
+	} else {
+		while (time_current() - start < ticks_per_second * (tick_t)stress_duration)
+			thread_sleep(100);
+	}
+
+finalize:
+	atomic_store32(&stress_stop, 1, memory_order_release);
+	if (publish) {
+		if (publish_started) {
+			thread_join(&publish->thread);
+			thread_finalize(&publish->thread);
+			if (!result)
+				stress_publish_report(publish, time_elapsed(start));
+		}
+		stress_publish_finalize(publish);
+		memory_deallocate(publish->latency);
+		memory_deallocate(publish);
+	}
+	for (size_t iflood = 0; iflood < flood_count; ++iflood) {
+		if (flood[iflood]->sock)
+			socket_deallocate(flood[iflood]->sock);
+		memory_deallocate(flood[iflood]->latency);
+		memory_deallocate(flood[iflood]->pending_count);
+		memory_deallocate(flood[iflood]->pending_tick);
+		memory_deallocate(flood[iflood]);
+	}
+
+	return result;
+}
+
 int
 main_initialize(void) {
 	int ret = 0;
@@ -97,9 +602,43 @@ main_initialize(void) {
 int
 main_run(void* main_arg) {
 	int result = 0;
+	mdns_loop_t* loop = 0;
 
 	FOUNDATION_UNUSED(main_arg);
 
+	bool flood_mode = false;
+	bool publish_mode = false;
+	const string_const_t* cmdline = environment_command_line();
+	for (size_t iarg = 1, asize = array_size(cmdline); iarg < asize; ++iarg) {
+		if (string_equal(STRING_ARGS(cmdline[iarg]), STRING_CONST("--flood"))) {
+			flood_mode = true;
+		} else if (string_equal(STRING_ARGS(cmdline[iarg]), STRING_CONST("--publish"))) {
+			publish_mode = true;
+		} else if (iarg + 1 < asize) {
+			unsigned int value = string_to_uint(STRING_ARGS(cmdline[iarg + 1]), false);
+			if (string_equal(STRING_ARGS(cmdline[iarg]), STRING_CONST("--qps")))
+				stress_qps = value;
+			else if (string_equal(STRING_ARGS(cmdline[iarg]), STRING_CONST("--threads")))
+				stress_threads = value;
+			else if (string_equal(STRING_ARGS(cmdline[iarg]), STRING_CONST("--services")))
+				stress_services = value;
+			else if (string_equal(STRING_ARGS(cmdline[iarg]), STRING_CONST("--duration")))
+				stress_duration = value;
+			else
+				continue;
+			++iarg;
+		}
+	}
+	if (flood_mode || publish_mode) {
+		if (!stress_qps || !stress_threads || (stress_threads > STRESS_THREADS_MAX) || !stress_services ||
+		    (stress_services > STRESS_SERVICES_MAX) || !stress_duration) {
+			log_info(HASH_MDNS, STRING_CONST("Usage: mdns [--flood] [--publish] [--qps <count>] [--threads <1-64>] "
+			                                 "[--services <1-1024>] [--duration <seconds>]"));
+			return -1;
+		}
+		return stress_run(flood_mode, publish_mode);
+	}
+
 	socket_t* sock = udp_socket_allocate();
 	if (!sock)
 		return -1;
@@ -116,13 +655,19 @@ main_run(void* main_arg) {
 		goto finalize;
 	}
 
-	log_infof(HASH_MDNS, STRING_CONST("Reading DNS-SD responses\n"));
-	for (int iloop = 0; iloop < 10; ++iloop) {
-		mdns_discovery_recv(sock, recvbuffer, sizeof(recvbuffer), query_callback, 0);
-		thread_sleep(1000);
+	loop = mdns_loop_allocate();
+	if (!loop || (mdns_loop_add_socket(loop, sock, MDNS_LOOP_DISCOVERY, recvbuffer, sizeof(recvbuffer),
+	                                   query_callback, 0) < 0)) {
+		log_error(HASH_MDNS, ERROR_SYSTEM_CALL_FAIL, STRING_CONST("Failed to create mDNS event loop"));
+		result = -1;
+		goto finalize;
 	}
 
+	log_infof(HASH_MDNS, STRING_CONST("Reading DNS-SD responses\n"));
+	mdns_loop_run(loop, 10000);
+
 finalize:
+	mdns_loop_deallocate(loop);
 	if (sock)
 		socket_deallocate(sock);
 
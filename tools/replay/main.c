@@ -0,0 +1,530 @@
+/* main.c  -  mDNS library capture replay  -  Public Domain  -  2014 Mattias Jansson
+ *
+ * This library provides a cross-platform mDNS and DNS-SD library in C based
+ * on our foundation and network libraries. The implementation is based on RFC 6762
+ * and RFC 6763.
+ *
+ * The latest source code maintained by Mattias Jansson is always available at
+ *
+ * https://github.com/mjansson/mdns_lib
+ *
+ * The foundation and network library source code maintained by Mattias Jansson
+ * is always available at
+ *
+ * https://github.com/mjansson/foundation_lib
+ * https://github.com/mjansson/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify
+ * it without any restrictions.
+ *
+ */
+
+#include <foundation/foundation.h>
+#include <network/network.h>
+#include <mdns/mdns.h>
+
+#include <stdlib.h>
+
+// Replays the UDP port 5353 payloads of a pcap or pcapng capture through the parse functions used by
+// mdns_service_listen and mdns_query_recv, as fast as possible or at the original timing
+#define REPLAY_PAYLOAD_MAX 9216
+#define REPLAY_INTERFACES_MAX 16
+
+#define REPLAY_LINKTYPE_NULL 0
+#define REPLAY_LINKTYPE_ETHERNET 1
+#define REPLAY_LINKTYPE_RAW 101
+#define REPLAY_LINKTYPE_LOOP 108
+#define REPLAY_LINKTYPE_LINUX_SLL 113
+#define REPLAY_LINKTYPE_IPV4 228
+#define REPLAY_LINKTYPE_IPV6 229
+#define REPLAY_LINKTYPE_LINUX_SLL2 276
+
+typedef struct replay_t replay_t;
+typedef struct replay_interface_t replay_interface_t;
+
+struct replay_interface_t {
+	uint16_t linktype;
+	// Timestamp units per second
+	uint64_t resolution;
+};
+
+struct replay_t {
+	// Options
+	bool timing;
+	unsigned int loops;
+	// Byte order of the capture differs from the host
+	bool swap;
+	replay_interface_t interface[REPLAY_INTERFACES_MAX];
+	size_t interface_count;
+	// Timestamp of the first packet in nanoseconds and the tick it was replayed at
+	uint64_t first_timestamp;
+	tick_t first_tick;
+	bool started;
+	// Datagram fed to the parse functions, buffer is 32 bit aligned
+	mdns_datagram_t datagram;
+	uint32_t buffer[REPLAY_PAYLOAD_MAX / 4];
+	// Parse time of each packet in ticks
+	tick_t* latency;
+	size_t latency_capacity;
+	// Counters
+	size_t frames;
+	size_t skipped;
+	size_t packets;
+	size_t queries;
+	size_t responses;
+	size_t records;
+	size_t bytes;
+	tick_t parse_ticks;
+};
+
+static replay_t replay;
+
+static uint16_t
+replay_read16(const uint8_t* data, bool swap) {
+	uint16_t value;
+	memcpy(&value, data, sizeof(value));
+	return swap ? (uint16_t)((value >> 8) | (value << 8)) : value;
+}
+
+static uint32_t
+replay_read32(const uint8_t* data, bool swap) {
+	uint32_t value;
+	memcpy(&value, data, sizeof(value));
+	if (swap)
+		value = ((value >> 24) & 0xFF) | ((value >> 8) & 0xFF00) | ((value << 8) & 0xFF0000) | (value << 24);
+	return value;
+}
+
+static uint16_t
+replay_read16_network(const uint8_t* data) {
+	return (uint16_t)((data[0] << 8) | data[1]);
+}
+
+// Extract the UDP payload of a mDNS packet from an IPv4 or IPv6 packet, setting the source address.
+// Fragmented packets are skipped. Returns true if the packet is UDP to or from port 5353
+static bool
+replay_ip_payload(const uint8_t* ip, size_t length, mdns_datagram_t* datagram) {
+	const uint8_t* udp = 0;
+	size_t udp_length = 0;
+	if ((length >= 20) && ((ip[0] >> 4) == 4)) {
+		size_t header_length = (size_t)(ip[0] & 0x0F) * 4;
+		size_t total_length = replay_read16_network(ip + 2);
+		if ((ip[9] != 17) || (header_length < 20) || (total_length > length) || (total_length < header_length) ||
+		    (replay_read16_network(ip + 6) & 0x3FFF))
+			return false;
+		udp = ip + header_length;
+		udp_length = total_length - header_length;
+
+		network_address_ipv4_initialize(&datagram->address.ipv4);
+		struct sockaddr_in* saddr = &datagram->address.ipv4.saddr;
+		saddr->sin_family = AF_INET;
+		memcpy(&saddr->sin_addr.s_addr, ip + 12, 4);
+		datagram->from = (const network_address_t*)&datagram->address.ipv4;
+	} else if ((length >= 40) && ((ip[0] >> 4) == 6)) {
+		// Skip hop-by-hop, routing and destination option headers
+		uint8_t next_header = ip[6];
+		size_t offset = 40;
+		while (((next_header == 0) || (next_header == 43) || (next_header == 60)) && (offset + 8 <= length)) {
+			next_header = ip[offset];
+			offset += ((size_t)ip[offset + 1] + 1) * 8;
+		}
+		size_t total_length = 40 + (size_t)replay_read16_network(ip + 4);
+		if ((next_header != 17) || (total_length > length) || (offset > total_length))
+			return false;
+		udp = ip + offset;
+		udp_length = total_length - offset;
+
+		network_address_ipv6_initialize(&datagram->address.ipv6);
+		struct sockaddr_in6* saddr = &datagram->address.ipv6.saddr;
+		saddr->sin6_family = AF_INET6;
+		memcpy(&saddr->sin6_addr, ip + 8, 16);
+		datagram->from = (const network_address_t*)&datagram->address.ipv6;
+	} else {
+		return false;
+	}
+
+	if (udp_length < 8)
+		return false;
+	uint16_t source_port = replay_read16_network(udp);
+	uint16_t dest_port = replay_read16_network(udp + 2);
+	size_t payload_length = replay_read16_network(udp + 4);
+	if (((source_port != MDNS_PORT) && (dest_port != MDNS_PORT)) || (payload_length < 8) ||
+	    (payload_length > udp_length))
+		return false;
+	payload_length -= 8;
+	if (payload_length > datagram->capacity)
+		return false;
+
+	network_address_ip_set_port((network_address_t*)datagram->from, source_port);
+	memcpy(datagram->buffer, udp + 8, payload_length);
+	datagram->size = payload_length;
+	return true;
+}
+
+// Find the IP packet in a link layer frame
+static bool
+replay_frame_payload(const uint8_t* frame, size_t length, uint16_t linktype, mdns_datagram_t* datagram) {
+	switch (linktype) {
+		case REPLAY_LINKTYPE_ETHERNET: {
+			size_t offset = 12;
+			uint16_t ethertype = (length >= 14) ? replay_read16_network(frame + offset) : 0;
+			// Skip 802.1Q and 802.1ad VLAN tags
+			while (((ethertype == 0x8100) || (ethertype == 0x88A8)) && (offset + 6 <= length)) {
+				offset += 4;
+				ethertype = replay_read16_network(frame + offset);
+			}
+			if ((ethertype != 0x0800) && (ethertype != 0x86DD))
+				return false;
+			return replay_ip_payload(frame + offset + 2, length - (offset + 2), datagram);
+		}
+
+		case REPLAY_LINKTYPE_NULL:
+		case REPLAY_LINKTYPE_LOOP:
+			// Address family header, IPv4 or IPv6 is told apart by the IP version
+			return (length > 4) && replay_ip_payload(frame + 4, length - 4, datagram);
+
+		case REPLAY_LINKTYPE_LINUX_SLL:
+			return (length > 16) && replay_ip_payload(frame + 16, length - 16, datagram);
+
+		case REPLAY_LINKTYPE_LINUX_SLL2:
+			return (length > 20) && replay_ip_payload(frame + 20, length - 20, datagram);
+
+		case REPLAY_LINKTYPE_RAW:
+		case REPLAY_LINKTYPE_IPV4:
+		case REPLAY_LINKTYPE_IPV6:
+			return replay_ip_payload(frame, length, datagram);
+
+		default:
+			break;
+	}
+	return false;
+}
+
+static int
+replay_callback(socket_t* sock, const network_address_t* from, mdns_entry_type_t entry, uint16_t query_id,
+                uint16_t rtype, uint16_t rclass, uint32_t ttl, const void* data, size_t size, size_t name_offset,
+                size_t name_length, size_t record_offset, size_t record_length, void* user_data) {
+	(void)sizeof(sock);
+	(void)sizeof(from);
+	(void)sizeof(query_id);
+	(void)sizeof(rtype);
+	(void)sizeof(rclass);
+	(void)sizeof(ttl);
+	(void)sizeof(data);
+	(void)sizeof(size);
+	(void)sizeof(name_offset);
+	(void)sizeof(name_length);
+	(void)sizeof(record_offset);
+	(void)sizeof(record_length);
+	if (entry != MDNS_ENTRYTYPE_END)
+		++*(size_t*)user_data;
+	return 0;
+}
+
+// Wait until the time the packet was captured at, relative to the first packet
+static void
+replay_wait(uint64_t timestamp) {
+	if (!replay.started) {
+		replay.first_timestamp = timestamp;
+		replay.first_tick = time_current();
+		replay.started = true;
+		return;
+	}
+	if (timestamp <= replay.first_timestamp)
+		return;
+	uint64_t delta = timestamp - replay.first_timestamp;
+	uint64_t ticks_per_second = (uint64_t)time_ticks_per_second();
+	tick_t target = replay.first_tick + (tick_t)((delta / 1000000000ULL) * ticks_per_second +
+	                                              ((delta % 1000000000ULL) * ticks_per_second) / 1000000000ULL);
+	tick_t now = time_current();
+	while (now < target) {
+		if ((target - now) > (tick_t)(ticks_per_second / 500))
+			thread_sleep(1);
+		else
+			thread_yield();
+		now = time_current();
+	}
+}
+
+static void
+replay_frame(uint64_t timestamp, const uint8_t* frame, size_t length, uint16_t linktype) {
+	++replay.frames;
+	mdns_datagram_t* datagram = &replay.datagram;
+	if (!replay_frame_payload(frame, length, linktype, datagram) || (datagram->size < 12)) {
+		++replay.skipped;
+		return;
+	}
+	if (replay.timing)
+		replay_wait(timestamp);
+
+	// Queries go through the responder parse path, responses through the querier parse path
+	const uint8_t* header = (const uint8_t*)datagram->buffer;
+	bool response = (header[2] & 0x80) != 0;
+	size_t records = 0;
+	tick_t start = time_current();
+	if (response)
+		mdns_query_parse(0, datagram->from, datagram->buffer, datagram->size, replay_callback, &records, 0);
+	else
+		mdns_service_parse(0, datagram->from, datagram->buffer, datagram->size, replay_callback, &records);
+	tick_t elapsed = time_current() - start;
+
+	replay.parse_ticks += elapsed;
+	if (replay.packets < replay.latency_capacity)
+		replay.latency[replay.packets] = elapsed;
+	++replay.packets;
+	replay.records += records;
+	replay.bytes += datagram->size;
+	if (response)
+		++replay.responses;
+	else
+		++replay.queries;
+}
+
+// Classic pcap, with microsecond or nanosecond timestamps in either byte order
+static int
+replay_pcap(const uint8_t* data, size_t size) {
+	uint32_t magic = replay_read32(data, false);
+	bool nanoseconds = (magic == 0xA1B23C4DU) || (magic == 0x4D3CB2A1U);
+	replay.swap = (magic == 0xD4C3B2A1U) || (magic == 0x4D3CB2A1U);
+	uint16_t linktype = (uint16_t)replay_read32(data + 20, replay.swap);
+
+	size_t offset = 24;
+	while (offset + 16 <= size) {
+		uint64_t seconds = replay_read32(data + offset, replay.swap);
+		uint64_t fraction = replay_read32(data + offset + 4, replay.swap);
+		size_t length = replay_read32(data + offset + 8, replay.swap);
+		offset += 16;
+		if (length > size - offset) {
+			log_warnf(HASH_MDNS, WARNING_SUSPICIOUS, STRING_CONST("Truncated capture record at offset %u"),
+			          (unsigned int)offset);
+			break;
+		}
+		uint64_t timestamp = (seconds * 1000000000ULL) + (nanoseconds ? fraction : fraction * 1000ULL);
+		replay_frame(timestamp, data + offset, length, linktype);
+		offset += length;
+	}
+	return 0;
+}
+
+// Interface description options, only the timestamp resolution is used
+static void
+replay_pcapng_interface(const uint8_t* block, size_t length) {
+	if ((length < 20) || (replay.interface_count >= REPLAY_INTERFACES_MAX))
+		return;
+	replay_interface_t* interface = replay.interface + replay.interface_count++;
+	interface->linktype = replay_read16(block + 8, replay.swap);
+	interface->resolution = 1000000;
+
+	size_t offset = 16;
+	while (offset + 4 <= length - 4) {
+		uint16_t code = replay_read16(block + offset, replay.swap);
+		size_t option_length = replay_read16(block + offset + 2, replay.swap);
+		offset += 4;
+		if (!code || (offset + option_length > length - 4))
+			break;
+		if ((code == 9) && (option_length >= 1)) {
+			// if_tsresol, a negative power of ten or of two if the high bit is set
+			uint8_t tsresol = block[offset];
+			uint64_t resolution = 1;
+			for (unsigned int iexp = 0; iexp < (tsresol & 0x7F) && (iexp < 63); ++iexp)
+				resolution *= (tsresol & 0x80) ? 2 : 10;
+			interface->resolution = resolution;
+		}
+		offset += (option_length + 3) & ~(size_t)3;
+	}
+}
+
+static int
+replay_pcapng(const uint8_t* data, size_t size) {
+	size_t offset = 0;
+	while (offset + 12 <= size) {
+		const uint8_t* block = data + offset;
+		uint32_t type = replay_read32(block, replay.swap);
+		if (type == 0x0A0D0D0AU) {
+			// Section header, the byte order magic tells the byte order of the section
+			replay.swap = (replay_read32(block + 8, false) != 0x1A2B3C4DU);
+			replay.interface_count = 0;
+		}
+		size_t length = replay_read32(block + 4, replay.swap);
+		if ((length < 12) || (length > size - offset)) {
+			log_warnf(HASH_MDNS, WARNING_SUSPICIOUS, STRING_CONST("Truncated capture block at offset %u"),
+			          (unsigned int)offset);
+			break;
+		}
+
+		if (type == 1) {
+			replay_pcapng_interface(block, length);
+		} else if ((type == 6) && (length >= 32)) {
+			// Enhanced packet block
+			size_t interface_id = replay_read32(block + 8, replay.swap);
+			uint64_t ts = ((uint64_t)replay_read32(block + 12, replay.swap) << 32) |
+			              (uint64_t)replay_read32(block + 16, replay.swap);
+			size_t captured = replay_read32(block + 20, replay.swap);
+			if ((interface_id < replay.interface_count) && (captured <= length - 32)) {
+				const replay_interface_t* interface = replay.interface + interface_id;
+				uint64_t timestamp = (ts / interface->resolution) * 1000000000ULL +
+				                     ((ts % interface->resolution) * 1000000000ULL) / interface->resolution;
+				replay_frame(timestamp, block + 28, captured, interface->linktype);
+			}
+		} else if ((type == 3) && (length >= 16) && replay.interface_count) {
+			// Simple packet block, captured on the first interface without a timestamp
+			size_t captured = replay_read32(block + 8, replay.swap);
+			if (captured > length - 16)
+				captured = length - 16;
+			replay_frame(0, block + 12, captured, replay.interface[0].linktype);
+		}
+		offset += length;
+	}
+	return 0;
+}
+
+static int
+replay_tick_compare(const void* lhs, const void* rhs) {
+	tick_t lhs_tick = *(const tick_t*)lhs;
+	tick_t rhs_tick = *(const tick_t*)rhs;
+	return (lhs_tick < rhs_tick) ? -1 : ((lhs_tick > rhs_tick) ? 1 : 0);
+}
+
+static double
+replay_percentile(size_t count, double percentile) {
+	if (!count)
+		return 0;
+	size_t index = (size_t)(percentile * (double)(count - 1) + 0.5);
+	return ((double)replay.latency[index] * 1000000000.0) / (double)time_ticks_per_second();
+}
+
+static void
+replay_report(deltatime_t wall) {
+	double parse_seconds = (double)replay.parse_ticks / (double)time_ticks_per_second();
+	log_infof(HASH_MDNS,
+	          STRING_CONST("Replayed %u packets (%u queries, %u responses) with %u records and %u bytes from %u "
+	                       "frames, %u frames skipped, in %.3f s"),
+	          (unsigned int)replay.packets, (unsigned int)replay.queries, (unsigned int)replay.responses,
+	          (unsigned int)replay.records, (unsigned int)replay.bytes, (unsigned int)replay.frames,
+	          (unsigned int)replay.skipped, (double)wall);
+	if (!replay.packets || (parse_seconds <= 0))
+		return;
+
+	log_infof(HASH_MDNS, STRING_CONST("Parse throughput %.0f packets/s, %.0f records/s, %.1f MiB/s"),
+	          (double)replay.packets / parse_seconds, (double)replay.records / parse_seconds,
+	          ((double)replay.bytes / parse_seconds) / (1024.0 * 1024.0));
+
+	size_t count = (replay.packets < replay.latency_capacity) ? replay.packets : replay.latency_capacity;
+	qsort(replay.latency, count, sizeof(tick_t), replay_tick_compare);
+	log_infof(HASH_MDNS,
+	          STRING_CONST("Parse latency per packet p50 %.0f ns, p90 %.0f ns, p99 %.0f ns, p99.9 %.0f ns, "
+	                       "max %.0f ns"),
+	          replay_percentile(count, 0.5), replay_percentile(count, 0.9), replay_percentile(count, 0.99),
+	          replay_percentile(count, 0.999), replay_percentile(count, 1.0));
+}
+
+int
+main_initialize(void) {
+	int ret = 0;
+	application_t application = {0};
+	foundation_config_t config = {0};
+
+	application.name = string_const(STRING_CONST("replay-mdns"));
+	application.short_name = string_const(STRING_CONST("replay-mdns"));
+	application.flags = APPLICATION_UTILITY;
+
+	log_enable_prefix(false);
+	log_set_suppress(0, ERRORLEVEL_WARNING);
+
+	if ((ret = foundation_initialize(memory_system_malloc(), application, config)) < 0)
+		return ret;
+
+	network_config_t network_config = {0};
+	if ((ret = network_module_initialize(network_config)) < 0)
+		return ret;
+
+	mdns_config_t mdns_config = {0};
+	if ((ret = mdns_module_initialize(mdns_config)) < 0)
+		return ret;
+
+	return 0;
+}
+
+int
+main_run(void* main_arg) {
+	int result = 0;
+	string_const_t path = {0, 0};
+	uint8_t* data = 0;
+	stream_t* stream = 0;
+
+	FOUNDATION_UNUSED(main_arg);
+
+	replay.loops = 1;
+	const string_const_t* cmdline = environment_command_line();
+	for (size_t iarg = 1, asize = array_size(cmdline); iarg < asize; ++iarg) {
+		if (string_equal(STRING_ARGS(cmdline[iarg]), STRING_CONST("--timing"))) {
+			replay.timing = true;
+		} else if (string_equal(STRING_ARGS(cmdline[iarg]), STRING_CONST("--loop")) && (iarg + 1 < asize)) {
+			++iarg;
+			replay.loops = string_to_uint(STRING_ARGS(cmdline[iarg]), false);
+		} else {
+			path = cmdline[iarg];
+		}
+	}
+	if (!path.length || !replay.loops) {
+		log_info(HASH_MDNS, STRING_CONST("Usage: replay-mdns [--timing] [--loop <count>] <file.pcap|file.pcapng>"));
+		return -1;
+	}
+
+	stream = stream_open(STRING_ARGS(path), STREAM_IN | STREAM_BINARY);
+	size_t size = stream ? stream_size(stream) : 0;
+	if (size < 24) {
+		log_errorf(HASH_MDNS, ERROR_INVALID_VALUE, STRING_CONST("Failed to read capture file: %.*s"),
+		           STRING_FORMAT(path));
+		result = -1;
+		goto finalize;
+	}
+	data = memory_allocate(HASH_MDNS, size, 0, MEMORY_PERSISTENT);
+	if (stream_read(stream, data, size) != size) {
+		log_errorf(HASH_MDNS, ERROR_SYSTEM_CALL_FAIL, STRING_CONST("Failed to read capture file: %.*s"),
+		           STRING_FORMAT(path));
+		result = -1;
+		goto finalize;
+	}
+
+	// Every record holds at least a 16 byte header and a minimal IPv4 and UDP header
+	replay.latency_capacity = (size / (16 + 28)) * replay.loops + 1;
+	replay.latency = memory_allocate(HASH_MDNS, sizeof(tick_t) * replay.latency_capacity, 0, MEMORY_PERSISTENT);
+	replay.datagram.buffer = replay.buffer;
+	replay.datagram.capacity = sizeof(replay.buffer);
+
+	uint32_t magic = replay_read32(data, false);
+	bool pcapng = (magic == 0x0A0D0D0AU);
+	if (!pcapng && (magic != 0xA1B2C3D4U) && (magic != 0xD4C3B2A1U) && (magic != 0xA1B23C4DU) &&
+	    (magic != 0x4D3CB2A1U)) {
+		log_errorf(HASH_MDNS, ERROR_MALFORMED_DATA, STRING_CONST("Not a pcap or pcapng file: %.*s"),
+		           STRING_FORMAT(path));
+		result = -1;
+		goto finalize;
+	}
+
+	tick_t start = time_current();
+	for (unsigned int iloop = 0; iloop < replay.loops; ++iloop) {
+		replay.started = false;
+		if (pcapng)
+			replay_pcapng(data, size);
+		else
+			replay_pcap(data, size);
+	}
+	replay_report(time_elapsed(start));
+
+finalize:
+	memory_deallocate(replay.latency);
+	memory_deallocate(data);
+	if (stream)
+		stream_deallocate(stream);
+
+	return result;
+}
+
+void
+main_finalize(void) {
+	mdns_module_finalize();
+	network_module_finalize();
+	foundation_finalize();
+}